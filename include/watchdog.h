@@ -10,9 +10,35 @@
 */
 
 #include <linux/watchdog.h>
+#include <stdint.h>
 
 typedef int watchdog_t;
 
+/* Snapshot fields */
+#define WD_SNAP_TIMEOUT     (1U << 0)
+#define WD_SNAP_PRETIMEOUT  (1U << 1)
+#define WD_SNAP_TIMELEFT    (1U << 2)
+#define WD_SNAP_BOOTSTATUS  (1U << 3)
+#define WD_SNAP_STATUS      (1U << 4)
+#define WD_SNAP_TEMP        (1U << 5)
+#define WD_SNAP_INFO        (1U << 6)
+#define WD_SNAP_ALL         (WD_SNAP_TIMEOUT | WD_SNAP_PRETIMEOUT | WD_SNAP_TIMELEFT | \
+                             WD_SNAP_BOOTSTATUS | WD_SNAP_STATUS | WD_SNAP_TEMP | WD_SNAP_INFO)
+
+struct wd_snapshot
+{
+    uint64_t                timestamp_ns;   /* CLOCK_MONOTONIC time of sample */
+    unsigned int            valid;          /* WD_SNAP_* fields read successfully */
+    unsigned int            unsupported;    /* WD_SNAP_* fields not supported by driver */
+    unsigned int            timeout;
+    unsigned int            pretimeout;
+    unsigned int            timeleft;
+    int                     bootstatus;
+    int                     status;
+    int                     temp;
+    struct watchdog_info    info;
+};
+
 /*
     Open Watchdog device
 
@@ -37,6 +63,19 @@ watchdog_t wd_open(const char *dev);
 */
 int wd_close(watchdog_t wd);
 
+/*
+    Release Watchdog device without magic close,
+    so WatchDog is still running and will reset system if nobody feeds it
+
+    PARAMS
+    @IN wd - wd descriptor
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int wd_release(watchdog_t wd);
+
 /*
     Get Timeout from WatchDog
 
@@ -200,6 +239,33 @@ void wd_print_decoded_flag(int flag);
 */
 int wd_get_info(watchdog_t wd, struct watchdog_info *wd_info);
 
+/*
+    Get requested WatchDog state at once.
+    Fields not supported by driver are marked in snap->unsupported
+    and skipped in next snapshots of the same descriptor.
+
+    PARAMS
+    @IN wd - watchdog descriptor
+    @OUT snap - snapshot
+    @IN fields_mask - WD_SNAP_* fields to read
+
+    RETURN
+    0 iff every requested field is valid or unsupported
+    Non-zero iff failure
+*/
+int wd_get_snapshot(watchdog_t wd, struct wd_snapshot *snap, unsigned int fields_mask);
+
+/*
+    Print WatchDog snapshot
+
+    PARAMS
+    @IN snap - pointer to snapshot
+
+    RETURN
+    This is a void function
+*/
+void wd_print_snapshot(const struct wd_snapshot *snap);
+
 /*
     Print WatchDog info
 
@@ -0,0 +1,136 @@
+#ifndef WD_BACKEND_H
+#define WD_BACKEND_H
+
+/*
+    WatchDog backends.
+
+    watchdog_t is a handle to backend instance, every wd_* call
+    goes through backend ops table. Available backends:
+    - chardev: kernel /dev/watchdogN (ioctl)
+    - sysfs: read-only /sys/class/watchdog/watchdogN
+    - sim: in-process simulated watchdog (see wd_sim.h)
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <watchdog.h>
+#include <stdbool.h>
+
+#define WD_BACKEND_SIM_PREFIX   "sim:"
+#define WD_BACKEND_SYSFS_PREFIX "/sys/"
+
+typedef enum
+{
+    WD_BACKEND_AUTO = 0,    /* guess from device path */
+    WD_BACKEND_CHARDEV,
+    WD_BACKEND_SYSFS,
+    WD_BACKEND_SIM
+} wd_backend_type_t;
+
+/* Backend operations, used as bit numbers in masks */
+typedef enum
+{
+    WD_OP_KEEPALIVE = 0,
+    WD_OP_GET_TIMEOUT,
+    WD_OP_SET_TIMEOUT,
+    WD_OP_GET_PRETIMEOUT,
+    WD_OP_SET_PRETIMEOUT,
+    WD_OP_GET_TIMELEFT,
+    WD_OP_GET_BOOTSTATUS,
+    WD_OP_GET_STATUS,
+    WD_OP_GET_TEMP,
+    WD_OP_SET_OPTIONS,
+    WD_OP_GET_INFO,
+    WD_OP_MAX
+} wd_op_t;
+
+#define WD_OP_BIT(op)   (1U << (op))
+
+/* Backend instance state */
+struct wd_backend_ctx
+{
+    int     fd;     /* descriptor or -1 if backend has none */
+    void    *priv;  /* backend private data */
+};
+
+/*
+    Every op returns 0 iff success, -errno iff failure.
+    NULL op means not supported (-EOPNOTSUPP).
+*/
+struct wd_backend_ops
+{
+    const char  *name;
+
+    int (*open)(struct wd_backend_ctx *ctx, const char *dev);
+    int (*close)(struct wd_backend_ctx *ctx, bool magic);
+    int (*keepalive)(struct wd_backend_ctx *ctx);
+    int (*get_timeout)(struct wd_backend_ctx *ctx, unsigned int *timeout);
+    int (*set_timeout)(struct wd_backend_ctx *ctx, unsigned int timeout);
+    int (*get_pretimeout)(struct wd_backend_ctx *ctx, unsigned int *timeout);
+    int (*set_pretimeout)(struct wd_backend_ctx *ctx, unsigned int timeout);
+    int (*get_timeleft)(struct wd_backend_ctx *ctx, unsigned int *time);
+    int (*get_bootstatus)(struct wd_backend_ctx *ctx, int *status);
+    int (*get_status)(struct wd_backend_ctx *ctx, int *status);
+    int (*get_temp)(struct wd_backend_ctx *ctx, int *temp);
+    int (*set_options)(struct wd_backend_ctx *ctx, int options);
+    int (*get_info)(struct wd_backend_ctx *ctx, struct watchdog_info *wd_info);
+};
+
+extern const struct wd_backend_ops wd_backend_chardev;
+extern const struct wd_backend_ops wd_backend_sysfs;
+extern const struct wd_backend_ops wd_backend_sim;
+
+/*
+    Open WatchDog with given backend
+
+    PARAMS
+    @IN type - backend type
+    @IN dev - device (path or sim:[opts]), NULL means default device
+
+    RETURN
+    -1 iff failure
+    WD descriptior iff success
+*/
+watchdog_t wd_open_backend(wd_backend_type_t type, const char *dev);
+
+/*
+    Adopt already opened WatchDog character device (e.g. received over SCM_RIGHTS),
+    descriptor is owned by returned handle
+
+    PARAMS
+    @IN fd - descriptor of opened /dev/watchdogN
+
+    RETURN
+    -1 iff failure
+    WD descriptior iff success
+*/
+watchdog_t wd_open_fd(int fd);
+
+/*
+    Get backend private data
+
+    PARAMS
+    @IN wd - watchdog descriptor
+    @IN ops - expected backend
+
+    RETURN
+    NULL iff wd is not valid or uses other backend
+    Pointer to private data iff success
+*/
+void *wd_backend_priv(watchdog_t wd, const struct wd_backend_ops *ops);
+
+/*
+    Get descriptor used by backend
+
+    PARAMS
+    @IN wd - watchdog descriptor
+
+    RETURN
+    -1 iff backend has no descriptor
+    Descriptor iff success
+*/
+int wd_get_fd(watchdog_t wd);
+
+#endif
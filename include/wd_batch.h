@@ -0,0 +1,117 @@
+#ifndef WD_BATCH_H
+#define WD_BATCH_H
+
+/*
+    Batch mode, command stream executed against one open descriptor.
+
+    Script is parsed once into compact op list and validated as a whole
+    (syntax, arguments, pretimeout below timeout, driver capabilities)
+    before first op touches the device, so broken script never leaves
+    WatchDog half configured. Ops run in order on one handle, first failure
+    stops the batch. Results are formatted into one buffer.
+    Script: one op per line, "op [arg]" or "op=arg", '#' starts comment,
+        op names are the same as in control socket (get-timeout, set-timeout, snapshot, ...)
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <watchdog.h>
+#include <wd_format.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define WD_BATCH_MAX_OPS        256
+#define WD_BATCH_MAX_SCRIPT     (64 * 1024)
+#define WD_BATCH_LINE_MAX       256
+
+struct wd_batch_op
+{
+    uint16_t    op;         /* wd_op_t or WD_CTL_SNAPSHOT */
+    uint16_t    line;       /* script line, for messages */
+    uint32_t    arg;        /* value for setters */
+    int32_t     err;        /* 0 or errno, valid for executed ops */
+    int64_t     val;        /* value for getters */
+};
+
+struct wd_batch
+{
+    struct wd_batch_op  ops[WD_BATCH_MAX_OPS];
+    size_t              nops;
+    size_t              done;       /* executed ops, failed one included */
+    int                 need;       /* WDIOF_* options required by setters */
+    unsigned int        snaps;      /* snapshot ops, at most one */
+    struct wd_snapshot  snap;       /* result of snapshot op */
+};
+
+/*
+    Parse and validate script, nothing is executed
+
+    PARAMS
+    @OUT batch - batch
+    @IN script - script text
+    @IN len - script length
+
+    RETURN
+    0 iff success
+    Non-zero iff failure (line is logged)
+*/
+int wd_batch_parse(struct wd_batch *batch, const char *script, size_t len);
+
+/*
+    Read whole script and parse it
+
+    PARAMS
+    @OUT batch - batch
+    @IN path - script path, "-" means stdin
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_batch_load(struct wd_batch *batch, const char *path);
+
+/*
+    Check that device supports every setter of batch, nothing is written
+
+    PARAMS
+    @IN batch - parsed batch
+    @IN wd - WatchDog descriptor
+
+    RETURN
+    0 iff success
+    Non-zero iff device lacks capability
+*/
+int wd_batch_check(const struct wd_batch *batch, watchdog_t wd);
+
+/*
+    Execute batch, stops on first failure
+
+    PARAMS
+    @IN batch - parsed and checked batch
+    @IN wd - WatchDog descriptor
+    @OUT out - getter results are merged here (valid bits are set)
+
+    RETURN
+    0 iff every op succeeded
+    Non-zero iff failure, batch->done tells how far it went
+*/
+int wd_batch_run(struct wd_batch *batch, watchdog_t wd, struct wd_snapshot *out);
+
+/*
+    Format results of executed ops as text, one line per op
+
+    PARAMS
+    @IN batch - executed batch
+    @OUT buf - output buffer
+    @IN size - buffer size
+
+    RETURN
+    -1 iff buffer is too small
+    Length of output iff success
+*/
+ssize_t wd_batch_format(const struct wd_batch *batch, char *buf, size_t size);
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef WD_CHECK_H
+#define WD_CHECK_H
+
+/*
+    Health checks gating the feed.
+
+    Checks run on small worker pool, each one again when its TTL expires.
+    Feeder only reads cached results (atomics), so slow check never delays
+    wd_keepalive; check running longer than its deadline counts as failed.
+    Check specs: TYPE:ARG[,deadline=MS][,ttl=MS]
+        disk:DIR        file can be created, written and fsynced in DIR
+        rofs:PATH       filesystem of PATH is not mounted read-only
+        mem:KB          MemAvailable is at least KB
+        pid:PIDFILE     process from PIDFILE is alive
+        exec:CMD        /bin/sh -c CMD exits with 0
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <wd_stats.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define WD_CHECK_MAX                16
+#define WD_CHECK_DEFAULT_WORKERS    2
+#define WD_CHECK_MAX_WORKERS        8
+#define WD_CHECK_DEFAULT_DEADLINE_MS 1000
+#define WD_CHECK_DEFAULT_TTL_MS     5000
+
+typedef enum
+{
+    WD_CHECK_DISK = 0,
+    WD_CHECK_ROFS,
+    WD_CHECK_MEM,
+    WD_CHECK_PID,
+    WD_CHECK_EXEC
+} wd_check_type_t;
+
+typedef enum
+{
+    WD_CHECK_PENDING = 0,   /* not finished yet, does not block feed */
+    WD_CHECK_OK,
+    WD_CHECK_FAIL,
+    WD_CHECK_TIMEOUT
+} wd_check_result_t;
+
+struct wd_check_conf
+{
+    wd_check_type_t type;
+    const char      *arg;
+    uint64_t        deadline_ns;
+    uint64_t        ttl_ns;
+};
+
+struct wd_check
+{
+    struct wd_check_conf conf;
+
+    /* written by worker, read by feeder */
+    uint32_t        result;         /* wd_check_result_t of last finished run */
+    bool            running;
+    uint64_t        started_ns;
+    uint64_t        finished_ns;
+
+    /* counters */
+    uint64_t        runs;
+    uint64_t        failures;
+    uint64_t        timeouts;       /* runs which finished past deadline */
+    struct wd_hist  latency;
+};
+
+struct wd_checks;
+
+/*
+    Parse check spec, spec is modified
+
+    PARAMS
+    @IN spec - TYPE:ARG[,deadline=MS][,ttl=MS]
+    @OUT conf - check config
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_check_parse(char *spec, struct wd_check_conf *conf);
+
+/*
+    Start worker pool running checks
+
+    PARAMS
+    @IN confs - checks
+    @IN n - number of checks
+    @IN workers - number of worker threads, 0 means default
+
+    RETURN
+    NULL iff failure
+    Pointer to pool iff success
+*/
+struct wd_checks *wd_checks_start(const struct wd_check_conf *confs, size_t n, unsigned int workers);
+
+/*
+    Stop workers and free pool, waits only for checks that finish
+
+    PARAMS
+    @IN checks - pool
+
+    RETURN
+    This is a void function
+*/
+void wd_checks_stop(struct wd_checks *checks);
+
+/*
+    Find failed check, lock free, never blocks
+
+    PARAMS
+    @IN checks - pool
+    @IN now - CLOCK_MONOTONIC time
+
+    RETURN
+    NULL iff every check passes (or is pending)
+    Pointer to first failed check
+*/
+const struct wd_check *wd_checks_failed(const struct wd_checks *checks, uint64_t now);
+
+/*
+    Tell whether every check has finished at least once, lock free, never blocks
+
+    PARAMS
+    @IN checks - pool or NULL
+
+    RETURN
+    true iff no check is pending
+*/
+bool wd_checks_settled(const struct wd_checks *checks);
+
+/*
+    Get check
+
+    PARAMS
+    @IN checks - pool
+    @IN i - check index
+
+    RETURN
+    NULL iff there is no such check
+    Pointer to check iff success
+*/
+const struct wd_check *wd_checks_get(const struct wd_checks *checks, size_t i);
+
+/*
+    Get printable check name (TYPE:ARG)
+
+    PARAMS
+    @IN check - check
+    @OUT buf - output buffer
+    @IN size - buffer size
+
+    RETURN
+    buf
+*/
+const char *wd_check_name(const struct wd_check *check, char *buf, size_t size);
+
+/*
+    Get printable result
+
+    PARAMS
+    @IN result - wd_check_result_t
+
+    RETURN
+    Result name
+*/
+const char *wd_check_result_name(unsigned int result);
+
+#endif
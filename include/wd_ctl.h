@@ -0,0 +1,217 @@
+#ifndef WD_CTL_H
+#define WD_CTL_H
+
+/*
+    Control socket of running daemon.
+
+    Daemon owns /dev/watchdog, so other tools talk to it through
+    AF_UNIX SOCK_SEQPACKET socket served from feeder loop.
+    Every message is one datagram, no framing and no partial reads:
+        request  = hdr + cmd[ncmds]
+        response = hdr + res[ncmds] + payload (snapshot, info, ...)
+    Server never blocks, client that does not read its responses is dropped.
+    Structures are in host byte order, socket is local only.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <wd_loop.h>
+#include <wd_backend.h>
+#include <wd_format.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define WD_CTL_MAGIC            0x54434457U /* "WDCT" */
+#define WD_CTL_VERSION          1
+#define WD_CTL_DEFAULT_PATH     "/run/watchdog.ctl"
+#define WD_CTL_MAX_CMDS         64
+#define WD_CTL_MAX_MSG          8192
+#define WD_CTL_MAX_CLIENTS      64
+
+/* control ops, backend ops keep wd_op_t numbers */
+typedef enum
+{
+    WD_CTL_SNAPSHOT = WD_OP_MAX,    /* payload: struct wd_snapshot, cached */
+    WD_CTL_FEED,                    /* payload: struct wd_ctl_feed */
+    WD_CTL_DEVS,                    /* val: number of fed devices */
+    WD_CTL_SOFT_KICK,               /* arg: index of daemon soft timer */
+    WD_CTL_OP_MAX
+} wd_ctl_op_t;
+
+struct wd_ctl_hdr
+{
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    ncmds;      /* cmds in request, results in response */
+    uint32_t    seq;        /* copied from request to response */
+    uint32_t    pad;
+};
+
+struct wd_ctl_cmd
+{
+    uint16_t    op;         /* wd_op_t or wd_ctl_op_t */
+    uint16_t    dev;        /* index of fed device */
+    uint32_t    arg;        /* value for setters */
+};
+
+struct wd_ctl_res
+{
+    uint16_t    op;
+    uint16_t    dev;
+    int32_t     err;        /* 0 or errno */
+    int64_t     val;        /* value for getters */
+    uint32_t    off;        /* payload offset from message start, 0 means none */
+    uint32_t    len;        /* payload length */
+};
+
+/* feeder state of one device */
+struct wd_ctl_feed
+{
+    uint64_t    feeds;
+    uint64_t    errors;
+    uint64_t    withheld;
+    uint64_t    period_ns;
+    uint64_t    next_ns;    /* CLOCK_MONOTONIC time of next feed */
+    uint32_t    timeout;
+    uint32_t    withholding;
+};
+
+/*
+    Execute one command, called from loop thread
+
+    PARAMS
+    @IN arg - user data
+    @IN cmd - command
+    @OUT res - result, op and dev are already set
+    @OUT payload - response payload, res->off and res->len are set by server
+
+    RETURN
+    This is a void function
+*/
+typedef void (*wd_ctl_handler_t)(void *arg, const struct wd_ctl_cmd *cmd, struct wd_ctl_res *res, struct wd_fbuf *payload);
+
+struct wd_ctl_server;
+
+struct wd_ctl_client
+{
+    struct wd_event         ev;
+    struct wd_ctl_server    *server;
+};
+
+struct wd_ctl_server
+{
+    struct wd_event         ev;     /* listening socket */
+    struct wd_loop          *loop;
+    const char              *path;
+    dev_t                   st_dev;     /* socket file, removed on deinit only if still ours */
+    ino_t                   st_ino;
+    wd_ctl_handler_t        handler;
+    void                    *arg;
+    struct wd_ctl_client    clients[WD_CTL_MAX_CLIENTS];
+    uint64_t                requests;
+    uint64_t                dropped;    /* clients dropped because of bad or unread messages */
+    uint8_t                 req[WD_CTL_MAX_MSG];
+    uint8_t                 resp[WD_CTL_MAX_MSG];
+};
+
+/*
+    Listen on path and serve requests in loop, stale socket file is replaced
+
+    PARAMS
+    @OUT server - server to init (must be valid until wd_ctl_server_deinit)
+    @IN path - socket path
+    @IN loop - feeder loop
+    @IN handler - command handler
+    @IN arg - handler user data
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_ctl_server_init(struct wd_ctl_server *server, const char *path, struct wd_loop *loop,
+                       wd_ctl_handler_t handler, void *arg);
+
+/*
+    Close clients and listening socket, remove socket file unless other daemon bound it meanwhile.
+    Server can be zeroed with ev.fd == -1 and never inited
+
+    PARAMS
+    @IN server - server
+
+    RETURN
+    This is a void function
+*/
+void wd_ctl_server_deinit(struct wd_ctl_server *server);
+
+/*
+    Connect to daemon
+
+    PARAMS
+    @IN path - socket path, NULL means default
+
+    RETURN
+    -1 iff failure
+    socket descriptor iff success
+*/
+int wd_ctl_connect(const char *path);
+
+/*
+    Send batch of commands and wait for response
+
+    PARAMS
+    @IN fd - socket from wd_ctl_connect
+    @IN cmds - commands
+    @IN n - number of commands (max WD_CTL_MAX_CMDS)
+    @OUT buf - response message (at least WD_CTL_MAX_MSG bytes)
+    @IN size - size of buf
+
+    RETURN
+    -1 iff failure
+    Length of validated response iff success, results follow header
+*/
+ssize_t wd_ctl_call(int fd, const struct wd_ctl_cmd *cmds, size_t n, void *buf, size_t size);
+
+/*
+    Copy payload of result out of response
+
+    PARAMS
+    @IN msg - response from wd_ctl_call
+    @IN len - length of response
+    @IN res - result from response
+    @OUT out - destination
+    @IN size - expected payload size
+
+    RETURN
+    0 iff success
+    Non-zero iff result has no payload of that size
+*/
+int wd_ctl_payload(const void *msg, size_t len, const struct wd_ctl_res *res, void *out, size_t size);
+
+/*
+    Get name of op, like "get-timeleft" or "snapshot"
+
+    PARAMS
+    @IN op - wd_op_t or wd_ctl_op_t
+
+    RETURN
+    Pointer to static string
+*/
+const char *wd_ctl_op_name(unsigned int op);
+
+/*
+    Parse op name
+
+    PARAMS
+    @IN name - name from wd_ctl_op_name
+    @OUT op - op
+
+    RETURN
+    0 iff success
+    Non-zero iff unknown name
+*/
+int wd_ctl_op_parse(const char *name, unsigned int *op);
+
+#endif
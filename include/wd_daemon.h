@@ -0,0 +1,110 @@
+#ifndef WD_DAEMON_H
+#define WD_DAEMON_H
+
+/*
+    Long running WatchDog feeder / supervisor.
+    Every device is opened once and fed from one timerfd driven epoll loop,
+    each device has own timeout and feed schedule.
+    Magic close is used only on clean shutdown (SIGTERM / SIGINT).
+    SIGUSR1 dumps scheduler counters to log.
+    Every feed is recorded in wd_stats, optionally shared through stats file.
+    With RT hardening (wd_rt) loop does not use heap or stdio,
+    SIGUSR1 dump is skipped then, use stats file instead.
+    With heartbeat registry (wd_heartbeat) keepalive is withheld while any
+    registered client missed its deadline or any health check (wd_check) fails.
+    With PSI triggers (wd_psi) keepalive is withheld while memory, cpu or io
+    pressure lasts longer than hold time.
+    Control socket (wd_ctl) lets other tools query and configure fed devices.
+    With handover socket (wd_handover) new daemon takes devices over from
+    running one without closing them, then listens for next upgrade itself.
+    Boot status history (wd_history) gets one record per device and boot
+    on start, with last feeds of previous boot taken from stats file.
+    Metrics exporter (wd_exporter) serves Prometheus text rendered from
+    snapshot which feed path refreshes right after keepalive.
+    Sampling engine (wd_sample) polls temperature and status of every
+    device on the same loop and fires threshold and rate rules.
+    Soft timers (wd_soft) are critical timers on wheel driven by the loop,
+    kicked through control socket (soft-kick=IDX), keepalive is withheld
+    while any of them is expired.
+    With batched feed (wd_uring) due devices are fed by one io_uring_enter,
+    devices due soon join the batch early, so devices with the same period
+    end up in one batch per tick.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <watchdog.h>
+#include <wd_sched.h>
+#include <wd_stats.h>
+#include <wd_rt.h>
+#include <wd_heartbeat.h>
+#include <wd_check.h>
+#include <wd_psi.h>
+#include <wd_ctl.h>
+#include <wd_handover.h>
+#include <wd_history.h>
+#include <wd_exporter.h>
+#include <wd_sample.h>
+#include <wd_soft.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define WD_DAEMON_MAX_DEVS  32
+#define WD_DAEMON_MAX_SOFT  64
+
+struct wd_daemon_conf
+{
+    const char              *devs[WD_DAEMON_MAX_DEVS];  /* device paths */
+    size_t                  ndevs;                      /* 0 means default device */
+    watchdog_t              wd;                         /* already opened devs[0] or -1 */
+    struct wd_sched_conf    sched;                      /* keepalive scheduling */
+    const char              *stats_path;                /* feed stats file or NULL */
+    unsigned int            near_miss_pct;              /* near miss slack in % of timeout */
+    struct wd_rt_conf       rt;                         /* RT hardening of feeder */
+    uint64_t                run_ns;                     /* stop after, 0 means until signal */
+    bool                    selftest;                   /* fail iff loop took page faults */
+    bool                    heartbeat;                  /* gate keepalive on client heartbeats */
+    const char              *hb_shm;                    /* registry shm name or NULL */
+    struct wd_check_conf    checks[WD_CHECK_MAX];       /* health checks */
+    size_t                  nchecks;
+    unsigned int            check_workers;              /* 0 means default */
+    struct wd_psi_conf      psi[WD_PSI_MAX];            /* pressure triggers */
+    size_t                  npsi;
+    uint64_t                psi_hold_ns;                /* pressure lasting that long starves feed */
+    const char              *ctl_path;                  /* control socket or NULL */
+    const char              *handover_path;             /* take over from / hand over to, or NULL */
+    const char              *history_path;              /* boot status history or NULL */
+    struct wd_exporter_conf metrics;                    /* exporter, off unless listen or path is set */
+    struct wd_sample_conf   sample;                     /* temperature and status sampling */
+    bool                    uring;                      /* batched feed by io_uring writes */
+    uint64_t                soft_ns[WD_DAEMON_MAX_SOFT];  /* soft timer timeouts */
+    size_t                  nsoft;
+};
+
+/*
+    Init daemon config with default values
+
+    PARAMS
+    @OUT conf - config
+
+    RETURN
+    This is a void function
+*/
+void wd_daemon_conf_init(struct wd_daemon_conf *conf);
+
+/*
+    Run feeder until SIGTERM / SIGINT or until conf->run_ns elapsed
+
+    PARAMS
+    @IN conf - daemon config
+
+    RETURN
+    0 iff clean shutdown
+    Non-zero iff failure
+*/
+int wd_daemon_run(const struct wd_daemon_conf *conf);
+
+#endif
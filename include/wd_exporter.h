@@ -0,0 +1,155 @@
+#ifndef WD_EXPORTER_H
+#define WD_EXPORTER_H
+
+/*
+    Prometheus metrics exporter of feeder.
+
+    Body is rendered on exporter timer from what feeder already holds:
+    snapshot cached by feed path right after keepalive, feed counters and
+    stats histograms. Scrape gets the last rendered body, so it never
+    reaches hardware and costs only non-blocking socket writes in loop.
+    Body is not replaced while any client still reads it, client slower
+    than one interval is dropped.
+    Textfile (node_exporter textfile collector) is written to PATH.tmp and
+    renamed over PATH, readers never see half written file.
+    Listen address: [HOST:]PORT, HOST is 127.0.0.1 by default, [::1]:PORT for IPv6
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <watchdog.h>
+#include <wd_loop.h>
+#include <wd_stats.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define WD_EXPORTER_MAX_DEVS            32
+#define WD_EXPORTER_MAX_CLIENTS         8
+#define WD_EXPORTER_MAX_REQ             1024    /* request head, longer one is dropped */
+#define WD_EXPORTER_MAX_HDR             256
+#define WD_EXPORTER_MAX_PATH            4096
+#define WD_EXPORTER_DEFAULT_INTERVAL_MS 5000
+
+/* body big enough for n devices */
+#define WD_EXPORTER_BODY_SIZE(n)        ((size_t)(n) * 16 * 1024 + 4096)
+
+struct wd_exporter_conf
+{
+    const char  *listen;        /* [HOST:]PORT or NULL */
+    const char  *path;          /* textfile or NULL */
+    uint64_t    interval_ns;    /* render period */
+};
+
+/* what feeder knows about one device, filled by source without ioctls */
+struct wd_exporter_dev
+{
+    const char                  *dev;
+    const struct wd_snapshot    *snap;          /* cached snapshot or NULL */
+    uint64_t                    snap_age_ns;
+    unsigned int                timeout;
+    uint64_t                    feeds;
+    uint64_t                    errors;
+    uint64_t                    withheld;
+    uint64_t                    missed;         /* timer periods lost because feeder was late */
+    bool                        withholding;
+    const struct wd_stats       *stats;
+};
+
+/* fills devs, returns number of devices */
+typedef size_t (*wd_exporter_source_t)(void *arg, struct wd_exporter_dev *devs, size_t n);
+
+struct wd_exporter;
+
+struct wd_exporter_client
+{
+    struct wd_event     ev;
+    struct wd_exporter  *exporter;
+    uint64_t            since_ns;       /* accept time */
+    size_t              rlen;           /* request bytes read */
+    const char          *body;          /* metrics or error text */
+    size_t              body_len;
+    size_t              hdr_len;
+    size_t              off;            /* response bytes sent */
+    bool                sending;
+    char                req[WD_EXPORTER_MAX_REQ];
+    char                hdr[WD_EXPORTER_MAX_HDR];
+};
+
+struct wd_exporter
+{
+    struct wd_event             ev;     /* listening socket */
+    struct wd_event             timer;  /* render */
+    struct wd_loop              *loop;
+    uint64_t                    interval_ns;
+    wd_exporter_source_t        source;
+    void                        *arg;
+    const char                  *path;
+    char                        tmp_path[WD_EXPORTER_MAX_PATH];
+    char                        *body;
+    size_t                      size;
+    size_t                      len;    /* 0 until first successful render */
+    uint64_t                    renders;
+    uint64_t                    scrapes;
+    uint64_t                    dropped;    /* bad, slow or excess clients */
+    uint64_t                    failures;   /* body overflow or textfile write */
+    struct wd_exporter_dev      devs[WD_EXPORTER_MAX_DEVS];
+    struct wd_exporter_client   clients[WD_EXPORTER_MAX_CLIENTS];
+};
+
+/*
+    Init exporter config with default values
+
+    PARAMS
+    @OUT conf - config
+
+    RETURN
+    This is a void function
+*/
+void wd_exporter_conf_init(struct wd_exporter_conf *conf);
+
+/*
+    Start listener and / or textfile, first body is rendered at once
+
+    PARAMS
+    @OUT exporter - exporter to init (must be valid until wd_exporter_deinit)
+    @IN conf - config, listen or path must be set
+    @IN ndevs - max number of devices given by source (max WD_EXPORTER_MAX_DEVS)
+    @IN loop - feeder loop
+    @IN source - device state callback, must not block
+    @IN arg - source user data
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_exporter_init(struct wd_exporter *exporter, const struct wd_exporter_conf *conf, size_t ndevs,
+                     struct wd_loop *loop, wd_exporter_source_t source, void *arg);
+
+/*
+    Close clients, listener and timer, exporter can be zeroed and never inited
+
+    PARAMS
+    @IN exporter - exporter
+
+    RETURN
+    This is a void function
+*/
+void wd_exporter_deinit(struct wd_exporter *exporter);
+
+/*
+    Render metrics of devices in Prometheus text format
+
+    PARAMS
+    @OUT fb - output buffer
+    @IN devs - devices
+    @IN n - number of devices
+
+    RETURN
+    This is a void function
+*/
+void wd_exporter_format(struct wd_fbuf *fb, const struct wd_exporter_dev *devs, size_t n);
+
+#endif
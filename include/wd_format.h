@@ -0,0 +1,198 @@
+#ifndef WD_FORMAT_H
+#define WD_FORMAT_H
+
+/*
+    Machine readable WatchDog output (JSON / key=value / binary).
+
+    Everything is formatted into caller supplied buffer,
+    functions do not allocate memory and do not touch stdio.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <watchdog.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <stdbool.h>
+
+#define WD_FORMAT_BIN_MAGIC     0x4e534457U /* "WDSN" */
+#define WD_FORMAT_BIN_VERSION   1
+
+typedef enum
+{
+    WD_FORMAT_TEXT = 0,
+    WD_FORMAT_JSON,
+    WD_FORMAT_KV,
+    WD_FORMAT_BIN
+} wd_format_t;
+
+/* one decoded WDIOF_* bit */
+struct wd_flag_desc
+{
+    int         flag;
+    const char  *name;  /* short machine name */
+    const char  *desc;  /* human description */
+};
+
+/* header of binary snapshot, followed by struct wd_snapshot in host byte order */
+struct wd_format_bin_hdr
+{
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    size;   /* sizeof(struct wd_snapshot) */
+};
+
+/* append-only view of caller buffer */
+struct wd_fbuf
+{
+    char    *buf;
+    size_t  size;
+    size_t  len;
+    bool    overflow;   /* something did not fit, output is truncated */
+};
+
+/*
+    Init buffer view
+
+    PARAMS
+    @OUT fb - buffer view
+    @IN buf - caller buffer
+    @IN size - size of caller buffer
+
+    RETURN
+    This is a void function
+*/
+void wd_fbuf_init(struct wd_fbuf *fb, char *buf, size_t size);
+
+/*
+    Append raw bytes
+
+    PARAMS
+    @IN fb - buffer view
+    @IN data - bytes
+    @IN len - number of bytes
+
+    RETURN
+    This is a void function
+*/
+void wd_fbuf_put(struct wd_fbuf *fb, const void *data, size_t len);
+
+/*
+    Append NULL terminated string
+
+    PARAMS
+    @IN fb - buffer view
+    @IN str - string
+
+    RETURN
+    This is a void function
+*/
+void wd_fbuf_str(struct wd_fbuf *fb, const char *str);
+
+/*
+    Append unsigned number in decimal
+
+    PARAMS
+    @IN fb - buffer view
+    @IN val - number
+
+    RETURN
+    This is a void function
+*/
+void wd_fbuf_u64(struct wd_fbuf *fb, uint64_t val);
+
+/*
+    Append signed number in decimal
+
+    PARAMS
+    @IN fb - buffer view
+    @IN val - number
+
+    RETURN
+    This is a void function
+*/
+void wd_fbuf_i64(struct wd_fbuf *fb, int64_t val);
+
+/*
+    Append number in hex with 0x prefix
+
+    PARAMS
+    @IN fb - buffer view
+    @IN val - number
+
+    RETURN
+    This is a void function
+*/
+void wd_fbuf_hex(struct wd_fbuf *fb, uint64_t val);
+
+/*
+    Append quoted and JSON escaped string
+
+    PARAMS
+    @IN fb - buffer view
+    @IN str - string
+    @IN max - max length of string (string does not need NULL terminator)
+
+    RETURN
+    This is a void function
+*/
+void wd_fbuf_quoted(struct wd_fbuf *fb, const char *str, size_t max);
+
+/*
+    Get table of known WatchDog flags
+
+    PARAMS
+    @OUT n - number of entries
+
+    RETURN
+    Pointer to static table
+*/
+const struct wd_flag_desc *wd_format_flag_table(size_t *n);
+
+/*
+    Parse format name (text, json, kv, bin)
+
+    PARAMS
+    @IN str - format name
+    @OUT fmt - format
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_format_parse(const char *str, wd_format_t *fmt);
+
+/*
+    Format flag as list of names separated by sep
+
+    PARAMS
+    @OUT buf - output buffer
+    @IN size - buffer size
+    @IN flag - set of bits
+    @IN sep - separator
+
+    RETURN
+    -1 iff buffer is too small
+    Number of bytes written iff success (buf is not NULL terminated)
+*/
+ssize_t wd_format_flags(char *buf, size_t size, int flag, char sep);
+
+/*
+    Format snapshot, only valid fields are emitted
+
+    PARAMS
+    @OUT buf - output buffer
+    @IN size - buffer size
+    @IN snap - snapshot
+    @IN fmt - output format (TEXT is not supported here)
+
+    RETURN
+    -1 iff failure or buffer is too small
+    Number of bytes written iff success (buf is not NULL terminated)
+*/
+ssize_t wd_format_snapshot(char *buf, size_t size, const struct wd_snapshot *snap, wd_format_t fmt);
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef WD_HANDOVER_H
+#define WD_HANDOVER_H
+
+/*
+    Zero downtime upgrade of feeder.
+
+    Running daemon listens on handover socket. New daemon connects,
+    old one feeds every device for the last time, stops its timers and sends
+    feeder state together with open WatchDog descriptors (SCM_RIGHTS).
+    New daemon feeds at once, finishes its init and only then acks with time
+    of its first feeds, old one then exits without magic close, device is
+    never closed. Without ack in time (or when new daemon fails to start and
+    closes socket) old daemon simply feeds again.
+    Device whose feed is withheld is never fed by handover, new daemon keeps
+    withholding it until its own checks decide.
+    CLOCK_MONOTONIC is system wide, so feed gap is measured across processes.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define WD_HANDOVER_MAGIC       0x4f484457U /* "WDHO" */
+#define WD_HANDOVER_VERSION     1
+#define WD_HANDOVER_MAX_DEVS    32
+#define WD_HANDOVER_DEV_LEN     128
+
+#define WD_HANDOVER_WITHHOLDING (1U << 0)   /* old daemon withholds feed of device */
+
+/* feeder state of one device */
+struct wd_handover_dev
+{
+    char        dev[WD_HANDOVER_DEV_LEN];   /* path, empty means default device */
+    uint64_t    last_feed_ns;               /* last keepalive of old daemon */
+    uint64_t    feeds;
+    uint64_t    errors;
+    uint64_t    withheld;
+    uint32_t    timeout;
+    uint32_t    flags;                      /* WD_HANDOVER_* */
+};
+
+/* old -> new, one descriptor per device in the same order */
+struct wd_handover_msg
+{
+    uint32_t                magic;
+    uint16_t                version;
+    uint16_t                ndevs;
+    uint32_t                pid;        /* old daemon */
+    uint32_t                pad;
+    struct wd_handover_dev  devs[WD_HANDOVER_MAX_DEVS];
+};
+
+/* new -> old */
+struct wd_handover_ack
+{
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    ndevs;
+    uint64_t    first_feed_ns[WD_HANDOVER_MAX_DEVS];    /* 0 means device was not fed */
+};
+
+struct wd_handover_listener
+{
+    int         fd;
+    const char  *path;
+    dev_t       st_dev;     /* socket file, removed on close only if still ours */
+    ino_t       st_ino;
+};
+
+/*
+    Listen for new daemon, stale socket file is replaced
+
+    PARAMS
+    @OUT l - listener
+    @IN path - socket path
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_handover_listen(struct wd_handover_listener *l, const char *path);
+
+/*
+    Close listener, socket file is removed unless other daemon bound it meanwhile.
+    Listener can be zeroed with fd == -1 and never inited
+
+    PARAMS
+    @IN l - listener
+
+    RETURN
+    This is a void function
+*/
+void wd_handover_unlisten(struct wd_handover_listener *l);
+
+/*
+    Connect to running daemon
+
+    PARAMS
+    @IN path - socket path
+
+    RETURN
+    -1 iff there is no daemon to take over from
+    socket descriptor iff success
+*/
+int wd_handover_connect(const char *path);
+
+/*
+    Send state and descriptors to new daemon
+
+    PARAMS
+    @IN fd - connected socket
+    @IN msg - state, msg->ndevs descriptors follow
+    @IN fds - WatchDog descriptors
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_handover_send(int fd, const struct wd_handover_msg *msg, const int *fds);
+
+/*
+    Receive state and descriptors from old daemon
+
+    PARAMS
+    @IN fd - socket from wd_handover_connect
+    @OUT msg - state
+    @OUT fds - WatchDog descriptors (WD_HANDOVER_MAX_DEVS entries), owned by caller
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_handover_recv(int fd, struct wd_handover_msg *msg, int *fds);
+
+/*
+    Send ack to old daemon
+
+    PARAMS
+    @IN fd - socket from wd_handover_connect
+    @IN ack - ack
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_handover_send_ack(int fd, const struct wd_handover_ack *ack);
+
+/*
+    Receive ack without blocking
+
+    PARAMS
+    @IN fd - connected socket
+    @OUT ack - ack
+
+    RETURN
+    0 iff success
+    Non-zero iff peer is gone or sent garbage
+*/
+int wd_handover_recv_ack(int fd, struct wd_handover_ack *ack);
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef WD_HEARTBEAT_H
+#define WD_HEARTBEAT_H
+
+/*
+    Shared-memory heartbeat registry.
+
+    Applications register in POSIX shm segment and get own cache line slot,
+    heartbeat is one atomic store of CLOCK_MONOTONIC time (vDSO, no syscall).
+    Feeder scans slots and calls wd_keepalive only while every registered
+    client heartbeated within its deadline, so hung service reboots the box.
+    Slots are claimed with CAS, there are no locks and no shared counters
+    written on heartbeat path, so clients never false-share.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <wd_time.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define WD_HB_MAGIC             0x42484457U /* "WDHB" */
+#define WD_HB_VERSION           1
+#define WD_HB_DEFAULT_SHM       "/wd_heartbeat"
+#define WD_HB_DEFAULT_SLOTS     4096
+#define WD_HB_NAME_LEN          40
+#define WD_HB_CACHE_LINE        64
+
+typedef enum
+{
+    WD_HB_SLOT_FREE = 0,
+    WD_HB_SLOT_CLAIMED,     /* being filled by client */
+    WD_HB_SLOT_ACTIVE
+} wd_hb_slot_state_t;
+
+struct wd_hb_slot
+{
+    uint64_t    beat_ns;        /* last heartbeat, written only by owner */
+    uint64_t    deadline_ns;    /* max time between heartbeats */
+    uint32_t    state;          /* wd_hb_slot_state_t */
+    uint32_t    pid;            /* owner */
+    char        name[WD_HB_NAME_LEN];
+} __attribute__((aligned(WD_HB_CACHE_LINE)));
+
+struct wd_hb_hdr
+{
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    slot_size;  /* sizeof(struct wd_hb_slot) */
+    uint32_t    nslots;
+    uint32_t    used;       /* high water mark of claimed slots, bounds scan */
+} __attribute__((aligned(WD_HB_CACHE_LINE)));
+
+/* client side */
+struct wd_hb_client
+{
+    struct wd_hb_hdr    *hdr;
+    size_t              size;
+    struct wd_hb_slot   *slot;
+};
+
+/* feeder side */
+struct wd_hb_registry
+{
+    struct wd_hb_hdr    *hdr;
+    size_t              size;
+    const char          *shm;
+    uint32_t            stale;      /* stale clients at last scan */
+    uint64_t            withheld;   /* scans which withheld keepalive */
+};
+
+/* one stale client found by scan */
+struct wd_hb_stale
+{
+    uint32_t    slot;
+    uint32_t    pid;
+    uint64_t    late_ns;    /* how long past deadline */
+    char        name[WD_HB_NAME_LEN];
+};
+
+/*
+    Register client or attach to existing slot with the same name
+
+    PARAMS
+    @OUT client - client handle
+    @IN shm - shm name or NULL for default
+    @IN name - client name
+    @IN deadline_ns - max time between heartbeats
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_hb_register(struct wd_hb_client *client, const char *shm, const char *name, uint64_t deadline_ns);
+
+/*
+    Unregister client, feeder stops watching it
+
+    PARAMS
+    @IN client - client handle
+
+    RETURN
+    This is a void function
+*/
+void wd_hb_unregister(struct wd_hb_client *client);
+
+/*
+    Detach from registry, slot stays watched (client keeps running elsewhere)
+
+    PARAMS
+    @IN client - client handle
+
+    RETURN
+    This is a void function
+*/
+void wd_hb_detach(struct wd_hb_client *client);
+
+/*
+    Heartbeat, one atomic store
+
+    PARAMS
+    @IN client - client handle
+
+    RETURN
+    This is a void function
+*/
+static inline void wd_hb_beat(const struct wd_hb_client *client)
+{
+    __atomic_store_n(&client->slot->beat_ns, wd_time_now_ns(), __ATOMIC_RELEASE);
+}
+
+/*
+    Create or reuse registry segment
+
+    PARAMS
+    @OUT reg - registry
+    @IN shm - shm name or NULL for default
+    @IN nslots - number of slots, 0 means default
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_hb_registry_create(struct wd_hb_registry *reg, const char *shm, size_t nslots);
+
+/*
+    Attach read-only to existing registry
+
+    PARAMS
+    @OUT reg - registry
+    @IN shm - shm name or NULL for default
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_hb_registry_attach(struct wd_hb_registry *reg, const char *shm);
+
+/*
+    Unmap registry
+
+    PARAMS
+    @IN reg - registry
+    @IN unlink - remove segment
+
+    RETURN
+    This is a void function
+*/
+void wd_hb_registry_destroy(struct wd_hb_registry *reg, bool unlink);
+
+/*
+    Find clients which missed their deadline
+
+    PARAMS
+    @IN reg - registry
+    @IN now - current CLOCK_MONOTONIC time
+    @OUT stale - first stale client or NULL
+
+    RETURN
+    Number of stale clients
+*/
+uint32_t wd_hb_registry_scan(struct wd_hb_registry *reg, uint64_t now, struct wd_hb_stale *stale);
+
+/*
+    Get slot of registry
+
+    PARAMS
+    @IN reg - registry
+    @IN i - slot index
+
+    RETURN
+    NULL iff slot is not active
+    Pointer to slot iff success
+*/
+const struct wd_hb_slot *wd_hb_registry_slot(const struct wd_hb_registry *reg, uint32_t i);
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef WD_HISTORY_H
+#define WD_HISTORY_H
+
+/*
+    Persistent boot status history.
+
+    Fixed size records in mmap'ed ring file, one record per device and boot:
+    bootstatus with what previous feeder saw last (feeds, errors, near misses,
+    time left) copied from its stats file before new feeder reuses it.
+    Records of one boot are deduplicated by kernel boot_id, so tool and
+    daemon may both record on every start. Record is published by release
+    store of its sequence number, so readers never parse text and never
+    see half written record. Ring keeps last N boots, query is one linear
+    pass over fixed records, no matter how many years they cover.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <wd_format.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define WD_HISTORY_MAGIC            0x49484457U /* "WDHI" */
+#define WD_HISTORY_VERSION          1
+#define WD_HISTORY_DEFAULT_RECORDS  16384
+#define WD_HISTORY_MAX_RECORDS      (1024 * 1024)
+#define WD_HISTORY_DEV_LEN          64
+#define WD_HISTORY_MAX_DEVS         64      /* distinct devices in query */
+#define WD_HISTORY_DEFAULT_DEV      "/dev/watchdog"
+
+/* record fields filled in */
+#define WD_HISTORY_HAS_BOOTSTATUS   (1U << 0)
+#define WD_HISTORY_HAS_TIMEOUT      (1U << 1)
+#define WD_HISTORY_HAS_PREV         (1U << 2)   /* stats of previous boot feeder */
+#define WD_HISTORY_HAS_TIMELEFT     (1U << 3)
+
+struct wd_history_hdr
+{
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    rec_size;       /* sizeof(struct wd_history_rec) */
+    uint32_t    capacity;       /* records in ring */
+    uint32_t    pad;
+    uint64_t    head;           /* records ever written */
+};
+
+struct wd_history_rec
+{
+    uint64_t    seq;            /* head after this record, 0 while written */
+    uint64_t    time_ns;        /* CLOCK_REALTIME of record */
+    uint64_t    boot_ns;        /* CLOCK_REALTIME of boot */
+    uint8_t     boot_id[16];
+    char        dev[WD_HISTORY_DEV_LEN];
+    int32_t     bootstatus;
+    uint32_t    fields;         /* WD_HISTORY_HAS_* */
+    uint32_t    timeout;
+    uint32_t    prev_timeleft;  /* last time left seen before reset */
+    uint64_t    prev_feeds;
+    uint64_t    prev_errors;
+    uint64_t    prev_near_misses;
+    int64_t     prev_min_slack_ns;
+    uint64_t    prev_seen_ns;   /* CLOCK_REALTIME of last stats update */
+};
+
+/* last feed stats of previous boot, taken from stats file */
+struct wd_history_prev
+{
+    char        dev[WD_HISTORY_DEV_LEN];
+    uint32_t    fields;         /* WD_HISTORY_HAS_PREV and maybe WD_HISTORY_HAS_TIMELEFT */
+    uint32_t    timeleft;
+    uint64_t    feeds;
+    uint64_t    errors;
+    uint64_t    near_misses;
+    int64_t     min_slack_ns;
+    uint64_t    seen_ns;
+};
+
+struct wd_history
+{
+    struct wd_history_hdr   *hdr;
+    struct wd_history_rec   *recs;
+    size_t                  size;       /* mapped bytes */
+    int                     fd;         /* -1 for read-only */
+};
+
+/*
+    Open history file for recording, file is created if needed
+
+    PARAMS
+    @OUT history - history
+    @IN path - history file
+    @IN capacity - records of new file, 0 means default, existing file keeps its own
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_history_open(struct wd_history *history, const char *path, size_t capacity);
+
+/*
+    Map history file read-only
+
+    PARAMS
+    @OUT history - history
+    @IN path - history file
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_history_attach(struct wd_history *history, const char *path);
+
+/*
+    Unmap history, history can be zeroed and never opened
+
+    PARAMS
+    @IN history - history
+
+    RETURN
+    This is a void function
+*/
+void wd_history_close(struct wd_history *history);
+
+/*
+    Load last feed stats of previous boot, must be called before stats file is reused
+
+    PARAMS
+    @IN stats_path - stats file of feeder
+    @OUT prev - one entry per device of stats file
+    @IN n - size of prev
+
+    RETURN
+    Number of loaded devices, 0 if file is missing or was written in this boot
+*/
+size_t wd_history_prev_load(const char *stats_path, struct wd_history_prev *prev, size_t n);
+
+/*
+    Record device state of this boot, second record of the same device and boot is skipped
+
+    PARAMS
+    @IN history - history opened by wd_history_open
+    @IN dev - device path, NULL means default device
+    @IN fields - WD_HISTORY_HAS_BOOTSTATUS and / or WD_HISTORY_HAS_TIMEOUT
+    @IN bootstatus - WDIOF_* bits of last reset
+    @IN timeout - current timeout
+    @IN prev - previous boot stats of device or NULL
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_history_record(struct wd_history *history, const char *dev, uint32_t fields, int bootstatus,
+                      unsigned int timeout, const struct wd_history_prev *prev);
+
+/*
+    Aggregate whole history per device: boots, resets by cause, last boot
+
+    PARAMS
+    @OUT buf - output buffer
+    @IN size - buffer size
+    @IN history - history
+    @IN fmt - output format (binary is not supported)
+
+    RETURN
+    -1 iff failure
+    Length of output iff success
+*/
+ssize_t wd_history_format(char *buf, size_t size, const struct wd_history *history, wd_format_t fmt);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef WD_LOG_H
+#define WD_LOG_H
+
+/*
+    Logging macros shared by all WatchDog modules
+
+    Level is chosen at compile time (make LOG_LEVEL=TRACE),
+    disabled levels compile to nothing but arguments are still type checked.
+    WD_ERROR always returns err, only message can be compiled out.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <log.h>
+
+#define WD_LOG_LEVEL_NONE   0
+#define WD_LOG_LEVEL_ERROR  1
+#define WD_LOG_LEVEL_INFO   2
+#define WD_LOG_LEVEL_TRACE  3
+
+#ifndef WD_LOG_LEVEL
+#define WD_LOG_LEVEL WD_LOG_LEVEL_INFO
+#endif
+
+#if WD_LOG_LEVEL >= WD_LOG_LEVEL_ERROR
+#define WD_ERROR(fmt, err, ...) ERROR(fmt, err, ##__VA_ARGS__)
+#else
+#define WD_ERROR(fmt, err, ...) \
+    do { \
+        if (0) \
+            LOG(fmt, ##__VA_ARGS__); \
+        return err; \
+    } while (0)
+#endif
+
+#if WD_LOG_LEVEL >= WD_LOG_LEVEL_INFO
+#define WD_LOG(fmt, ...)        LOG(fmt, ##__VA_ARGS__)
+#else
+#define WD_LOG(fmt, ...) \
+    do { \
+        if (0) \
+            LOG(fmt, ##__VA_ARGS__); \
+    } while (0)
+#endif
+
+#if WD_LOG_LEVEL >= WD_LOG_LEVEL_TRACE
+#define WD_TRACE(...)           TRACE(__VA_ARGS__)
+#else
+#define WD_TRACE(...)           do { } while (0)
+#endif
+
+#endif
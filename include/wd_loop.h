@@ -0,0 +1,159 @@
+#ifndef WD_LOOP_H
+#define WD_LOOP_H
+
+/*
+    Simple epoll based event loop with timerfd helpers.
+    Every event source is a descriptor with a callback,
+    so feeders, sockets and timers share one thread.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct wd_event;
+
+typedef void (*wd_event_cb_t)(struct wd_event *ev, uint32_t events);
+
+struct wd_event
+{
+    int             fd;     /* descriptor watched by loop */
+    wd_event_cb_t   cb;     /* called when fd is ready */
+    void            *arg;   /* user data */
+};
+
+struct wd_loop
+{
+    int     epfd;
+    bool    running;
+};
+
+/*
+    Init event loop
+
+    PARAMS
+    @OUT loop - loop to init
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_loop_init(struct wd_loop *loop);
+
+/*
+    Deinit event loop, registered descriptors are not closed
+
+    PARAMS
+    @IN loop - loop to deinit
+
+    RETURN
+    This is a void function
+*/
+void wd_loop_deinit(struct wd_loop *loop);
+
+/*
+    Register event in loop
+
+    PARAMS
+    @IN loop - event loop
+    @IN ev - event (must be valid as long as it is registered)
+    @IN events - epoll events (EPOLLIN, ...)
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_loop_add(struct wd_loop *loop, struct wd_event *ev, uint32_t events);
+
+/*
+    Unregister event from loop
+
+    PARAMS
+    @IN loop - event loop
+    @IN ev - event
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_loop_del(struct wd_loop *loop, struct wd_event *ev);
+
+/*
+    Change epoll events of registered event
+
+    PARAMS
+    @IN loop - event loop
+    @IN ev - registered event
+    @IN events - epoll events (EPOLLIN, ...)
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_loop_mod(struct wd_loop *loop, struct wd_event *ev, uint32_t events);
+
+/*
+    Dispatch events until wd_loop_stop is called
+
+    PARAMS
+    @IN loop - event loop
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_loop_run(struct wd_loop *loop);
+
+/*
+    Stop loop, wd_loop_run returns after current dispatch
+
+    PARAMS
+    @IN loop - event loop
+
+    RETURN
+    This is a void function
+*/
+void wd_loop_stop(struct wd_loop *loop);
+
+/*
+    Create CLOCK_MONOTONIC timerfd
+
+    PARAMS
+    NO PARAMS
+
+    RETURN
+    -1 iff failure
+    timer descriptor iff success
+*/
+int wd_timer_create(void);
+
+/*
+    Arm timer at absolute CLOCK_MONOTONIC deadline
+
+    PARAMS
+    @IN tfd - timer descriptor
+    @IN deadline_ns - absolute time in ns
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_timer_arm(int tfd, uint64_t deadline_ns);
+
+/*
+    Acknowledge timer expiration
+
+    PARAMS
+    @IN tfd - timer descriptor
+    @OUT expirations - number of expirations since last ack (can be NULL)
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_timer_ack(int tfd, uint64_t *expirations);
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef WD_PSI_H
+#define WD_PSI_H
+
+/*
+    Pressure stall (PSI) policy gating the feed.
+
+    Every trigger is written to /proc/pressure/RES (or RES.pressure of cgroup)
+    and polled for EPOLLPRI in feeder loop, kernel wakes us only when stall
+    time in window exceeds threshold, so nothing is polled from /proc.
+    Kernel fires trigger at most once per window, so events not further than
+    2 windows apart form one pressure episode. Feed is starved only after
+    episode lasted for hold time, short spikes never reset the box.
+    Trigger specs: RES:some|full=STALL_MS/WINDOW_MS[,cgroup=DIR]
+        RES is cpu, memory or io, window is 500 .. 10000 ms
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <wd_loop.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define WD_PSI_MAX                  8
+#define WD_PSI_DEFAULT_HOLD_MS      10000
+#define WD_PSI_MIN_WINDOW_MS        500
+#define WD_PSI_MAX_WINDOW_MS        10000
+
+typedef enum
+{
+    WD_PSI_CPU = 0,
+    WD_PSI_MEMORY,
+    WD_PSI_IO
+} wd_psi_res_t;
+
+struct wd_psi_conf
+{
+    wd_psi_res_t    res;
+    bool            full;           /* all tasks stalled, otherwise some */
+    uint64_t        stall_ns;       /* threshold of stall time in window */
+    uint64_t        window_ns;
+    const char      *cgroup;        /* cgroup dir or NULL for system wide */
+};
+
+struct wd_psi_trigger
+{
+    struct wd_psi_conf conf;
+    struct wd_event ev;
+    uint64_t        since_ns;       /* start of current episode */
+    uint64_t        last_ns;        /* last event, 0 means none */
+    uint64_t        events;
+    uint64_t        episodes;
+    uint64_t        max_ns;         /* longest episode */
+};
+
+struct wd_psi
+{
+    struct wd_psi_trigger triggers[WD_PSI_MAX];
+    size_t          n;
+    uint64_t        hold_ns;
+};
+
+/*
+    Parse trigger spec, spec is modified and must outlive conf
+
+    PARAMS
+    @IN spec - RES:some|full=STALL_MS/WINDOW_MS[,cgroup=DIR]
+    @OUT conf - trigger config
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_psi_parse(char *spec, struct wd_psi_conf *conf);
+
+/*
+    Register triggers and watch them in loop
+
+    PARAMS
+    @OUT psi - policy to init
+    @IN confs - trigger configs
+    @IN n - number of triggers (max WD_PSI_MAX)
+    @IN hold_ns - how long pressure must last before feed is starved
+    @IN loop - feeder loop
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_psi_init(struct wd_psi *psi, const struct wd_psi_conf *confs, size_t n, uint64_t hold_ns, struct wd_loop *loop);
+
+/*
+    Unregister and close triggers, psi can be zeroed and never inited
+
+    PARAMS
+    @IN psi - policy
+
+    RETURN
+    This is a void function
+*/
+void wd_psi_deinit(struct wd_psi *psi);
+
+/*
+    Find trigger whose pressure lasted for hold time
+
+    PARAMS
+    @IN psi - policy (can be NULL)
+    @IN now - CLOCK_MONOTONIC time in ns
+
+    RETURN
+    NULL iff feed can go on
+    Pointer to first starving trigger iff pressure lasted too long
+*/
+const struct wd_psi_trigger *wd_psi_starving(const struct wd_psi *psi, uint64_t now);
+
+/*
+    Write trigger name like "memory some 150/1000 ms" into buf
+
+    PARAMS
+    @IN trigger - trigger
+    @OUT buf - output buffer
+    @IN size - size of buffer
+
+    RETURN
+    Pointer to buf
+*/
+const char *wd_psi_name(const struct wd_psi_trigger *trigger, char *buf, size_t size);
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef WD_RT_H
+#define WD_RT_H
+
+/*
+    Real-time hardening of the feeder.
+
+    Applied once, after every device is opened and before keepalive loop:
+    SCHED_FIFO or SCHED_DEADLINE policy, CPU pinning, mlockall with
+    prefaulted stack. After that feeder must not allocate or use stdio,
+    page faults and involuntary context switches taken inside the loop
+    are reported by wd_rt_usage_get / wd_rt_usage_diff.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define WD_RT_DEFAULT_FIFO_PRIO         50
+#define WD_RT_DEFAULT_DL_RUNTIME_US     500
+#define WD_RT_DEFAULT_DL_PERIOD_US      10000
+#define WD_RT_DEFAULT_STACK_PREFAULT    (256 * 1024)
+
+typedef enum
+{
+    WD_RT_SCHED_NONE = 0,
+    WD_RT_SCHED_FIFO,
+    WD_RT_SCHED_DEADLINE
+} wd_rt_sched_t;
+
+struct wd_rt_conf
+{
+    wd_rt_sched_t   sched;
+    int             prio;           /* SCHED_FIFO priority */
+    uint64_t        dl_runtime_us;  /* SCHED_DEADLINE budget */
+    uint64_t        dl_period_us;   /* SCHED_DEADLINE period == deadline */
+    int             cpu;            /* pin to CPU or -1 */
+    bool            mlock;          /* mlockall + prefault stack */
+    size_t          stack_prefault; /* bytes of stack touched before loop */
+};
+
+/* resources used by calling thread */
+struct wd_rt_usage
+{
+    long    minflt;     /* page faults without IO */
+    long    majflt;     /* page faults with IO */
+    long    nvcsw;      /* voluntary context switches */
+    long    nivcsw;     /* involuntary context switches */
+};
+
+/*
+    Init RT config with default values (nothing enabled)
+
+    PARAMS
+    @OUT conf - config
+
+    RETURN
+    This is a void function
+*/
+void wd_rt_conf_init(struct wd_rt_conf *conf);
+
+/*
+    Is anything in RT config enabled
+
+    PARAMS
+    @IN conf - config
+
+    RETURN
+    true iff RT hardening was requested
+*/
+bool wd_rt_enabled(const struct wd_rt_conf *conf);
+
+/*
+    Apply RT config to calling thread
+
+    PARAMS
+    @IN conf - config
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_rt_apply(const struct wd_rt_conf *conf);
+
+/*
+    Get resources used by calling thread
+
+    PARAMS
+    @OUT usage - usage
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_rt_usage_get(struct wd_rt_usage *usage);
+
+/*
+    Compute usage taken between two samples
+
+    PARAMS
+    @IN start - earlier sample
+    @IN end - later sample
+    @OUT diff - end - start
+
+    RETURN
+    This is a void function
+*/
+void wd_rt_usage_diff(const struct wd_rt_usage *start, const struct wd_rt_usage *end, struct wd_rt_usage *diff);
+
+#endif
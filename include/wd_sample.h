@@ -0,0 +1,221 @@
+#ifndef WD_SAMPLE_H
+#define WD_SAMPLE_H
+
+/*
+    Temperature and status sampling engine of feeder.
+
+    Every device has own timerfd in feeder loop, no threads. Each tick reads
+    temperature and status (fields driver does not support are never read
+    again) into rolling window of last WD_SAMPLE_WINDOW samples with min,
+    max, mean, EWMA and EWMA of rate of change. Memory is fixed.
+    While values are stable, period doubles up to max period, so idle box
+    pays a couple of ioctls per minute. Any change, tripped rule or value
+    heading to threshold before next sample brings period back to min.
+    Rule trips and clears are logged, tripped rule can run hook command
+    (not waited for, one at a time) and set WDIOS_TEMPPANIC once.
+    RT feeder does no stdio and no fork inside loop, so with notifier loop
+    only queues trips and clears into lock free ring and notifier thread
+    (normal policy, started before RT hardening) logs them and runs hooks.
+    Rule specs: METRIC OP VALUE[,panic][,exec=CMD]
+        temp>=N, temp<=N    temperature in degrees fahrenheit
+        rate>=N, rate<=N    temperature change in degrees fahrenheit per minute
+        status&MASK         any of WDIOF_* bits set in status
+        exec is last, CMD runs as sh -c CMD with $1 device, $2 rule, $3 value
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <watchdog.h>
+#include <wd_loop.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#define WD_SAMPLE_MAX_RULES         8
+#define WD_SAMPLE_WINDOW            64      /* samples in rolling window */
+#define WD_SAMPLE_DEFAULT_MIN_MS    1000
+#define WD_SAMPLE_DEFAULT_MAX_MS    60000
+#define WD_SAMPLE_DEFAULT_STABLE    1       /* degrees F of change treated as noise */
+#define WD_SAMPLE_STABLE_TICKS      4       /* stable samples before period doubles */
+#define WD_SAMPLE_EWMA_ALPHA        0.125
+
+typedef enum
+{
+    WD_SAMPLE_TEMP = 0,
+    WD_SAMPLE_RATE,
+    WD_SAMPLE_STATUS
+} wd_sample_metric_t;
+
+typedef enum
+{
+    WD_SAMPLE_GE = 0,
+    WD_SAMPLE_LE,
+    WD_SAMPLE_ANY
+} wd_sample_cmp_t;
+
+struct wd_sample_rule
+{
+    wd_sample_metric_t  metric;
+    wd_sample_cmp_t     cmp;
+    int64_t             threshold;  /* degrees F, degrees F per minute or WDIOF_* mask */
+    bool                panic;      /* set WDIOS_TEMPPANIC when tripped */
+    const char          *exec;      /* hook command or NULL */
+};
+
+struct wd_sample_conf
+{
+    struct wd_sample_rule   rules[WD_SAMPLE_MAX_RULES];
+    size_t                  nrules;
+    bool                    enabled;
+    uint64_t                min_period_ns;
+    uint64_t                max_period_ns;
+    int                     stable;     /* change treated as noise, also hysteresis of temp rules */
+};
+
+struct wd_sample_window
+{
+    int         vals[WD_SAMPLE_WINDOW];
+    size_t      n;
+    size_t      head;       /* next slot to write */
+    int64_t     sum;
+    int         min;
+    int         max;
+    int         last;
+    double      ewma;
+};
+
+struct wd_sample_trip
+{
+    bool        tripped;
+    uint64_t    trips;
+    pid_t       hook;       /* running hook or 0 */
+};
+
+struct wd_sample_notifier;
+
+struct wd_sampler
+{
+    const struct wd_sample_conf *conf;
+    watchdog_t              wd;
+    const char              *dev;
+    struct wd_event         timer;
+    uint64_t                period_ns;
+    uint64_t                last_ns;    /* time of last temperature sample */
+    unsigned int            stable;     /* consecutive stable samples */
+    bool                    has_temp;
+    bool                    has_status;
+    bool                    panic_set;
+    struct wd_sample_window temp;
+    double                  rate;       /* EWMA of degrees F per minute */
+    int                     status;
+    uint64_t                samples;
+    uint64_t                errors;
+    struct wd_sample_trip   trips[WD_SAMPLE_MAX_RULES];
+    struct wd_sample_notifier *notifier;    /* NULL means logs and hooks run in loop */
+};
+
+/*
+    Init sampling config with default values, engine is disabled
+
+    PARAMS
+    @OUT conf - config
+
+    RETURN
+    This is a void function
+*/
+void wd_sample_conf_init(struct wd_sample_conf *conf);
+
+/*
+    Parse rule spec, spec is modified and must outlive rule
+
+    PARAMS
+    @IN spec - METRIC OP VALUE[,panic][,exec=CMD]
+    @OUT rule - rule
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_sample_parse(char *spec, struct wd_sample_rule *rule);
+
+/*
+    Probe what device reports and start sampling it in loop
+
+    PARAMS
+    @OUT sampler - sampler to init (must be valid until wd_sampler_deinit)
+    @IN conf - config
+    @IN wd - WatchDog descriptor
+    @IN dev - device name for logs and hooks
+    @IN loop - feeder loop
+
+    RETURN
+    0 iff success
+    Non-zero iff failure (device reports neither temperature nor status)
+*/
+int wd_sampler_init(struct wd_sampler *sampler, const struct wd_sample_conf *conf, watchdog_t wd,
+                    const char *dev, struct wd_loop *loop);
+
+/*
+    Close timer, sampler can be zeroed with timer.fd == -1 and never inited
+
+    PARAMS
+    @IN sampler - sampler
+
+    RETURN
+    This is a void function
+*/
+void wd_sampler_deinit(struct wd_sampler *sampler);
+
+/*
+    Start thread which logs rule trips and runs hooks of samplers instead of loop,
+    must be called before loop runs
+
+    PARAMS
+    @IN samplers - inited samplers, all fed by the same loop
+    @IN n - number of samplers
+
+    RETURN
+    NULL iff failure
+    Pointer to notifier iff success
+*/
+struct wd_sample_notifier *wd_sample_notifier_start(struct wd_sampler *const *samplers, size_t n);
+
+/*
+    Log queued events, stop thread and free notifier, samplers log in loop again
+
+    PARAMS
+    @IN notifier - notifier or NULL
+
+    RETURN
+    This is a void function
+*/
+void wd_sample_notifier_stop(struct wd_sample_notifier *notifier);
+
+/*
+    Mean of rolling window
+
+    PARAMS
+    @IN window - window
+
+    RETURN
+    Mean or 0.0 iff window is empty
+*/
+double wd_sample_mean(const struct wd_sample_window *window);
+
+/*
+    Write rule like "temp >= 180" into buf
+
+    PARAMS
+    @IN rule - rule
+    @OUT buf - output buffer
+    @IN size - size of buffer
+
+    RETURN
+    Pointer to buf
+*/
+const char *wd_sample_rule_name(const struct wd_sample_rule *rule, char *buf, size_t size);
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef WD_SCAN_H
+#define WD_SCAN_H
+
+/*
+    Parallel query of many WatchDogs (host, guests, chroots).
+
+    Device list is enumerated once from roots, then worker threads take
+    devices by atomic index, open them, read snapshot and close them again.
+    Every device has its own result slot, so workers never share anything
+    but the index and output keeps enumeration order.
+    Every root is one of
+        directory   - ROOT/sys/class/watchdog/watchdog*, read-only via sysfs,
+                      "/" means host
+        sim:[opts]  - simulated device
+        pattern     - glob of device paths, opened with given backend;
+                      device nodes are read via sysfs instead (opening one
+                      arms its timer), nodes without sysfs are listed as
+                      not probed and never opened, and nodes of the same
+                      WatchDog, like /dev/watchdog and /dev/watchdog0,
+                      are queried once
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <watchdog.h>
+#include <wd_backend.h>
+#include <wd_format.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define WD_SCAN_MAX_ROOTS       64
+#define WD_SCAN_MAX_DEVS        1024
+#define WD_SCAN_MAX_WORKERS     64
+#define WD_SCAN_DEV_LEN         256
+
+/* output buffer big enough for n devices in any format */
+#define WD_SCAN_OUT_SIZE(n)     ((size_t)(n) * 1024 + 256)
+
+struct wd_scan_dev
+{
+    char                dev[WD_SCAN_DEV_LEN];
+    char                path[WD_SCAN_DEV_LEN];  /* what is opened (sysfs dir of node), empty means dev */
+    wd_backend_type_t   backend;
+    dev_t               rdev;                   /* device node or 0 */
+    bool                unprobed;               /* node without sysfs, opening it would arm its timer */
+    int                 err;            /* 0 or errno of failed open / snapshot */
+    uint64_t            latency_ns;     /* open + snapshot + close */
+    struct wd_snapshot  snap;
+};
+
+struct wd_scan
+{
+    struct wd_scan_dev  *devs;
+    size_t              ndevs;
+    size_t              next;           /* next device to query, taken atomically */
+    size_t              failed;
+    size_t              unprobed;
+    unsigned int        workers;        /* workers used by last run */
+    uint64_t            elapsed_ns;     /* wall time of last run */
+};
+
+/*
+    Enumerate devices
+
+    PARAMS
+    @IN roots - roots, see above
+    @IN n - number of roots
+    @IN backend - backend of pattern devices
+
+    RETURN
+    NULL iff failure or nothing was found
+    Pointer to scan iff success
+*/
+struct wd_scan *wd_scan_create(const char *const *roots, size_t n, wd_backend_type_t backend);
+
+/*
+    Query every device on worker pool, returns when all are done
+
+    PARAMS
+    @IN scan - scan
+    @IN workers - number of threads, 0 means one per online CPU
+
+    RETURN
+    0 iff every device answered
+    Non-zero iff any device failed (see scan->devs[i].err)
+*/
+int wd_scan_run(struct wd_scan *scan, unsigned int workers);
+
+/*
+    Format results, text is a table, json an array of {dev, snapshot}
+
+    PARAMS
+    @OUT buf - output buffer (WD_SCAN_OUT_SIZE(scan->ndevs) is enough)
+    @IN size - buffer size
+    @IN scan - scan after wd_scan_run
+    @IN fmt - output format (binary is not supported)
+
+    RETURN
+    -1 iff failure
+    Length of output iff success
+*/
+ssize_t wd_scan_format(char *buf, size_t size, const struct wd_scan *scan, wd_format_t fmt);
+
+/*
+    Free scan
+
+    PARAMS
+    @IN scan - scan
+
+    RETURN
+    This is a void function
+*/
+void wd_scan_destroy(struct wd_scan *scan);
+
+#endif
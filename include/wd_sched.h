@@ -0,0 +1,113 @@
+#ifndef WD_SCHED_H
+#define WD_SCHED_H
+
+/*
+    Keepalive scheduler.
+
+    FIXED mode feeds every feed_pct % of timeout.
+    ADAPTIVE mode samples time left (WDIOC_GETTIMELEFT) before each feed,
+    tracks real feed lateness and moves the period so slack at feed time
+    stays inside [slack_min_pct, slack_max_pct] % of timeout.
+    Drivers without GETTIMELEFT fall back to FIXED mode.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <watchdog.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+
+#define WD_SCHED_DEFAULT_FEED_PCT       50
+#define WD_SCHED_DEFAULT_SLACK_MIN_PCT  30
+#define WD_SCHED_DEFAULT_SLACK_MAX_PCT  60
+
+#define WD_SCHED_TIMELEFT_NONE          UINT_MAX
+
+typedef enum
+{
+    WD_SCHED_FIXED = 0,
+    WD_SCHED_ADAPTIVE
+} wd_sched_mode_t;
+
+struct wd_sched_conf
+{
+    wd_sched_mode_t mode;
+    unsigned int    feed_pct;       /* fixed period in % of timeout */
+    unsigned int    slack_min_pct;  /* slack below means feeding too late */
+    unsigned int    slack_max_pct;  /* slack above means wasted wakeups */
+};
+
+struct wd_sched
+{
+    struct wd_sched_conf conf;
+
+    uint64_t    timeout_ns;
+    uint64_t    period_ns;      /* currently chosen feed period */
+    uint64_t    last_feed_ns;   /* end of previous keepalive */
+    uint64_t    late_ns;        /* decaying max of wakeup lateness */
+
+    /* counters */
+    int64_t     slack_ns;       /* slack observed at last feed */
+    unsigned int timeleft;      /* GETTIMELEFT at last feed or WD_SCHED_TIMELEFT_NONE */
+    int64_t     min_slack_ns;
+    uint64_t    wakeups;
+    uint64_t    adjustments;    /* how many times period changed */
+    bool        has_timeleft;   /* driver supports GETTIMELEFT */
+};
+
+/*
+    Init scheduler config with default values
+
+    PARAMS
+    @OUT conf - config
+
+    RETURN
+    This is a void function
+*/
+void wd_sched_conf_init(struct wd_sched_conf *conf);
+
+/*
+    Init scheduler for device, probes GETTIMELEFT in ADAPTIVE mode
+
+    PARAMS
+    @OUT sched - scheduler
+    @IN conf - config
+    @IN wd - watchdog descriptor
+    @IN timeout - WD timeout in seconds
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_sched_init(struct wd_sched *sched, const struct wd_sched_conf *conf, watchdog_t wd, unsigned int timeout);
+
+/*
+    Sample slack just before keepalive
+
+    PARAMS
+    @IN sched - scheduler
+    @IN wd - watchdog descriptor
+    @IN now - current time in ns
+
+    RETURN
+    This is a void function
+*/
+void wd_sched_sample(struct wd_sched *sched, watchdog_t wd, uint64_t now);
+
+/*
+    Account finished keepalive and choose next wakeup
+
+    PARAMS
+    @IN sched - scheduler
+    @IN scheduled - time when feed was scheduled
+    @IN fed - time when keepalive returned
+
+    RETURN
+    Absolute time of next feed in ns
+*/
+uint64_t wd_sched_next(struct wd_sched *sched, uint64_t scheduled, uint64_t fed);
+
+#endif
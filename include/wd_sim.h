@@ -0,0 +1,113 @@
+#ifndef WD_SIM_H
+#define WD_SIM_H
+
+/*
+    In-process simulated WatchDog.
+
+    Open it with wd_open("sim:") or wd_open("sim:opt=val,...").
+    Options:
+        timeout=S       WD timeout in seconds (default 60)
+        pretimeout=S    pretimeout in seconds (default 0)
+        bootstatus=X    bootstatus reported by device
+        temp=T          temperature in degrees fahrenheit
+        tempramp=D      temperature changes by D degrees every second since open
+        notimeleft      driver without GETTIMELEFT support
+        nowayout        magic close does not disarm timer
+        state=PATH      keep running flag and expirations in PATH across opens
+
+    Model: opening arms the timer, keepalive restarts it, magic close
+    disarms it unless nowayout is set. When time left drops to 0 simulated
+    system is "reset": expiration is counted, bootstatus gets
+    WDIOF_CARDRESET and timer restarts.
+    Closing without magic close (or with nowayout) leaves timer running,
+    simulated system would be reset. With state=PATH next open (in any
+    process) sees that reset: expiration is counted and bootstatus gets
+    WDIOF_CARDRESET. Holder killed without close is seen the same way.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <watchdog.h>
+#include <wd_backend.h>
+#include <stdint.h>
+
+#define WD_SIM_DEFAULT_TIMEOUT  60
+
+struct wd_sim_stats
+{
+    uint64_t    keepalives;
+    uint64_t    expirations;    /* simulated resets */
+    uint64_t    faults;         /* injected failures returned */
+    int64_t     min_slack_ns;   /* smallest time left seen at keepalive */
+};
+
+/*
+    Switch simulator to manual clock, time moves only by wd_sim_advance
+
+    PARAMS
+    @IN wd - watchdog descriptor of simulator
+    @IN start_ns - initial time
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_sim_manual_clock(watchdog_t wd, uint64_t start_ns);
+
+/*
+    Move manual clock forward
+
+    PARAMS
+    @IN wd - watchdog descriptor of simulator
+    @IN delta_ns - time to add
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_sim_advance(watchdog_t wd, uint64_t delta_ns);
+
+/*
+    Make next calls fail
+
+    PARAMS
+    @IN wd - watchdog descriptor of simulator
+    @IN ops_mask - WD_OP_BIT(op) of ops to fail
+    @IN err - errno returned by failing op
+    @IN count - number of failures, 0 means until cleared by ops_mask = 0
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_sim_inject_fault(watchdog_t wd, unsigned int ops_mask, int err, unsigned int count);
+
+/*
+    Add artificial latency (busy wait) to every op
+
+    PARAMS
+    @IN wd - watchdog descriptor of simulator
+    @IN latency_ns - latency
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_sim_set_latency(watchdog_t wd, uint64_t latency_ns);
+
+/*
+    Get simulator statistics
+
+    PARAMS
+    @IN wd - watchdog descriptor of simulator
+    @OUT stats - statistics
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_sim_get_stats(watchdog_t wd, struct wd_sim_stats *stats);
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef WD_SOFT_H
+#define WD_SOFT_H
+
+/*
+    Software WatchDog timers multiplexed onto one hardware WatchDog.
+
+    Timers live in hierarchical timing wheel (4 levels x 256 slots of ticks),
+    arm and destroy are O(1). Kick is lazy: one atomic store of coarse time,
+    wheel is not touched, timer is re-queued only when its old deadline comes.
+    Arm, kick and expiry are all stamped with CLOCK_MONOTONIC_COARSE, deadline
+    has resolution of one tick plus one jiffy.
+    Expired timer runs its callback (under context lock, callback may only kick)
+    or, without callback, is reported through context eventfd.
+    Expired timer which is kicked again is re-armed.
+    Hardware WatchDog given to context is fed only while no CRITICAL timer
+    is expired.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <watchdog.h>
+#include <wd_loop.h>
+#include <wd_time.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define WD_SOFT_DEFAULT_TICK_NS     (10 * WD_NSEC_PER_MSEC)
+
+/* timer flags */
+#define WD_SOFT_CRITICAL            (1U << 0)   /* expiry stops hardware feed */
+
+struct wd_soft;
+struct wd_soft_timer;
+
+typedef void (*wd_soft_cb_t)(struct wd_soft_timer *timer, void *arg);
+
+struct wd_soft_stats
+{
+    uint64_t    timers;             /* alive timers */
+    uint64_t    expired;            /* currently expired timers */
+    uint64_t    critical_expired;   /* currently expired critical timers */
+    uint64_t    expirations;        /* total */
+    uint64_t    requeues;           /* kicked timers moved in wheel */
+    uint64_t    feeds;
+    uint64_t    withheld;           /* feeds skipped because of critical timer */
+};
+
+/*
+    Create soft WatchDog context
+
+    PARAMS
+    @IN tick_ns - wheel resolution, 0 means default
+    @IN wd - hardware WatchDog fed by context or -1
+
+    RETURN
+    NULL iff failure
+    Pointer to context iff success
+*/
+struct wd_soft *wd_soft_ctx_create(uint64_t tick_ns, watchdog_t wd);
+
+/*
+    Destroy context and every timer, stops context thread
+
+    PARAMS
+    @IN ctx - context
+
+    RETURN
+    This is a void function
+*/
+void wd_soft_ctx_destroy(struct wd_soft *ctx);
+
+/*
+    Drive context from caller loop (tick timer is added to loop)
+
+    PARAMS
+    @IN ctx - context
+    @IN loop - loop
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_soft_ctx_attach(struct wd_soft *ctx, struct wd_loop *loop);
+
+/*
+    Drive context from own thread
+
+    PARAMS
+    @IN ctx - context
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_soft_ctx_start(struct wd_soft *ctx);
+
+/*
+    Move wheel to given time, fire expired timers and feed hardware WatchDog
+
+    PARAMS
+    @IN ctx - context
+    @IN now - CLOCK_MONOTONIC time
+
+    RETURN
+    Number of timers expired in this call
+*/
+size_t wd_soft_ctx_process(struct wd_soft *ctx, uint64_t now);
+
+/*
+    Get eventfd, readable (counter of expirations) when timer without callback expired
+
+    PARAMS
+    @IN ctx - context
+
+    RETURN
+    eventfd
+*/
+int wd_soft_ctx_fd(const struct wd_soft *ctx);
+
+/*
+    Is every critical timer alive
+
+    PARAMS
+    @IN ctx - context
+
+    RETURN
+    true iff no critical timer is expired
+*/
+bool wd_soft_ctx_healthy(struct wd_soft *ctx);
+
+/*
+    Get context counters
+
+    PARAMS
+    @IN ctx - context
+    @OUT stats - counters
+
+    RETURN
+    This is a void function
+*/
+void wd_soft_ctx_stats(struct wd_soft *ctx, struct wd_soft_stats *stats);
+
+/*
+    Create and arm soft WatchDog timer
+
+    PARAMS
+    @IN ctx - context
+    @IN timeout_ns - timer expires when not kicked for this long
+    @IN flags - WD_SOFT_* flags
+    @IN cb - expiry callback or NULL (eventfd)
+    @IN arg - callback argument
+
+    RETURN
+    NULL iff failure
+    Pointer to timer iff success
+*/
+struct wd_soft_timer *wd_soft_create(struct wd_soft *ctx, uint64_t timeout_ns, unsigned int flags, wd_soft_cb_t cb, void *arg);
+
+/*
+    Kick timer, lock free, callable from any thread
+
+    PARAMS
+    @IN timer - timer
+
+    RETURN
+    This is a void function
+*/
+void wd_soft_kick(struct wd_soft_timer *timer);
+
+/*
+    Is timer expired
+
+    PARAMS
+    @IN timer - timer
+
+    RETURN
+    true iff timer expired and was not kicked since
+*/
+bool wd_soft_expired(const struct wd_soft_timer *timer);
+
+/*
+    Disarm and free timer
+
+    PARAMS
+    @IN timer - timer
+
+    RETURN
+    This is a void function
+*/
+void wd_soft_destroy(struct wd_soft_timer *timer);
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef WD_STATS_H
+#define WD_STATS_H
+
+/*
+    Keepalive jitter and deadline slack instrumentation.
+
+    Feeder records every feed (scheduled vs actual time, keepalive duration,
+    time left) into fixed-size ring and log-linear (HDR style) histograms.
+    There is exactly one writer per device, readers (other processes via
+    mmap'ed stats file) never block it: ring slots are published by
+    release store of sequence number, counters are relaxed atomics.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <wd_format.h>
+
+#define WD_STATS_MAGIC          0x54534457U /* "WDST" */
+#define WD_STATS_VERSION        1
+#define WD_STATS_MAX_DEVS       32
+#define WD_STATS_RING_SIZE      1024        /* power of 2 */
+#define WD_STATS_DEV_NAME_LEN   64
+
+/* histogram: 8 linear sub-buckets for every power of 2 of ns */
+#define WD_HIST_SUB_BITS        3
+#define WD_HIST_SUB             (1U << WD_HIST_SUB_BITS)
+#define WD_HIST_POWERS          48
+#define WD_HIST_BUCKETS         (WD_HIST_POWERS * WD_HIST_SUB)
+
+#define WD_STATS_TIMELEFT_NONE  UINT32_MAX
+
+/* default near-miss: slack below 25% of timeout */
+#define WD_STATS_DEFAULT_NEAR_MISS_PCT  25
+
+struct wd_hist
+{
+    uint64_t    count;
+    uint64_t    max;
+    uint64_t    buckets[WD_HIST_BUCKETS];
+};
+
+struct wd_feed_sample
+{
+    uint64_t    sched_ns;       /* when feed was scheduled */
+    uint64_t    actual_ns;      /* when feeder woke up */
+    int64_t     slack_ns;       /* time left before feed */
+    uint32_t    ioctl_ns;       /* keepalive duration */
+    uint32_t    timeleft;       /* GETTIMELEFT in s or WD_STATS_TIMELEFT_NONE */
+};
+
+struct wd_stats
+{
+    char                    dev[WD_STATS_DEV_NAME_LEN];
+    uint64_t                timeout_ns;
+    uint64_t                near_miss_ns;   /* slack below it is a near miss */
+
+    /* counters */
+    uint64_t                seq;            /* number of samples ever written */
+    uint64_t                feeds;
+    uint64_t                errors;
+    uint64_t                near_misses;
+    int64_t                 min_slack_ns;
+
+    struct wd_hist          jitter;         /* actual - scheduled */
+    struct wd_hist          ioctl;          /* keepalive duration */
+    struct wd_hist          slack;          /* time left before feed */
+
+    struct wd_feed_sample   ring[WD_STATS_RING_SIZE];
+};
+
+struct wd_stats_file
+{
+    uint32_t        magic;
+    uint32_t        version;
+    uint32_t        ndevs;
+    uint32_t        size;   /* sizeof(struct wd_stats_file) */
+    struct wd_stats devs[WD_STATS_MAX_DEVS];
+};
+
+/*
+    Create stats storage, shared file if path is given, anonymous memory otherwise
+
+    PARAMS
+    @IN path - path to stats file or NULL
+    @IN ndevs - number of devices
+
+    RETURN
+    NULL iff failure
+    Pointer to stats iff success
+*/
+struct wd_stats_file *wd_stats_create(const char *path, size_t ndevs);
+
+/*
+    Attach read-only to stats file of running feeder
+
+    PARAMS
+    @IN path - path to stats file
+
+    RETURN
+    NULL iff failure
+    Pointer to stats iff success
+*/
+const struct wd_stats_file *wd_stats_attach(const char *path);
+
+/*
+    Unmap stats
+
+    PARAMS
+    @IN file - stats
+
+    RETURN
+    This is a void function
+*/
+void wd_stats_destroy(const struct wd_stats_file *file);
+
+/*
+    Init stats of one device
+
+    PARAMS
+    @IN stats - device stats
+    @IN dev - device name
+    @IN timeout_ns - WD timeout
+    @IN near_miss_pct - slack below this % of timeout is near miss
+
+    RETURN
+    This is a void function
+*/
+void wd_stats_dev_init(struct wd_stats *stats, const char *dev, uint64_t timeout_ns, unsigned int near_miss_pct);
+
+/*
+    Record one feed, hot path
+
+    PARAMS
+    @IN stats - device stats
+    @IN sample - feed sample
+    @IN ok - keepalive succeeded
+
+    RETURN
+    This is a void function
+*/
+void wd_stats_record(struct wd_stats *stats, const struct wd_feed_sample *sample, bool ok);
+
+/*
+    Add value to histogram, single writer
+
+    PARAMS
+    @IN hist - histogram
+    @IN val - value in ns
+
+    RETURN
+    This is a void function
+*/
+void wd_hist_add(struct wd_hist *hist, uint64_t val);
+
+/*
+    Get value below which p % of recorded values are
+
+    PARAMS
+    @IN hist - histogram
+    @IN p - percentile 0.0 - 100.0
+
+    RETURN
+    Upper bound of percentile bucket in ns
+*/
+uint64_t wd_hist_percentile(const struct wd_hist *hist, double p);
+
+/*
+    Count values surely not above val (values of buckets whose upper bound is <= val)
+
+    PARAMS
+    @IN hist - histogram
+    @IN val - value in ns
+
+    RETURN
+    Number of values
+*/
+uint64_t wd_hist_count_le(const struct wd_hist *hist, uint64_t val);
+
+/*
+    Estimate sum of recorded values from bucket midpoints (error below 1/16)
+
+    PARAMS
+    @IN hist - histogram
+
+    RETURN
+    Sum in ns
+*/
+uint64_t wd_hist_sum(const struct wd_hist *hist);
+
+/*
+    Copy last samples without blocking the writer
+
+    PARAMS
+    @IN stats - device stats
+    @OUT samples - output array
+    @IN n - max number of samples
+
+    RETURN
+    Number of copied samples
+*/
+size_t wd_stats_last(const struct wd_stats *stats, struct wd_feed_sample *samples, size_t n);
+
+/*
+    Format min slack, jitter percentiles and near misses of every device
+
+    PARAMS
+    @OUT buf - output buffer
+    @IN size - buffer size
+    @IN file - stats
+    @IN fmt - output format, binary is not supported (stats file is binary already)
+
+    RETURN
+    -1 iff failure
+    Output length iff success
+*/
+ssize_t wd_stats_format(char *buf, size_t size, const struct wd_stats_file *file, wd_format_t fmt);
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef WD_SYSFS_H
+#define WD_SYSFS_H
+
+/*
+    Read-only WatchDog queries via /sys/class/watchdog/watchdogN.
+
+    Device node is never opened, so queries do not arm the timer
+    and work while another process (daemon) holds the device.
+    Attributes are opened once and re-read with pread.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <watchdog.h>
+#include <stdbool.h>
+
+#define WD_SYSFS_CLASS  "/sys/class/watchdog"
+
+typedef enum
+{
+    WD_SYSFS_TIMEOUT = 0,
+    WD_SYSFS_PRETIMEOUT,
+    WD_SYSFS_TIMELEFT,
+    WD_SYSFS_BOOTSTATUS,
+    WD_SYSFS_STATUS,
+    WD_SYSFS_IDENTITY,
+    WD_SYSFS_FW_VERSION,
+    WD_SYSFS_OPTIONS,
+    WD_SYSFS_STATE,
+    WD_SYSFS_ATTRS
+} wd_sysfs_attr_t;
+
+struct wd_sysfs
+{
+    int fds[WD_SYSFS_ATTRS];   /* -1 iff attribute is not exported by driver */
+};
+
+/*
+    Open sysfs attributes of WatchDog
+
+    PARAMS
+    @IN dev - /dev/watchdogN, /dev/watchdog (watchdog0) or sysfs directory
+    @OUT sysfs - sysfs handle
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_sysfs_open(const char *dev, struct wd_sysfs *sysfs);
+
+/*
+    Close sysfs attributes
+
+    PARAMS
+    @IN sysfs - sysfs handle
+
+    RETURN
+    This is a void function
+*/
+void wd_sysfs_close(struct wd_sysfs *sysfs);
+
+/*
+    Get Timeout from sysfs
+
+    PARAMS
+    @IN sysfs - sysfs handle
+    @OUT timeout - WD timeout
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_sysfs_get_timeout(const struct wd_sysfs *sysfs, unsigned int *timeout);
+
+/*
+    Get PRE Timeout from sysfs
+
+    PARAMS
+    @IN sysfs - sysfs handle
+    @OUT timeout - WD pre timeout
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_sysfs_get_pretimeout(const struct wd_sysfs *sysfs, unsigned int *timeout);
+
+/*
+    Get time left to reset system from sysfs
+
+    PARAMS
+    @IN sysfs - sysfs handle
+    @OUT time - time left to reset
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_sysfs_get_timeleft(const struct wd_sysfs *sysfs, unsigned int *time);
+
+/*
+    Get Bootstatus from sysfs
+
+    PARAMS
+    @IN sysfs - sysfs handle
+    @OUT status - bootstatus
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_sysfs_get_bootstatus(const struct wd_sysfs *sysfs, int *status);
+
+/*
+    Get Status from sysfs
+
+    PARAMS
+    @IN sysfs - sysfs handle
+    @OUT status - status
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_sysfs_get_status(const struct wd_sysfs *sysfs, int *status);
+
+/*
+    Get WatchDog info (identity, firmware, options) from sysfs
+
+    PARAMS
+    @IN sysfs - sysfs handle
+    @OUT wd_info - watchdog info
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_sysfs_get_info(const struct wd_sysfs *sysfs, struct watchdog_info *wd_info);
+
+/*
+    Check whether WatchDog is running
+
+    PARAMS
+    @IN sysfs - sysfs handle
+    @OUT active - true iff WD is active
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_sysfs_get_state(const struct wd_sysfs *sysfs, bool *active);
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef WD_TIME_H
+#define WD_TIME_H
+
+/*
+    Monotonic time helpers used by WatchDog feeders
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <stdint.h>
+#include <time.h>
+
+#define WD_NSEC_PER_USEC    ((uint64_t)1000)
+#define WD_NSEC_PER_MSEC    ((uint64_t)1000000)
+#define WD_NSEC_PER_SEC     ((uint64_t)1000000000)
+
+/*
+    Get current CLOCK_MONOTONIC time
+
+    PARAMS
+    NO PARAMS
+
+    RETURN
+    Time in nanoseconds
+*/
+static inline uint64_t wd_time_now_ns(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * WD_NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+/*
+    Get current CLOCK_MONOTONIC_COARSE time, few ns but tick (1 - 4 ms) precision,
+    never ahead of wd_time_now_ns
+
+    PARAMS
+    NO PARAMS
+
+    RETURN
+    Time in nanoseconds
+*/
+static inline uint64_t wd_time_coarse_ns(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+
+    return (uint64_t)ts.tv_sec * WD_NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+/*
+    Convert nanoseconds to timespec
+
+    PARAMS
+    @IN ns - time in nanoseconds
+    @OUT ts - timespec
+
+    RETURN
+    This is a void function
+*/
+static inline void wd_time_to_timespec(uint64_t ns, struct timespec *ts)
+{
+    ts->tv_sec = (time_t)(ns / WD_NSEC_PER_SEC);
+    ts->tv_nsec = (long)(ns % WD_NSEC_PER_SEC);
+}
+
+#endif
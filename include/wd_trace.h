@@ -0,0 +1,147 @@
+#ifndef WD_TRACE_H
+#define WD_TRACE_H
+
+/*
+    Binary trace of wd_* calls.
+
+    When enabled every call at watchdog.c dispatch layer writes one fixed-size
+    record (function id, monotonic time, return code, errno, argument and
+    backend latency) into per-process mmap'ed ring file. No formatting on hot
+    path, writers claim slots with one atomic add, readers check record
+    sequence to skip torn records.
+    Decode with tools/wd_trace_decode (make trace-decode).
+    Recording (--record) is the same trace with ring big enough to hold
+    whole run, tools/wd_replay (make replay) drives it again with original
+    timing and compares latency and slack.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <wd_backend.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define WD_TRACE_MAGIC          0x52544457U /* "WDTR" */
+#define WD_TRACE_VERSION        2
+#define WD_TRACE_DEFAULT_RECS   4096        /* power of 2 */
+#define WD_TRACE_RECORD_RECS    (1U << 18)  /* 10 MB, a week of feeds every 5 s */
+
+/* function ids, backend ops keep wd_op_t numbers */
+typedef enum
+{
+    WD_TRACE_FN_OPEN = WD_OP_MAX,
+    WD_TRACE_FN_CLOSE,
+    WD_TRACE_FN_RELEASE,
+    WD_TRACE_FN_SNAPSHOT,
+    WD_TRACE_FN_MAX
+} wd_trace_fn_t;
+
+struct wd_trace_rec
+{
+    uint64_t    seq;    /* index + 1 when record is complete */
+    uint64_t    ts_ns;  /* CLOCK_MONOTONIC at return */
+    uint16_t    fn;     /* wd_op_t or wd_trace_fn_t */
+    int16_t     wd;     /* handle */
+    int32_t     ret;
+    int32_t     err;    /* errno at return */
+    uint32_t    arg;    /* value set or got, 0 when call has none */
+    uint32_t    lat_ns; /* time spent in backend, 0 when not measured */
+    uint32_t    pad;
+};
+
+struct wd_trace_hdr
+{
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    rec_size;   /* sizeof(struct wd_trace_rec) */
+    uint32_t    nrecs;      /* ring capacity, power of 2 */
+    uint32_t    pid;
+    uint64_t    seq;        /* number of records ever claimed */
+    uint64_t    start_ns;   /* CLOCK_MONOTONIC at open */
+    uint8_t     pad[32];
+};
+
+/* ring header, NULL when tracing is disabled */
+extern struct wd_trace_hdr *wd_trace_ring;
+
+/*
+    Start tracing into file
+
+    PARAMS
+    @IN path - trace file, created or truncated
+    @IN nrecs - ring capacity, rounded up to power of 2, 0 means default
+
+    RETURN
+    0 iff success
+    Non-zero iff failure
+*/
+int wd_trace_open(const char *path, size_t nrecs);
+
+/*
+    Stop tracing, file stays for decoder
+
+    PARAMS
+    NO PARAMS
+
+    RETURN
+    This is a void function
+*/
+void wd_trace_close(void);
+
+/*
+    Write one record, do not call directly, use WD_TRACE_CALL or WD_TRACE_OP
+
+    PARAMS
+    @IN fn - function id
+    @IN wd - handle
+    @IN ret - return code
+    @IN arg - value set or got
+    @IN start_ns - CLOCK_MONOTONIC before backend call, 0 means not measured
+
+    RETURN
+    This is a void function
+*/
+void wd_trace_record(unsigned int fn, watchdog_t wd, int ret, uint32_t arg, uint64_t start_ns);
+
+/*
+    Get CLOCK_MONOTONIC for latency of traced call, do not call directly, use WD_TRACE_START
+
+    PARAMS
+    NO PARAMS
+
+    RETURN
+    Time in ns
+*/
+uint64_t wd_trace_now(void);
+
+/*
+    Get function name
+
+    PARAMS
+    @IN fn - function id
+
+    RETURN
+    Function name or "unknown"
+*/
+const char *wd_trace_fn_name(unsigned int fn);
+
+/* disabled trace costs one predicted branch */
+#define WD_TRACE_CALL(fn, wd, ret) \
+    do { \
+        if (__builtin_expect(wd_trace_ring != NULL, 0)) \
+            wd_trace_record((unsigned int)(fn), wd, ret, 0, 0); \
+    } while (0)
+
+#define WD_TRACE_OP(fn, wd, ret, arg, start_ns) \
+    do { \
+        if (__builtin_expect(wd_trace_ring != NULL, 0)) \
+            wd_trace_record((unsigned int)(fn), wd, ret, arg, start_ns); \
+    } while (0)
+
+/* start of traced call, 0 when trace is disabled */
+#define WD_TRACE_START() \
+    (__builtin_expect(wd_trace_ring != NULL, 0) ? wd_trace_now() : 0)
+
+#endif
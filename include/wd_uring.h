@@ -0,0 +1,107 @@
+#ifndef WD_URING_H
+#define WD_URING_H
+
+/*
+    Batched keepalive over io_uring.
+
+    WatchDog core treats any write to device as keepalive, so feeding many
+    devices is one io_uring_enter: one write SQE per device, submitted and
+    reaped in the same call. Every completion is checked, so failure of one
+    device is reported for that device only.
+    Ring is set up with raw syscalls, no liburing. Device descriptors are
+    registered as fixed files at init.
+    Devices without descriptor (sim, sysfs) are fed by wd_keepalive in the
+    same batch. When io_uring is not available (old kernel, seccomp,
+    kernel.io_uring_disabled) or enter fails, every device is fed by ioctl.
+    Written byte is never 'V', magic close is not armed by feeding.
+    WatchDog core has no nowait write, kernel completes writes in its io-wq
+    workers, caller still waits for all of them inside the one enter.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <watchdog.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define WD_URING_MAX_DEVS   32
+
+struct wd_uring_dev
+{
+    watchdog_t  wd;
+    int         fd;         /* descriptor or -1 when fed by ioctl */
+};
+
+struct wd_uring
+{
+    int                 fd;         /* io_uring or -1 when devices are fed by ioctl */
+    bool                fixed;      /* descriptors registered as fixed files */
+    void                *sq_ring;
+    size_t              sq_ring_len;
+    void                *cq_ring;
+    size_t              cq_ring_len;
+    void                *sqes;
+    size_t              sqes_len;
+    unsigned int        *sq_head;
+    unsigned int        *sq_tail;
+    unsigned int        *sq_array;
+    unsigned int        sq_mask;
+    unsigned int        *cq_head;
+    unsigned int        *cq_tail;
+    void                *cqes;
+    unsigned int        cq_mask;
+    uint64_t            off;        /* write offset, -1 (current position) when kernel supports it */
+    struct wd_uring_dev devs[WD_URING_MAX_DEVS];
+    size_t              ndevs;
+
+    /* counters */
+    uint64_t            batches;    /* io_uring_enter calls */
+    uint64_t            writes;     /* keepalives done by write */
+    uint64_t            ioctls;     /* keepalives done by ioctl */
+    uint64_t            errors;     /* failed keepalives */
+};
+
+/*
+    Register devices and set up ring, falls back to ioctl if ring cannot be set up
+
+    PARAMS
+    @OUT ring - ring to init (must be valid until wd_uring_deinit)
+    @IN wds - WatchDog descriptors, index in wds is device index in wd_uring_feed
+    @IN n - number of devices (max WD_URING_MAX_DEVS)
+
+    RETURN
+    0 iff success (ring->fd == -1 means ioctl fallback)
+    Non-zero iff failure
+*/
+int wd_uring_init(struct wd_uring *ring, const watchdog_t *wds, size_t n);
+
+/*
+    Unmap and close ring, ring can be zeroed with fd == -1 and never inited
+
+    PARAMS
+    @IN ring - ring
+
+    RETURN
+    This is a void function
+*/
+void wd_uring_deinit(struct wd_uring *ring);
+
+/*
+    Feed devices in one batch
+
+    PARAMS
+    @IN ring - ring
+    @IN idx - indexes of devices to feed
+    @IN n - number of indexes
+    @OUT res - result of every device, 0 iff fed, -errno iff failure
+
+    RETURN
+    0 iff every device was fed
+    Non-zero iff any device failed
+*/
+int wd_uring_feed(struct wd_uring *ring, const size_t *idx, size_t n, int *res);
+
+#endif
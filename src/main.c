@@ -12,6 +12,21 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <wd_daemon.h>
+#include <glob.h>
+#include <wd_backend.h>
+#include <wd_format.h>
+#include <unistd.h>
+#include <wd_time.h>
+#include <wd_stats.h>
+#include <sched.h>
+#include <wd_trace.h>
+#include <wd_heartbeat.h>
+#include <inttypes.h>
+#include <wd_ctl.h>
+#include <wd_batch.h>
+#include <wd_scan.h>
+#include <wd_history.h>
 
 #define WD_OPEN(wd, dev) \
     __extension__ \
@@ -19,10 +34,11 @@
         int ______ret = wd; \
         if (!is_open) \
         { \
-            ______ret = wd_open(dev); \
+            ______ret = wd_open_backend(backend, dev); \
             if (______ret == -1) \
                 return 1; \
             is_open = true; \
+            open_dev = dev; \
         } \
         ______ret; \
     })
@@ -52,9 +68,53 @@ enum {
     OPT_GET_TEMP,
     OPT_SET_OPTIONS,
     OPT_GET_INFO,
+    OPT_DAEMON,
+    OPT_FEED_RATIO,
+    OPT_ADAPTIVE,
+    OPT_SLACK_BAND,
+    OPT_GET_SNAPSHOT,
+    OPT_SYSFS,
+    OPT_FORMAT,
+    OPT_STATS,
+    OPT_NEAR_MISS,
+    OPT_FEED_STATS,
+    OPT_RT_FIFO,
+    OPT_RT_DEADLINE,
+    OPT_MLOCK,
+    OPT_CPU,
+    OPT_SELFTEST,
+    OPT_TRACE,
+    OPT_RECORD,
+    OPT_HEARTBEAT,
+    OPT_HB_SHM,
+    OPT_HB_BEAT,
+    OPT_HB_LIST,
+    OPT_CHECK,
+    OPT_CHECK_WORKERS,
+    OPT_PSI,
+    OPT_PSI_HOLD,
+    OPT_SOFT_TIMER,
+    OPT_CTL,
+    OPT_CTL_GET,
+    OPT_HANDOVER,
+    OPT_BATCH,
+    OPT_SCAN,
+    OPT_SCAN_WORKERS,
+    OPT_HISTORY,
+    OPT_HISTORY_QUERY,
+    OPT_METRICS_LISTEN,
+    OPT_METRICS_FILE,
+    OPT_METRICS_INTERVAL,
+    OPT_SAMPLE,
+    OPT_SAMPLE_PERIOD,
+    OPT_URING,
     OPT_HELP
 } OPTIONS;
 
+#define OUT_BUF_SIZE    4096
+#define STATS_BUF_SIZE  (64 * 1024)
+#define BATCH_BUF_SIZE  (64 * 1024)
+
 #define OPT_NO_MATCH    0
 #define OPT_ERROR       -1
 
@@ -63,11 +123,202 @@ int my_getopt_long_only(int argc, char *const *argv, const char *short_opt, cons
 
 /* Print help */
 void usage(void);
+void print_heartbeats(const struct wd_hb_registry *reg);
+int ctl_query(const char *path, char *list, wd_format_t format, struct wd_snapshot *out);
+
+void print_heartbeats(const struct wd_hb_registry *reg)
+{
+    const struct wd_hb_slot *slot;
+    const uint64_t now = wd_time_now_ns();
+    uint64_t beat;
+    uint32_t i;
+
+    (void)printf("%-6s %-40s %-8s %12s %12s  %s\n", "SLOT", "NAME", "PID", "DEADLINE", "AGE", "STATE");
+    for (i = 0; i < reg->hdr->nslots; ++i)
+    {
+        slot = wd_hb_registry_slot(reg, i);
+        if (slot == NULL)
+            continue;
+
+        beat = __atomic_load_n(&slot->beat_ns, __ATOMIC_ACQUIRE);
+        beat = now > beat ? now - beat : 0;
+        (void)printf("%-6" PRIu32 " %-40.*s %-8" PRIu32 " %9" PRIu64 " ms %9" PRIu64 " ms  %s\n",
+                     i, (int)sizeof(slot->name), slot->name, slot->pid,
+                     slot->deadline_ns / WD_NSEC_PER_MSEC, beat / WD_NSEC_PER_MSEC,
+                     beat > slot->deadline_ns ? "STALE" : "fresh");
+    }
+}
+
+int ctl_query(const char *path, char *list, wd_format_t format, struct wd_snapshot *out)
+{
+    static uint64_t msg[WD_CTL_MAX_MSG / sizeof(uint64_t)];
+    struct wd_ctl_cmd cmds[WD_CTL_MAX_CMDS];
+    const struct wd_ctl_res *res;
+    struct wd_ctl_feed feed;
+    unsigned int op;
+    size_t n = 0;
+    size_t i;
+    ssize_t len;
+    char *save;
+    char *tok;
+    char *val;
+    char *dev;
+    int ret = 0;
+    int fd;
+
+    /* op[=arg][@dev],... all go to daemon in one request */
+    for (tok = strtok_r(list, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save))
+    {
+        dev = strchr(tok, '@');
+        if (dev != NULL)
+            *dev++ = '\0';
+
+        val = strchr(tok, '=');
+        if (val != NULL)
+            *val++ = '\0';
+
+        if (n == WD_CTL_MAX_CMDS || wd_ctl_op_parse(tok, &op))
+        {
+            (void)fprintf(stderr, "Control op [%s] - Incorrect argument\n", tok);
+            return 1;
+        }
+
+        cmds[n].op = (uint16_t)op;
+        cmds[n].dev = dev ? (uint16_t)atoi(dev) : 0;
+        cmds[n].arg = val ? (uint32_t)strtoul(val, NULL, 0) : 0;
+        ++n;
+    }
+
+    fd = wd_ctl_connect(path);
+    if (fd == -1)
+        return 1;
+
+    len = wd_ctl_call(fd, cmds, n, msg, sizeof(msg));
+    (void)close(fd);
+    if (len < 0)
+        return 1;
+
+    res = (const struct wd_ctl_res *)((const struct wd_ctl_hdr *)msg + 1);
+    for (i = 0; i < n; ++i, ++res)
+    {
+        if (res->err)
+        {
+            (void)fprintf(stderr, "dev %u %s: %s\n", res->dev, wd_ctl_op_name(res->op), strerror(res->err));
+            ret = 1;
+            continue;
+        }
+
+        switch (res->op)
+        {
+            case WD_OP_GET_TIMEOUT:
+            {
+                out->timeout = (unsigned int)res->val;
+                out->valid |= WD_SNAP_TIMEOUT;
+                break;
+            }
+            case WD_OP_GET_PRETIMEOUT:
+            {
+                out->pretimeout = (unsigned int)res->val;
+                out->valid |= WD_SNAP_PRETIMEOUT;
+                break;
+            }
+            case WD_OP_GET_TIMELEFT:
+            {
+                out->timeleft = (unsigned int)res->val;
+                out->valid |= WD_SNAP_TIMELEFT;
+                break;
+            }
+            case WD_OP_GET_BOOTSTATUS:
+            {
+                out->bootstatus = (int)res->val;
+                out->valid |= WD_SNAP_BOOTSTATUS;
+                break;
+            }
+            case WD_OP_GET_STATUS:
+            {
+                out->status = (int)res->val;
+                out->valid |= WD_SNAP_STATUS;
+                break;
+            }
+            case WD_OP_GET_TEMP:
+            {
+                out->temp = (int)res->val;
+                out->valid |= WD_SNAP_TEMP;
+                break;
+            }
+            case WD_OP_GET_INFO:
+            {
+                if (wd_ctl_payload(msg, (size_t)len, res, &out->info, sizeof(out->info)) == 0)
+                    out->valid |= WD_SNAP_INFO;
+
+                if (format == WD_FORMAT_TEXT)
+                    (void)printf("dev %u %s: %.*s firmware %u options 0x%x\n", res->dev, wd_ctl_op_name(res->op),
+                                 (int)sizeof(out->info.identity), (const char *)out->info.identity,
+                                 out->info.firmware_version, out->info.options);
+
+                continue;
+            }
+            case WD_CTL_SNAPSHOT:
+            {
+                if (wd_ctl_payload(msg, (size_t)len, res, out, sizeof(*out)))
+                {
+                    ret = 1;
+                    continue;
+                }
+
+                if (format == WD_FORMAT_TEXT)
+                {
+                    (void)printf("dev %u %s (%" PRId64 " ms old):\n", res->dev, wd_ctl_op_name(res->op),
+                                 res->val / (int64_t)WD_NSEC_PER_MSEC);
+                    wd_print_snapshot(out);
+                }
+
+                continue;
+            }
+            case WD_CTL_FEED:
+            {
+                if (wd_ctl_payload(msg, (size_t)len, res, &feed, sizeof(feed)))
+                {
+                    ret = 1;
+                    continue;
+                }
+
+                if (format == WD_FORMAT_TEXT)
+                    (void)printf("dev %u %s: feeds %" PRIu64 " errors %" PRIu64 " withheld %" PRIu64
+                                 " period %" PRIu64 " ms timeout %u s%s\n",
+                                 res->dev, wd_ctl_op_name(res->op), feed.feeds, feed.errors, feed.withheld,
+                                 feed.period_ns / WD_NSEC_PER_MSEC, feed.timeout,
+                                 feed.withholding ? " withholding" : "");
+
+                continue;
+            }
+            case WD_OP_SET_TIMEOUT:
+            case WD_OP_SET_PRETIMEOUT:
+            case WD_OP_SET_OPTIONS:
+            case WD_CTL_SOFT_KICK:
+            {
+                if (format == WD_FORMAT_TEXT)
+                    (void)printf("dev %u %s: ok\n", res->dev, wd_ctl_op_name(res->op));
+
+                continue;
+            }
+            default:
+                break;
+        }
+
+        if (format == WD_FORMAT_TEXT)
+            (void)printf("dev %u %s: %" PRId64 "\n", res->dev, wd_ctl_op_name(res->op), res->val);
+    }
+
+    return ret;
+}
 
 void usage(void)
 {
     (void)printf("HELP\n\n");
     (void)printf("--dev [x]\t\t- change watchdog, default is /dev/watchdog\n");
+    (void)printf("\t\t\t  sim:[timeout=x,...] opens simulated watchdog\n");
+    (void)printf("\t\t\t  daemon feeds every given --dev, glob patterns are allowed\n");
     (void)printf("--get-timeout\t\t- get timeout in seconds\n");
     (void)printf("--set-timeout [x]\t- set timeout in seconds\n");
     (void)printf("--get-pretimeout\t- get pretimeout in seconds\n");
@@ -79,28 +330,115 @@ void usage(void)
     (void)printf("--get-temp\t\t- get temperature in in degrees fahrenheit\n");
     (void)printf("--set-options [x]\t- set options in hex\n");
     (void)printf("--get-info\t\t- get info about WatchDog\n");
+    (void)printf("--get-snapshot\t\t- get all supported WatchDog state at once\n");
+    (void)printf("--format [x]\t\t- output format: text, json, kv, bin, default is text\n");
+    (void)printf("--sysfs\t\t\t- answer queries from /sys/class/watchdog, device is not opened\n");
+    (void)printf("--daemon\t\t- keep device open and feed it until SIGTERM\n");
+    (void)printf("--feed-ratio [x]\t- daemon feed period in %% of timeout, default is %d\n", WD_SCHED_DEFAULT_FEED_PCT);
+    (void)printf("--adaptive\t\t- daemon adapts feed period to time left\n");
+    (void)printf("--slack-band [x:y]\t- adaptive slack band in %% of timeout, default is %d:%d\n",
+                 WD_SCHED_DEFAULT_SLACK_MIN_PCT, WD_SCHED_DEFAULT_SLACK_MAX_PCT);
+    (void)printf("--stats [x]\t\t- daemon shares feed stats through file x\n");
+    (void)printf("--near-miss [x]\t\t- slack below x %% of timeout is a near miss, default is %d\n",
+                 WD_STATS_DEFAULT_NEAR_MISS_PCT);
+    (void)printf("--feed-stats [x]\t- print min slack, jitter and near misses from daemon stats file x\n");
+    (void)printf("--rt-fifo [x]\t\t- daemon runs with SCHED_FIFO priority x\n");
+    (void)printf("--rt-deadline [x:y]\t- daemon runs with SCHED_DEADLINE runtime x us every y us\n");
+    (void)printf("--mlock\t\t\t- daemon locks memory and prefaults stack before feeding\n");
+    (void)printf("--cpu [x]\t\t- daemon is pinned to CPU x\n");
+    (void)printf("--selftest [x]\t\t- feed for x seconds, report page faults and context switches\n");
+    (void)printf("--trace [x]\t\t- binary trace of following wd_* calls into file x\n");
+    (void)printf("--record [x]\t\t- record following wd_* calls into file x for wd_replay, up to %u calls\n",
+                 WD_TRACE_RECORD_RECS);
+    (void)printf("--heartbeat\t\t- daemon feeds only while every registered client heartbeats in time\n");
+    (void)printf("--hb-shm [x]\t\t- heartbeat registry shm name, default is %s\n", WD_HB_DEFAULT_SHM);
+    (void)printf("--hb-beat [x:y]\t\t- register client x with deadline y ms (if needed) and heartbeat\n");
+    (void)printf("--hb-list\t\t- print heartbeat clients\n");
+    (void)printf("--check [x]\t\t- daemon feeds only while check x passes, TYPE:ARG[,deadline=ms][,ttl=ms]\n");
+    (void)printf("\t\t\t  TYPE is disk:path, rofs:path, mem:KB, pid:file or exec:cmd\n");
+    (void)printf("--check-workers [x]\t- run checks on x threads, default is %u\n", WD_CHECK_DEFAULT_WORKERS);
+    (void)printf("--psi [x]\t\t- daemon starves feed under pressure x, RES:some|full=STALL_MS/WINDOW_MS[,cgroup=DIR]\n");
+    (void)printf("\t\t\t  RES is cpu, memory or io\n");
+    (void)printf("--psi-hold [x]\t\t- pressure must last x ms before feed is starved, default is %u\n", WD_PSI_DEFAULT_HOLD_MS);
+    (void)printf("--soft-timer [x]\t- daemon feeds only while soft timer kicked every x ms is alive (can be repeated)\n");
+    (void)printf("\t\t\t  timers are kicked by --ctl-get soft-kick=IDX\n");
+    (void)printf("--ctl [x]\t\t- control socket path, daemon serves it, default for --ctl-get is %s\n", WD_CTL_DEFAULT_PATH);
+    (void)printf("--ctl-get [x]\t\t- send ops x to daemon in one request, op[=arg][@dev],...\n");
+    (void)printf("\t\t\t  op is get-timeout, set-timeout, get-timeleft, get-info, snapshot, feed, devs, ...\n");
+    (void)printf("--handover [x]\t\t- daemon takes devices over from daemon listening on x, then listens on x\n");
+    (void)printf("--batch [x]\t\t- run ops from file x (- is stdin) on one descriptor, one op[ arg] per line\n");
+    (void)printf("\t\t\t  whole script is validated first, first failed op stops the batch\n");
+    (void)printf("--scan [x]\t\t- query WatchDogs in parallel, x is root dir (ROOT/sys/class/watchdog, read-only),\n");
+    (void)printf("\t\t\t  sim:[opts] or device glob, can be repeated\n");
+    (void)printf("--scan-workers [x]\t- threads of --scan, default is one per CPU, max is %d\n", WD_SCAN_MAX_WORKERS);
+    (void)printf("--history [x]\t\t- record bootstatus of this boot in history file x (daemon or --get-bootstatus)\n");
+    (void)printf("--history-query [x]\t- aggregate history file x per device: boots, reset causes, last boot\n");
+    (void)printf("--metrics-listen [x]\t- daemon serves Prometheus metrics over HTTP on [HOST:]PORT x, HOST is 127.0.0.1\n");
+    (void)printf("--metrics-file [x]\t- daemon writes Prometheus metrics to textfile x (atomic rename)\n");
+    (void)printf("--metrics-interval [x]\t- metrics are rendered every x ms, default is %d\n", WD_EXPORTER_DEFAULT_INTERVAL_MS);
+    (void)printf("--sample [x]\t\t- daemon samples temperature and status, fires rule x, METRIC OP VALUE[,panic][,exec=CMD]\n");
+    (void)printf("\t\t\t  temp>=F, temp<=F, rate>=F/min, rate<=F/min or status&MASK, can be repeated\n");
+    (void)printf("--sample-period [x:y]\t- sample every x ms, up to y ms while stable, default is %d:%d\n",
+                 WD_SAMPLE_DEFAULT_MIN_MS, WD_SAMPLE_DEFAULT_MAX_MS);
+    (void)printf("--uring\t\t\t- daemon feeds due devices by one io_uring write batch, ioctl if not available\n");
     (void)printf("--help\t\t\t- print this usage\n");
     (void)printf("\n");
     (void)printf("Examples\n");
     (void)printf("./watchdog.out --dev /dev/watchdog0 --set-timeout 8\n");
     (void)printf("./watchdog.out --set-options 0x3\n");
     (void)printf("./watchdog.out --get-info --get-temp --get-bootstatus --get-timeleft\n");
+    (void)printf("./watchdog.out --sysfs --dev /dev/watchdog1 --get-timeleft --get-bootstatus\n");
+    (void)printf("./watchdog.out --format=json --get-timeleft --get-bootstatus\n");
+    (void)printf("./watchdog.out --set-timeout 30 --feed-ratio 40 --daemon\n");
+    (void)printf("./watchdog.out --dev '/dev/watchdog[0-9]*' --daemon\n");
+    (void)printf("./watchdog.out --dev sim:timeout=10 --adaptive --daemon\n");
+    (void)printf("./watchdog.out --stats /run/wd.stats --daemon\n");
+    (void)printf("./watchdog.out --rt-fifo 80 --mlock --cpu 1 --daemon\n");
+    (void)printf("./watchdog.out --dev sim:timeout=2 --rt-fifo 80 --mlock --selftest 10 --daemon\n");
+    (void)printf("./watchdog.out --trace /tmp/wd.trace --dev sim: --daemon\n");
+    (void)printf("./watchdog.out --record /var/tmp/wd.rec --adaptive --daemon\n");
+    (void)printf("./watchdog.out --heartbeat --daemon\n");
+    (void)printf("./watchdog.out --hb-beat backup:600000\n");
+    (void)printf("./watchdog.out --check mem:65536 --check disk:/var/log,deadline=500 --daemon\n");
+    (void)printf("./watchdog.out --psi memory:full=500/1000 --psi io:some=800/1000 --psi-hold 30000 --daemon\n");
+    (void)printf("./watchdog.out --ctl /run/watchdog.ctl --daemon\n");
+    (void)printf("./watchdog.out --ctl-get get-timeleft,feed,snapshot@1,set-timeout=30\n");
+    (void)printf("./watchdog.out --ctl /run/watchdog.ctl --soft-timer 60000 --daemon\n");
+    (void)printf("./watchdog.out --ctl-get soft-kick=0\n");
+    (void)printf("./watchdog.out --handover /run/watchdog.handover --daemon\n");
+    (void)printf("./watchdog.out --format=json --feed-stats /run/wd.stats\n");
+    (void)printf("printf 'set-timeout 30\\nset-pretimeout 10\\nsnapshot\\n' | ./watchdog.out --batch -\n");
+    (void)printf("./watchdog.out --format=json --scan / --scan /srv/guest1 --scan /srv/guest2\n");
+    (void)printf("./watchdog.out --stats /var/lib/wd.stats --history /var/lib/wd.history --daemon\n");
+    (void)printf("./watchdog.out --history-query /var/lib/wd.history\n");
+    (void)printf("./watchdog.out --metrics-listen 9102 --metrics-file /var/lib/node_exporter/watchdog.prom --daemon\n");
+    (void)printf("./watchdog.out --sample temp>=170,exec=/etc/wd/hot.sh --sample temp>=190,panic --sample rate>=10 --daemon\n");
+    (void)printf("./watchdog.out --dev '/dev/watchdog[0-9]*' --uring --daemon\n");
     (void)printf("\n");
 }
 
 int my_getopt_long_only(int argc, char *const *argv, const char *short_opt, const struct option *long_opt, int *index)
 {
+    /* table is the same on every call, count it once */
+    static const struct option *opt_table;
+    static int opt_size;
     int temp;
-    int opt_size;
     int opt_index;
     int _index;
+    size_t name_len;
+    const char *opt;
 
     if (long_opt == NULL)
         return OPT_ERROR;
 
-    opt_size = 0;
-    while (long_opt[opt_size].name != NULL)
-        ++opt_size;
+    if (long_opt != opt_table)
+    {
+        opt_size = 0;
+        while (long_opt[opt_size].name != NULL)
+            ++opt_size;
+
+        opt_table = long_opt;
+    }
 
     temp = getopt_long_only(argc, argv, short_opt, long_opt, &_index);
     if (index != NULL)
@@ -119,19 +457,20 @@ int my_getopt_long_only(int argc, char *const *argv, const char *short_opt, cons
         return OPT_ERROR;
 
     opt_index = optind - 1;
-    if (long_opt[_index].has_arg == required_argument)
+    /* --option value, but not --option=value */
+    if (long_opt[_index].has_arg == required_argument && optarg == argv[opt_index])
         --opt_index;
 
-    /* -option */
-    if (strcmp(long_opt[_index].name, argv[opt_index] + 1) == 0)
-        return temp;
-
-    /* --option */
-    if (strcmp(long_opt[_index].name, argv[opt_index] + 2) == 0)
-        return temp;
+    name_len = strlen(long_opt[_index].name);
+    opt = argv[opt_index] + 1;
+    if (*opt == '-')
+        ++opt;
 
     /* only part of word */
-    return OPT_NO_MATCH;
+    if (strncmp(long_opt[_index].name, opt, name_len) != 0 || (opt[name_len] != '\0' && opt[name_len] != '='))
+        return OPT_NO_MATCH;
+
+    return temp;
 }
 
 int main(int argc, char **argv)
@@ -139,6 +478,7 @@ int main(int argc, char **argv)
     /* logic */
     int i;
     bool is_open = false;
+    const char *open_dev = NULL;    /* device of open handle, NULL means default */
     int ret;
 
     /* WD parameters */
@@ -148,6 +488,47 @@ int main(int argc, char **argv)
     int flag;
     int temperature;
     struct watchdog_info info;
+    struct wd_snapshot snap;
+
+    /* output */
+    wd_format_t format = WD_FORMAT_TEXT;
+    struct wd_snapshot out;
+    char out_buf[OUT_BUF_SIZE];
+    ssize_t out_len;
+
+    wd_backend_type_t backend = WD_BACKEND_AUTO;
+
+    /* daemon */
+    bool daemon_mode = false;
+    struct wd_daemon_conf daemon_conf;
+    glob_t devs_glob;
+    int glob_flags = GLOB_NOCHECK;
+
+    /* heartbeat clients */
+    struct wd_hb_client hb_client;
+    struct wd_hb_registry hb_reg;
+    unsigned long long hb_deadline_ms;
+    char *hb_sep;
+
+    /* feed stats query */
+    const char *feed_stats = NULL;
+    const struct wd_stats_file *stats;
+    static char stats_buf[STATS_BUF_SIZE];
+
+    /* batch mode */
+    static struct wd_batch batch;
+    static char batch_buf[BATCH_BUF_SIZE];
+
+    /* fleet scan */
+    const char *scan_roots[WD_SCAN_MAX_ROOTS];
+    size_t nscan_roots = 0;
+    unsigned int scan_workers = 0;
+    struct wd_scan *scan;
+    char *scan_buf;
+
+    /* boot status history */
+    const char *history_query = NULL;
+    struct wd_history history;
 
     /* options */
     struct option long_option[] =
@@ -164,10 +545,53 @@ int main(int argc, char **argv)
         {"get-temp",        no_argument,        0,  OPT_GET_TEMP},
         {"set-options",     required_argument,  0,  OPT_SET_OPTIONS},
         {"get-info",        no_argument,        0,  OPT_GET_INFO},
+        {"get-snapshot",    no_argument,        0,  OPT_GET_SNAPSHOT},
+        {"sysfs",           no_argument,        0,  OPT_SYSFS},
+        {"format",          required_argument,  0,  OPT_FORMAT},
+        {"daemon",          no_argument,        0,  OPT_DAEMON},
+        {"feed-ratio",      required_argument,  0,  OPT_FEED_RATIO},
+        {"adaptive",        no_argument,        0,  OPT_ADAPTIVE},
+        {"slack-band",      required_argument,  0,  OPT_SLACK_BAND},
+        {"stats",           required_argument,  0,  OPT_STATS},
+        {"near-miss",       required_argument,  0,  OPT_NEAR_MISS},
+        {"feed-stats",      required_argument,  0,  OPT_FEED_STATS},
+        {"rt-fifo",         required_argument,  0,  OPT_RT_FIFO},
+        {"rt-deadline",     required_argument,  0,  OPT_RT_DEADLINE},
+        {"mlock",           no_argument,        0,  OPT_MLOCK},
+        {"cpu",             required_argument,  0,  OPT_CPU},
+        {"selftest",        required_argument,  0,  OPT_SELFTEST},
+        {"trace",           required_argument,  0,  OPT_TRACE},
+        {"record",          required_argument,  0,  OPT_RECORD},
+        {"heartbeat",       no_argument,        0,  OPT_HEARTBEAT},
+        {"hb-shm",          required_argument,  0,  OPT_HB_SHM},
+        {"hb-beat",         required_argument,  0,  OPT_HB_BEAT},
+        {"hb-list",         no_argument,        0,  OPT_HB_LIST},
+        {"check",           required_argument,  0,  OPT_CHECK},
+        {"check-workers",   required_argument,  0,  OPT_CHECK_WORKERS},
+        {"psi",             required_argument,  0,  OPT_PSI},
+        {"psi-hold",        required_argument,  0,  OPT_PSI_HOLD},
+        {"soft-timer",      required_argument,  0,  OPT_SOFT_TIMER},
+        {"ctl",             required_argument,  0,  OPT_CTL},
+        {"ctl-get",         required_argument,  0,  OPT_CTL_GET},
+        {"handover",        required_argument,  0,  OPT_HANDOVER},
+        {"batch",           required_argument,  0,  OPT_BATCH},
+        {"scan",            required_argument,  0,  OPT_SCAN},
+        {"scan-workers",    required_argument,  0,  OPT_SCAN_WORKERS},
+        {"history",         required_argument,  0,  OPT_HISTORY},
+        {"history-query",   required_argument,  0,  OPT_HISTORY_QUERY},
+        {"metrics-listen",  required_argument,  0,  OPT_METRICS_LISTEN},
+        {"metrics-file",    required_argument,  0,  OPT_METRICS_FILE},
+        {"metrics-interval", required_argument, 0,  OPT_METRICS_INTERVAL},
+        {"sample",          required_argument,  0,  OPT_SAMPLE},
+        {"sample-period",   required_argument,  0,  OPT_SAMPLE_PERIOD},
+        {"uring",           no_argument,        0,  OPT_URING},
         {"help",            no_argument,        0,  OPT_HELP},
         {NULL,              0,                  0,  0}
     };
 
+    wd_daemon_conf_init(&daemon_conf);
+    (void)memset(&out, 0, sizeof(out));
+
     /* no error msg */
     opterr = 0;
     if (argc < 2)
@@ -183,6 +607,14 @@ int main(int argc, char **argv)
             case OPT_DEVICE:
             {
                 dev = optarg;
+                if (glob(optarg, glob_flags, NULL, &devs_glob))
+                {
+                    (void)fprintf(stderr, "Device [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                glob_flags |= GLOB_APPEND;
                 break;
             }
             case OPT_GET_TIMEOUT:
@@ -192,7 +624,10 @@ int main(int argc, char **argv)
                 if (ret)
                     return 1;
 
-                (void)printf("WD Timeout = %d [s]\n", timeout);
+                out.timeout = timeout;
+                out.valid |= WD_SNAP_TIMEOUT;
+                if (format == WD_FORMAT_TEXT)
+                    (void)printf("WD Timeout = %d [s]\n", timeout);
 
                 break;
             }
@@ -214,7 +649,8 @@ int main(int argc, char **argv)
                     return 1;
                 }
 
-                (void)printf("Timeout set to %u\n", timeout);
+                if (format == WD_FORMAT_TEXT)
+                    (void)printf("Timeout set to %u\n", timeout);
 
                 break;
             }
@@ -228,7 +664,10 @@ int main(int argc, char **argv)
                     return 1;
                 }
 
-                (void)printf("WD PreTimeout = %d [s]\n", timeout);
+                out.pretimeout = timeout;
+                out.valid |= WD_SNAP_PRETIMEOUT;
+                if (format == WD_FORMAT_TEXT)
+                    (void)printf("WD PreTimeout = %d [s]\n", timeout);
 
                 break;
             }
@@ -250,7 +689,8 @@ int main(int argc, char **argv)
                     return 1;
                 }
 
-                (void)printf("PreTimeout set to %u\n", timeout);
+                if (format == WD_FORMAT_TEXT)
+                    (void)printf("PreTimeout set to %u\n", timeout);
 
                 break;
             }
@@ -264,7 +704,8 @@ int main(int argc, char **argv)
                     return 1;
                 }
 
-                (void)printf("Watchdog fed\n");
+                if (format == WD_FORMAT_TEXT)
+                    (void)printf("Watchdog fed\n");
 
                 break;
             }
@@ -278,7 +719,10 @@ int main(int argc, char **argv)
                     return 1;
                 }
 
-                (void)printf("WD Time left to reset = %d [s]\n", timeout);
+                out.timeleft = timeout;
+                out.valid |= WD_SNAP_TIMELEFT;
+                if (format == WD_FORMAT_TEXT)
+                    (void)printf("WD Time left to reset = %d [s]\n", timeout);
 
                 break;
             }
@@ -292,8 +736,13 @@ int main(int argc, char **argv)
                     return 1;
                 }
 
-                (void)printf("WD Boot Status:\n");
-                wd_print_decoded_flag(flag);
+                out.bootstatus = flag;
+                out.valid |= WD_SNAP_BOOTSTATUS;
+                if (format == WD_FORMAT_TEXT)
+                {
+                    (void)printf("WD Boot Status:\n");
+                    wd_print_decoded_flag(flag);
+                }
 
                 break;
             }
@@ -307,8 +756,13 @@ int main(int argc, char **argv)
                     return 1;
                 }
 
-                (void)printf("WD Status:\n");
-                wd_print_decoded_flag(flag);
+                out.status = flag;
+                out.valid |= WD_SNAP_STATUS;
+                if (format == WD_FORMAT_TEXT)
+                {
+                    (void)printf("WD Status:\n");
+                    wd_print_decoded_flag(flag);
+                }
 
                 break;
             }
@@ -322,7 +776,10 @@ int main(int argc, char **argv)
                     return 1;
                 }
 
-                (void)printf("Temperature = %d [F]\n", temperature);
+                out.temp = temperature;
+                out.valid |= WD_SNAP_TEMP;
+                if (format == WD_FORMAT_TEXT)
+                    (void)printf("Temperature = %d [F]\n", temperature);
 
                 break;
             }
@@ -344,7 +801,8 @@ int main(int argc, char **argv)
                     return 1;
                 }
 
-                (void)printf("Option set to %#x\n", flag);
+                if (format == WD_FORMAT_TEXT)
+                    (void)printf("Option set to %#x\n", flag);
 
                 break;
             }
@@ -358,11 +816,428 @@ int main(int argc, char **argv)
                     return 1;
                 }
 
-                wd_print_info(&info);
-                wd_print_decoded_flag(flag);
+                out.info = info;
+                out.valid |= WD_SNAP_INFO;
+                if (format == WD_FORMAT_TEXT)
+                    wd_print_info(&info);
+
+                break;
+            }
+            case OPT_GET_SNAPSHOT:
+            {
+                wd = WD_OPEN(wd, dev);
+                ret = wd_get_snapshot(wd, &snap, WD_SNAP_ALL);
+                if (ret)
+                {
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                out = snap;
+                if (format == WD_FORMAT_TEXT)
+                    wd_print_snapshot(&snap);
+
+                break;
+            }
+            case OPT_SYSFS:
+            {
+                backend = WD_BACKEND_SYSFS;
+                break;
+            }
+            case OPT_FORMAT:
+            {
+                if (wd_format_parse(optarg, &format))
+                {
+                    (void)fprintf(stderr, "Format [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
 
                 break;
             }
+            case OPT_DAEMON:
+            {
+                daemon_mode = true;
+                break;
+            }
+            case OPT_FEED_RATIO:
+            {
+                daemon_conf.sched.feed_pct = (unsigned int)atoi(optarg);
+                if (daemon_conf.sched.feed_pct == 0 || daemon_conf.sched.feed_pct >= 100)
+                {
+                    (void)fprintf(stderr, "Feed ratio [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                break;
+            }
+            case OPT_ADAPTIVE:
+            {
+                daemon_conf.sched.mode = WD_SCHED_ADAPTIVE;
+                break;
+            }
+            case OPT_SLACK_BAND:
+            {
+                if (sscanf(optarg, "%u:%u", &daemon_conf.sched.slack_min_pct, &daemon_conf.sched.slack_max_pct) != 2 ||
+                    daemon_conf.sched.slack_min_pct >= daemon_conf.sched.slack_max_pct ||
+                    daemon_conf.sched.slack_max_pct >= 100)
+                {
+                    (void)fprintf(stderr, "Slack band [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                break;
+            }
+            case OPT_STATS:
+            {
+                daemon_conf.stats_path = optarg;
+                break;
+            }
+            case OPT_NEAR_MISS:
+            {
+                daemon_conf.near_miss_pct = (unsigned int)atoi(optarg);
+                if (daemon_conf.near_miss_pct == 0 || daemon_conf.near_miss_pct >= 100)
+                {
+                    (void)fprintf(stderr, "Near miss [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                break;
+            }
+            case OPT_FEED_STATS:
+            {
+                feed_stats = optarg;
+                break;
+            }
+            case OPT_RT_FIFO:
+            {
+                daemon_conf.rt.sched = WD_RT_SCHED_FIFO;
+                daemon_conf.rt.prio = atoi(optarg);
+                if (daemon_conf.rt.prio < sched_get_priority_min(SCHED_FIFO) ||
+                    daemon_conf.rt.prio > sched_get_priority_max(SCHED_FIFO))
+                {
+                    (void)fprintf(stderr, "RT priority [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                break;
+            }
+            case OPT_RT_DEADLINE:
+            {
+                daemon_conf.rt.sched = WD_RT_SCHED_DEADLINE;
+                if (sscanf(optarg, "%" SCNu64 ":%" SCNu64, &daemon_conf.rt.dl_runtime_us, &daemon_conf.rt.dl_period_us) != 2 ||
+                    daemon_conf.rt.dl_runtime_us == 0 || daemon_conf.rt.dl_runtime_us > daemon_conf.rt.dl_period_us)
+                {
+                    (void)fprintf(stderr, "RT deadline [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                break;
+            }
+            case OPT_MLOCK:
+            {
+                daemon_conf.rt.mlock = true;
+                break;
+            }
+            case OPT_CPU:
+            {
+                daemon_conf.rt.cpu = atoi(optarg);
+                if (daemon_conf.rt.cpu < 0)
+                {
+                    (void)fprintf(stderr, "CPU [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                break;
+            }
+            case OPT_SELFTEST:
+            {
+                if (atoi(optarg) <= 0)
+                {
+                    (void)fprintf(stderr, "Selftest [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                daemon_conf.run_ns = (uint64_t)atoi(optarg) * WD_NSEC_PER_SEC;
+                daemon_conf.selftest = true;
+                break;
+            }
+            case OPT_TRACE:
+            {
+                if (wd_trace_open(optarg, 0))
+                {
+                    (void)fprintf(stderr, "Trace [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                break;
+            }
+            case OPT_RECORD:
+            {
+                if (wd_trace_open(optarg, WD_TRACE_RECORD_RECS))
+                {
+                    (void)fprintf(stderr, "Record [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                break;
+            }
+            case OPT_HEARTBEAT:
+            {
+                daemon_conf.heartbeat = true;
+                break;
+            }
+            case OPT_HB_SHM:
+            {
+                daemon_conf.hb_shm = optarg;
+                break;
+            }
+            case OPT_HB_BEAT:
+            {
+                hb_sep = strrchr(optarg, ':');
+                hb_deadline_ms = hb_sep ? strtoull(hb_sep + 1, NULL, 0) : 0;
+                if (hb_sep == NULL || hb_sep == optarg || hb_deadline_ms == 0)
+                {
+                    (void)fprintf(stderr, "Heartbeat [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                *hb_sep = '\0';
+                if (wd_hb_register(&hb_client, daemon_conf.hb_shm, optarg, hb_deadline_ms * WD_NSEC_PER_MSEC))
+                {
+                    (void)fprintf(stderr, "Cannot heartbeat as %s\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                /* slot stays watched after exit, next --hb-beat finds it by name */
+                wd_hb_beat(&hb_client);
+                wd_hb_detach(&hb_client);
+                break;
+            }
+            case OPT_HB_LIST:
+            {
+                if (wd_hb_registry_attach(&hb_reg, daemon_conf.hb_shm))
+                {
+                    (void)fprintf(stderr, "Cannot read heartbeat registry\n");
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                print_heartbeats(&hb_reg);
+                wd_hb_registry_destroy(&hb_reg, false);
+                break;
+            }
+            case OPT_CHECK:
+            {
+                if (daemon_conf.nchecks == WD_CHECK_MAX ||
+                    wd_check_parse(optarg, &daemon_conf.checks[daemon_conf.nchecks]))
+                {
+                    (void)fprintf(stderr, "Check [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                ++daemon_conf.nchecks;
+                break;
+            }
+            case OPT_CHECK_WORKERS:
+            {
+                daemon_conf.check_workers = (unsigned int)atoi(optarg);
+                if (daemon_conf.check_workers == 0 || daemon_conf.check_workers > WD_CHECK_MAX_WORKERS)
+                {
+                    (void)fprintf(stderr, "Check workers [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                break;
+            }
+            case OPT_PSI:
+            {
+                if (daemon_conf.npsi == WD_PSI_MAX ||
+                    wd_psi_parse(optarg, &daemon_conf.psi[daemon_conf.npsi]))
+                {
+                    (void)fprintf(stderr, "PSI [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                ++daemon_conf.npsi;
+                break;
+            }
+            case OPT_PSI_HOLD:
+            {
+                daemon_conf.psi_hold_ns = strtoull(optarg, NULL, 0) * WD_NSEC_PER_MSEC;
+                break;
+            }
+            case OPT_SOFT_TIMER:
+            {
+                if (daemon_conf.nsoft == WD_DAEMON_MAX_SOFT ||
+                    (daemon_conf.soft_ns[daemon_conf.nsoft] = strtoull(optarg, NULL, 0) * WD_NSEC_PER_MSEC) == 0)
+                {
+                    (void)fprintf(stderr, "Soft timer [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                ++daemon_conf.nsoft;
+                break;
+            }
+            case OPT_CTL:
+            {
+                daemon_conf.ctl_path = optarg;
+                break;
+            }
+            case OPT_HANDOVER:
+            {
+                daemon_conf.handover_path = optarg;
+                break;
+            }
+            case OPT_CTL_GET:
+            {
+                if (ctl_query(daemon_conf.ctl_path, optarg, format, &out))
+                {
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                break;
+            }
+            case OPT_BATCH:
+            {
+                /* whole script is validated before device is touched */
+                if (wd_batch_load(&batch, optarg))
+                {
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                wd = WD_OPEN(wd, dev);
+                if (wd_batch_check(&batch, wd))
+                {
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                ret = wd_batch_run(&batch, wd, &out);
+                if (format == WD_FORMAT_TEXT)
+                {
+                    out_len = wd_batch_format(&batch, batch_buf, sizeof(batch_buf));
+                    if (out_len < 0 || write(STDOUT_FILENO, batch_buf, (size_t)out_len) != out_len)
+                        ret = 1;
+                }
+
+                if (ret)
+                {
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                break;
+            }
+            case OPT_SCAN:
+            {
+                if (nscan_roots == WD_SCAN_MAX_ROOTS)
+                {
+                    (void)fprintf(stderr, "Too many scan roots, max is %d\n", WD_SCAN_MAX_ROOTS);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                scan_roots[nscan_roots++] = optarg;
+                break;
+            }
+            case OPT_SCAN_WORKERS:
+            {
+                scan_workers = (unsigned int)atoi(optarg);
+                if (scan_workers == 0 || scan_workers > WD_SCAN_MAX_WORKERS)
+                {
+                    (void)fprintf(stderr, "Scan workers [%s] - Incorrect argument, max is %d\n", optarg, WD_SCAN_MAX_WORKERS);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                break;
+            }
+            case OPT_HISTORY:
+            {
+                daemon_conf.history_path = optarg;
+                break;
+            }
+            case OPT_HISTORY_QUERY:
+            {
+                history_query = optarg;
+                break;
+            }
+            case OPT_METRICS_LISTEN:
+            {
+                daemon_conf.metrics.listen = optarg;
+                break;
+            }
+            case OPT_METRICS_FILE:
+            {
+                daemon_conf.metrics.path = optarg;
+                break;
+            }
+            case OPT_METRICS_INTERVAL:
+            {
+                daemon_conf.metrics.interval_ns = strtoull(optarg, NULL, 0) * WD_NSEC_PER_MSEC;
+                if (daemon_conf.metrics.interval_ns == 0)
+                {
+                    (void)fprintf(stderr, "Metrics interval [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                break;
+            }
+            case OPT_SAMPLE:
+            {
+                if (daemon_conf.sample.nrules == WD_SAMPLE_MAX_RULES ||
+                    wd_sample_parse(optarg, &daemon_conf.sample.rules[daemon_conf.sample.nrules]))
+                {
+                    (void)fprintf(stderr, "Sample rule [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                ++daemon_conf.sample.nrules;
+                daemon_conf.sample.enabled = true;
+                break;
+            }
+            case OPT_SAMPLE_PERIOD:
+            {
+                if (sscanf(optarg, "%" SCNu64 ":%" SCNu64, &daemon_conf.sample.min_period_ns,
+                           &daemon_conf.sample.max_period_ns) != 2 ||
+                    daemon_conf.sample.min_period_ns == 0 ||
+                    daemon_conf.sample.min_period_ns > daemon_conf.sample.max_period_ns)
+                {
+                    (void)fprintf(stderr, "Sample period [%s] - Incorrect argument\n", optarg);
+                    WD_CLOSE(wd);
+                    return 1;
+                }
+
+                daemon_conf.sample.min_period_ns *= WD_NSEC_PER_MSEC;
+                daemon_conf.sample.max_period_ns *= WD_NSEC_PER_MSEC;
+                daemon_conf.sample.enabled = true;
+                break;
+            }
+            case OPT_URING:
+            {
+                daemon_conf.uring = true;
+                break;
+            }
             case OPT_HELP:
             {
                 usage();
@@ -373,7 +1248,119 @@ int main(int argc, char **argv)
         }
     }
 
+    if (daemon_mode)
+    {
+        if (glob_flags & GLOB_APPEND)
+        {
+            if (devs_glob.gl_pathc > WD_DAEMON_MAX_DEVS)
+            {
+                (void)fprintf(stderr, "Too many devices, max is %d\n", WD_DAEMON_MAX_DEVS);
+                WD_CLOSE(wd);
+                globfree(&devs_glob);
+                return 1;
+            }
+
+            for (daemon_conf.ndevs = 0; daemon_conf.ndevs < devs_glob.gl_pathc; ++daemon_conf.ndevs)
+                daemon_conf.devs[daemon_conf.ndevs] = devs_glob.gl_pathv[daemon_conf.ndevs];
+        }
+
+        /* same device opened by previous options is taken over, magic close would leave a gap without WD */
+        if (is_open && daemon_conf.ndevs <= 1 &&
+            (open_dev == NULL ? daemon_conf.ndevs == 0 :
+                                daemon_conf.ndevs == 1 && strcmp(open_dev, daemon_conf.devs[0]) == 0))
+        {
+            daemon_conf.wd = wd;
+            is_open = false;
+        }
+
+        WD_CLOSE(wd);
+        ret = wd_daemon_run(&daemon_conf);
+
+        if (glob_flags & GLOB_APPEND)
+            globfree(&devs_glob);
+
+        return ret;
+    }
+
+    if (glob_flags & GLOB_APPEND)
+        globfree(&devs_glob);
+
     WD_CLOSE(wd);
 
+    /* bootstatus was read anyway, daemon records the same boot only once */
+    if (daemon_conf.history_path != NULL && (out.valid & WD_SNAP_BOOTSTATUS))
+    {
+        if (wd_history_open(&history, daemon_conf.history_path, 0))
+            return 1;
+
+        ret = wd_history_record(&history, dev,
+                                WD_HISTORY_HAS_BOOTSTATUS | ((out.valid & WD_SNAP_TIMEOUT) ? WD_HISTORY_HAS_TIMEOUT : 0),
+                                out.bootstatus, out.timeout, NULL);
+        wd_history_close(&history);
+        if (ret)
+            return 1;
+    }
+
+    if (history_query != NULL)
+    {
+        if (wd_history_attach(&history, history_query))
+            return 1;
+
+        out_len = wd_history_format(stats_buf, sizeof(stats_buf), &history, format);
+        wd_history_close(&history);
+        if (out_len < 0 || write(STDOUT_FILENO, stats_buf, (size_t)out_len) != out_len)
+            return 1;
+
+        return 0;
+    }
+
+    if (nscan_roots > 0)
+    {
+        scan = wd_scan_create(scan_roots, nscan_roots, backend);
+        if (scan == NULL)
+            return 1;
+
+        ret = wd_scan_run(scan, scan_workers);
+
+        /* table or stream of all devices goes out with one write */
+        scan_buf = malloc(WD_SCAN_OUT_SIZE(scan->ndevs));
+        out_len = scan_buf ? wd_scan_format(scan_buf, WD_SCAN_OUT_SIZE(scan->ndevs), scan, format) : -1;
+        if (out_len < 0 || write(STDOUT_FILENO, scan_buf, (size_t)out_len) != out_len)
+            ret = 1;
+
+        free(scan_buf);
+        wd_scan_destroy(scan);
+
+        return ret;
+    }
+
+    if (feed_stats != NULL)
+    {
+        stats = wd_stats_attach(feed_stats);
+        if (stats == NULL)
+        {
+            (void)fprintf(stderr, "Cannot read feed stats from %s\n", feed_stats);
+            return 1;
+        }
+
+        out_len = wd_stats_format(stats_buf, sizeof(stats_buf), stats, format);
+        wd_stats_destroy(stats);
+        if (out_len < 0 || write(STDOUT_FILENO, stats_buf, (size_t)out_len) != out_len)
+            return 1;
+
+        return 0;
+    }
+
+    /* whole machine readable answer goes out with one write */
+    if (format != WD_FORMAT_TEXT)
+    {
+        if (out.timestamp_ns == 0)
+            out.timestamp_ns = wd_time_now_ns();
+
+        out_len = wd_format_snapshot(out_buf, sizeof(out_buf), &out, format);
+        if (out_len < 0 || write(STDOUT_FILENO, out_buf, (size_t)out_len) != out_len)
+            return 1;
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -1,21 +1,163 @@
 #include <watchdog.h>
+#include <wd_backend.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <fcntl.h>
 #include <errno.h>
 #include <linux/watchdog.h>
-#include <unistd.h>
-#include <sys/ioctl.h>
 #include <string.h>
+#include <pthread.h>
 #include <common.h>
-#include <log.h>
+#include <wd_log.h>
 #include <inttypes.h>
+#include <stdbool.h>
+#include <wd_time.h>
+#include <wd_format.h>
+#include <wd_trace.h>
 
-#define WD_CLOSE_MSG    "V"
-#define WD_DEV          "/dev/watchdog"
-#define WD_ERROR(fmt, err, ...) ERROR(fmt, err, ##__VA_ARGS__)
-#define WD_LOG(fmt, ...)        LOG(fmt, ##__VA_ARGS__)
-#define WD_TRACE(...)           TRACE(__VA_ARGS__)
+#define WD_MAX_HANDLES  256
+
+/* capability cache used by snapshots */
+struct wd_caps
+{
+    bool                    has_info;       /* info fetched by get_info */
+    unsigned int            unsupported;    /* WD_SNAP_* fields driver rejected */
+    struct watchdog_info    info;
+};
+
+struct wd_handle
+{
+    const struct wd_backend_ops *ops;       /* NULL iff handle is free */
+    struct wd_backend_ctx       ctx;
+    struct wd_caps              caps;
+};
+
+static struct wd_handle wd_handles[WD_MAX_HANDLES];
+static pthread_mutex_t wd_handles_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct wd_handle *wd_handle_get(watchdog_t wd);
+static watchdog_t wd_handle_alloc(const struct wd_backend_ops *ops);
+static void wd_handle_free(watchdog_t wd);
+static int wd_backend_ret(unsigned int fn, watchdog_t wd, uint64_t start, const void *arg, int ret);
+static const struct wd_backend_ops *wd_backend_guess(const char *dev);
+static bool wd_errno_unsupported(int err);
+static int wd_snapshot_ret(struct wd_snapshot *snap, unsigned int field, int ret);
+static int wd_close_common(watchdog_t wd, bool magic);
+
+static struct wd_handle *wd_handle_get(watchdog_t wd)
+{
+    if (wd < 0 || wd >= WD_MAX_HANDLES || wd_handles[wd].ops == NULL)
+        return NULL;
+
+    return &wd_handles[wd];
+}
+
+static watchdog_t wd_handle_alloc(const struct wd_backend_ops *ops)
+{
+    watchdog_t wd;
+
+    (void)pthread_mutex_lock(&wd_handles_lock);
+    for (wd = 0; wd < WD_MAX_HANDLES; ++wd)
+        if (wd_handles[wd].ops == NULL)
+        {
+            (void)memset(&wd_handles[wd], 0, sizeof(wd_handles[wd]));
+            wd_handles[wd].ops = ops;
+            wd_handles[wd].ctx.fd = -1;
+            break;
+        }
+    (void)pthread_mutex_unlock(&wd_handles_lock);
+
+    return wd < WD_MAX_HANDLES ? wd : -1;
+}
+
+static void wd_handle_free(watchdog_t wd)
+{
+    (void)pthread_mutex_lock(&wd_handles_lock);
+    wd_handles[wd].ops = NULL;
+    (void)pthread_mutex_unlock(&wd_handles_lock);
+}
+
+/* backend returns -errno, wd_* API keeps ioctl convention: -1 and errno */
+static int wd_backend_ret(unsigned int fn, watchdog_t wd, uint64_t start, const void *arg, int ret)
+{
+    uint32_t val = 0;
+
+    /* value set is recorded always, value got only when backend filled it */
+    if (wd_trace_ring != NULL && arg != NULL &&
+        (ret == 0 || fn == WD_OP_SET_TIMEOUT || fn == WD_OP_SET_PRETIMEOUT || fn == WD_OP_SET_OPTIONS))
+        (void)memcpy(&val, arg, sizeof(val));
+
+    if (ret != 0)
+    {
+        errno = -ret;
+        ret = -1;
+    }
+
+    WD_TRACE_OP(fn, wd, ret, val, start);
+
+    return ret;
+}
+
+static const struct wd_backend_ops *wd_backend_guess(const char *dev)
+{
+    if (dev == NULL)
+        return &wd_backend_chardev;
+
+    if (strncmp(dev, WD_BACKEND_SIM_PREFIX, strlen(WD_BACKEND_SIM_PREFIX)) == 0)
+        return &wd_backend_sim;
+
+    if (strncmp(dev, WD_BACKEND_SYSFS_PREFIX, strlen(WD_BACKEND_SYSFS_PREFIX)) == 0)
+        return &wd_backend_sysfs;
+
+    return &wd_backend_chardev;
+}
+
+/* EINVAL is a rejected value or broken driver, not a missing ioctl, and must reach caller */
+static bool wd_errno_unsupported(int err)
+{
+    return err == ENOTTY || err == EOPNOTSUPP;
+}
+
+static int wd_snapshot_ret(struct wd_snapshot *snap, unsigned int field, int ret)
+{
+    if (ret == 0)
+    {
+        snap->valid |= field;
+        return 0;
+    }
+
+    if (wd_errno_unsupported(-ret))
+    {
+        snap->unsupported |= field;
+        return 0;
+    }
+
+    return 1;
+}
+
+static int wd_close_common(watchdog_t wd, bool magic)
+{
+    struct wd_handle *h;
+    uint64_t start;
+    int ret;
+
+    h = wd_handle_get(wd);
+    if (h == NULL)
+        WD_ERROR("Incorrect WatchDog descriptor\n", 1, "");
+
+    start = WD_TRACE_START();
+    ret = h->ops->close ? h->ops->close(&h->ctx, magic) : 0;
+    wd_handle_free(wd);
+
+    if (ret)
+        errno = -ret;
+
+    WD_TRACE_OP(magic ? WD_TRACE_FN_CLOSE : WD_TRACE_FN_RELEASE, wd, ret ? -1 : 0, 0, start);
+
+    if (ret)
+        WD_ERROR("Cannot close Watchdog\n", 1, "");
+
+    return 0;
+}
 
 void wd_print_info(struct watchdog_info *wd_info)
 {
@@ -32,6 +174,10 @@ void wd_print_info(struct watchdog_info *wd_info)
 
 void wd_print_decoded_flag(int flag)
 {
+    const struct wd_flag_desc *flags;
+    size_t n;
+    size_t i;
+
     WD_TRACE("");
 
     (void)printf("WD FLAGS\n");
@@ -42,89 +188,142 @@ void wd_print_decoded_flag(int flag)
         return;
     }
 
-    if (GET_FLAG(flag, WDIOF_OVERHEAT))
-        (void)printf("\tReset due to CPU overheat\n");
+    flags = wd_format_flag_table(&n);
+    for (i = 0; i < n; ++i)
+        if (GET_FLAG(flag, flags[i].flag))
+            (void)printf("\t%s\n", flags[i].desc);
+}
+
+watchdog_t wd_open(const char *dev)
+{
+    WD_TRACE("");
 
-    if (GET_FLAG(flag, WDIOF_FANFAULT))
-        (void)printf("\tFan failed\n");
+    return wd_open_backend(WD_BACKEND_AUTO, dev);
+}
 
-    if (GET_FLAG(flag, WDIOF_EXTERN1))
-        (void)printf("\tExternal relay 1\n");
+watchdog_t wd_open_backend(wd_backend_type_t type, const char *dev)
+{
+    const struct wd_backend_ops *ops;
+    struct wd_handle *h;
+    watchdog_t wd;
+    uint64_t start;
+    int ret;
 
-    if (GET_FLAG(flag, WDIOF_EXTERN2))
-        (void)printf("\tExternal relay 2\n");
+    WD_TRACE("");
 
-    if (GET_FLAG(flag, WDIOF_POWERUNDER))
-        (void)printf("\tPower bad/power fault\n");
+    switch (type)
+    {
+        case WD_BACKEND_CHARDEV:
+        {
+            ops = &wd_backend_chardev;
+            break;
+        }
+        case WD_BACKEND_SYSFS:
+        {
+            ops = &wd_backend_sysfs;
+            break;
+        }
+        case WD_BACKEND_SIM:
+        {
+            ops = &wd_backend_sim;
+            break;
+        }
+        case WD_BACKEND_AUTO:
+        default:
+            ops = wd_backend_guess(dev);
+    }
 
-    if (GET_FLAG(flag, WDIOF_CARDRESET))
-        (void)printf("\tCard previously reset the CPU\n");
+    wd = wd_handle_alloc(ops);
+    if (wd == -1)
+        WD_ERROR("Too many opened watchdogs\n", -1, "");
 
-    if (GET_FLAG(flag, WDIOF_POWEROVER))
-        (void)printf("\tPower over voltage\n");
+    h = &wd_handles[wd];
+    start = WD_TRACE_START();
+    ret = ops->open(&h->ctx, dev);
+    if (ret)
+    {
+        wd_handle_free(wd);
+        errno = -ret;
+        WD_TRACE_OP(WD_TRACE_FN_OPEN, wd, -1, 0, start);
+        WD_ERROR("Cannot open %s device (%s)\n", -1, dev ? dev : "default", ops->name);
+    }
 
-    if (GET_FLAG(flag, WDIOF_SETTIMEOUT))
-        (void)printf("\tSet timeout (in seconds)\n");
+    WD_TRACE_OP(WD_TRACE_FN_OPEN, wd, 0, 0, start);
 
-    if (GET_FLAG(flag, WDIOF_MAGICCLOSE))
-        (void)printf("\tSupports magic close char\n");
+    return wd;
+}
+
+watchdog_t wd_open_fd(int fd)
+{
+    watchdog_t wd;
+
+    WD_TRACE("");
 
-    if (GET_FLAG(flag, WDIOF_PRETIMEOUT))
-        (void)printf("\tPretimeout (in seconds), get/set\n");
+    if (fd < 0)
+        WD_ERROR("fd < 0\n", -1, "");
 
-    if (GET_FLAG(flag, WDIOF_ALARMONLY))
-        (void)printf("\tWatchdog triggers external alarm not a reboot\n");
+    wd = wd_handle_alloc(&wd_backend_chardev);
+    if (wd == -1)
+        WD_ERROR("Too many opened watchdogs\n", -1, "");
 
-    if (GET_FLAG(flag, WDIOF_KEEPALIVEPING))
-        (void)printf("\tKeep alive ping reply\n");
+    /* chardev backend keeps only descriptor, nothing else to set up */
+    wd_handles[wd].ctx.fd = fd;
+    WD_TRACE_CALL(WD_TRACE_FN_OPEN, wd, 0);
 
+    return wd;
 }
 
-watchdog_t wd_open(const char *dev)
+void *wd_backend_priv(watchdog_t wd, const struct wd_backend_ops *ops)
 {
-    char *wd;
-    int fd;
+    struct wd_handle *h = wd_handle_get(wd);
 
-    WD_TRACE("");
+    if (h == NULL || h->ops != ops)
+        return NULL;
+
+    return h->ctx.priv;
+}
 
-    dev ? (wd = (char *)dev) : (wd = (char *)WD_DEV);
+int wd_get_fd(watchdog_t wd)
+{
+    struct wd_handle *h = wd_handle_get(wd);
 
-    fd = open(wd, O_RDWR);
-    if (fd == -1)
-        WD_ERROR("Cannot open %s device\n", -1, wd);
+    if (h == NULL)
+        return -1;
 
-    return fd;
+    return h->ctx.fd;
 }
 
 int wd_close(watchdog_t wd)
 {
     WD_TRACE("");
 
-    if (wd == -1)
-        WD_ERROR("Incorrect WatchDog descriptor\n", 1, "");
-
-    if (write(wd, WD_CLOSE_MSG, strlen(WD_CLOSE_MSG)) == -1)
-        WD_ERROR("Cannot close Watchdog\n", 1, "");
+    return wd_close_common(wd, true);
+}
 
-    if (close(wd) == -1)
-        WD_ERROR("Cannot close Watchdog\n", 1, "");
+int wd_release(watchdog_t wd)
+{
+    WD_TRACE("");
 
-    return 0;
+    return wd_close_common(wd, false);
 }
 
 int wd_get_timeout(watchdog_t wd, unsigned int *timeout)
 {
+    struct wd_handle *h;
+    uint64_t start;
     int ret;
 
     WD_TRACE("");
 
-    if (wd == -1)
+    h = wd_handle_get(wd);
+    if (h == NULL)
         WD_ERROR("Incorrect WatchDog descriptor\n", 1, "");
 
     if (timeout == NULL)
         WD_ERROR("timeout == NULL\n", 1, "");
 
-    ret = ioctl(wd, WDIOC_GETTIMEOUT, timeout);
+    start = WD_TRACE_START();
+    ret = wd_backend_ret(WD_OP_GET_TIMEOUT, wd, start, timeout, h->ops->get_timeout ? h->ops->get_timeout(&h->ctx, timeout) : -EOPNOTSUPP);
     if (ret)
         WD_ERROR("Cannot get Watchdog timeout\n", ret, "");
 
@@ -133,14 +332,18 @@ int wd_get_timeout(watchdog_t wd, unsigned int *timeout)
 
 int wd_set_timeout(watchdog_t wd, unsigned int timeout)
 {
+    struct wd_handle *h;
+    uint64_t start;
     int ret;
 
     WD_TRACE("");
 
-    if (wd == -1)
+    h = wd_handle_get(wd);
+    if (h == NULL)
         WD_ERROR("Incorrect WatchDog descriptor\n", 1, "");
 
-    ret = ioctl(wd, WDIOC_SETTIMEOUT, &timeout);
+    start = WD_TRACE_START();
+    ret = wd_backend_ret(WD_OP_SET_TIMEOUT, wd, start, &timeout, h->ops->set_timeout ? h->ops->set_timeout(&h->ctx, timeout) : -EOPNOTSUPP);
     if (ret)
         WD_ERROR("Cannot set Watchdog timeout\n", ret, "");
 
@@ -149,14 +352,18 @@ int wd_set_timeout(watchdog_t wd, unsigned int timeout)
 
 int wd_keepalive(watchdog_t wd)
 {
+    struct wd_handle *h;
+    uint64_t start;
     int ret;
 
     WD_TRACE("");
 
-    if (wd == -1)
+    h = wd_handle_get(wd);
+    if (h == NULL)
         WD_ERROR("Incorrect WatchDog descriptor\n", 1, "");
 
-    ret = ioctl(wd, WDIOC_KEEPALIVE, NULL);
+    start = WD_TRACE_START();
+    ret = wd_backend_ret(WD_OP_KEEPALIVE, wd, start, NULL, h->ops->keepalive ? h->ops->keepalive(&h->ctx) : -EOPNOTSUPP);
     if (ret)
         WD_ERROR("Cannot feed watchdog\n", ret, "");
 
@@ -165,17 +372,21 @@ int wd_keepalive(watchdog_t wd)
 
 int wd_get_pretimeout(watchdog_t wd, unsigned int *timeout)
 {
+    struct wd_handle *h;
+    uint64_t start;
     int ret;
 
     WD_TRACE("");
 
-    if (wd == -1)
+    h = wd_handle_get(wd);
+    if (h == NULL)
         WD_ERROR("Incorrect WatchDog descriptor\n", 1, "");
 
     if (timeout == NULL)
         WD_ERROR("Timeout == NULL\n", 1, "");
 
-    ret = ioctl(wd, WDIOC_GETPRETIMEOUT, timeout);
+    start = WD_TRACE_START();
+    ret = wd_backend_ret(WD_OP_GET_PRETIMEOUT, wd, start, timeout, h->ops->get_pretimeout ? h->ops->get_pretimeout(&h->ctx, timeout) : -EOPNOTSUPP);
     if (ret)
         WD_ERROR("Cannot get Watchdog pretimeout\n", ret, "");
 
@@ -184,14 +395,18 @@ int wd_get_pretimeout(watchdog_t wd, unsigned int *timeout)
 
 int wd_set_pretimeout(watchdog_t wd, unsigned int timeout)
 {
+    struct wd_handle *h;
+    uint64_t start;
     int ret;
 
     WD_TRACE("");
 
-    if (wd == -1)
+    h = wd_handle_get(wd);
+    if (h == NULL)
         WD_ERROR("Incorrect WatchDog descriptor\n", 1, "");
 
-    ret = ioctl(wd, WDIOC_SETPRETIMEOUT, &timeout);
+    start = WD_TRACE_START();
+    ret = wd_backend_ret(WD_OP_SET_PRETIMEOUT, wd, start, &timeout, h->ops->set_pretimeout ? h->ops->set_pretimeout(&h->ctx, timeout) : -EOPNOTSUPP);
     if (ret)
         WD_ERROR("Cannot set Watchdog pretimeout\n", ret, "");
 
@@ -200,17 +415,21 @@ int wd_set_pretimeout(watchdog_t wd, unsigned int timeout)
 
 int wd_get_timeleft(watchdog_t wd, unsigned int *time)
 {
+    struct wd_handle *h;
+    uint64_t start;
     int ret;
 
     WD_TRACE("");
 
-    if (wd == -1)
+    h = wd_handle_get(wd);
+    if (h == NULL)
         WD_ERROR("Incorrect WatchDog descriptor\n", 1, "");
 
     if (time == NULL)
         WD_ERROR("time == NULL\n", 1, "");
 
-    ret = ioctl(wd, WDIOC_GETTIMELEFT, time);
+    start = WD_TRACE_START();
+    ret = wd_backend_ret(WD_OP_GET_TIMELEFT, wd, start, time, h->ops->get_timeleft ? h->ops->get_timeleft(&h->ctx, time) : -EOPNOTSUPP);
     if (ret)
         WD_ERROR("Cannot get time left to reset by Watchdog\n", ret, "");
 
@@ -219,17 +438,21 @@ int wd_get_timeleft(watchdog_t wd, unsigned int *time)
 
 int wd_get_bootstatus(watchdog_t wd, int *status)
 {
+    struct wd_handle *h;
+    uint64_t start;
     int ret;
 
     WD_TRACE("");
 
-    if (wd == -1)
+    h = wd_handle_get(wd);
+    if (h == NULL)
         WD_ERROR("Incorrect WatchDog descriptor\n", 1, "");
 
     if (status == NULL)
         WD_ERROR("status == NULL\n", 1, "");
 
-    ret = ioctl(wd, WDIOC_GETBOOTSTATUS, status);
+    start = WD_TRACE_START();
+    ret = wd_backend_ret(WD_OP_GET_BOOTSTATUS, wd, start, status, h->ops->get_bootstatus ? h->ops->get_bootstatus(&h->ctx, status) : -EOPNOTSUPP);
     if (ret)
         WD_ERROR("Cannot get Bootstatus\n", ret, "");
 
@@ -238,17 +461,21 @@ int wd_get_bootstatus(watchdog_t wd, int *status)
 
 int wd_get_status(watchdog_t wd, int *status)
 {
+    struct wd_handle *h;
+    uint64_t start;
     int ret;
 
     WD_TRACE("");
 
-    if (wd == -1)
+    h = wd_handle_get(wd);
+    if (h == NULL)
         WD_ERROR("Incorrect WatchDog descriptor\n", 1, "");
 
     if (status == NULL)
         WD_ERROR("status == NULL\n", 1, "");
 
-    ret = ioctl(wd, WDIOC_GETSTATUS, status);
+    start = WD_TRACE_START();
+    ret = wd_backend_ret(WD_OP_GET_STATUS, wd, start, status, h->ops->get_status ? h->ops->get_status(&h->ctx, status) : -EOPNOTSUPP);
     if (ret)
         WD_ERROR("Cannot get Status\n", ret, "");
 
@@ -257,17 +484,21 @@ int wd_get_status(watchdog_t wd, int *status)
 
 int wd_get_temp(watchdog_t wd, int *temp)
 {
+    struct wd_handle *h;
+    uint64_t start;
     int ret;
 
     WD_TRACE("");
 
-    if (wd == -1)
+    h = wd_handle_get(wd);
+    if (h == NULL)
         WD_ERROR("Incorrect WatchDog descriptor\n", 1, "");
 
     if (temp == NULL)
         WD_ERROR("temp == NULL\n", 1, "");
 
-    ret = ioctl(wd, WDIOC_GETTEMP, temp);
+    start = WD_TRACE_START();
+    ret = wd_backend_ret(WD_OP_GET_TEMP, wd, start, temp, h->ops->get_temp ? h->ops->get_temp(&h->ctx, temp) : -EOPNOTSUPP);
     if (ret)
         WD_ERROR("Cannot get Temperature\n", ret, "");
 
@@ -276,12 +507,15 @@ int wd_get_temp(watchdog_t wd, int *temp)
 
 int wd_set_options(watchdog_t wd, int options)
 {
+    struct wd_handle *h;
     int temp;
+    uint64_t start;
     int ret;
 
     WD_TRACE("");
 
-    if (wd == -1)
+    h = wd_handle_get(wd);
+    if (h == NULL)
         WD_ERROR("Incorrect WatchDog descriptor\n", 1, "");
 
     temp = options;
@@ -292,7 +526,8 @@ int wd_set_options(watchdog_t wd, int options)
     if (temp)
         WD_ERROR("Incorrect option\n", 1, "");
 
-    ret = ioctl(wd, WDIOC_SETOPTIONS, &options);
+    start = WD_TRACE_START();
+    ret = wd_backend_ret(WD_OP_SET_OPTIONS, wd, start, &options, h->ops->set_options ? h->ops->set_options(&h->ctx, options) : -EOPNOTSUPP);
     if (ret)
         WD_ERROR("Cannot set options\n", ret, "");
 
@@ -301,19 +536,153 @@ int wd_set_options(watchdog_t wd, int options)
 
 int wd_get_info(watchdog_t wd, struct watchdog_info *wd_info)
 {
+    struct wd_handle *h;
+    uint64_t start;
     int ret;
 
     WD_TRACE("");
 
-    if (wd == -1)
+    h = wd_handle_get(wd);
+    if (h == NULL)
         WD_ERROR("Incorrect WatchDog descriptor\n", 1, "");
 
     if (wd_info == NULL)
         WD_ERROR("wd_info == NULL\n", 1, "");
 
-    ret = ioctl(wd, WDIOC_GETSUPPORT, wd_info);
+    start = WD_TRACE_START();
+    ret = wd_backend_ret(WD_OP_GET_INFO, wd, start, &wd_info->options, h->ops->get_info ? h->ops->get_info(&h->ctx, wd_info) : -EOPNOTSUPP);
     if (ret)
         WD_ERROR("Cannot get WatchDog info\n", ret, "");
 
     return 0;
-}
\ No newline at end of file
+}
+
+int wd_get_snapshot(watchdog_t wd, struct wd_snapshot *snap, unsigned int fields_mask)
+{
+    const struct wd_backend_ops *ops;
+    struct wd_backend_ctx *ctx;
+    struct wd_caps *caps;
+    struct wd_handle *h;
+    unsigned int todo;
+    uint64_t start;
+    int ret = 0;
+    int err;
+
+    WD_TRACE("");
+
+    h = wd_handle_get(wd);
+    if (h == NULL)
+        WD_ERROR("Incorrect WatchDog descriptor\n", 1, "");
+
+    if (snap == NULL)
+        WD_ERROR("snap == NULL\n", 1, "");
+
+    ops = h->ops;
+    ctx = &h->ctx;
+    caps = &h->caps;
+
+    (void)memset(snap, 0, sizeof(*snap));
+    start = WD_TRACE_START();
+
+    /* capability bits tell which optional calls are worth trying */
+    if (!caps->has_info && !GET_FLAG(caps->unsupported, WD_SNAP_INFO))
+    {
+        err = ops->get_info ? ops->get_info(ctx, &caps->info) : -EOPNOTSUPP;
+        if (err == 0)
+        {
+            caps->has_info = true;
+            if (!GET_FLAG(caps->info.options, WDIOF_PRETIMEOUT))
+                caps->unsupported |= WD_SNAP_PRETIMEOUT;
+        }
+        else if (wd_errno_unsupported(-err))
+            caps->unsupported |= WD_SNAP_INFO;
+        else
+            ret = 1;
+    }
+
+    snap->unsupported = fields_mask & caps->unsupported;
+    todo = fields_mask & ~caps->unsupported;
+
+    if (GET_FLAG(todo, WD_SNAP_INFO) && caps->has_info)
+    {
+        snap->info = caps->info;
+        snap->valid |= WD_SNAP_INFO;
+    }
+
+    snap->timestamp_ns = wd_time_now_ns();
+
+    if (GET_FLAG(todo, WD_SNAP_TIMELEFT))
+        ret |= wd_snapshot_ret(snap, WD_SNAP_TIMELEFT,
+                               ops->get_timeleft ? ops->get_timeleft(ctx, &snap->timeleft) : -EOPNOTSUPP);
+
+    if (GET_FLAG(todo, WD_SNAP_TIMEOUT))
+        ret |= wd_snapshot_ret(snap, WD_SNAP_TIMEOUT,
+                               ops->get_timeout ? ops->get_timeout(ctx, &snap->timeout) : -EOPNOTSUPP);
+
+    if (GET_FLAG(todo, WD_SNAP_PRETIMEOUT))
+        ret |= wd_snapshot_ret(snap, WD_SNAP_PRETIMEOUT,
+                               ops->get_pretimeout ? ops->get_pretimeout(ctx, &snap->pretimeout) : -EOPNOTSUPP);
+
+    if (GET_FLAG(todo, WD_SNAP_BOOTSTATUS))
+        ret |= wd_snapshot_ret(snap, WD_SNAP_BOOTSTATUS,
+                               ops->get_bootstatus ? ops->get_bootstatus(ctx, &snap->bootstatus) : -EOPNOTSUPP);
+
+    if (GET_FLAG(todo, WD_SNAP_STATUS))
+        ret |= wd_snapshot_ret(snap, WD_SNAP_STATUS,
+                               ops->get_status ? ops->get_status(ctx, &snap->status) : -EOPNOTSUPP);
+
+    if (GET_FLAG(todo, WD_SNAP_TEMP))
+        ret |= wd_snapshot_ret(snap, WD_SNAP_TEMP,
+                               ops->get_temp ? ops->get_temp(ctx, &snap->temp) : -EOPNOTSUPP);
+
+    /* remember what driver rejected, next snapshot will not ask again */
+    caps->unsupported |= snap->unsupported;
+
+    WD_TRACE_OP(WD_TRACE_FN_SNAPSHOT, wd, ret, fields_mask, start);
+
+    if (ret)
+        WD_ERROR("Cannot get WatchDog snapshot\n", 1, "");
+
+    return 0;
+}
+
+void wd_print_snapshot(const struct wd_snapshot *snap)
+{
+    WD_TRACE("");
+
+    if (snap == NULL)
+        return;
+
+    (void)printf("WD SNAPSHOT at %" PRIu64 ".%09" PRIu64 "\n",
+                 snap->timestamp_ns / WD_NSEC_PER_SEC, snap->timestamp_ns % WD_NSEC_PER_SEC);
+
+    if (GET_FLAG(snap->valid, WD_SNAP_TIMEOUT))
+        (void)printf("WD Timeout = %u [s]\n", snap->timeout);
+
+    if (GET_FLAG(snap->valid, WD_SNAP_PRETIMEOUT))
+        (void)printf("WD PreTimeout = %u [s]\n", snap->pretimeout);
+
+    if (GET_FLAG(snap->valid, WD_SNAP_TIMELEFT))
+        (void)printf("WD Time left to reset = %u [s]\n", snap->timeleft);
+
+    if (GET_FLAG(snap->valid, WD_SNAP_TEMP))
+        (void)printf("Temperature = %d [F]\n", snap->temp);
+
+    if (GET_FLAG(snap->valid, WD_SNAP_BOOTSTATUS))
+    {
+        (void)printf("WD Boot Status:\n");
+        wd_print_decoded_flag(snap->bootstatus);
+    }
+
+    if (GET_FLAG(snap->valid, WD_SNAP_STATUS))
+    {
+        (void)printf("WD Status:\n");
+        wd_print_decoded_flag(snap->status);
+    }
+
+    if (GET_FLAG(snap->valid, WD_SNAP_INFO))
+        wd_print_info((struct watchdog_info *)&snap->info);
+
+    if (snap->unsupported)
+        (void)printf("WD Unsupported fields = %#x\n", snap->unsupported);
+}
@@ -0,0 +1,417 @@
+#include <wd_batch.h>
+#include <wd_ctl.h>
+#include <wd_log.h>
+#include <linux/watchdog.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#define WD_BATCH_OPTIONS (WDIOS_DISABLECARD | WDIOS_ENABLECARD | WDIOS_TEMPPANIC)
+
+static int wd_batch_line(struct wd_batch *batch, char *line, unsigned int nr);
+static int wd_batch_exec(struct wd_batch_op *bop, watchdog_t wd, struct wd_snapshot *out, struct wd_snapshot *snap);
+
+static int wd_batch_line(struct wd_batch *batch, char *line, unsigned int nr)
+{
+    struct wd_batch_op *bop;
+    unsigned int op;
+    unsigned long val;
+    char *name;
+    char *arg;
+    char *end;
+    bool setter;
+
+    end = strchr(line, '#');
+    if (end != NULL)
+        *end = '\0';
+
+    name = strtok_r(line, " \t\r=", &end);
+    if (name == NULL)
+        return 0;
+
+    arg = strtok_r(NULL, " \t\r", &end);
+    if (strtok_r(NULL, " \t\r", &end) != NULL)
+        WD_ERROR("Batch line %u: trailing garbage\n", 1, nr);
+
+    /* daemon only ops have no meaning for one descriptor */
+    if (wd_ctl_op_parse(name, &op) || (op >= WD_OP_MAX && op != WD_CTL_SNAPSHOT))
+        WD_ERROR("Batch line %u: unknown op %s\n", 1, nr, name);
+
+    /* snapshot reads everything, second one would only hide the first */
+    if (op == WD_CTL_SNAPSHOT && batch->snaps++)
+        WD_ERROR("Batch line %u: only one snapshot per batch\n", 1, nr);
+
+    if (batch->nops == WD_BATCH_MAX_OPS)
+        WD_ERROR("Batch line %u: too many ops, max is %d\n", 1, nr, WD_BATCH_MAX_OPS);
+
+    bop = &batch->ops[batch->nops];
+    (void)memset(bop, 0, sizeof(*bop));
+    bop->op = (uint16_t)op;
+    bop->line = (uint16_t)(nr > UINT16_MAX ? UINT16_MAX : nr);
+
+    setter = op == WD_OP_SET_TIMEOUT || op == WD_OP_SET_PRETIMEOUT || op == WD_OP_SET_OPTIONS;
+    if (setter != (arg != NULL))
+        WD_ERROR("Batch line %u: %s %s\n", 1, nr, name, setter ? "needs argument" : "takes no argument");
+
+    if (setter)
+    {
+        errno = 0;
+        val = strtoul(arg, &end, 0);
+        if (errno || *end != '\0' || *arg == '-' || val > UINT32_MAX)
+            WD_ERROR("Batch line %u: incorrect argument %s\n", 1, nr, arg);
+
+        bop->arg = (uint32_t)val;
+    }
+
+    switch (op)
+    {
+        case WD_OP_SET_TIMEOUT:
+        {
+            if (bop->arg == 0)
+                WD_ERROR("Batch line %u: timeout must be positive\n", 1, nr);
+
+            batch->need |= WDIOF_SETTIMEOUT;
+            break;
+        }
+        case WD_OP_SET_PRETIMEOUT:
+        {
+            batch->need |= WDIOF_PRETIMEOUT;
+            break;
+        }
+        case WD_OP_SET_OPTIONS:
+        {
+            if ((bop->arg & ~(uint32_t)WD_BATCH_OPTIONS) ||
+                (bop->arg & (WDIOS_DISABLECARD | WDIOS_ENABLECARD)) == (WDIOS_DISABLECARD | WDIOS_ENABLECARD))
+                WD_ERROR("Batch line %u: incorrect options 0x%x\n", 1, nr, bop->arg);
+
+            break;
+        }
+        default:
+            break;
+    }
+
+    ++batch->nops;
+
+    return 0;
+}
+
+static int wd_batch_exec(struct wd_batch_op *bop, watchdog_t wd, struct wd_snapshot *out, struct wd_snapshot *snap)
+{
+    unsigned int uval = 0;
+    int ival = 0;
+    int ret;
+
+    errno = 0;
+    switch (bop->op)
+    {
+        case WD_OP_KEEPALIVE:
+        {
+            ret = wd_keepalive(wd);
+            break;
+        }
+        case WD_OP_GET_TIMEOUT:
+        {
+            ret = wd_get_timeout(wd, &uval);
+            out->timeout = uval;
+            out->valid |= ret ? 0 : WD_SNAP_TIMEOUT;
+            bop->val = uval;
+            break;
+        }
+        case WD_OP_SET_TIMEOUT:
+        {
+            ret = wd_set_timeout(wd, bop->arg);
+            break;
+        }
+        case WD_OP_GET_PRETIMEOUT:
+        {
+            ret = wd_get_pretimeout(wd, &uval);
+            out->pretimeout = uval;
+            out->valid |= ret ? 0 : WD_SNAP_PRETIMEOUT;
+            bop->val = uval;
+            break;
+        }
+        case WD_OP_SET_PRETIMEOUT:
+        {
+            ret = wd_set_pretimeout(wd, bop->arg);
+            break;
+        }
+        case WD_OP_GET_TIMELEFT:
+        {
+            ret = wd_get_timeleft(wd, &uval);
+            out->timeleft = uval;
+            out->valid |= ret ? 0 : WD_SNAP_TIMELEFT;
+            bop->val = uval;
+            break;
+        }
+        case WD_OP_GET_BOOTSTATUS:
+        {
+            ret = wd_get_bootstatus(wd, &ival);
+            out->bootstatus = ival;
+            out->valid |= ret ? 0 : WD_SNAP_BOOTSTATUS;
+            bop->val = ival;
+            break;
+        }
+        case WD_OP_GET_STATUS:
+        {
+            ret = wd_get_status(wd, &ival);
+            out->status = ival;
+            out->valid |= ret ? 0 : WD_SNAP_STATUS;
+            bop->val = ival;
+            break;
+        }
+        case WD_OP_GET_TEMP:
+        {
+            ret = wd_get_temp(wd, &ival);
+            out->temp = ival;
+            out->valid |= ret ? 0 : WD_SNAP_TEMP;
+            bop->val = ival;
+            break;
+        }
+        case WD_OP_SET_OPTIONS:
+        {
+            ret = wd_set_options(wd, (int)bop->arg);
+            break;
+        }
+        case WD_OP_GET_INFO:
+        {
+            ret = wd_get_info(wd, &out->info);
+            out->valid |= ret ? 0 : WD_SNAP_INFO;
+            bop->val = ret ? 0 : out->info.options;
+            break;
+        }
+        case WD_CTL_SNAPSHOT:
+        {
+            ret = wd_get_snapshot(wd, snap, WD_SNAP_ALL);
+            if (snap->valid)
+            {
+                ret = 0;
+                *out = *snap;
+            }
+
+            break;
+        }
+        default:
+        {
+            errno = EOPNOTSUPP;
+            ret = 1;
+            break;
+        }
+    }
+
+    if (ret)
+        bop->err = errno ? errno : EIO;
+
+    return ret;
+}
+
+int wd_batch_parse(struct wd_batch *batch, const char *script, size_t len)
+{
+    char line[WD_BATCH_LINE_MAX];
+    const char *end;
+    size_t line_len;
+    unsigned int nr = 0;
+    uint32_t timeout = 0;
+    size_t i;
+
+    WD_TRACE("");
+
+    if (batch == NULL || script == NULL)
+        WD_ERROR("batch == NULL || script == NULL\n", 1, "");
+
+    batch->nops = 0;
+    batch->done = 0;
+    batch->need = 0;
+    batch->snaps = 0;
+    (void)memset(&batch->snap, 0, sizeof(batch->snap));
+
+    while (len > 0)
+    {
+        ++nr;
+        end = memchr(script, '\n', len);
+        line_len = end ? (size_t)(end - script) : len;
+        if (line_len >= sizeof(line))
+            WD_ERROR("Batch line %u: too long, max is %d\n", 1, nr, WD_BATCH_LINE_MAX - 1);
+
+        (void)memcpy(line, script, line_len);
+        line[line_len] = '\0';
+        if (memchr(line, '\0', line_len) != NULL)
+            WD_ERROR("Batch line %u: binary data\n", 1, nr);
+
+        if (wd_batch_line(batch, line, nr))
+            return 1;
+
+        line_len += end ? 1 : 0;
+        script += line_len;
+        len -= line_len;
+    }
+
+    if (batch->nops == 0)
+        WD_ERROR("Batch is empty\n", 1, "");
+
+    /* drivers reject pretimeout not below timeout, catch it before first write */
+    for (i = 0; i < batch->nops; ++i)
+        if (batch->ops[i].op == WD_OP_SET_TIMEOUT)
+            timeout = batch->ops[i].arg;
+        else if (batch->ops[i].op == WD_OP_SET_PRETIMEOUT && timeout != 0 && batch->ops[i].arg >= timeout)
+            WD_ERROR("Batch line %u: pretimeout %u is not below timeout %u\n", 1,
+                     batch->ops[i].line, batch->ops[i].arg, timeout);
+
+    return 0;
+}
+
+int wd_batch_load(struct wd_batch *batch, const char *path)
+{
+    static char script[WD_BATCH_MAX_SCRIPT + 1];
+    size_t len = 0;
+    ssize_t ret;
+    int fd;
+
+    WD_TRACE("");
+
+    if (path == NULL)
+        WD_ERROR("path == NULL\n", 1, "");
+
+    fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        WD_ERROR("Cannot open batch %s\n", 1, path);
+
+    /* one byte over limit tells that script was truncated */
+    do
+    {
+        ret = read(fd, script + len, sizeof(script) - len);
+        if (ret > 0)
+            len += (size_t)ret;
+    } while ((ret > 0 && len < sizeof(script)) || (ret == -1 && errno == EINTR));
+
+    if (fd != STDIN_FILENO)
+        (void)close(fd);
+
+    if (ret == -1)
+        WD_ERROR("Cannot read batch %s\n", 1, path);
+
+    if (len > WD_BATCH_MAX_SCRIPT)
+        WD_ERROR("Batch %s is too big, max is %d bytes\n", 1, path, WD_BATCH_MAX_SCRIPT);
+
+    return wd_batch_parse(batch, script, len);
+}
+
+int wd_batch_check(const struct wd_batch *batch, watchdog_t wd)
+{
+    struct watchdog_info info;
+
+    WD_TRACE("");
+
+    if (batch == NULL)
+        WD_ERROR("batch == NULL\n", 1, "");
+
+    if (batch->need == 0)
+        return 0;
+
+    /* backend without info cannot tell, driver itself will refuse */
+    if (wd_get_info(wd, &info))
+        return 0;
+
+    if ((batch->need & WDIOF_SETTIMEOUT) && !(info.options & WDIOF_SETTIMEOUT))
+        WD_ERROR("%.*s cannot set timeout, batch not started\n", 1, (int)sizeof(info.identity), (const char *)info.identity);
+
+    if ((batch->need & WDIOF_PRETIMEOUT) && !(info.options & WDIOF_PRETIMEOUT))
+        WD_ERROR("%.*s has no pretimeout, batch not started\n", 1, (int)sizeof(info.identity), (const char *)info.identity);
+
+    return 0;
+}
+
+int wd_batch_run(struct wd_batch *batch, watchdog_t wd, struct wd_snapshot *out)
+{
+    struct wd_batch_op *bop;
+
+    WD_TRACE("");
+
+    if (batch == NULL || out == NULL)
+        WD_ERROR("batch == NULL || out == NULL\n", 1, "");
+
+    for (batch->done = 0; batch->done < batch->nops; )
+    {
+        bop = &batch->ops[batch->done++];
+        if (wd_batch_exec(bop, wd, out, &batch->snap))
+            WD_ERROR("Batch line %u: %s failed, %zu ops not executed\n", 1,
+                     bop->line, wd_ctl_op_name(bop->op), batch->nops - batch->done);
+    }
+
+    return 0;
+}
+
+ssize_t wd_batch_format(const struct wd_batch *batch, char *buf, size_t size)
+{
+    const struct wd_batch_op *bop;
+    struct wd_fbuf fb;
+    ssize_t len;
+    size_t i;
+
+    WD_TRACE("");
+
+    if (batch == NULL || buf == NULL)
+        WD_ERROR("batch == NULL || buf == NULL\n", -1, "");
+
+    wd_fbuf_init(&fb, buf, size);
+    for (i = 0; i < batch->done; ++i)
+    {
+        bop = &batch->ops[i];
+        wd_fbuf_str(&fb, wd_ctl_op_name(bop->op));
+        wd_fbuf_str(&fb, bop->op == WD_CTL_SNAPSHOT && bop->err == 0 ? ":\n" : ": ");
+
+        if (bop->err)
+        {
+            wd_fbuf_str(&fb, strerror(bop->err));
+            wd_fbuf_str(&fb, "\n");
+            continue;
+        }
+
+        switch (bop->op)
+        {
+            case WD_OP_KEEPALIVE:
+            case WD_OP_SET_TIMEOUT:
+            case WD_OP_SET_PRETIMEOUT:
+            case WD_OP_SET_OPTIONS:
+            {
+                wd_fbuf_str(&fb, "ok\n");
+                break;
+            }
+            case WD_OP_GET_STATUS:
+            case WD_OP_GET_BOOTSTATUS:
+            case WD_OP_GET_INFO:
+            {
+                wd_fbuf_hex(&fb, (uint64_t)bop->val);
+                wd_fbuf_str(&fb, "\n");
+                break;
+            }
+            case WD_CTL_SNAPSHOT:
+            {
+                /* snapshot lines as key=value, text has no formatter of its own */
+                if (fb.overflow)
+                    break;
+
+                len = wd_format_snapshot(fb.buf + fb.len, fb.size - fb.len, &batch->snap, WD_FORMAT_KV);
+                if (len < 0)
+                    fb.overflow = true;
+                else
+                    fb.len += (size_t)len;
+
+                break;
+            }
+            default:
+            {
+                wd_fbuf_i64(&fb, bop->val);
+                wd_fbuf_str(&fb, "\n");
+                break;
+            }
+        }
+    }
+
+    if (fb.overflow)
+        WD_ERROR("Batch output does not fit in %zu bytes\n", -1, size);
+
+    return (ssize_t)fb.len;
+}
@@ -0,0 +1,130 @@
+#include <wd_backend.h>
+#include <wd_log.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/ioctl.h>
+
+#define WD_CLOSE_MSG    "V"
+#define WD_DEV          "/dev/watchdog"
+
+static int wd_chardev_ioctl(struct wd_backend_ctx *ctx, unsigned long req, void *arg);
+static int wd_chardev_open(struct wd_backend_ctx *ctx, const char *dev);
+static int wd_chardev_close(struct wd_backend_ctx *ctx, bool magic);
+static int wd_chardev_keepalive(struct wd_backend_ctx *ctx);
+static int wd_chardev_get_timeout(struct wd_backend_ctx *ctx, unsigned int *timeout);
+static int wd_chardev_set_timeout(struct wd_backend_ctx *ctx, unsigned int timeout);
+static int wd_chardev_get_pretimeout(struct wd_backend_ctx *ctx, unsigned int *timeout);
+static int wd_chardev_set_pretimeout(struct wd_backend_ctx *ctx, unsigned int timeout);
+static int wd_chardev_get_timeleft(struct wd_backend_ctx *ctx, unsigned int *time);
+static int wd_chardev_get_bootstatus(struct wd_backend_ctx *ctx, int *status);
+static int wd_chardev_get_status(struct wd_backend_ctx *ctx, int *status);
+static int wd_chardev_get_temp(struct wd_backend_ctx *ctx, int *temp);
+static int wd_chardev_set_options(struct wd_backend_ctx *ctx, int options);
+static int wd_chardev_get_info(struct wd_backend_ctx *ctx, struct watchdog_info *wd_info);
+
+const struct wd_backend_ops wd_backend_chardev =
+{
+    .name           = "chardev",
+    .open           = wd_chardev_open,
+    .close          = wd_chardev_close,
+    .keepalive      = wd_chardev_keepalive,
+    .get_timeout    = wd_chardev_get_timeout,
+    .set_timeout    = wd_chardev_set_timeout,
+    .get_pretimeout = wd_chardev_get_pretimeout,
+    .set_pretimeout = wd_chardev_set_pretimeout,
+    .get_timeleft   = wd_chardev_get_timeleft,
+    .get_bootstatus = wd_chardev_get_bootstatus,
+    .get_status     = wd_chardev_get_status,
+    .get_temp       = wd_chardev_get_temp,
+    .set_options    = wd_chardev_set_options,
+    .get_info       = wd_chardev_get_info
+};
+
+static int wd_chardev_ioctl(struct wd_backend_ctx *ctx, unsigned long req, void *arg)
+{
+    if (ioctl(ctx->fd, req, arg) == -1)
+        return -errno;
+
+    return 0;
+}
+
+static int wd_chardev_open(struct wd_backend_ctx *ctx, const char *dev)
+{
+    ctx->fd = open(dev ? dev : WD_DEV, O_RDWR | O_CLOEXEC);
+    if (ctx->fd == -1)
+        return -errno;
+
+    return 0;
+}
+
+static int wd_chardev_close(struct wd_backend_ctx *ctx, bool magic)
+{
+    int ret = 0;
+
+    if (magic && write(ctx->fd, WD_CLOSE_MSG, strlen(WD_CLOSE_MSG)) == -1)
+        ret = -errno;
+
+    if (close(ctx->fd) == -1 && ret == 0)
+        ret = -errno;
+
+    ctx->fd = -1;
+
+    return ret;
+}
+
+static int wd_chardev_keepalive(struct wd_backend_ctx *ctx)
+{
+    return wd_chardev_ioctl(ctx, WDIOC_KEEPALIVE, NULL);
+}
+
+static int wd_chardev_get_timeout(struct wd_backend_ctx *ctx, unsigned int *timeout)
+{
+    return wd_chardev_ioctl(ctx, WDIOC_GETTIMEOUT, timeout);
+}
+
+static int wd_chardev_set_timeout(struct wd_backend_ctx *ctx, unsigned int timeout)
+{
+    return wd_chardev_ioctl(ctx, WDIOC_SETTIMEOUT, &timeout);
+}
+
+static int wd_chardev_get_pretimeout(struct wd_backend_ctx *ctx, unsigned int *timeout)
+{
+    return wd_chardev_ioctl(ctx, WDIOC_GETPRETIMEOUT, timeout);
+}
+
+static int wd_chardev_set_pretimeout(struct wd_backend_ctx *ctx, unsigned int timeout)
+{
+    return wd_chardev_ioctl(ctx, WDIOC_SETPRETIMEOUT, &timeout);
+}
+
+static int wd_chardev_get_timeleft(struct wd_backend_ctx *ctx, unsigned int *time)
+{
+    return wd_chardev_ioctl(ctx, WDIOC_GETTIMELEFT, time);
+}
+
+static int wd_chardev_get_bootstatus(struct wd_backend_ctx *ctx, int *status)
+{
+    return wd_chardev_ioctl(ctx, WDIOC_GETBOOTSTATUS, status);
+}
+
+static int wd_chardev_get_status(struct wd_backend_ctx *ctx, int *status)
+{
+    return wd_chardev_ioctl(ctx, WDIOC_GETSTATUS, status);
+}
+
+static int wd_chardev_get_temp(struct wd_backend_ctx *ctx, int *temp)
+{
+    return wd_chardev_ioctl(ctx, WDIOC_GETTEMP, temp);
+}
+
+static int wd_chardev_set_options(struct wd_backend_ctx *ctx, int options)
+{
+    return wd_chardev_ioctl(ctx, WDIOC_SETOPTIONS, &options);
+}
+
+static int wd_chardev_get_info(struct wd_backend_ctx *ctx, struct watchdog_info *wd_info)
+{
+    return wd_chardev_ioctl(ctx, WDIOC_GETSUPPORT, wd_info);
+}
@@ -0,0 +1,476 @@
+#include <wd_check.h>
+#include <wd_time.h>
+#include <wd_log.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/statvfs.h>
+#include <sys/wait.h>
+
+#define WD_CHECK_ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define WD_CHECK_EXEC_POLL_NS   (1 * WD_NSEC_PER_MSEC)
+
+extern char **environ;
+
+struct wd_checks
+{
+    struct wd_check checks[WD_CHECK_MAX];
+    size_t          n;
+    pthread_t       workers[WD_CHECK_MAX_WORKERS];
+    unsigned int    nworkers;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    bool            stop;
+};
+
+static const char *const wd_check_types[] =
+{
+    [WD_CHECK_DISK] = "disk",
+    [WD_CHECK_ROFS] = "rofs",
+    [WD_CHECK_MEM]  = "mem",
+    [WD_CHECK_PID]  = "pid",
+    [WD_CHECK_EXEC] = "exec"
+};
+
+static const char *const wd_check_results[] =
+{
+    [WD_CHECK_PENDING]  = "pending",
+    [WD_CHECK_OK]       = "ok",
+    [WD_CHECK_FAIL]     = "fail",
+    [WD_CHECK_TIMEOUT]  = "timeout"
+};
+
+static int wd_check_opt(char *spec, const char *name, uint64_t *val);
+static bool wd_check_disk(const char *dir);
+static bool wd_check_rofs(const char *path);
+static bool wd_check_mem(const char *arg);
+static bool wd_check_pid(const char *pidfile);
+static bool wd_check_exec(const char *cmd, uint64_t deadline_ns);
+static bool wd_check_run(const struct wd_check_conf *conf);
+static struct wd_check *wd_checks_next(struct wd_checks *checks, uint64_t now, uint64_t *wake);
+static void *wd_checks_worker(void *arg);
+
+/* cuts ",name=val" out of spec */
+static int wd_check_opt(char *spec, const char *name, uint64_t *val)
+{
+    char *opt = strstr(spec, name);
+    char *end;
+
+    if (opt == NULL)
+        return 0;
+
+    *val = strtoull(opt + strlen(name), &end, 0) * WD_NSEC_PER_MSEC;
+    if (end == opt + strlen(name) || (*end != '\0' && *end != ','))
+        return 1;
+
+    (void)memmove(opt, end, strlen(end) + 1);
+
+    return 0;
+}
+
+static bool wd_check_disk(const char *dir)
+{
+    char path[512];
+    const char byte = 0;
+    bool ok;
+    int fd;
+
+    (void)snprintf(path, sizeof(path), "%s/.wd_check.%ld", dir, (long)getpid());
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1)
+        return false;
+
+    ok = write(fd, &byte, sizeof(byte)) == (ssize_t)sizeof(byte) && fsync(fd) == 0;
+    ok &= close(fd) == 0;
+    ok &= unlink(path) == 0;
+
+    return ok;
+}
+
+static bool wd_check_rofs(const char *path)
+{
+    struct statvfs st;
+
+    if (statvfs(path, &st) == -1)
+        return false;
+
+    return !(st.f_flag & ST_RDONLY);
+}
+
+static bool wd_check_mem(const char *arg)
+{
+    char buf[4096];
+    const char *line;
+    unsigned long long avail;
+    ssize_t len;
+    int fd;
+
+    fd = open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+
+    len = read(fd, buf, sizeof(buf) - 1);
+    (void)close(fd);
+    if (len <= 0)
+        return false;
+
+    buf[len] = '\0';
+    line = strstr(buf, "MemAvailable:");
+    if (line == NULL)
+        return false;
+
+    avail = strtoull(line + strlen("MemAvailable:"), NULL, 10);
+
+    return avail >= strtoull(arg, NULL, 0);
+}
+
+static bool wd_check_pid(const char *pidfile)
+{
+    char buf[32];
+    ssize_t len;
+    long pid;
+    int fd;
+
+    fd = open(pidfile, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+
+    len = read(fd, buf, sizeof(buf) - 1);
+    (void)close(fd);
+    if (len <= 0)
+        return false;
+
+    buf[len] = '\0';
+    pid = strtol(buf, NULL, 10);
+    if (pid <= 0)
+        return false;
+
+    /* EPERM: alive, owned by somebody else */
+    return kill((pid_t)pid, 0) == 0 || errno == EPERM;
+}
+
+static bool wd_check_exec(const char *cmd, uint64_t deadline_ns)
+{
+    posix_spawnattr_t attr;
+    char *const argv[] = {(char *)"sh", (char *)"-c", (char *)cmd, NULL};
+    const uint64_t end = wd_time_now_ns() + deadline_ns;
+    struct timespec ts;
+    sigset_t none;
+    pid_t pid;
+    pid_t ret;
+    int status;
+    int err;
+
+    if (posix_spawnattr_init(&attr) != 0)
+        return false;
+
+    /* own process group, whole script tree is killed on deadline; workers inherit mask blocked for signalfd */
+    (void)sigemptyset(&none);
+    (void)posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+    (void)posix_spawnattr_setpgroup(&attr, 0);
+    (void)posix_spawnattr_setsigmask(&attr, &none);
+    err = posix_spawn(&pid, "/bin/sh", NULL, &attr, argv, environ);
+    (void)posix_spawnattr_destroy(&attr);
+    if (err != 0)
+        return false;
+
+    wd_time_to_timespec(WD_CHECK_EXEC_POLL_NS, &ts);
+    while ((ret = waitpid(pid, &status, WNOHANG)) == 0 && wd_time_now_ns() < end)
+        (void)nanosleep(&ts, NULL);
+
+    if (ret == 0)
+    {
+        (void)kill(-pid, SIGKILL);
+        (void)waitpid(pid, &status, 0);
+        return false;
+    }
+
+    return ret == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static bool wd_check_run(const struct wd_check_conf *conf)
+{
+    switch (conf->type)
+    {
+        case WD_CHECK_DISK:
+            return wd_check_disk(conf->arg);
+        case WD_CHECK_ROFS:
+            return wd_check_rofs(conf->arg);
+        case WD_CHECK_MEM:
+            return wd_check_mem(conf->arg);
+        case WD_CHECK_PID:
+            return wd_check_pid(conf->arg);
+        case WD_CHECK_EXEC:
+            return wd_check_exec(conf->arg, conf->deadline_ns);
+        default:
+            return false;
+    }
+}
+
+/* called with lock held, wake is set to earliest due time when nothing is due */
+static struct wd_check *wd_checks_next(struct wd_checks *checks, uint64_t now, uint64_t *wake)
+{
+    struct wd_check *check;
+    uint64_t due;
+    size_t i;
+
+    *wake = UINT64_MAX;
+    for (i = 0; i < checks->n; ++i)
+    {
+        check = &checks->checks[i];
+        if (check->running)
+            continue;
+
+        due = check->runs ? check->finished_ns + check->conf.ttl_ns : 0;
+        if (due <= now)
+            return check;
+
+        if (due < *wake)
+            *wake = due;
+    }
+
+    return NULL;
+}
+
+static void *wd_checks_worker(void *arg)
+{
+    struct wd_checks *checks = (struct wd_checks *)arg;
+    struct wd_check *check;
+    struct timespec ts;
+    uint64_t wake;
+    uint64_t start;
+    uint64_t end;
+    uint32_t result;
+
+    (void)pthread_mutex_lock(&checks->lock);
+    while (!checks->stop)
+    {
+        check = wd_checks_next(checks, wd_time_now_ns(), &wake);
+        if (check == NULL)
+        {
+            if (wake == UINT64_MAX)
+                (void)pthread_cond_wait(&checks->cond, &checks->lock);
+            else
+            {
+                wd_time_to_timespec(wake, &ts);
+                (void)pthread_cond_timedwait(&checks->cond, &checks->lock, &ts);
+            }
+
+            continue;
+        }
+
+        start = wd_time_now_ns();
+        __atomic_store_n(&check->started_ns, start, __ATOMIC_RELAXED);
+        __atomic_store_n(&check->running, true, __ATOMIC_RELEASE);
+        (void)pthread_mutex_unlock(&checks->lock);
+
+        result = wd_check_run(&check->conf) ? WD_CHECK_OK : WD_CHECK_FAIL;
+        end = wd_time_now_ns();
+        if (end - start > check->conf.deadline_ns)
+            result = WD_CHECK_TIMEOUT;
+
+        (void)pthread_mutex_lock(&checks->lock);
+        ++check->runs;
+        if (result == WD_CHECK_FAIL)
+            ++check->failures;
+        else if (result == WD_CHECK_TIMEOUT)
+            ++check->timeouts;
+
+        wd_hist_add(&check->latency, end - start);
+        __atomic_store_n(&check->finished_ns, end, __ATOMIC_RELAXED);
+        __atomic_store_n(&check->result, result, __ATOMIC_RELAXED);
+        __atomic_store_n(&check->running, false, __ATOMIC_RELEASE);
+
+        /* another worker may sleep until this check is due */
+        (void)pthread_cond_broadcast(&checks->cond);
+    }
+    (void)pthread_mutex_unlock(&checks->lock);
+
+    return NULL;
+}
+
+int wd_check_parse(char *spec, struct wd_check_conf *conf)
+{
+    char *sep;
+    size_t i;
+
+    WD_TRACE("");
+
+    if (spec == NULL || conf == NULL)
+        WD_ERROR("spec == NULL || conf == NULL\n", 1, "");
+
+    (void)memset(conf, 0, sizeof(*conf));
+    conf->deadline_ns = WD_CHECK_DEFAULT_DEADLINE_MS * WD_NSEC_PER_MSEC;
+    conf->ttl_ns = WD_CHECK_DEFAULT_TTL_MS * WD_NSEC_PER_MSEC;
+
+    if (wd_check_opt(spec, ",deadline=", &conf->deadline_ns) || wd_check_opt(spec, ",ttl=", &conf->ttl_ns))
+        WD_ERROR("Incorrect check option in %s\n", 1, spec);
+
+    if (conf->deadline_ns == 0)
+        WD_ERROR("Check deadline == 0\n", 1, "");
+
+    sep = strchr(spec, ':');
+    if (sep == NULL || sep[1] == '\0')
+        WD_ERROR("Check %s has no argument\n", 1, spec);
+
+    *sep = '\0';
+    conf->arg = sep + 1;
+
+    for (i = 0; i < WD_CHECK_ARRAY_SIZE(wd_check_types); ++i)
+        if (strcmp(spec, wd_check_types[i]) == 0)
+        {
+            conf->type = (wd_check_type_t)i;
+            return 0;
+        }
+
+    WD_ERROR("Unknown check %s\n", 1, spec);
+}
+
+struct wd_checks *wd_checks_start(const struct wd_check_conf *confs, size_t n, unsigned int workers)
+{
+    struct wd_checks *checks;
+    pthread_condattr_t attr;
+    unsigned int i;
+    size_t j;
+
+    WD_TRACE("");
+
+    if (confs == NULL || n == 0 || n > WD_CHECK_MAX)
+        WD_ERROR("Incorrect number of checks, max is %d\n", NULL, WD_CHECK_MAX);
+
+    if (workers == 0)
+        workers = WD_CHECK_DEFAULT_WORKERS;
+
+    if (workers > WD_CHECK_MAX_WORKERS)
+        workers = WD_CHECK_MAX_WORKERS;
+
+    checks = calloc(1, sizeof(*checks));
+    if (checks == NULL)
+        WD_ERROR("Cannot allocate checks\n", NULL, "");
+
+    for (j = 0; j < n; ++j)
+        checks->checks[j].conf = confs[j];
+
+    checks->n = n;
+    (void)pthread_mutex_init(&checks->lock, NULL);
+
+    /* due times are monotonic */
+    (void)pthread_condattr_init(&attr);
+    (void)pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    (void)pthread_cond_init(&checks->cond, &attr);
+    (void)pthread_condattr_destroy(&attr);
+
+    for (i = 0; i < workers; ++i)
+    {
+        if (pthread_create(&checks->workers[i], NULL, wd_checks_worker, checks) != 0)
+        {
+            wd_checks_stop(checks);
+            WD_ERROR("Cannot start check worker\n", NULL, "");
+        }
+
+        ++checks->nworkers;
+    }
+
+    return checks;
+}
+
+void wd_checks_stop(struct wd_checks *checks)
+{
+    unsigned int i;
+
+    WD_TRACE("");
+
+    if (checks == NULL)
+        return;
+
+    (void)pthread_mutex_lock(&checks->lock);
+    checks->stop = true;
+    (void)pthread_cond_broadcast(&checks->cond);
+    (void)pthread_mutex_unlock(&checks->lock);
+
+    for (i = 0; i < checks->nworkers; ++i)
+        (void)pthread_join(checks->workers[i], NULL);
+
+    (void)pthread_cond_destroy(&checks->cond);
+    (void)pthread_mutex_destroy(&checks->lock);
+    free(checks);
+}
+
+const struct wd_check *wd_checks_failed(const struct wd_checks *checks, uint64_t now)
+{
+    const struct wd_check *check;
+    uint64_t started;
+    size_t i;
+
+    if (checks == NULL)
+        return NULL;
+
+    for (i = 0; i < checks->n; ++i)
+    {
+        check = &checks->checks[i];
+
+        /* stuck check is a failed check, do not wait for it */
+        if (__atomic_load_n(&check->running, __ATOMIC_ACQUIRE))
+        {
+            started = __atomic_load_n(&check->started_ns, __ATOMIC_RELAXED);
+            if (now > started && now - started > check->conf.deadline_ns)
+                return check;
+        }
+
+        switch (__atomic_load_n(&check->result, __ATOMIC_RELAXED))
+        {
+            case WD_CHECK_FAIL:
+            case WD_CHECK_TIMEOUT:
+                return check;
+            default:
+                break;
+        }
+    }
+
+    return NULL;
+}
+
+bool wd_checks_settled(const struct wd_checks *checks)
+{
+    size_t i;
+
+    if (checks == NULL)
+        return true;
+
+    for (i = 0; i < checks->n; ++i)
+        if (__atomic_load_n(&checks->checks[i].result, __ATOMIC_RELAXED) == WD_CHECK_PENDING)
+            return false;
+
+    return true;
+}
+
+const struct wd_check *wd_checks_get(const struct wd_checks *checks, size_t i)
+{
+    if (checks == NULL || i >= checks->n)
+        return NULL;
+
+    return &checks->checks[i];
+}
+
+const char *wd_check_name(const struct wd_check *check, char *buf, size_t size)
+{
+    (void)snprintf(buf, size, "%s:%s", wd_check_types[check->conf.type], check->conf.arg);
+
+    return buf;
+}
+
+const char *wd_check_result_name(unsigned int result)
+{
+    if (result >= WD_CHECK_ARRAY_SIZE(wd_check_results))
+        return "unknown";
+
+    return wd_check_results[result];
+}
@@ -0,0 +1,356 @@
+#define _GNU_SOURCE
+#include <wd_ctl.h>
+#include <wd_log.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#define WD_CTL_ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+/* payloads start at 8 byte boundary, client can still memcpy them out */
+#define WD_CTL_ALIGN(x) (((x) + 7U) & ~(size_t)7U)
+
+static const char *const wd_ctl_op_names[] =
+{
+    [WD_OP_KEEPALIVE]       = "keepalive",
+    [WD_OP_GET_TIMEOUT]     = "get-timeout",
+    [WD_OP_SET_TIMEOUT]     = "set-timeout",
+    [WD_OP_GET_PRETIMEOUT]  = "get-pretimeout",
+    [WD_OP_SET_PRETIMEOUT]  = "set-pretimeout",
+    [WD_OP_GET_TIMELEFT]    = "get-timeleft",
+    [WD_OP_GET_BOOTSTATUS]  = "get-bootstatus",
+    [WD_OP_GET_STATUS]      = "get-status",
+    [WD_OP_GET_TEMP]        = "get-temp",
+    [WD_OP_SET_OPTIONS]     = "set-options",
+    [WD_OP_GET_INFO]        = "get-info",
+    [WD_CTL_SNAPSHOT]       = "snapshot",
+    [WD_CTL_FEED]           = "feed",
+    [WD_CTL_DEVS]           = "devs",
+    [WD_CTL_SOFT_KICK]      = "soft-kick"
+};
+
+static int wd_ctl_addr(const char *path, struct sockaddr_un *addr);
+static void wd_ctl_accept(struct wd_event *ev, uint32_t events);
+static void wd_ctl_client_event(struct wd_event *ev, uint32_t events);
+static void wd_ctl_client_drop(struct wd_ctl_client *client);
+static ssize_t wd_ctl_serve(struct wd_ctl_server *server, size_t len);
+
+static int wd_ctl_addr(const char *path, struct sockaddr_un *addr)
+{
+    (void)memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+
+    if (strlen(path) >= sizeof(addr->sun_path))
+        WD_ERROR("Socket path %s is too long\n", 1, path);
+
+    (void)strcpy(addr->sun_path, path);
+
+    return 0;
+}
+
+static void wd_ctl_client_drop(struct wd_ctl_client *client)
+{
+    (void)close(client->ev.fd);
+    client->ev.fd = -1;
+}
+
+/* builds response in server->resp, returns its length or -1 for malformed request */
+static ssize_t wd_ctl_serve(struct wd_ctl_server *server, size_t len)
+{
+    const struct wd_ctl_hdr *req = (const struct wd_ctl_hdr *)server->req;
+    const struct wd_ctl_cmd *cmds = (const struct wd_ctl_cmd *)(req + 1);
+    struct wd_ctl_hdr *resp = (struct wd_ctl_hdr *)server->resp;
+    struct wd_ctl_res *res = (struct wd_ctl_res *)(resp + 1);
+    struct wd_fbuf payload;
+    size_t start;
+    size_t i;
+
+    if (len < sizeof(*req) || req->magic != WD_CTL_MAGIC || req->version != WD_CTL_VERSION ||
+        req->ncmds > WD_CTL_MAX_CMDS || len != sizeof(*req) + req->ncmds * sizeof(*cmds))
+        return -1;
+
+    *resp = *req;
+    start = sizeof(*resp) + req->ncmds * sizeof(*res);
+    wd_fbuf_init(&payload, (char *)server->resp, sizeof(server->resp));
+    payload.len = start;
+
+    for (i = 0; i < req->ncmds; ++i)
+    {
+        (void)memset(&res[i], 0, sizeof(res[i]));
+        res[i].op = cmds[i].op;
+        res[i].dev = cmds[i].dev;
+
+        payload.len = WD_CTL_ALIGN(payload.len);
+        if (payload.len > payload.size)
+            payload.len = payload.size;
+
+        start = payload.len;
+        server->handler(server->arg, &cmds[i], &res[i], &payload);
+
+        if (payload.overflow)
+        {
+            res[i].err = ENOSPC;
+            payload.overflow = false;
+            payload.len = start;
+        }
+        else if (payload.len != start)
+        {
+            res[i].off = (uint32_t)start;
+            res[i].len = (uint32_t)(payload.len - start);
+        }
+    }
+
+    ++server->requests;
+
+    return (ssize_t)payload.len;
+}
+
+static void wd_ctl_client_event(struct wd_event *ev, uint32_t events)
+{
+    struct wd_ctl_client *client = (struct wd_ctl_client *)ev->arg;
+    struct wd_ctl_server *server = client->server;
+    ssize_t len;
+
+    /* slot was dropped earlier in the same dispatch */
+    if (ev->fd == -1)
+        return;
+
+    if (events & EPOLLIN)
+    {
+        len = recv(ev->fd, server->req, sizeof(server->req), MSG_DONTWAIT | MSG_TRUNC);
+        if (len == -1 && (errno == EAGAIN || errno == EINTR))
+            return;
+
+        if (len <= 0)
+        {
+            wd_ctl_client_drop(client);
+            return;
+        }
+
+        /* oversized request is cut by kernel, MSG_TRUNC reports real length */
+        if ((size_t)len > sizeof(server->req) ||
+            (len = wd_ctl_serve(server, (size_t)len)) < 0 ||
+            send(ev->fd, server->resp, (size_t)len, MSG_DONTWAIT | MSG_NOSIGNAL) != len)
+        {
+            ++server->dropped;
+            wd_ctl_client_drop(client);
+        }
+
+        return;
+    }
+
+    if (events & (EPOLLHUP | EPOLLERR))
+        wd_ctl_client_drop(client);
+}
+
+static void wd_ctl_accept(struct wd_event *ev, uint32_t events)
+{
+    struct wd_ctl_server *server = (struct wd_ctl_server *)ev->arg;
+    struct wd_ctl_client *client = NULL;
+    size_t i;
+    int fd;
+
+    (void)events;
+
+    fd = accept4(ev->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd == -1)
+        return;
+
+    for (i = 0; i < WD_CTL_ARRAY_SIZE(server->clients); ++i)
+        if (server->clients[i].ev.fd == -1)
+        {
+            client = &server->clients[i];
+            break;
+        }
+
+    if (client == NULL)
+    {
+        ++server->dropped;
+        (void)close(fd);
+        return;
+    }
+
+    client->ev.fd = fd;
+    if (wd_loop_add(server->loop, &client->ev, EPOLLIN))
+        wd_ctl_client_drop(client);
+}
+
+int wd_ctl_server_init(struct wd_ctl_server *server, const char *path, struct wd_loop *loop,
+                       wd_ctl_handler_t handler, void *arg)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    size_t i;
+
+    WD_TRACE("");
+
+    if (server == NULL || loop == NULL || handler == NULL)
+        WD_ERROR("server == NULL || loop == NULL || handler == NULL\n", 1, "");
+
+    (void)memset(server, 0, sizeof(*server));
+    server->ev.fd = -1;
+    server->loop = loop;
+    server->path = path ? path : WD_CTL_DEFAULT_PATH;
+    server->handler = handler;
+    server->arg = arg;
+
+    for (i = 0; i < WD_CTL_ARRAY_SIZE(server->clients); ++i)
+    {
+        server->clients[i].ev.fd = -1;
+        server->clients[i].ev.cb = wd_ctl_client_event;
+        server->clients[i].ev.arg = &server->clients[i];
+        server->clients[i].server = server;
+    }
+
+    if (wd_ctl_addr(server->path, &addr))
+        return 1;
+
+    server->ev.fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->ev.fd == -1)
+        WD_ERROR("Cannot create control socket\n", 1, "");
+
+    /* socket of crashed daemon is left behind */
+    (void)unlink(server->path);
+    if (bind(server->ev.fd, (const struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        server->path = NULL;
+        WD_ERROR("Cannot bind control socket %s\n", 1, addr.sun_path);
+    }
+
+    if (stat(server->path, &st) == 0)
+    {
+        server->st_dev = st.st_dev;
+        server->st_ino = st.st_ino;
+    }
+
+    /* setters reach hardware, only owner can connect */
+    if (chmod(server->path, S_IRUSR | S_IWUSR) == -1 || listen(server->ev.fd, WD_CTL_MAX_CLIENTS) == -1)
+        WD_ERROR("Cannot listen on control socket %s\n", 1, server->path);
+
+    server->ev.cb = wd_ctl_accept;
+    server->ev.arg = server;
+
+    return wd_loop_add(loop, &server->ev, EPOLLIN);
+}
+
+void wd_ctl_server_deinit(struct wd_ctl_server *server)
+{
+    struct stat st;
+    size_t i;
+
+    WD_TRACE("");
+
+    if (server == NULL || server->ev.fd == -1)
+        return;
+
+    for (i = 0; i < WD_CTL_ARRAY_SIZE(server->clients); ++i)
+        if (server->clients[i].ev.fd != -1)
+            wd_ctl_client_drop(&server->clients[i]);
+
+    (void)close(server->ev.fd);
+    server->ev.fd = -1;
+
+    /* after handover new daemon already listens on the same path */
+    if (server->path && stat(server->path, &st) == 0 && st.st_dev == server->st_dev && st.st_ino == server->st_ino)
+        (void)unlink(server->path);
+}
+
+int wd_ctl_connect(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    WD_TRACE("");
+
+    if (wd_ctl_addr(path ? path : WD_CTL_DEFAULT_PATH, &addr))
+        return -1;
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        WD_ERROR("Cannot create control socket\n", -1, "");
+
+    if (connect(fd, (const struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        (void)close(fd);
+        WD_ERROR("Cannot connect to %s, is daemon running?\n", -1, addr.sun_path);
+    }
+
+    return fd;
+}
+
+ssize_t wd_ctl_call(int fd, const struct wd_ctl_cmd *cmds, size_t n, void *buf, size_t size)
+{
+    static uint32_t seq;
+    uint8_t req[sizeof(struct wd_ctl_hdr) + WD_CTL_MAX_CMDS * sizeof(struct wd_ctl_cmd)];
+    struct wd_ctl_hdr *hdr = (struct wd_ctl_hdr *)req;
+    const struct wd_ctl_hdr *resp = (const struct wd_ctl_hdr *)buf;
+    const size_t len = sizeof(*hdr) + n * sizeof(*cmds);
+    ssize_t rlen;
+
+    WD_TRACE("");
+
+    if (cmds == NULL || buf == NULL || n > WD_CTL_MAX_CMDS || size < WD_CTL_MAX_MSG)
+        WD_ERROR("cmds == NULL || buf == NULL || n > max || size < max\n", -1, "");
+
+    (void)memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = WD_CTL_MAGIC;
+    hdr->version = WD_CTL_VERSION;
+    hdr->ncmds = (uint16_t)n;
+    hdr->seq = ++seq;
+    (void)memcpy(hdr + 1, cmds, n * sizeof(*cmds));
+
+    if (send(fd, req, len, MSG_NOSIGNAL) != (ssize_t)len)
+        WD_ERROR("Cannot send control request\n", -1, "");
+
+    rlen = recv(fd, buf, size, 0);
+    if (rlen < (ssize_t)sizeof(*resp))
+        WD_ERROR("Daemon dropped control request\n", -1, "");
+
+    if (resp->magic != WD_CTL_MAGIC || resp->seq != hdr->seq || resp->ncmds != n ||
+        (size_t)rlen < sizeof(*resp) + n * sizeof(struct wd_ctl_res))
+        WD_ERROR("Malformed control response\n", -1, "");
+
+    return rlen;
+}
+
+int wd_ctl_payload(const void *msg, size_t len, const struct wd_ctl_res *res, void *out, size_t size)
+{
+    if (msg == NULL || res == NULL || out == NULL)
+        return 1;
+
+    if (res->err || res->off == 0 || res->len != size || (size_t)res->off + res->len > len)
+        return 1;
+
+    (void)memcpy(out, (const uint8_t *)msg + res->off, size);
+
+    return 0;
+}
+
+const char *wd_ctl_op_name(unsigned int op)
+{
+    if (op >= WD_CTL_ARRAY_SIZE(wd_ctl_op_names) || wd_ctl_op_names[op] == NULL)
+        return "unknown";
+
+    return wd_ctl_op_names[op];
+}
+
+int wd_ctl_op_parse(const char *name, unsigned int *op)
+{
+    unsigned int i;
+
+    if (name == NULL || op == NULL)
+        return 1;
+
+    for (i = 0; i < WD_CTL_ARRAY_SIZE(wd_ctl_op_names); ++i)
+        if (strcmp(name, wd_ctl_op_names[i]) == 0)
+        {
+            *op = i;
+            return 0;
+        }
+
+    return 1;
+}
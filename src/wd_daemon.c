@@ -0,0 +1,1403 @@
+#define _GNU_SOURCE
+#include <wd_daemon.h>
+#include <wd_loop.h>
+#include <wd_backend.h>
+#include <wd_uring.h>
+#include <wd_time.h>
+#include <wd_log.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#define WD_DAEMON_DEV_NAME(dev) ((dev) ? (dev) : "default watchdog")
+
+/* while withholding feed, recovery of clients is checked this often */
+#define WD_DAEMON_HB_RECHECK_NS (100 * WD_NSEC_PER_MSEC)
+
+/* snapshot older than this is taken again on control request */
+#define WD_DAEMON_SNAP_TTL_NS   (1000 * WD_NSEC_PER_MSEC)
+
+/* batched feed takes devices due within 1/DIV of their period, early feed is always safe */
+#define WD_DAEMON_BATCH_EARLY_DIV   4
+
+struct wd_daemon;
+
+struct wd_feed_dev
+{
+    watchdog_t      wd;
+    const char      *dev;
+    unsigned int    timeout;    /* WD timeout in seconds */
+    uint64_t        next_ns;    /* next scheduled feed */
+    struct wd_sched sched;
+    uint64_t        feeds;
+    uint64_t        missed;     /* timer periods lost because we were late */
+    uint64_t        errors;
+    uint64_t        withheld;   /* feeds skipped by client, check or pressure */
+    bool            withholding;
+    uint64_t        held_ns;    /* withholding taken over is kept at least until then, 0 means none */
+    char            name[WD_HANDOVER_DEV_LEN];  /* dev of taken over device points here */
+    struct wd_hb_registry *hb;
+    const struct wd_checks *checks;
+    const struct wd_psi *psi;
+    struct wd_stats *stats;
+    struct wd_snapshot snap;    /* cached for control socket and exporter */
+    uint64_t        snap_ns;    /* 0 means no snapshot yet */
+    uint64_t        refresh_ns; /* exporter snapshot period, 0 means off */
+    struct wd_event timer;
+    struct wd_sampler sampler;
+    struct wd_daemon *daemon;
+};
+
+struct wd_daemon
+{
+    struct wd_loop      loop;
+    struct wd_event     sig;
+    struct wd_event     stop;   /* end of timed run */
+    struct wd_feed_dev  fdevs[WD_DAEMON_MAX_DEVS];
+    size_t              nfdevs;
+    struct wd_stats_file *stats;
+    struct wd_hb_registry hb;
+    struct wd_checks    *checks;
+    struct wd_psi       psi;
+    struct wd_ctl_server ctl;
+    struct wd_handover_listener ho;
+    struct wd_event     ho_listen;
+    struct wd_event     ho_peer;    /* new daemon during handover */
+    struct wd_event     ho_timer;   /* ack deadline */
+    struct wd_exporter  metrics;
+    struct wd_uring     ring;   /* batched feed, fd == -1 means per device ioctl */
+    struct wd_soft      *soft;  /* soft timers or NULL */
+    struct wd_soft_timer *soft_timers[WD_DAEMON_MAX_SOFT];
+    struct wd_sample_notifier *notifier;    /* sampler logs and hooks of RT loop */
+    struct wd_handover_msg ho_msg;  /* state sent or taken over */
+    struct wd_handover_ack ho_ack;  /* first feeds after takeover, sent when init is done */
+    int                 ho_from;    /* old daemon waiting for ack, -1 means none */
+    const struct wd_daemon_conf *conf;
+    bool                rt;     /* no stdio inside loop */
+    bool                clean;  /* clean shutdown requested */
+    const struct wd_feed_dev *broken;   /* feed timer could not be rearmed */
+};
+
+static void wd_daemon_feed(struct wd_event *ev, uint32_t events);
+static void wd_daemon_feed_batch(struct wd_daemon *daemon, struct wd_feed_dev *first);
+static uint64_t wd_daemon_missed(const struct wd_feed_dev *fdev, uint64_t now);
+static void wd_daemon_rearm(struct wd_feed_dev *fdev);
+static bool wd_daemon_hold(struct wd_feed_dev *fdev, uint64_t now);
+static void wd_daemon_fed(struct wd_feed_dev *fdev, struct wd_feed_sample *sample,
+                          bool ok, uint64_t start, uint64_t end);
+static void wd_daemon_signal(struct wd_event *ev, uint32_t events);
+static void wd_daemon_stop(struct wd_event *ev, uint32_t events);
+static int wd_daemon_stop_init(struct wd_daemon *daemon, uint64_t run_ns);
+static bool wd_daemon_withhold(struct wd_feed_dev *fdev, uint64_t now);
+static size_t wd_daemon_soft_expired(const struct wd_daemon *daemon);
+static int wd_daemon_soft_init(struct wd_daemon *daemon);
+static int wd_daemon_snapshot(struct wd_feed_dev *fdev, uint64_t now);
+static size_t wd_daemon_metrics(void *arg, struct wd_exporter_dev *devs, size_t n);
+static int wd_daemon_set_timeout(struct wd_daemon *daemon, struct wd_feed_dev *fdev, unsigned int timeout);
+static void wd_daemon_ctl(void *arg, const struct wd_ctl_cmd *cmd, struct wd_ctl_res *res, struct wd_fbuf *payload);
+static uint64_t wd_daemon_verdict_ns(const struct wd_daemon_conf *conf);
+static int wd_daemon_takeover(struct wd_daemon *daemon, const char *path);
+static int wd_daemon_takeover_ack(struct wd_daemon *daemon);
+static void wd_daemon_takeover_log(const struct wd_daemon *daemon);
+static int wd_daemon_handover_init(struct wd_daemon *daemon, const char *path);
+static int wd_daemon_handover_start(struct wd_daemon *daemon, int fd);
+static void wd_daemon_handover_abort(struct wd_daemon *daemon);
+static void wd_daemon_handover_relisten(struct wd_daemon *daemon);
+static void wd_daemon_handover_accept(struct wd_event *ev, uint32_t events);
+static void wd_daemon_handover_ack(struct wd_event *ev, uint32_t events);
+static void wd_daemon_handover_timeout(struct wd_event *ev, uint32_t events);
+static void wd_daemon_history(const struct wd_daemon *daemon, const char *path,
+                              const struct wd_history_prev *prev, size_t nprev);
+static int wd_daemon_selftest_report(const struct wd_rt_usage *start, const struct wd_rt_usage *end, bool selftest);
+
+static int wd_daemon_dev_init(struct wd_daemon *daemon, struct wd_feed_dev *fdev, const struct wd_daemon_conf *conf);
+static int wd_daemon_signal_init(struct wd_daemon *daemon);
+static void wd_daemon_dump(const struct wd_daemon *daemon);
+static int wd_daemon_cleanup(struct wd_daemon *daemon);
+
+/* index of first expired soft timer or nsoft when all are alive */
+static size_t wd_daemon_soft_expired(const struct wd_daemon *daemon)
+{
+    size_t i;
+
+    for (i = 0; i < daemon->conf->nsoft; ++i)
+        if (wd_soft_expired(daemon->soft_timers[i]))
+            break;
+
+    return i;
+}
+
+static bool wd_daemon_withhold(struct wd_feed_dev *fdev, uint64_t now)
+{
+    struct wd_hb_stale stale;
+    const struct wd_check *check;
+    const struct wd_psi_trigger *trigger;
+    char name[256];
+    size_t soft;
+    const bool was = fdev->withholding;
+    const bool quiet = fdev->daemon->rt;   /* no stdio inside RT loop, withheld feeds are in stats */
+
+    fdev->withholding = true;
+    if (fdev->hb != NULL && wd_hb_registry_scan(fdev->hb, now, &stale) != 0)
+    {
+        if (!was && !quiet)
+            WD_LOG("%s: withholding keepalive, client %s (pid %" PRIu32 ") is %" PRIu64 " ms past deadline\n",
+                   WD_DAEMON_DEV_NAME(fdev->dev), stale.name, stale.pid, stale.late_ns / WD_NSEC_PER_MSEC);
+    }
+    else if ((check = wd_checks_failed(fdev->checks, now)) != NULL)
+    {
+        if (!was && !quiet)
+            WD_LOG("%s: withholding keepalive, check %s: %s\n",
+                   WD_DAEMON_DEV_NAME(fdev->dev), wd_check_name(check, name, sizeof(name)),
+                   __atomic_load_n(&check->running, __ATOMIC_RELAXED) ? "past deadline" : wd_check_result_name(check->result));
+    }
+    else if ((trigger = wd_psi_starving(fdev->psi, now)) != NULL)
+    {
+        if (!was && !quiet)
+            WD_LOG("%s: withholding keepalive, pressure %s lasts %" PRIu64 " ms\n",
+                   WD_DAEMON_DEV_NAME(fdev->dev), wd_psi_name(trigger, name, sizeof(name)),
+                   (now - trigger->since_ns) / WD_NSEC_PER_MSEC);
+    }
+    else if ((soft = wd_daemon_soft_expired(fdev->daemon)) < fdev->daemon->conf->nsoft)
+    {
+        if (!was && !quiet)
+            WD_LOG("%s: withholding keepalive, soft timer %zu not kicked for %" PRIu64 " ms\n",
+                   WD_DAEMON_DEV_NAME(fdev->dev), soft, fdev->daemon->conf->soft_ns[soft] / WD_NSEC_PER_MSEC);
+    }
+    else if (fdev->held_ns && (now < fdev->held_ns || !wd_checks_settled(fdev->checks)))
+    {
+        /* old daemon was withholding, our checks, pressure and soft timers have no verdict yet */
+    }
+    else
+    {
+        fdev->held_ns = 0;
+        fdev->withholding = false;
+        if (was && !quiet)
+            WD_LOG("%s: clients, checks, pressure and soft timers healthy again, feeding\n", WD_DAEMON_DEV_NAME(fdev->dev));
+    }
+
+    return fdev->withholding;
+}
+
+/* timer is one-shot and reads 1 expiration however late we are, lost periods come from lateness */
+static uint64_t wd_daemon_missed(const struct wd_feed_dev *fdev, uint64_t now)
+{
+    if (now <= fdev->next_ns || fdev->sched.period_ns == 0)
+        return 0;
+
+    return (now - fdev->next_ns) / fdev->sched.period_ns;
+}
+
+static void wd_daemon_rearm(struct wd_feed_dev *fdev)
+{
+    if (wd_timer_arm(fdev->timer.fd, fdev->next_ns) == 0)
+        return;
+
+    /* device would never be fed again, stop and let it expire; reported after loop, no stdio here */
+    fdev->daemon->broken = fdev;
+    wd_loop_stop(&fdev->daemon->loop);
+}
+
+static bool wd_daemon_hold(struct wd_feed_dev *fdev, uint64_t now)
+{
+    /* hung client: let hardware expire unless it recovers in time */
+    if (!wd_daemon_withhold(fdev, now))
+        return false;
+
+    ++fdev->withheld;
+    fdev->missed += wd_daemon_missed(fdev, now);
+    fdev->next_ns = now + (fdev->sched.period_ns < WD_DAEMON_HB_RECHECK_NS ? fdev->sched.period_ns : WD_DAEMON_HB_RECHECK_NS);
+    wd_daemon_rearm(fdev);
+
+    /* falling time left is what exporter should show now */
+    if (fdev->refresh_ns && now - fdev->snap_ns > fdev->refresh_ns)
+        (void)wd_daemon_snapshot(fdev, now);
+
+    return true;
+}
+
+static void wd_daemon_fed(struct wd_feed_dev *fdev, struct wd_feed_sample *sample,
+                          bool ok, uint64_t start, uint64_t end)
+{
+    if (ok)
+        ++fdev->feeds;
+    else
+        ++fdev->errors;
+
+    sample->slack_ns = fdev->sched.slack_ns;
+    sample->ioctl_ns = end - start > UINT32_MAX ? UINT32_MAX : (uint32_t)(end - start);
+    sample->timeleft = fdev->sched.timeleft == WD_SCHED_TIMELEFT_NONE ? WD_STATS_TIMELEFT_NONE : (uint32_t)fdev->sched.timeleft;
+    wd_stats_record(fdev->stats, sample, ok);
+
+    fdev->missed += wd_daemon_missed(fdev, sample->actual_ns);
+    fdev->next_ns = wd_sched_next(&fdev->sched, fdev->next_ns, end);
+
+    wd_daemon_rearm(fdev);
+
+    /* keepalive is done and next one is a period away, exporter never reads hardware itself */
+    if (fdev->refresh_ns && end - fdev->snap_ns > fdev->refresh_ns)
+        (void)wd_daemon_snapshot(fdev, end);
+}
+
+static void wd_daemon_feed_batch(struct wd_daemon *daemon, struct wd_feed_dev *first)
+{
+    struct wd_feed_dev *fdev;
+    struct wd_feed_sample samples[WD_DAEMON_MAX_DEVS];
+    size_t idx[WD_DAEMON_MAX_DEVS];
+    int res[WD_DAEMON_MAX_DEVS];
+    const uint64_t now = wd_time_now_ns();
+    uint64_t start;
+    uint64_t end;
+    size_t n = 0;
+    size_t i;
+
+    for (i = 0; i < daemon->nfdevs; ++i)
+    {
+        fdev = &daemon->fdevs[i];
+        if (fdev == first)
+        {
+            if (wd_daemon_hold(fdev, now))
+                continue;
+        }
+        else
+        {
+            /* devices with the same period fall into the same batch after first one */
+            if (fdev->next_ns > now + fdev->sched.period_ns / WD_DAEMON_BATCH_EARLY_DIV)
+                continue;
+
+            /* withholding one is left to its own timer */
+            if (wd_daemon_withhold(fdev, now))
+                continue;
+        }
+
+        samples[n].sched_ns = fdev->next_ns;
+        samples[n].actual_ns = now;
+        wd_sched_sample(&fdev->sched, fdev->wd, now);
+        idx[n++] = i;
+    }
+
+    if (n == 0)
+        return;
+
+    start = wd_time_now_ns();
+    (void)wd_uring_feed(&daemon->ring, idx, n, res);
+    end = wd_time_now_ns();
+
+    /* rearmed timer of device already due reads 0 expirations and is skipped */
+    for (i = 0; i < n; ++i)
+        wd_daemon_fed(&daemon->fdevs[idx[i]], &samples[i], res[i] == 0, start, end);
+}
+
+static void wd_daemon_feed(struct wd_event *ev, uint32_t events)
+{
+    struct wd_feed_dev *fdev = (struct wd_feed_dev *)ev->arg;
+    struct wd_feed_sample sample;
+    uint64_t exp;
+    uint64_t start;
+    uint64_t end;
+    bool ok;
+
+    (void)events;
+
+    if (wd_timer_ack(ev->fd, &exp) || exp == 0)
+        return;
+
+    if (fdev->daemon->ring.fd != -1)
+    {
+        wd_daemon_feed_batch(fdev->daemon, fdev);
+        return;
+    }
+
+    sample.sched_ns = fdev->next_ns;
+    sample.actual_ns = wd_time_now_ns();
+
+    if (wd_daemon_hold(fdev, sample.actual_ns))
+        return;
+
+    wd_sched_sample(&fdev->sched, fdev->wd, sample.actual_ns);
+
+    start = wd_time_now_ns();
+    ok = wd_keepalive(fdev->wd) == 0;
+    end = wd_time_now_ns();
+
+    wd_daemon_fed(fdev, &sample, ok, start, end);
+}
+
+static int wd_daemon_snapshot(struct wd_feed_dev *fdev, uint64_t now)
+{
+    struct wd_snapshot snap;
+    int ret;
+
+    snap.valid = 0;
+    ret = wd_get_snapshot(fdev->wd, &snap, WD_SNAP_ALL);
+    if (snap.valid == 0)
+        return ret ? ret : 1;
+
+    fdev->snap = snap;
+    fdev->snap_ns = now;
+
+    return 0;
+}
+
+static int wd_daemon_set_timeout(struct wd_daemon *daemon, struct wd_feed_dev *fdev, unsigned int timeout)
+{
+    if (wd_set_timeout(fdev->wd, timeout) || wd_get_timeout(fdev->wd, &fdev->timeout) || fdev->timeout == 0)
+        return 1;
+
+    /* period follows new timeout, adaptive state starts over */
+    if (wd_sched_init(&fdev->sched, &daemon->conf->sched, fdev->wd, fdev->timeout))
+        return 1;
+
+    fdev->stats->timeout_ns = fdev->sched.timeout_ns;
+    fdev->stats->near_miss_ns = fdev->sched.timeout_ns / 100 * daemon->conf->near_miss_pct;
+    fdev->snap_ns = 0;
+
+    fdev->next_ns = wd_sched_next(&fdev->sched, 0, wd_time_now_ns());
+
+    return wd_timer_arm(fdev->timer.fd, fdev->next_ns);
+}
+
+static void wd_daemon_ctl(void *arg, const struct wd_ctl_cmd *cmd, struct wd_ctl_res *res, struct wd_fbuf *payload)
+{
+    struct wd_daemon *daemon = (struct wd_daemon *)arg;
+    struct wd_feed_dev *fdev;
+    struct watchdog_info info;
+    struct wd_ctl_feed feed;
+    unsigned int uval = 0;
+    uint64_t now;
+    int ival = 0;
+    int ret;
+
+    if (cmd->op == WD_CTL_DEVS)
+    {
+        res->val = (int64_t)daemon->nfdevs;
+        return;
+    }
+
+    /* soft timers belong to daemon, not to device */
+    if (cmd->op == WD_CTL_SOFT_KICK)
+    {
+        if (cmd->arg >= daemon->conf->nsoft)
+            res->err = ENOENT;
+        else
+            wd_soft_kick(daemon->soft_timers[cmd->arg]);
+
+        return;
+    }
+
+    if (cmd->dev >= daemon->nfdevs)
+    {
+        res->err = ENODEV;
+        return;
+    }
+
+    fdev = &daemon->fdevs[cmd->dev];
+    errno = 0;
+
+    switch (cmd->op)
+    {
+        case WD_OP_GET_TIMEOUT:
+        {
+            ret = wd_get_timeout(fdev->wd, &uval);
+            res->val = uval;
+            break;
+        }
+        case WD_OP_SET_TIMEOUT:
+        {
+            ret = wd_daemon_set_timeout(daemon, fdev, cmd->arg);
+            break;
+        }
+        case WD_OP_GET_PRETIMEOUT:
+        {
+            ret = wd_get_pretimeout(fdev->wd, &uval);
+            res->val = uval;
+            break;
+        }
+        case WD_OP_SET_PRETIMEOUT:
+        {
+            ret = wd_set_pretimeout(fdev->wd, cmd->arg);
+            break;
+        }
+        case WD_OP_GET_TIMELEFT:
+        {
+            ret = wd_get_timeleft(fdev->wd, &uval);
+            res->val = uval;
+            break;
+        }
+        case WD_OP_GET_BOOTSTATUS:
+        {
+            ret = wd_get_bootstatus(fdev->wd, &ival);
+            res->val = ival;
+            break;
+        }
+        case WD_OP_GET_STATUS:
+        {
+            ret = wd_get_status(fdev->wd, &ival);
+            res->val = ival;
+            break;
+        }
+        case WD_OP_GET_TEMP:
+        {
+            ret = wd_get_temp(fdev->wd, &ival);
+            res->val = ival;
+            break;
+        }
+        case WD_OP_SET_OPTIONS:
+        {
+            ret = wd_set_options(fdev->wd, (int)cmd->arg);
+            break;
+        }
+        case WD_OP_GET_INFO:
+        {
+            ret = wd_get_info(fdev->wd, &info);
+            if (ret == 0)
+                wd_fbuf_put(payload, &info, sizeof(info));
+
+            break;
+        }
+        case WD_CTL_SNAPSHOT:
+        {
+            /* many readers polling together cost one set of ioctls per TTL */
+            now = wd_time_now_ns();
+            ret = 0;
+            if (fdev->snap_ns == 0 || now - fdev->snap_ns > WD_DAEMON_SNAP_TTL_NS)
+                ret = wd_daemon_snapshot(fdev, now);
+
+            if (ret == 0)
+            {
+                res->val = (int64_t)(now - fdev->snap_ns);
+                wd_fbuf_put(payload, &fdev->snap, sizeof(fdev->snap));
+            }
+
+            break;
+        }
+        case WD_CTL_FEED:
+        {
+            (void)memset(&feed, 0, sizeof(feed));
+            feed.feeds = fdev->feeds;
+            feed.errors = fdev->errors;
+            feed.withheld = fdev->withheld;
+            feed.period_ns = fdev->sched.period_ns;
+            feed.next_ns = fdev->next_ns;
+            feed.timeout = fdev->timeout;
+            feed.withholding = fdev->withholding;
+            wd_fbuf_put(payload, &feed, sizeof(feed));
+
+            return;
+        }
+        case WD_OP_KEEPALIVE:
+        {
+            /* only feeder feeds, foreign keepalive would bypass withhold policy */
+            res->err = EPERM;
+            return;
+        }
+        default:
+        {
+            res->err = EOPNOTSUPP;
+            return;
+        }
+    }
+
+    if (ret)
+        res->err = errno ? errno : EIO;
+}
+
+/* exporter source, everything here is already in memory */
+static size_t wd_daemon_metrics(void *arg, struct wd_exporter_dev *devs, size_t n)
+{
+    const struct wd_daemon *daemon = (const struct wd_daemon *)arg;
+    const struct wd_feed_dev *fdev;
+    const uint64_t now = wd_time_now_ns();
+    size_t i;
+
+    for (i = 0; i < daemon->nfdevs && i < n; ++i)
+    {
+        fdev = &daemon->fdevs[i];
+        (void)memset(&devs[i], 0, sizeof(devs[i]));
+        devs[i].dev = WD_DAEMON_DEV_NAME(fdev->dev);
+        devs[i].snap = fdev->snap_ns ? &fdev->snap : NULL;
+        devs[i].snap_age_ns = fdev->snap_ns ? now - fdev->snap_ns : 0;
+        devs[i].timeout = fdev->timeout;
+        devs[i].feeds = fdev->feeds;
+        devs[i].errors = fdev->errors;
+        devs[i].withheld = fdev->withheld;
+        devs[i].missed = fdev->missed;
+        devs[i].withholding = fdev->withholding;
+        devs[i].stats = fdev->stats;
+    }
+
+    return i;
+}
+
+/* pressure and soft timers need that long before they can find withheld device healthy */
+static uint64_t wd_daemon_verdict_ns(const struct wd_daemon_conf *conf)
+{
+    uint64_t ns = conf->npsi ? conf->psi_hold_ns : 0;
+    size_t i;
+
+    for (i = 0; i < conf->nsoft; ++i)
+        if (conf->soft_ns[i] > ns)
+            ns = conf->soft_ns[i];
+
+    return ns;
+}
+
+static int wd_daemon_takeover(struct wd_daemon *daemon, const char *path)
+{
+    struct wd_handover_msg *msg = &daemon->ho_msg;
+    struct wd_handover_ack *ack = &daemon->ho_ack;
+    const struct wd_handover_dev *dev;
+    struct wd_feed_dev *fdev;
+    int fds[WD_HANDOVER_MAX_DEVS];
+    size_t i;
+    int fd;
+
+    WD_TRACE("");
+
+    /* nobody to take over from, devices are opened as usual */
+    fd = wd_handover_connect(path);
+    if (fd == -1)
+        return 0;
+
+    if (wd_handover_recv(fd, msg, fds))
+    {
+        (void)close(fd);
+        return 1;
+    }
+
+    (void)memset(ack, 0, sizeof(*ack));
+    ack->magic = WD_HANDOVER_MAGIC;
+    ack->version = WD_HANDOVER_VERSION;
+    ack->ndevs = msg->ndevs;
+
+    /* ack is sent when init is done, old daemon feeds again when we close without it */
+    daemon->ho_from = fd;
+
+    /* old daemon stopped feeding when it sent state, feed before anything else */
+    daemon->nfdevs = msg->ndevs;
+    for (i = 0; i < daemon->nfdevs; ++i)
+    {
+        fdev = &daemon->fdevs[i];
+        fdev->wd = wd_open_fd(fds[i]);
+        if (fdev->wd == -1)
+        {
+            for (; i < daemon->nfdevs; ++i)
+                (void)close(fds[i]);
+
+            return 1;
+        }
+
+        /* next handover reuses message, name must live in device */
+        dev = &msg->devs[i];
+        (void)strncpy(fdev->name, dev->dev, sizeof(fdev->name) - 1);
+        fdev->dev = fdev->name[0] ? fdev->name : NULL;
+        fdev->feeds = dev->feeds;
+        fdev->errors = dev->errors;
+        fdev->withheld = dev->withheld;
+
+        /* policy of old daemon stopped feeding, handover must not revive device */
+        if (dev->flags & WD_HANDOVER_WITHHOLDING)
+        {
+            fdev->withholding = true;
+            fdev->held_ns = wd_time_now_ns() + wd_daemon_verdict_ns(daemon->conf);
+            continue;
+        }
+
+        if (wd_keepalive(fdev->wd) == 0)
+            ack->first_feed_ns[i] = wd_time_now_ns();
+    }
+
+    return 0;
+}
+
+/* old daemon stops only now, init failing before left it feeding */
+static int wd_daemon_takeover_ack(struct wd_daemon *daemon)
+{
+    int ret;
+
+    if (daemon->ho_from == -1)
+        return 0;
+
+    ret = wd_handover_send_ack(daemon->ho_from, &daemon->ho_ack);
+    (void)close(daemon->ho_from);
+    daemon->ho_from = -1;
+
+    return ret;
+}
+
+static void wd_daemon_takeover_log(const struct wd_daemon *daemon)
+{
+    const struct wd_handover_msg *msg = &daemon->ho_msg;
+    const struct wd_feed_dev *fdev;
+    size_t i;
+
+    for (i = 0; i < msg->ndevs; ++i)
+    {
+        fdev = &daemon->fdevs[i];
+        if (daemon->ho_ack.first_feed_ns[i])
+            WD_LOG("%s: taken over from pid %" PRIu32 ", feed gap %" PRIu64 " us\n",
+                   WD_DAEMON_DEV_NAME(fdev->dev), msg->pid,
+                   (daemon->ho_ack.first_feed_ns[i] - msg->devs[i].last_feed_ns) / WD_NSEC_PER_USEC);
+        else if (msg->devs[i].flags & WD_HANDOVER_WITHHOLDING)
+            WD_LOG("%s: taken over from pid %" PRIu32 ", keepalive still withheld\n",
+                   WD_DAEMON_DEV_NAME(fdev->dev), msg->pid);
+        else
+            WD_LOG("%s: taken over from pid %" PRIu32 ", but first feed failed\n",
+                   WD_DAEMON_DEV_NAME(fdev->dev), msg->pid);
+    }
+}
+
+static int wd_daemon_handover_init(struct wd_daemon *daemon, const char *path)
+{
+    WD_TRACE("");
+
+    if (wd_handover_listen(&daemon->ho, path))
+        return 1;
+
+    daemon->ho_listen.fd = daemon->ho.fd;
+    daemon->ho_listen.cb = wd_daemon_handover_accept;
+    daemon->ho_listen.arg = daemon;
+
+    daemon->ho_peer.cb = wd_daemon_handover_ack;
+    daemon->ho_peer.arg = daemon;
+
+    daemon->ho_timer.fd = wd_timer_create();
+    if (daemon->ho_timer.fd == -1)
+        return 1;
+
+    daemon->ho_timer.cb = wd_daemon_handover_timeout;
+    daemon->ho_timer.arg = daemon;
+
+    if (wd_loop_add(&daemon->loop, &daemon->ho_timer, EPOLLIN))
+        return 1;
+
+    return wd_loop_add(&daemon->loop, &daemon->ho_listen, EPOLLIN);
+}
+
+static int wd_daemon_handover_start(struct wd_daemon *daemon, int fd)
+{
+    struct wd_handover_msg *msg = &daemon->ho_msg;
+    struct wd_handover_dev *dev;
+    struct wd_feed_dev *fdev;
+    int fds[WD_HANDOVER_MAX_DEVS];
+    uint64_t wait_ns = UINT64_MAX;
+    size_t i;
+
+    WD_TRACE("");
+
+    (void)memset(msg, 0, sizeof(*msg));
+    msg->magic = WD_HANDOVER_MAGIC;
+    msg->version = WD_HANDOVER_VERSION;
+    msg->ndevs = (uint16_t)daemon->nfdevs;
+    msg->pid = (uint32_t)getpid();
+
+    for (i = 0; i < daemon->nfdevs; ++i)
+    {
+        fds[i] = wd_get_fd(daemon->fdevs[i].wd);
+        if (fds[i] == -1)
+        {
+            if (!daemon->rt)
+                WD_LOG("%s: backend has no descriptor, cannot hand over\n", WD_DAEMON_DEV_NAME(daemon->fdevs[i].dev));
+
+            return 1;
+        }
+    }
+
+    /* last feeds, new daemon starts with whole timeout ahead; withheld device is never revived */
+    for (i = 0; i < daemon->nfdevs; ++i)
+    {
+        fdev = &daemon->fdevs[i];
+        dev = &msg->devs[i];
+
+        if (fdev->withholding)
+            dev->flags |= WD_HANDOVER_WITHHOLDING;
+        else if (wd_keepalive(fdev->wd) == 0)
+            ++fdev->feeds;
+        else
+            ++fdev->errors;
+
+        dev->last_feed_ns = wd_time_now_ns();
+        if (fdev->dev)
+            (void)strncpy(dev->dev, fdev->dev, sizeof(dev->dev) - 1);
+
+        dev->feeds = fdev->feeds;
+        dev->errors = fdev->errors;
+        dev->withheld = fdev->withheld;
+        dev->timeout = fdev->timeout;
+
+        if (fdev->sched.period_ns < wait_ns)
+            wait_ns = fdev->sched.period_ns;
+    }
+
+    if (wd_handover_send(fd, msg, fds))
+        return 1;
+
+    /* from now on new daemon feeds, ours resume only if it does not ack in one period */
+    for (i = 0; i < daemon->nfdevs; ++i)
+        (void)wd_timer_arm(daemon->fdevs[i].timer.fd, 0);
+
+    daemon->ho_peer.fd = fd;
+    if (wd_loop_add(&daemon->loop, &daemon->ho_peer, EPOLLIN) ||
+        wd_timer_arm(daemon->ho_timer.fd, wd_time_now_ns() + wait_ns))
+    {
+        daemon->ho_peer.fd = -1;
+        wd_daemon_handover_abort(daemon);
+        return 0;
+    }
+
+    if (!daemon->rt)
+        WD_LOG("Handing %zu devices over\n", daemon->nfdevs);
+
+    return 0;
+}
+
+static void wd_daemon_handover_abort(struct wd_daemon *daemon)
+{
+    struct wd_feed_dev *fdev;
+    uint64_t now;
+    size_t i;
+
+    if (!daemon->rt)
+        WD_LOG("Handover failed, feeding again\n");
+
+    if (daemon->ho_peer.fd != -1)
+    {
+        (void)close(daemon->ho_peer.fd);
+        daemon->ho_peer.fd = -1;
+    }
+
+    (void)wd_timer_arm(daemon->ho_timer.fd, 0);
+    wd_daemon_handover_relisten(daemon);
+
+    for (i = 0; i < daemon->nfdevs; ++i)
+    {
+        fdev = &daemon->fdevs[i];
+
+        /* withheld device only gets its timer back, policy decides on next wakeup */
+        if (!fdev->withholding)
+        {
+            if (wd_keepalive(fdev->wd) == 0)
+                ++fdev->feeds;
+            else
+                ++fdev->errors;
+        }
+
+        now = wd_time_now_ns();
+        fdev->next_ns = wd_sched_next(&fdev->sched, 0, now);
+        (void)wd_timer_arm(fdev->timer.fd, fdev->next_ns);
+    }
+}
+
+/* new daemon which failed to start may have replaced our socket file, next upgrade must find us */
+static void wd_daemon_handover_relisten(struct wd_daemon *daemon)
+{
+    const char *path = daemon->ho.path;
+    struct stat st;
+
+    if (path == NULL || (stat(path, &st) == 0 && st.st_dev == daemon->ho.st_dev && st.st_ino == daemon->ho.st_ino))
+        return;
+
+    wd_handover_unlisten(&daemon->ho);
+    daemon->ho_listen.fd = -1;
+    if (wd_handover_listen(&daemon->ho, path) == 0)
+    {
+        daemon->ho_listen.fd = daemon->ho.fd;
+        (void)wd_loop_add(&daemon->loop, &daemon->ho_listen, EPOLLIN);
+    }
+}
+
+static void wd_daemon_handover_accept(struct wd_event *ev, uint32_t events)
+{
+    struct wd_daemon *daemon = (struct wd_daemon *)ev->arg;
+    int fd;
+
+    (void)events;
+
+    fd = accept4(ev->fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd == -1)
+        return;
+
+    /* one handover at a time, refused daemon sees closed socket */
+    if (daemon->ho_peer.fd != -1 || wd_daemon_handover_start(daemon, fd))
+        (void)close(fd);
+}
+
+static void wd_daemon_handover_ack(struct wd_event *ev, uint32_t events)
+{
+    struct wd_daemon *daemon = (struct wd_daemon *)ev->arg;
+    const struct wd_handover_msg *msg = &daemon->ho_msg;
+    struct wd_handover_ack ack;
+    size_t i;
+
+    (void)events;
+
+    if (ev->fd == -1)
+        return;
+
+    if (wd_handover_recv_ack(ev->fd, &ack) || ack.ndevs != msg->ndevs)
+    {
+        wd_daemon_handover_abort(daemon);
+        return;
+    }
+
+    for (i = 0; i < msg->ndevs && !daemon->rt; ++i)
+        if (ack.first_feed_ns[i])
+            WD_LOG("%s: handed over, feed gap %" PRIu64 " us\n",
+                   WD_DAEMON_DEV_NAME(daemon->fdevs[i].dev),
+                   (ack.first_feed_ns[i] - msg->devs[i].last_feed_ns) / WD_NSEC_PER_USEC);
+
+    /* devices stay open in new daemon, clean stays false so they are released without magic close */
+    (void)close(ev->fd);
+    ev->fd = -1;
+    (void)wd_timer_arm(daemon->ho_timer.fd, 0);
+    wd_loop_stop(&daemon->loop);
+}
+
+static void wd_daemon_handover_timeout(struct wd_event *ev, uint32_t events)
+{
+    struct wd_daemon *daemon = (struct wd_daemon *)ev->arg;
+    uint64_t exp;
+
+    (void)events;
+
+    if (wd_timer_ack(ev->fd, &exp) || exp == 0 || daemon->ho_peer.fd == -1)
+        return;
+
+    wd_daemon_handover_abort(daemon);
+}
+
+static void wd_daemon_dump(const struct wd_daemon *daemon)
+{
+    const struct wd_feed_dev *fdev;
+    const struct wd_sched *sched;
+    const struct wd_stats *stats;
+    const struct wd_check *check;
+    const struct wd_psi_trigger *trigger;
+    struct wd_soft_stats soft;
+    char name[256];
+    size_t i;
+
+    for (i = 0; (check = wd_checks_get(daemon->checks, i)) != NULL; ++i)
+        WD_LOG("check %s: %s runs %" PRIu64 " failures %" PRIu64 " timeouts %" PRIu64
+               " latency p50 %" PRIu64 " us p99 %" PRIu64 " us max %" PRIu64 " us\n",
+               wd_check_name(check, name, sizeof(name)), wd_check_result_name(check->result),
+               check->runs, check->failures, check->timeouts,
+               wd_hist_percentile(&check->latency, 50.0) / WD_NSEC_PER_USEC,
+               wd_hist_percentile(&check->latency, 99.0) / WD_NSEC_PER_USEC,
+               check->latency.max / WD_NSEC_PER_USEC);
+
+    for (i = 0; i < daemon->psi.n; ++i)
+    {
+        trigger = &daemon->psi.triggers[i];
+        WD_LOG("pressure %s: events %" PRIu64 " episodes %" PRIu64 " longest %" PRIu64 " ms\n",
+               wd_psi_name(trigger, name, sizeof(name)), trigger->events, trigger->episodes,
+               trigger->max_ns / WD_NSEC_PER_MSEC);
+    }
+
+    if (daemon->soft != NULL)
+    {
+        wd_soft_ctx_stats(daemon->soft, &soft);
+        WD_LOG("soft timers %" PRIu64 " expired %" PRIu64 " expirations %" PRIu64 " requeues %" PRIu64 "\n",
+               soft.timers, soft.expired, soft.expirations, soft.requeues);
+    }
+
+    if (daemon->conf->uring)
+        WD_LOG("feed batches %" PRIu64 " writes %" PRIu64 " ioctls %" PRIu64 " errors %" PRIu64 " (%s)\n",
+               daemon->ring.batches, daemon->ring.writes, daemon->ring.ioctls, daemon->ring.errors,
+               daemon->ring.fd != -1 ? "io_uring" : "ioctl fallback");
+
+    for (i = 0; i < daemon->nfdevs; ++i)
+    {
+        fdev = &daemon->fdevs[i];
+        sched = &fdev->sched;
+        stats = fdev->stats;
+
+        WD_LOG("%s: feeds %" PRIu64 " errors %" PRIu64 " withheld %" PRIu64 " missed %" PRIu64
+               " wakeups %" PRIu64 " period %" PRIu64 " ms slack %" PRId64 " ms"
+               " min slack %" PRId64 " ms adjustments %" PRIu64 "\n",
+               WD_DAEMON_DEV_NAME(fdev->dev),
+               fdev->feeds, fdev->errors, fdev->withheld, fdev->missed, sched->wakeups,
+               sched->period_ns / WD_NSEC_PER_MSEC,
+               sched->slack_ns / (int64_t)WD_NSEC_PER_MSEC,
+               sched->wakeups ? sched->min_slack_ns / (int64_t)WD_NSEC_PER_MSEC : 0,
+               sched->adjustments);
+
+        if (fdev->sampler.samples && fdev->sampler.has_temp)
+            WD_LOG("%s: temp %d min %d max %d mean %.1f ewma %.1f rate %.1f F/min samples %" PRIu64
+                   " errors %" PRIu64 " period %" PRIu64 " ms\n",
+                   WD_DAEMON_DEV_NAME(fdev->dev), fdev->sampler.temp.last, fdev->sampler.temp.min,
+                   fdev->sampler.temp.max, wd_sample_mean(&fdev->sampler.temp), fdev->sampler.temp.ewma,
+                   fdev->sampler.rate, fdev->sampler.samples, fdev->sampler.errors,
+                   fdev->sampler.period_ns / WD_NSEC_PER_MSEC);
+
+        if (stats == NULL || stats->feeds == 0)
+            continue;
+
+        WD_LOG("%s: near misses %" PRIu64 " jitter p50 %" PRIu64 " us p99 %" PRIu64 " us max %" PRIu64 " us"
+               " keepalive p99 %" PRIu64 " us\n",
+               WD_DAEMON_DEV_NAME(fdev->dev), stats->near_misses,
+               wd_hist_percentile(&stats->jitter, 50.0) / WD_NSEC_PER_USEC,
+               wd_hist_percentile(&stats->jitter, 99.0) / WD_NSEC_PER_USEC,
+               stats->jitter.max / WD_NSEC_PER_USEC,
+               wd_hist_percentile(&stats->ioctl, 99.0) / WD_NSEC_PER_USEC);
+    }
+}
+
+static void wd_daemon_signal(struct wd_event *ev, uint32_t events)
+{
+    struct wd_daemon *daemon = (struct wd_daemon *)ev->arg;
+    struct signalfd_siginfo si;
+
+    (void)events;
+
+    if (read(ev->fd, &si, sizeof(si)) != (ssize_t)sizeof(si))
+        return;
+
+    if (si.ssi_signo == SIGUSR1)
+    {
+        if (!daemon->rt)
+            wd_daemon_dump(daemon);
+
+        return;
+    }
+
+    if (si.ssi_signo == SIGTERM || si.ssi_signo == SIGINT)
+    {
+        daemon->clean = true;
+        wd_loop_stop(&daemon->loop);
+    }
+}
+
+static void wd_daemon_stop(struct wd_event *ev, uint32_t events)
+{
+    struct wd_daemon *daemon = (struct wd_daemon *)ev->arg;
+    uint64_t exp;
+
+    (void)events;
+
+    if (wd_timer_ack(ev->fd, &exp) || exp == 0)
+        return;
+
+    daemon->clean = true;
+    wd_loop_stop(&daemon->loop);
+}
+
+static int wd_daemon_stop_init(struct wd_daemon *daemon, uint64_t run_ns)
+{
+    WD_TRACE("");
+
+    daemon->stop.fd = wd_timer_create();
+    if (daemon->stop.fd == -1)
+        return 1;
+
+    daemon->stop.cb = wd_daemon_stop;
+    daemon->stop.arg = daemon;
+
+    if (wd_timer_arm(daemon->stop.fd, wd_time_now_ns() + run_ns))
+        return 1;
+
+    return wd_loop_add(&daemon->loop, &daemon->stop, EPOLLIN);
+}
+
+static int wd_daemon_selftest_report(const struct wd_rt_usage *start, const struct wd_rt_usage *end, bool selftest)
+{
+    struct wd_rt_usage diff;
+
+    wd_rt_usage_diff(start, end, &diff);
+
+    WD_LOG("Feed loop took %ld minor and %ld major page faults, %ld involuntary and %ld voluntary context switches\n",
+           diff.minflt, diff.majflt, diff.nivcsw, diff.nvcsw);
+
+    if (selftest && (diff.minflt || diff.majflt))
+        WD_ERROR("Self-test failed, feed loop is not free of page faults\n", 1, "");
+
+    return 0;
+}
+
+static void wd_daemon_history(const struct wd_daemon *daemon, const char *path,
+                              const struct wd_history_prev *prev, size_t nprev)
+{
+    struct wd_history history;
+    const struct wd_feed_dev *fdev;
+    const struct wd_history_prev *dev_prev;
+    uint32_t fields;
+    int bootstatus;
+    size_t i;
+    size_t j;
+
+    /* history is a report, feeder runs without it */
+    if (wd_history_open(&history, path, 0))
+        return;
+
+    for (i = 0; i < daemon->nfdevs; ++i)
+    {
+        fdev = &daemon->fdevs[i];
+        fields = WD_HISTORY_HAS_TIMEOUT;
+        if (wd_get_bootstatus(fdev->wd, &bootstatus) == 0)
+            fields |= WD_HISTORY_HAS_BOOTSTATUS;
+        else
+            bootstatus = 0;
+
+        dev_prev = NULL;
+        for (j = 0; j < nprev && dev_prev == NULL; ++j)
+            if (strncmp(prev[j].dev, WD_DAEMON_DEV_NAME(fdev->dev), sizeof(prev[j].dev)) == 0)
+                dev_prev = &prev[j];
+
+        (void)wd_history_record(&history, fdev->dev, fields, bootstatus, fdev->timeout, dev_prev);
+    }
+
+    wd_history_close(&history);
+}
+
+static int wd_daemon_dev_init(struct wd_daemon *daemon, struct wd_feed_dev *fdev, const struct wd_daemon_conf *conf)
+{
+    WD_TRACE("");
+
+    if (fdev->wd == -1)
+    {
+        fdev->wd = wd_open(fdev->dev);
+        if (fdev->wd == -1)
+            return 1;
+    }
+
+    if (wd_get_timeout(fdev->wd, &fdev->timeout) || fdev->timeout == 0)
+        WD_ERROR("%s: Cannot get timeout, feed period unknown\n", 1, WD_DAEMON_DEV_NAME(fdev->dev));
+
+    if (wd_sched_init(&fdev->sched, &conf->sched, fdev->wd, fdev->timeout))
+        return 1;
+
+    fdev->hb = daemon->hb.hdr ? &daemon->hb : NULL;
+    fdev->checks = daemon->checks;
+    fdev->psi = daemon->psi.n ? &daemon->psi : NULL;
+    fdev->stats = &daemon->stats->devs[fdev - daemon->fdevs];
+    wd_stats_dev_init(fdev->stats, WD_DAEMON_DEV_NAME(fdev->dev), fdev->sched.timeout_ns, conf->near_miss_pct);
+
+    fdev->timer.fd = wd_timer_create();
+    if (fdev->timer.fd == -1)
+        return 1;
+
+    fdev->timer.cb = wd_daemon_feed;
+    fdev->timer.arg = fdev;
+    fdev->daemon = daemon;
+
+    if (conf->metrics.listen || conf->metrics.path)
+        fdev->refresh_ns = conf->metrics.interval_ns;
+
+    /* feed at once, device might have been opened long time ago; withholding taken over stays */
+    if (!fdev->withholding && wd_keepalive(fdev->wd))
+        return 1;
+
+    /* first exporter body already has driver state */
+    if (fdev->refresh_ns)
+        (void)wd_daemon_snapshot(fdev, wd_time_now_ns());
+
+    fdev->next_ns = wd_sched_next(&fdev->sched, 0, wd_time_now_ns());
+    if (wd_timer_arm(fdev->timer.fd, fdev->next_ns))
+        return 1;
+
+    if (wd_loop_add(&daemon->loop, &fdev->timer, EPOLLIN))
+        return 1;
+
+    WD_LOG("Feeding %s every %" PRIu64 " ms (timeout %u s, %s)\n",
+           WD_DAEMON_DEV_NAME(fdev->dev), fdev->sched.period_ns / WD_NSEC_PER_MSEC,
+           fdev->timeout, fdev->sched.has_timeleft ? "adaptive" : "fixed");
+
+    return 0;
+}
+
+static int wd_daemon_soft_init(struct wd_daemon *daemon)
+{
+    size_t i;
+
+    WD_TRACE("");
+
+    /* context does not feed, loop feeds every device and asks it for health */
+    daemon->soft = wd_soft_ctx_create(0, -1);
+    if (daemon->soft == NULL)
+        return 1;
+
+    if (wd_soft_ctx_attach(daemon->soft, &daemon->loop))
+        return 1;
+
+    for (i = 0; i < daemon->conf->nsoft; ++i)
+    {
+        daemon->soft_timers[i] = wd_soft_create(daemon->soft, daemon->conf->soft_ns[i], WD_SOFT_CRITICAL, NULL, NULL);
+        if (daemon->soft_timers[i] == NULL)
+            return 1;
+
+        WD_LOG("Soft timer %zu expires when not kicked for %" PRIu64 " ms\n", i, daemon->conf->soft_ns[i] / WD_NSEC_PER_MSEC);
+    }
+
+    return 0;
+}
+
+static int wd_daemon_signal_init(struct wd_daemon *daemon)
+{
+    sigset_t mask;
+
+    WD_TRACE("");
+
+    (void)sigemptyset(&mask);
+    (void)sigaddset(&mask, SIGTERM);
+    (void)sigaddset(&mask, SIGINT);
+    (void)sigaddset(&mask, SIGUSR1);
+
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) == -1)
+        WD_ERROR("Cannot block signals\n", 1, "");
+
+    daemon->sig.fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (daemon->sig.fd == -1)
+        WD_ERROR("Cannot create signalfd\n", 1, "");
+
+    daemon->sig.cb = wd_daemon_signal;
+    daemon->sig.arg = daemon;
+
+    return wd_loop_add(&daemon->loop, &daemon->sig, EPOLLIN);
+}
+
+static int wd_daemon_cleanup(struct wd_daemon *daemon)
+{
+    struct wd_feed_dev *fdev;
+    size_t i;
+    int ret = 0;
+
+    /* samplers outlive notifier, it may still report their last trips */
+    wd_sample_notifier_stop(daemon->notifier);
+
+    for (i = 0; i < daemon->nfdevs; ++i)
+    {
+        fdev = &daemon->fdevs[i];
+        if (fdev->wd != -1)
+        {
+            /* without magic close WD keeps running and resets a box whose feeder died */
+            if (daemon->clean)
+                ret |= wd_close(fdev->wd);
+            else
+                (void)wd_release(fdev->wd);
+        }
+
+        if (fdev->timer.fd != -1)
+            (void)close(fdev->timer.fd);
+
+        wd_sampler_deinit(&fdev->sampler);
+    }
+
+    if (daemon->sig.fd != -1)
+        (void)close(daemon->sig.fd);
+
+    if (daemon->stop.fd != -1)
+        (void)close(daemon->stop.fd);
+
+    /* tick timer leaves loop first */
+    wd_soft_ctx_destroy(daemon->soft);
+    wd_loop_deinit(&daemon->loop);
+    wd_stats_destroy(daemon->stats);
+    wd_hb_registry_destroy(&daemon->hb, false);
+    wd_checks_stop(daemon->checks);
+    wd_psi_deinit(&daemon->psi);
+    wd_ctl_server_deinit(&daemon->ctl);
+    wd_exporter_deinit(&daemon->metrics);
+    wd_uring_deinit(&daemon->ring);
+    wd_handover_unlisten(&daemon->ho);
+
+    if (daemon->ho_peer.fd != -1)
+        (void)close(daemon->ho_peer.fd);
+
+    if (daemon->ho_timer.fd != -1)
+        (void)close(daemon->ho_timer.fd);
+
+    /* init failed before ack, old daemon sees closed socket and keeps feeding */
+    if (daemon->ho_from != -1)
+        (void)close(daemon->ho_from);
+
+    return ret;
+}
+
+void wd_daemon_conf_init(struct wd_daemon_conf *conf)
+{
+    WD_TRACE("");
+
+    if (conf == NULL)
+        return;
+
+    (void)memset(conf, 0, sizeof(*conf));
+    conf->wd = -1;
+    wd_sched_conf_init(&conf->sched);
+    conf->near_miss_pct = WD_STATS_DEFAULT_NEAR_MISS_PCT;
+    wd_rt_conf_init(&conf->rt);
+    conf->psi_hold_ns = WD_PSI_DEFAULT_HOLD_MS * WD_NSEC_PER_MSEC;
+    wd_exporter_conf_init(&conf->metrics);
+    wd_sample_conf_init(&conf->sample);
+}
+
+int wd_daemon_run(const struct wd_daemon_conf *conf)
+{
+    struct wd_daemon daemon;
+    struct wd_rt_usage usage_start;
+    struct wd_rt_usage usage_end;
+    struct wd_history_prev prev[WD_DAEMON_MAX_DEVS];
+    watchdog_t wds[WD_DAEMON_MAX_DEVS];
+    struct wd_sampler *samplers[WD_DAEMON_MAX_DEVS];
+    size_t nprev = 0;
+    size_t i;
+    int ret = 1;
+
+    WD_TRACE("");
+
+    if (conf == NULL)
+        WD_ERROR("conf == NULL\n", 1, "");
+
+    if (conf->ndevs > WD_DAEMON_MAX_DEVS)
+        WD_ERROR("Too many devices, max is %d\n", 1, WD_DAEMON_MAX_DEVS);
+
+    (void)memset(&daemon, 0, sizeof(daemon));
+    daemon.sig.fd = -1;
+    daemon.stop.fd = -1;
+    daemon.ctl.ev.fd = -1;
+    daemon.ho.fd = -1;
+    daemon.ho_peer.fd = -1;
+    daemon.ho_timer.fd = -1;
+    daemon.ho_from = -1;
+    daemon.ring.fd = -1;
+    daemon.conf = conf;
+    daemon.nfdevs = conf->ndevs ? conf->ndevs : 1;
+    for (i = 0; i < WD_DAEMON_MAX_DEVS; ++i)
+    {
+        daemon.fdevs[i].wd = -1;
+        daemon.fdevs[i].dev = i < conf->ndevs ? conf->devs[i] : NULL;
+        daemon.fdevs[i].timer.fd = -1;
+        daemon.fdevs[i].sampler.timer.fd = -1;
+    }
+    daemon.fdevs[0].wd = conf->wd;
+
+    if (wd_loop_init(&daemon.loop))
+        return 1;
+
+    if (wd_daemon_signal_init(&daemon))
+        goto out;
+
+    /* devices of running daemon replace configured ones */
+    if (conf->handover_path && conf->wd == -1 && wd_daemon_takeover(&daemon, conf->handover_path))
+        goto out;
+
+    /* stats file still holds last feeds before reset, take them before it is reused */
+    if (conf->history_path)
+        nprev = wd_history_prev_load(conf->stats_path, prev, WD_DAEMON_MAX_DEVS);
+
+    /* without stats file counters live in anonymous memory, feed path is the same */
+    daemon.stats = wd_stats_create(conf->stats_path, daemon.nfdevs);
+    if (daemon.stats == NULL)
+        goto out;
+
+    /* registry outlives feeder, restarted feeder sees the same clients */
+    if (conf->heartbeat && wd_hb_registry_create(&daemon.hb, conf->hb_shm, 0))
+        goto out;
+
+    /* workers start before RT hardening, they keep normal policy and affinity */
+    if (conf->nchecks)
+    {
+        daemon.checks = wd_checks_start(conf->checks, conf->nchecks, conf->check_workers);
+        if (daemon.checks == NULL)
+            goto out;
+    }
+
+    /* triggers are polled by this loop, feed path only reads their state */
+    if (conf->npsi && wd_psi_init(&daemon.psi, conf->psi, conf->npsi, conf->psi_hold_ns, &daemon.loop))
+        goto out;
+
+    if (conf->nsoft && wd_daemon_soft_init(&daemon))
+        goto out;
+
+    for (i = 0; i < daemon.nfdevs; ++i)
+        if (wd_daemon_dev_init(&daemon, &daemon.fdevs[i], conf))
+            goto out;
+
+    if (conf->history_path)
+        wd_daemon_history(&daemon, conf->history_path, prev, nprev);
+
+    /* devices are open now, ring gets their descriptors as fixed files */
+    if (conf->uring)
+    {
+        for (i = 0; i < daemon.nfdevs; ++i)
+            wds[i] = daemon.fdevs[i].wd;
+
+        if (wd_uring_init(&daemon.ring, wds, daemon.nfdevs))
+            goto out;
+    }
+
+    /* samplers have own timers, feed timers are never shared or delayed by backoff */
+    for (i = 0; conf->sample.enabled && i < daemon.nfdevs; ++i)
+        if (wd_sampler_init(&daemon.fdevs[i].sampler, &conf->sample, daemon.fdevs[i].wd,
+                            WD_DAEMON_DEV_NAME(daemon.fdevs[i].dev), &daemon.loop))
+            goto out;
+
+    /* RT loop only queues trips, logs and hooks run on thread started before RT hardening */
+    if (conf->sample.enabled && wd_rt_enabled(&conf->rt))
+    {
+        for (i = 0; i < daemon.nfdevs; ++i)
+            samplers[i] = &daemon.fdevs[i].sampler;
+
+        daemon.notifier = wd_sample_notifier_start(samplers, daemon.nfdevs);
+        if (daemon.notifier == NULL)
+            goto out;
+    }
+
+    if (conf->run_ns && wd_daemon_stop_init(&daemon, conf->run_ns))
+        goto out;
+
+    /* next upgrade takes devices over from us */
+    if (conf->handover_path && wd_daemon_handover_init(&daemon, conf->handover_path))
+        goto out;
+
+    /* requests are served between feeds, socket I/O never blocks */
+    if (conf->ctl_path && wd_ctl_server_init(&daemon.ctl, conf->ctl_path, &daemon.loop, wd_daemon_ctl, &daemon))
+        goto out;
+
+    /* scrapes get body rendered on exporter timer, never an ioctl */
+    if ((conf->metrics.listen || conf->metrics.path) &&
+        wd_exporter_init(&daemon.metrics, &conf->metrics, daemon.nfdevs, &daemon.loop, wd_daemon_metrics, &daemon))
+        goto out;
+
+    /* everything below runs without heap and stdio until loop ends */
+    daemon.rt = wd_rt_enabled(&conf->rt);
+    if (daemon.rt && wd_rt_apply(&conf->rt))
+        goto out;
+
+    /* init is done, old daemon can stop feeding */
+    if (wd_daemon_takeover_ack(&daemon))
+        goto out;
+
+    if (!daemon.rt)
+        wd_daemon_takeover_log(&daemon);
+
+    if (wd_rt_usage_get(&usage_start))
+        goto out;
+
+    ret = wd_loop_run(&daemon.loop);
+
+    if (daemon.rt)
+        wd_daemon_takeover_log(&daemon);
+
+    if (daemon.broken != NULL)
+    {
+        WD_LOG("%s: cannot rearm feed timer, stopped feeding\n", WD_DAEMON_DEV_NAME(daemon.broken->dev));
+        ret = 1;
+    }
+
+    if (wd_rt_usage_get(&usage_end) == 0 && (daemon.rt || conf->selftest))
+        ret |= wd_daemon_selftest_report(&usage_start, &usage_end, conf->selftest);
+
+    wd_daemon_dump(&daemon);
+
+out:
+    ret |= wd_daemon_cleanup(&daemon);
+
+    return ret;
+}
@@ -0,0 +1,825 @@
+#define _GNU_SOURCE
+#include <wd_exporter.h>
+#include <wd_format.h>
+#include <wd_time.h>
+#include <wd_log.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#define WD_EXPORTER_ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+#define WD_EXPORTER_DEFAULT_HOST    "127.0.0.1"
+#define WD_EXPORTER_CONTENT_TYPE    "text/plain; version=0.0.4; charset=utf-8"
+
+typedef enum
+{
+    WD_EXPORTER_TIMEOUT = 0,
+    WD_EXPORTER_PRETIMEOUT,
+    WD_EXPORTER_TIMELEFT,
+    WD_EXPORTER_TEMP,
+    WD_EXPORTER_SNAP_AGE,
+    WD_EXPORTER_FEEDS,
+    WD_EXPORTER_ERRORS,
+    WD_EXPORTER_WITHHELD,
+    WD_EXPORTER_MISSED,
+    WD_EXPORTER_NEAR_MISSES,
+    WD_EXPORTER_MIN_SLACK,
+    WD_EXPORTER_WITHHOLDING,
+    WD_EXPORTER_METRICS
+} wd_exporter_metric_t;
+
+struct wd_exporter_metric
+{
+    const char  *name;
+    const char  *type;
+    const char  *help;
+    bool        ns;     /* value in ns, printed in seconds */
+};
+
+struct wd_exporter_val
+{
+    int64_t     val;
+    bool        known;
+};
+
+struct wd_exporter_bucket
+{
+    uint64_t    ns;
+    const char  *le;
+};
+
+static const struct wd_exporter_metric wd_exporter_metrics[] =
+{
+    [WD_EXPORTER_TIMEOUT]       = {"watchdog_timeout_seconds", "gauge", "WatchDog timeout", false},
+    [WD_EXPORTER_PRETIMEOUT]    = {"watchdog_pretimeout_seconds", "gauge", "WatchDog pretimeout", false},
+    [WD_EXPORTER_TIMELEFT]      = {"watchdog_timeleft_seconds", "gauge", "Time left before reset at last snapshot", false},
+    [WD_EXPORTER_TEMP]          = {"watchdog_temperature_fahrenheit", "gauge", "Temperature reported by WatchDog", false},
+    [WD_EXPORTER_SNAP_AGE]      = {"watchdog_snapshot_age_seconds", "gauge", "Age of cached snapshot", true},
+    [WD_EXPORTER_FEEDS]         = {"watchdog_feeds_total", "counter", "Successful keepalives", false},
+    [WD_EXPORTER_ERRORS]        = {"watchdog_feed_errors_total", "counter", "Failed keepalives", false},
+    [WD_EXPORTER_WITHHELD]      = {"watchdog_feeds_withheld_total", "counter", "Feeds skipped by heartbeat, check or pressure policy", false},
+    [WD_EXPORTER_MISSED]        = {"watchdog_feed_missed_periods_total", "counter", "Feed periods lost because feeder woke up late", false},
+    [WD_EXPORTER_NEAR_MISSES]   = {"watchdog_feed_near_misses_total", "counter", "Feeds with slack below near miss threshold", false},
+    [WD_EXPORTER_MIN_SLACK]     = {"watchdog_feed_min_slack_seconds", "gauge", "Lowest time left before any feed", true},
+    [WD_EXPORTER_WITHHOLDING]   = {"watchdog_withholding", "gauge", "1 while feed is withheld", false}
+};
+
+/* 1-2.5-5 series from 1 us to 10 s */
+static const struct wd_exporter_bucket wd_exporter_buckets[] =
+{
+    {1000ULL,           "0.000001"},
+    {2500ULL,           "0.0000025"},
+    {5000ULL,           "0.000005"},
+    {10000ULL,          "0.00001"},
+    {25000ULL,          "0.000025"},
+    {50000ULL,          "0.00005"},
+    {100000ULL,         "0.0001"},
+    {250000ULL,         "0.00025"},
+    {500000ULL,         "0.0005"},
+    {1000000ULL,        "0.001"},
+    {2500000ULL,        "0.0025"},
+    {5000000ULL,        "0.005"},
+    {10000000ULL,       "0.01"},
+    {25000000ULL,       "0.025"},
+    {50000000ULL,       "0.05"},
+    {100000000ULL,      "0.1"},
+    {250000000ULL,      "0.25"},
+    {500000000ULL,      "0.5"},
+    {1000000000ULL,     "1"},
+    {2500000000ULL,     "2.5"},
+    {5000000000ULL,     "5"},
+    {10000000000ULL,    "10"}
+};
+
+static void wd_exporter_values(const struct wd_exporter_dev *dev, struct wd_exporter_val *vals);
+static void wd_exporter_seconds(struct wd_fbuf *fb, int64_t ns);
+static void wd_exporter_label(struct wd_fbuf *fb, const char *str, size_t max);
+static void wd_exporter_family(struct wd_fbuf *fb, const char *name, const char *type, const char *help);
+static void wd_exporter_series(struct wd_fbuf *fb, const char *name, const char *suffix, const char *dev);
+static void wd_exporter_counter(struct wd_fbuf *fb, const char *name, const char *help, uint64_t val);
+static void wd_exporter_hist(struct wd_fbuf *fb, const char *name, const char *help, const struct wd_exporter_dev *devs,
+                             size_t n, size_t offset);
+static int wd_exporter_listen(struct wd_exporter *exporter, const char *listen);
+static void wd_exporter_render(struct wd_exporter *exporter);
+static void wd_exporter_textfile(struct wd_exporter *exporter);
+static void wd_exporter_timer(struct wd_event *ev, uint32_t events);
+static void wd_exporter_accept(struct wd_event *ev, uint32_t events);
+static void wd_exporter_client_event(struct wd_event *ev, uint32_t events);
+static void wd_exporter_client_drop(struct wd_exporter_client *client);
+static void wd_exporter_respond(struct wd_exporter_client *client);
+static void wd_exporter_send(struct wd_exporter_client *client);
+
+static void wd_exporter_values(const struct wd_exporter_dev *dev, struct wd_exporter_val *vals)
+{
+    const struct wd_snapshot *snap = dev->snap;
+    const struct wd_stats *stats = dev->stats;
+    size_t i;
+
+    for (i = 0; i < WD_EXPORTER_METRICS; ++i)
+        vals[i].known = false;
+
+    vals[WD_EXPORTER_TIMEOUT] = (struct wd_exporter_val){(int64_t)dev->timeout, dev->timeout != 0};
+    vals[WD_EXPORTER_FEEDS] = (struct wd_exporter_val){(int64_t)dev->feeds, true};
+    vals[WD_EXPORTER_ERRORS] = (struct wd_exporter_val){(int64_t)dev->errors, true};
+    vals[WD_EXPORTER_WITHHELD] = (struct wd_exporter_val){(int64_t)dev->withheld, true};
+    vals[WD_EXPORTER_MISSED] = (struct wd_exporter_val){(int64_t)dev->missed, true};
+    vals[WD_EXPORTER_WITHHOLDING] = (struct wd_exporter_val){dev->withholding ? 1 : 0, true};
+
+    if (snap != NULL)
+    {
+        vals[WD_EXPORTER_PRETIMEOUT] = (struct wd_exporter_val){(int64_t)snap->pretimeout, (snap->valid & WD_SNAP_PRETIMEOUT) != 0};
+        vals[WD_EXPORTER_TIMELEFT] = (struct wd_exporter_val){(int64_t)snap->timeleft, (snap->valid & WD_SNAP_TIMELEFT) != 0};
+        vals[WD_EXPORTER_TEMP] = (struct wd_exporter_val){snap->temp, (snap->valid & WD_SNAP_TEMP) != 0};
+        vals[WD_EXPORTER_SNAP_AGE] = (struct wd_exporter_val){(int64_t)dev->snap_age_ns, true};
+    }
+
+    if (stats != NULL)
+    {
+        vals[WD_EXPORTER_NEAR_MISSES] = (struct wd_exporter_val){(int64_t)stats->near_misses, true};
+        vals[WD_EXPORTER_MIN_SLACK] = (struct wd_exporter_val){stats->min_slack_ns, stats->min_slack_ns != INT64_MAX};
+    }
+}
+
+/* fixed point, no stdio on feeder loop */
+static void wd_exporter_seconds(struct wd_fbuf *fb, int64_t ns)
+{
+    char frac[9];
+    uint64_t mag = ns < 0 ? (uint64_t)0 - (uint64_t)ns : (uint64_t)ns;
+    uint64_t rem = mag % WD_NSEC_PER_SEC;
+    size_t len = sizeof(frac);
+    size_t i;
+
+    if (ns < 0)
+        wd_fbuf_put(fb, "-", 1);
+
+    wd_fbuf_u64(fb, mag / WD_NSEC_PER_SEC);
+    if (rem == 0)
+        return;
+
+    for (i = sizeof(frac); i > 0; --i)
+    {
+        frac[i - 1] = (char)('0' + rem % 10);
+        rem /= 10;
+    }
+
+    while (frac[len - 1] == '0')
+        --len;
+
+    wd_fbuf_put(fb, ".", 1);
+    wd_fbuf_put(fb, frac, len);
+}
+
+static void wd_exporter_label(struct wd_fbuf *fb, const char *str, size_t max)
+{
+    size_t i;
+
+    wd_fbuf_put(fb, "\"", 1);
+    for (i = 0; i < max && str[i] != '\0'; ++i)
+    {
+        if (str[i] == '\\' || str[i] == '"')
+        {
+            wd_fbuf_put(fb, "\\", 1);
+            wd_fbuf_put(fb, &str[i], 1);
+        }
+        else if (str[i] == '\n')
+            wd_fbuf_put(fb, "\\n", 2);
+        else
+            wd_fbuf_put(fb, &str[i], 1);
+    }
+    wd_fbuf_put(fb, "\"", 1);
+}
+
+static void wd_exporter_family(struct wd_fbuf *fb, const char *name, const char *type, const char *help)
+{
+    wd_fbuf_str(fb, "# HELP ");
+    wd_fbuf_str(fb, name);
+    wd_fbuf_str(fb, " ");
+    wd_fbuf_str(fb, help);
+    wd_fbuf_str(fb, "\n# TYPE ");
+    wd_fbuf_str(fb, name);
+    wd_fbuf_str(fb, " ");
+    wd_fbuf_str(fb, type);
+    wd_fbuf_str(fb, "\n");
+}
+
+/* name_suffix{device="dev" - caller adds more labels or closes it */
+static void wd_exporter_series(struct wd_fbuf *fb, const char *name, const char *suffix, const char *dev)
+{
+    wd_fbuf_str(fb, name);
+    wd_fbuf_str(fb, suffix);
+    wd_fbuf_str(fb, "{device=");
+    wd_exporter_label(fb, dev, WD_STATS_DEV_NAME_LEN);
+}
+
+/* counter of exporter itself, no labels */
+static void wd_exporter_counter(struct wd_fbuf *fb, const char *name, const char *help, uint64_t val)
+{
+    wd_exporter_family(fb, name, "counter", help);
+    wd_fbuf_str(fb, name);
+    wd_fbuf_str(fb, " ");
+    wd_fbuf_u64(fb, val);
+    wd_fbuf_str(fb, "\n");
+}
+
+/* hist is found at offset in struct wd_stats, so one function serves every histogram */
+static void wd_exporter_hist(struct wd_fbuf *fb, const char *name, const char *help, const struct wd_exporter_dev *devs,
+                             size_t n, size_t offset)
+{
+    const struct wd_hist *hist;
+    size_t i;
+    size_t j;
+
+    wd_exporter_family(fb, name, "histogram", help);
+
+    for (i = 0; i < n; ++i)
+    {
+        if (devs[i].stats == NULL)
+            continue;
+
+        hist = (const struct wd_hist *)(const void *)((const char *)devs[i].stats + offset);
+        for (j = 0; j < WD_EXPORTER_ARRAY_SIZE(wd_exporter_buckets); ++j)
+        {
+            wd_exporter_series(fb, name, "_bucket", devs[i].dev);
+            wd_fbuf_str(fb, ",le=\"");
+            wd_fbuf_str(fb, wd_exporter_buckets[j].le);
+            wd_fbuf_str(fb, "\"} ");
+            wd_fbuf_u64(fb, wd_hist_count_le(hist, wd_exporter_buckets[j].ns));
+            wd_fbuf_str(fb, "\n");
+        }
+
+        wd_exporter_series(fb, name, "_bucket", devs[i].dev);
+        wd_fbuf_str(fb, ",le=\"+Inf\"} ");
+        wd_fbuf_u64(fb, hist->count);
+        wd_fbuf_str(fb, "\n");
+
+        wd_exporter_series(fb, name, "_sum", devs[i].dev);
+        wd_fbuf_str(fb, "} ");
+        wd_exporter_seconds(fb, (int64_t)wd_hist_sum(hist));
+        wd_fbuf_str(fb, "\n");
+
+        wd_exporter_series(fb, name, "_count", devs[i].dev);
+        wd_fbuf_str(fb, "} ");
+        wd_fbuf_u64(fb, hist->count);
+        wd_fbuf_str(fb, "\n");
+    }
+}
+
+void wd_exporter_format(struct wd_fbuf *fb, const struct wd_exporter_dev *devs, size_t n)
+{
+    struct wd_exporter_val vals[WD_EXPORTER_MAX_DEVS][WD_EXPORTER_METRICS];
+    const struct wd_flag_desc *flags;
+    const struct wd_snapshot *snap;
+    size_t nflags;
+    size_t m;
+    size_t i;
+    size_t j;
+
+    if (fb == NULL || devs == NULL)
+        return;
+
+    if (n > WD_EXPORTER_MAX_DEVS)
+        n = WD_EXPORTER_MAX_DEVS;
+
+    for (i = 0; i < n; ++i)
+        wd_exporter_values(&devs[i], vals[i]);
+
+    /* all series of one family must be together */
+    for (m = 0; m < WD_EXPORTER_METRICS; ++m)
+    {
+        wd_exporter_family(fb, wd_exporter_metrics[m].name, wd_exporter_metrics[m].type, wd_exporter_metrics[m].help);
+
+        for (i = 0; i < n; ++i)
+        {
+            if (!vals[i][m].known)
+                continue;
+
+            wd_exporter_series(fb, wd_exporter_metrics[m].name, "", devs[i].dev);
+            wd_fbuf_str(fb, "} ");
+            if (wd_exporter_metrics[m].ns)
+                wd_exporter_seconds(fb, vals[i][m].val);
+            else
+                wd_fbuf_i64(fb, vals[i][m].val);
+
+            wd_fbuf_str(fb, "\n");
+        }
+    }
+
+    /* capability bits never mean reset cause, only status bits are exported */
+    flags = wd_format_flag_table(&nflags);
+    wd_exporter_family(fb, "watchdog_bootstatus", "gauge", "Cause of last reset, one series per WDIOF flag");
+    for (i = 0; i < n; ++i)
+    {
+        snap = devs[i].snap;
+        if (snap == NULL || !(snap->valid & WD_SNAP_BOOTSTATUS))
+            continue;
+
+        for (j = 0; j < nflags; ++j)
+        {
+            if (flags[j].flag >= WDIOF_SETTIMEOUT)
+                continue;
+
+            wd_exporter_series(fb, "watchdog_bootstatus", "", devs[i].dev);
+            wd_fbuf_str(fb, ",flag=\"");
+            wd_fbuf_str(fb, flags[j].name);
+            wd_fbuf_str(fb, (snap->bootstatus & flags[j].flag) ? "\"} 1\n" : "\"} 0\n");
+        }
+    }
+
+    wd_exporter_family(fb, "watchdog_info", "gauge", "WatchDog driver identity");
+    for (i = 0; i < n; ++i)
+    {
+        snap = devs[i].snap;
+        if (snap == NULL || !(snap->valid & WD_SNAP_INFO))
+            continue;
+
+        wd_exporter_series(fb, "watchdog_info", "", devs[i].dev);
+        wd_fbuf_str(fb, ",identity=");
+        wd_exporter_label(fb, (const char *)snap->info.identity, sizeof(snap->info.identity));
+        wd_fbuf_str(fb, ",firmware_version=\"");
+        wd_fbuf_u64(fb, snap->info.firmware_version);
+        wd_fbuf_str(fb, "\"} 1\n");
+    }
+
+    wd_exporter_hist(fb, "watchdog_feed_jitter_seconds", "Feeder wakeup delay after scheduled feed time",
+                     devs, n, offsetof(struct wd_stats, jitter));
+    wd_exporter_hist(fb, "watchdog_keepalive_duration_seconds", "Keepalive ioctl duration",
+                     devs, n, offsetof(struct wd_stats, ioctl));
+}
+
+static void wd_exporter_render(struct wd_exporter *exporter)
+{
+    struct wd_fbuf fb;
+    size_t n;
+
+    n = exporter->source(exporter->arg, exporter->devs, WD_EXPORTER_ARRAY_SIZE(exporter->devs));
+
+    wd_fbuf_init(&fb, exporter->body, exporter->size);
+    wd_exporter_format(&fb, exporter->devs, n);
+
+    ++exporter->renders;
+    wd_exporter_counter(&fb, "watchdog_exporter_scrapes_total", "Scrapes answered", exporter->scrapes);
+    wd_exporter_counter(&fb, "watchdog_exporter_dropped_clients_total", "Bad, slow or excess clients dropped",
+                        exporter->dropped);
+    wd_exporter_counter(&fb, "watchdog_exporter_failures_total", "Body overflows and textfile write failures",
+                        exporter->failures);
+
+    if (fb.overflow)
+    {
+        ++exporter->failures;
+        exporter->len = 0;
+        return;
+    }
+
+    exporter->len = fb.len;
+}
+
+static void wd_exporter_textfile(struct wd_exporter *exporter)
+{
+    ssize_t ret;
+    size_t off = 0;
+    int fd;
+
+    if (exporter->len == 0)
+        return;
+
+    fd = open(exporter->tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+    {
+        ++exporter->failures;
+        return;
+    }
+
+    while (off < exporter->len)
+    {
+        ret = write(fd, exporter->body + off, exporter->len - off);
+        if (ret == -1 && errno == EINTR)
+            continue;
+
+        if (ret <= 0)
+            break;
+
+        off += (size_t)ret;
+    }
+
+    /* collector reads whole old or whole new file, never a mix */
+    if (close(fd) == -1 || off != exporter->len || rename(exporter->tmp_path, exporter->path) == -1)
+    {
+        ++exporter->failures;
+        (void)unlink(exporter->tmp_path);
+    }
+}
+
+static void wd_exporter_timer(struct wd_event *ev, uint32_t events)
+{
+    struct wd_exporter *exporter = (struct wd_exporter *)ev->arg;
+    struct wd_exporter_client *client;
+    const uint64_t now = wd_time_now_ns();
+    uint64_t exp;
+    bool busy = false;
+    size_t i;
+
+    (void)events;
+
+    if (wd_timer_ack(ev->fd, &exp) || exp == 0)
+        return;
+
+    (void)wd_timer_arm(ev->fd, now + exporter->interval_ns);
+
+    for (i = 0; i < WD_EXPORTER_ARRAY_SIZE(exporter->clients); ++i)
+    {
+        client = &exporter->clients[i];
+        if (client->ev.fd == -1)
+            continue;
+
+        if (now - client->since_ns > exporter->interval_ns)
+        {
+            ++exporter->dropped;
+            wd_exporter_client_drop(client);
+        }
+        else if (client->sending && client->body == exporter->body)
+            busy = true;
+    }
+
+    /* client in the middle of old body, next tick renders */
+    if (busy)
+        return;
+
+    wd_exporter_render(exporter);
+
+    if (exporter->path)
+        wd_exporter_textfile(exporter);
+}
+
+static void wd_exporter_client_drop(struct wd_exporter_client *client)
+{
+    (void)close(client->ev.fd);
+    client->ev.fd = -1;
+    client->sending = false;
+}
+
+static void wd_exporter_send(struct wd_exporter_client *client)
+{
+    struct iovec iov[2];
+    struct msghdr msg;
+    size_t total = client->hdr_len + client->body_len;
+    ssize_t ret;
+
+    while (client->off < total)
+    {
+        (void)memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        if (client->off < client->hdr_len)
+        {
+            iov[0].iov_base = client->hdr + client->off;
+            iov[0].iov_len = client->hdr_len - client->off;
+            iov[1].iov_base = (void *)(uintptr_t)client->body;
+            iov[1].iov_len = client->body_len;
+            msg.msg_iovlen = 2;
+        }
+        else
+        {
+            iov[0].iov_base = (void *)(uintptr_t)(client->body + client->off - client->hdr_len);
+            iov[0].iov_len = total - client->off;
+            msg.msg_iovlen = 1;
+        }
+
+        ret = sendmsg(client->ev.fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (ret == -1 && errno == EINTR)
+            continue;
+
+        if (ret == -1 && errno == EAGAIN)
+        {
+            /* rest goes out when socket drains, loop never waits for client */
+            if (wd_loop_mod(client->exporter->loop, &client->ev, EPOLLOUT))
+                break;
+
+            return;
+        }
+
+        if (ret <= 0)
+            break;
+
+        client->off += (size_t)ret;
+    }
+
+    if (client->off < total)
+        ++client->exporter->dropped;
+
+    wd_exporter_client_drop(client);
+}
+
+static void wd_exporter_respond(struct wd_exporter_client *client)
+{
+    static const char not_found[] = "Not found, try /metrics\n";
+    static const char unavailable[] = "Metrics not rendered yet\n";
+    struct wd_exporter *exporter = client->exporter;
+    const char *status = "200 OK";
+    struct wd_fbuf fb;
+    bool head;
+
+    head = strncmp(client->req, "HEAD ", 5) == 0;
+    if (strncmp(client->req, "GET ", 4) != 0 && !head)
+    {
+        ++exporter->dropped;
+        wd_exporter_client_drop(client);
+        return;
+    }
+
+    client->body = exporter->body;
+    client->body_len = exporter->len;
+
+    if (strncmp(client->req + (head ? 5 : 4), "/metrics ", 9) != 0 &&
+        strncmp(client->req + (head ? 5 : 4), "/ ", 2) != 0)
+    {
+        status = "404 Not Found";
+        client->body = not_found;
+        client->body_len = sizeof(not_found) - 1;
+    }
+    else if (exporter->len == 0)
+    {
+        status = "503 Service Unavailable";
+        client->body = unavailable;
+        client->body_len = sizeof(unavailable) - 1;
+    }
+    else
+        ++exporter->scrapes;
+
+    wd_fbuf_init(&fb, client->hdr, sizeof(client->hdr));
+    wd_fbuf_str(&fb, "HTTP/1.1 ");
+    wd_fbuf_str(&fb, status);
+    wd_fbuf_str(&fb, "\r\nContent-Type: " WD_EXPORTER_CONTENT_TYPE "\r\nContent-Length: ");
+    wd_fbuf_u64(&fb, client->body_len);
+    wd_fbuf_str(&fb, "\r\nConnection: close\r\n\r\n");
+
+    client->hdr_len = fb.len;
+    client->off = 0;
+    client->sending = true;
+
+    if (head)
+        client->body_len = 0;
+
+    wd_exporter_send(client);
+}
+
+static void wd_exporter_client_event(struct wd_event *ev, uint32_t events)
+{
+    struct wd_exporter_client *client = (struct wd_exporter_client *)ev->arg;
+    ssize_t len;
+
+    /* slot was dropped earlier in the same dispatch */
+    if (ev->fd == -1)
+        return;
+
+    if (client->sending)
+    {
+        if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+            wd_exporter_send(client);
+
+        return;
+    }
+
+    if (events & EPOLLIN)
+    {
+        len = recv(ev->fd, client->req + client->rlen, sizeof(client->req) - 1 - client->rlen, MSG_DONTWAIT);
+        if (len == -1 && (errno == EAGAIN || errno == EINTR))
+            return;
+
+        if (len <= 0)
+        {
+            wd_exporter_client_drop(client);
+            return;
+        }
+
+        client->rlen += (size_t)len;
+        client->req[client->rlen] = '\0';
+
+        /* whole head is needed, request body is never expected */
+        if (strstr(client->req, "\r\n\r\n") != NULL || strstr(client->req, "\n\n") != NULL)
+            wd_exporter_respond(client);
+        else if (client->rlen == sizeof(client->req) - 1)
+        {
+            ++client->exporter->dropped;
+            wd_exporter_client_drop(client);
+        }
+
+        return;
+    }
+
+    if (events & (EPOLLHUP | EPOLLERR))
+        wd_exporter_client_drop(client);
+}
+
+static void wd_exporter_accept(struct wd_event *ev, uint32_t events)
+{
+    struct wd_exporter *exporter = (struct wd_exporter *)ev->arg;
+    struct wd_exporter_client *client = NULL;
+    size_t i;
+    int fd;
+
+    (void)events;
+
+    fd = accept4(ev->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd == -1)
+        return;
+
+    for (i = 0; i < WD_EXPORTER_ARRAY_SIZE(exporter->clients); ++i)
+        if (exporter->clients[i].ev.fd == -1)
+        {
+            client = &exporter->clients[i];
+            break;
+        }
+
+    if (client == NULL)
+    {
+        ++exporter->dropped;
+        (void)close(fd);
+        return;
+    }
+
+    client->ev.fd = fd;
+    client->since_ns = wd_time_now_ns();
+    client->rlen = 0;
+    client->sending = false;
+    if (wd_loop_add(exporter->loop, &client->ev, EPOLLIN))
+        wd_exporter_client_drop(client);
+}
+
+static int wd_exporter_listen(struct wd_exporter *exporter, const char *listen_addr)
+{
+    char host[256];
+    const char *port;
+    const char *sep;
+    struct addrinfo hints;
+    struct addrinfo *res;
+    size_t len;
+    int one = 1;
+
+    /* PORT, HOST:PORT or [HOST]:PORT */
+    sep = strrchr(listen_addr, ':');
+    if (sep == NULL)
+    {
+        (void)strcpy(host, WD_EXPORTER_DEFAULT_HOST);
+        port = listen_addr;
+    }
+    else
+    {
+        len = (size_t)(sep - listen_addr);
+        if (len >= 2 && listen_addr[0] == '[' && listen_addr[len - 1] == ']')
+        {
+            ++listen_addr;
+            len -= 2;
+        }
+
+        if (len == 0 || len >= sizeof(host))
+            WD_ERROR("Metrics address %s is incorrect\n", 1, listen_addr);
+
+        (void)memcpy(host, listen_addr, len);
+        host[len] = '\0';
+        port = sep + 1;
+    }
+
+    (void)memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV | AI_PASSIVE;
+
+    if (getaddrinfo(host, port, &hints, &res) != 0)
+        WD_ERROR("Metrics address %s:%s is incorrect\n", 1, host, port);
+
+    exporter->ev.fd = socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (exporter->ev.fd == -1)
+    {
+        freeaddrinfo(res);
+        WD_ERROR("Cannot create metrics socket\n", 1, "");
+    }
+
+    /* restarted feeder binds again while old connections are in TIME_WAIT */
+    (void)setsockopt(exporter->ev.fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    if (bind(exporter->ev.fd, res->ai_addr, res->ai_addrlen) == -1 ||
+        listen(exporter->ev.fd, WD_EXPORTER_MAX_CLIENTS) == -1)
+    {
+        freeaddrinfo(res);
+        WD_ERROR("Cannot listen on metrics address %s:%s\n", 1, host, port);
+    }
+
+    freeaddrinfo(res);
+
+    exporter->ev.cb = wd_exporter_accept;
+    exporter->ev.arg = exporter;
+
+    if (wd_loop_add(exporter->loop, &exporter->ev, EPOLLIN))
+        return 1;
+
+    WD_LOG("Serving metrics on %s:%s\n", host, port);
+
+    return 0;
+}
+
+void wd_exporter_conf_init(struct wd_exporter_conf *conf)
+{
+    WD_TRACE("");
+
+    if (conf == NULL)
+        return;
+
+    (void)memset(conf, 0, sizeof(*conf));
+    conf->interval_ns = WD_EXPORTER_DEFAULT_INTERVAL_MS * WD_NSEC_PER_MSEC;
+}
+
+int wd_exporter_init(struct wd_exporter *exporter, const struct wd_exporter_conf *conf, size_t ndevs,
+                     struct wd_loop *loop, wd_exporter_source_t source, void *arg)
+{
+    size_t i;
+
+    WD_TRACE("");
+
+    if (exporter == NULL || conf == NULL || loop == NULL || source == NULL)
+        WD_ERROR("exporter == NULL || conf == NULL || loop == NULL || source == NULL\n", 1, "");
+
+    if (conf->listen == NULL && conf->path == NULL)
+        WD_ERROR("Neither metrics address nor textfile is given\n", 1, "");
+
+    if (ndevs == 0 || ndevs > WD_EXPORTER_MAX_DEVS || conf->interval_ns == 0)
+        WD_ERROR("ndevs == 0 || ndevs > %d || interval == 0\n", 1, WD_EXPORTER_MAX_DEVS);
+
+    (void)memset(exporter, 0, sizeof(*exporter));
+    exporter->ev.fd = -1;
+    exporter->timer.fd = -1;
+    exporter->loop = loop;
+    exporter->interval_ns = conf->interval_ns;
+    exporter->source = source;
+    exporter->arg = arg;
+    exporter->path = conf->path;
+
+    for (i = 0; i < WD_EXPORTER_ARRAY_SIZE(exporter->clients); ++i)
+    {
+        exporter->clients[i].ev.fd = -1;
+        exporter->clients[i].ev.cb = wd_exporter_client_event;
+        exporter->clients[i].ev.arg = &exporter->clients[i];
+        exporter->clients[i].exporter = exporter;
+    }
+
+    if (conf->path && snprintf(exporter->tmp_path, sizeof(exporter->tmp_path), "%s.tmp", conf->path) >=
+                      (int)sizeof(exporter->tmp_path))
+        WD_ERROR("Metrics textfile path %s is too long\n", 1, conf->path);
+
+    /* loop may run without heap, body is allocated once here */
+    exporter->size = WD_EXPORTER_BODY_SIZE(ndevs);
+    exporter->body = malloc(exporter->size);
+    if (exporter->body == NULL)
+        WD_ERROR("Cannot allocate metrics body\n", 1, "");
+
+    if (conf->listen && wd_exporter_listen(exporter, conf->listen))
+        return 1;
+
+    exporter->timer.fd = wd_timer_create();
+    if (exporter->timer.fd == -1)
+        return 1;
+
+    exporter->timer.cb = wd_exporter_timer;
+    exporter->timer.arg = exporter;
+
+    wd_exporter_render(exporter);
+    if (exporter->path)
+        wd_exporter_textfile(exporter);
+
+    if (wd_timer_arm(exporter->timer.fd, wd_time_now_ns() + exporter->interval_ns))
+        return 1;
+
+    return wd_loop_add(loop, &exporter->timer, EPOLLIN);
+}
+
+void wd_exporter_deinit(struct wd_exporter *exporter)
+{
+    size_t i;
+
+    WD_TRACE("");
+
+    if (exporter == NULL || exporter->loop == NULL)
+        return;
+
+    for (i = 0; i < WD_EXPORTER_ARRAY_SIZE(exporter->clients); ++i)
+        if (exporter->clients[i].ev.fd != -1)
+            wd_exporter_client_drop(&exporter->clients[i]);
+
+    if (exporter->ev.fd != -1)
+        (void)close(exporter->ev.fd);
+
+    if (exporter->timer.fd != -1)
+        (void)close(exporter->timer.fd);
+
+    free(exporter->body);
+    exporter->body = NULL;
+    exporter->ev.fd = -1;
+    exporter->timer.fd = -1;
+    exporter->loop = NULL;
+}
@@ -0,0 +1,445 @@
+#include <wd_format.h>
+#include <wd_log.h>
+#include <common.h>
+#include <string.h>
+
+#define WD_FORMAT_ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+struct wd_field_desc
+{
+    unsigned int    field;
+    const char      *name;
+};
+
+static const struct wd_flag_desc wd_flags[] =
+{
+    {WDIOF_OVERHEAT,        "OVERHEAT",         "Reset due to CPU overheat"},
+    {WDIOF_FANFAULT,        "FANFAULT",         "Fan failed"},
+    {WDIOF_EXTERN1,         "EXTERN1",          "External relay 1"},
+    {WDIOF_EXTERN2,         "EXTERN2",          "External relay 2"},
+    {WDIOF_POWERUNDER,      "POWERUNDER",       "Power bad/power fault"},
+    {WDIOF_CARDRESET,       "CARDRESET",        "Card previously reset the CPU"},
+    {WDIOF_POWEROVER,       "POWEROVER",        "Power over voltage"},
+    {WDIOF_SETTIMEOUT,      "SETTIMEOUT",       "Set timeout (in seconds)"},
+    {WDIOF_MAGICCLOSE,      "MAGICCLOSE",       "Supports magic close char"},
+    {WDIOF_PRETIMEOUT,      "PRETIMEOUT",       "Pretimeout (in seconds), get/set"},
+    {WDIOF_ALARMONLY,       "ALARMONLY",        "Watchdog triggers external alarm not a reboot"},
+    {WDIOF_KEEPALIVEPING,   "KEEPALIVEPING",    "Keep alive ping reply"}
+};
+
+static const struct wd_field_desc wd_fields[] =
+{
+    {WD_SNAP_TIMEOUT,       "timeout"},
+    {WD_SNAP_PRETIMEOUT,    "pretimeout"},
+    {WD_SNAP_TIMELEFT,      "timeleft"},
+    {WD_SNAP_BOOTSTATUS,    "bootstatus"},
+    {WD_SNAP_STATUS,        "status"},
+    {WD_SNAP_TEMP,          "temp"},
+    {WD_SNAP_INFO,          "info"}
+};
+
+static const char *const wd_format_names[] =
+{
+    [WD_FORMAT_TEXT]    = "text",
+    [WD_FORMAT_JSON]    = "json",
+    [WD_FORMAT_KV]      = "kv",
+    [WD_FORMAT_BIN]     = "bin"
+};
+
+static void wd_format_json_flags(struct wd_fbuf *fb, const char *key, int flag);
+static void wd_format_json_key(struct wd_fbuf *fb, const char *key, bool *first);
+static void wd_format_kv_key(struct wd_fbuf *fb, const char *key);
+static void wd_format_json(struct wd_fbuf *fb, const struct wd_snapshot *snap);
+static void wd_format_kv(struct wd_fbuf *fb, const struct wd_snapshot *snap);
+
+void wd_fbuf_init(struct wd_fbuf *fb, char *buf, size_t size)
+{
+    fb->buf = buf;
+    fb->size = size;
+    fb->len = 0;
+    fb->overflow = false;
+}
+
+void wd_fbuf_put(struct wd_fbuf *fb, const void *data, size_t len)
+{
+    if (fb->overflow || fb->size - fb->len < len)
+    {
+        fb->overflow = true;
+        return;
+    }
+
+    (void)memcpy(fb->buf + fb->len, data, len);
+    fb->len += len;
+}
+
+void wd_fbuf_str(struct wd_fbuf *fb, const char *str)
+{
+    wd_fbuf_put(fb, str, strlen(str));
+}
+
+void wd_fbuf_u64(struct wd_fbuf *fb, uint64_t val)
+{
+    char tmp[20];
+    size_t i = sizeof(tmp);
+
+    do
+    {
+        tmp[--i] = (char)('0' + val % 10);
+        val /= 10;
+    } while (val);
+
+    wd_fbuf_put(fb, tmp + i, sizeof(tmp) - i);
+}
+
+void wd_fbuf_i64(struct wd_fbuf *fb, int64_t val)
+{
+    if (val < 0)
+    {
+        wd_fbuf_put(fb, "-", 1);
+        wd_fbuf_u64(fb, (uint64_t)0 - (uint64_t)val);
+        return;
+    }
+
+    wd_fbuf_u64(fb, (uint64_t)val);
+}
+
+void wd_fbuf_hex(struct wd_fbuf *fb, uint64_t val)
+{
+    static const char digits[] = "0123456789abcdef";
+    char tmp[18];
+    size_t i = sizeof(tmp);
+
+    do
+    {
+        tmp[--i] = digits[val & 0xf];
+        val >>= 4;
+    } while (val);
+
+    tmp[--i] = 'x';
+    tmp[--i] = '0';
+
+    wd_fbuf_put(fb, tmp + i, sizeof(tmp) - i);
+}
+
+void wd_fbuf_quoted(struct wd_fbuf *fb, const char *str, size_t max)
+{
+    static const char digits[] = "0123456789abcdef";
+    char esc[6] = {'\\', 'u', '0', '0', '0', '0'};
+    size_t i;
+    unsigned char c;
+
+    wd_fbuf_put(fb, "\"", 1);
+    for (i = 0; i < max && str[i] != '\0'; ++i)
+    {
+        c = (unsigned char)str[i];
+        if (c == '"' || c == '\\')
+        {
+            esc[1] = (char)c;
+            wd_fbuf_put(fb, esc, 2);
+            esc[1] = 'u';
+        }
+        else if (c < 0x20)
+        {
+            esc[4] = digits[c >> 4];
+            esc[5] = digits[c & 0xf];
+            wd_fbuf_put(fb, esc, sizeof(esc));
+        }
+        else
+            wd_fbuf_put(fb, &str[i], 1);
+    }
+    wd_fbuf_put(fb, "\"", 1);
+}
+
+const struct wd_flag_desc *wd_format_flag_table(size_t *n)
+{
+    if (n != NULL)
+        *n = WD_FORMAT_ARRAY_SIZE(wd_flags);
+
+    return wd_flags;
+}
+
+int wd_format_parse(const char *str, wd_format_t *fmt)
+{
+    size_t i;
+
+    WD_TRACE("");
+
+    if (str == NULL || fmt == NULL)
+        WD_ERROR("str == NULL || fmt == NULL\n", 1, "");
+
+    for (i = 0; i < WD_FORMAT_ARRAY_SIZE(wd_format_names); ++i)
+        if (strcmp(str, wd_format_names[i]) == 0)
+        {
+            *fmt = (wd_format_t)i;
+            return 0;
+        }
+
+    WD_ERROR("Unknown format %s\n", 1, str);
+}
+
+ssize_t wd_format_flags(char *buf, size_t size, int flag, char sep)
+{
+    struct wd_fbuf fb;
+    size_t i;
+    bool first = true;
+
+    wd_fbuf_init(&fb, buf, size);
+    if (flag == WDIOF_UNKNOWN)
+        wd_fbuf_str(&fb, "UNKNOWN");
+    else
+        for (i = 0; i < WD_FORMAT_ARRAY_SIZE(wd_flags); ++i)
+            if (GET_FLAG(flag, wd_flags[i].flag))
+            {
+                if (!first)
+                    wd_fbuf_put(&fb, &sep, 1);
+
+                wd_fbuf_str(&fb, wd_flags[i].name);
+                first = false;
+            }
+
+    return fb.overflow ? -1 : (ssize_t)fb.len;
+}
+
+static void wd_format_json_key(struct wd_fbuf *fb, const char *key, bool *first)
+{
+    if (!*first)
+        wd_fbuf_put(fb, ",", 1);
+
+    *first = false;
+    wd_fbuf_put(fb, "\"", 1);
+    wd_fbuf_str(fb, key);
+    wd_fbuf_put(fb, "\":", 2);
+}
+
+static void wd_format_json_flags(struct wd_fbuf *fb, const char *key, int flag)
+{
+    size_t i;
+    bool first = true;
+
+    wd_fbuf_put(fb, ",\"", 2);
+    wd_fbuf_str(fb, key);
+    wd_fbuf_str(fb, "_flags\":[");
+    for (i = 0; i < WD_FORMAT_ARRAY_SIZE(wd_flags); ++i)
+        if (flag != WDIOF_UNKNOWN && GET_FLAG(flag, wd_flags[i].flag))
+        {
+            if (!first)
+                wd_fbuf_put(fb, ",", 1);
+
+            first = false;
+            wd_fbuf_quoted(fb, wd_flags[i].name, strlen(wd_flags[i].name));
+        }
+    wd_fbuf_put(fb, "]", 1);
+}
+
+static void wd_format_json(struct wd_fbuf *fb, const struct wd_snapshot *snap)
+{
+    size_t i;
+    bool first = true;
+    bool first_field = true;
+
+    wd_fbuf_put(fb, "{", 1);
+    wd_format_json_key(fb, "timestamp_ns", &first);
+    wd_fbuf_u64(fb, snap->timestamp_ns);
+
+    if (GET_FLAG(snap->valid, WD_SNAP_TIMEOUT))
+    {
+        wd_format_json_key(fb, "timeout", &first);
+        wd_fbuf_u64(fb, snap->timeout);
+    }
+
+    if (GET_FLAG(snap->valid, WD_SNAP_PRETIMEOUT))
+    {
+        wd_format_json_key(fb, "pretimeout", &first);
+        wd_fbuf_u64(fb, snap->pretimeout);
+    }
+
+    if (GET_FLAG(snap->valid, WD_SNAP_TIMELEFT))
+    {
+        wd_format_json_key(fb, "timeleft", &first);
+        wd_fbuf_u64(fb, snap->timeleft);
+    }
+
+    if (GET_FLAG(snap->valid, WD_SNAP_BOOTSTATUS))
+    {
+        wd_format_json_key(fb, "bootstatus", &first);
+        wd_fbuf_i64(fb, snap->bootstatus);
+        wd_format_json_flags(fb, "bootstatus", snap->bootstatus);
+    }
+
+    if (GET_FLAG(snap->valid, WD_SNAP_STATUS))
+    {
+        wd_format_json_key(fb, "status", &first);
+        wd_fbuf_i64(fb, snap->status);
+        wd_format_json_flags(fb, "status", snap->status);
+    }
+
+    if (GET_FLAG(snap->valid, WD_SNAP_TEMP))
+    {
+        wd_format_json_key(fb, "temp", &first);
+        wd_fbuf_i64(fb, snap->temp);
+    }
+
+    if (GET_FLAG(snap->valid, WD_SNAP_INFO))
+    {
+        wd_format_json_key(fb, "identity", &first);
+        wd_fbuf_quoted(fb, (const char *)snap->info.identity, sizeof(snap->info.identity));
+        wd_format_json_key(fb, "firmware_version", &first);
+        wd_fbuf_u64(fb, snap->info.firmware_version);
+        wd_format_json_key(fb, "options", &first);
+        wd_fbuf_u64(fb, snap->info.options);
+        wd_format_json_flags(fb, "options", (int)snap->info.options);
+    }
+
+    wd_format_json_key(fb, "unsupported", &first);
+    wd_fbuf_put(fb, "[", 1);
+    for (i = 0; i < WD_FORMAT_ARRAY_SIZE(wd_fields); ++i)
+        if (GET_FLAG(snap->unsupported, wd_fields[i].field))
+        {
+            if (!first_field)
+                wd_fbuf_put(fb, ",", 1);
+
+            first_field = false;
+            wd_fbuf_quoted(fb, wd_fields[i].name, strlen(wd_fields[i].name));
+        }
+    wd_fbuf_str(fb, "]}\n");
+}
+
+static void wd_format_kv_key(struct wd_fbuf *fb, const char *key)
+{
+    wd_fbuf_str(fb, key);
+    wd_fbuf_put(fb, "=", 1);
+}
+
+static void wd_format_kv(struct wd_fbuf *fb, const struct wd_snapshot *snap)
+{
+    ssize_t len;
+    size_t i;
+
+    wd_format_kv_key(fb, "timestamp_ns");
+    wd_fbuf_u64(fb, snap->timestamp_ns);
+    wd_fbuf_put(fb, "\n", 1);
+
+    for (i = 0; i < WD_FORMAT_ARRAY_SIZE(wd_fields); ++i)
+    {
+        if (!GET_FLAG(snap->valid, wd_fields[i].field))
+            continue;
+
+        switch (wd_fields[i].field)
+        {
+            case WD_SNAP_TIMEOUT:
+            {
+                wd_format_kv_key(fb, wd_fields[i].name);
+                wd_fbuf_u64(fb, snap->timeout);
+                break;
+            }
+            case WD_SNAP_PRETIMEOUT:
+            {
+                wd_format_kv_key(fb, wd_fields[i].name);
+                wd_fbuf_u64(fb, snap->pretimeout);
+                break;
+            }
+            case WD_SNAP_TIMELEFT:
+            {
+                wd_format_kv_key(fb, wd_fields[i].name);
+                wd_fbuf_u64(fb, snap->timeleft);
+                break;
+            }
+            case WD_SNAP_TEMP:
+            {
+                wd_format_kv_key(fb, wd_fields[i].name);
+                wd_fbuf_i64(fb, snap->temp);
+                break;
+            }
+            case WD_SNAP_BOOTSTATUS:
+            case WD_SNAP_STATUS:
+            {
+                wd_format_kv_key(fb, wd_fields[i].name);
+                wd_fbuf_hex(fb, (uint32_t)(wd_fields[i].field == WD_SNAP_STATUS ? snap->status : snap->bootstatus));
+                wd_fbuf_put(fb, "\n", 1);
+                wd_fbuf_str(fb, wd_fields[i].name);
+                wd_format_kv_key(fb, "_flags");
+                len = wd_format_flags(fb->buf + fb->len, fb->size - fb->len,
+                                      wd_fields[i].field == WD_SNAP_STATUS ? snap->status : snap->bootstatus, ',');
+                if (len < 0)
+                    fb->overflow = true;
+                else
+                    fb->len += (size_t)len;
+                break;
+            }
+            case WD_SNAP_INFO:
+            {
+                wd_format_kv_key(fb, "identity");
+                wd_fbuf_quoted(fb, (const char *)snap->info.identity, sizeof(snap->info.identity));
+                wd_fbuf_put(fb, "\n", 1);
+                wd_format_kv_key(fb, "firmware_version");
+                wd_fbuf_u64(fb, snap->info.firmware_version);
+                wd_fbuf_put(fb, "\n", 1);
+                wd_format_kv_key(fb, "options");
+                wd_fbuf_hex(fb, snap->info.options);
+                wd_fbuf_put(fb, "\n", 1);
+                wd_format_kv_key(fb, "options_flags");
+                len = wd_format_flags(fb->buf + fb->len, fb->size - fb->len, (int)snap->info.options, ',');
+                if (len < 0)
+                    fb->overflow = true;
+                else
+                    fb->len += (size_t)len;
+                break;
+            }
+            default:
+                break;
+        }
+
+        wd_fbuf_put(fb, "\n", 1);
+    }
+
+    for (i = 0; i < WD_FORMAT_ARRAY_SIZE(wd_fields); ++i)
+        if (GET_FLAG(snap->unsupported, wd_fields[i].field))
+        {
+            wd_fbuf_str(fb, wd_fields[i].name);
+            wd_fbuf_str(fb, "_unsupported=1\n");
+        }
+}
+
+ssize_t wd_format_snapshot(char *buf, size_t size, const struct wd_snapshot *snap, wd_format_t fmt)
+{
+    struct wd_format_bin_hdr hdr;
+    struct wd_fbuf fb;
+
+    WD_TRACE("");
+
+    if (buf == NULL || snap == NULL)
+        WD_ERROR("buf == NULL || snap == NULL\n", -1, "");
+
+    wd_fbuf_init(&fb, buf, size);
+
+    switch (fmt)
+    {
+        case WD_FORMAT_JSON:
+        {
+            wd_format_json(&fb, snap);
+            break;
+        }
+        case WD_FORMAT_KV:
+        {
+            wd_format_kv(&fb, snap);
+            break;
+        }
+        case WD_FORMAT_BIN:
+        {
+            hdr.magic = WD_FORMAT_BIN_MAGIC;
+            hdr.version = WD_FORMAT_BIN_VERSION;
+            hdr.size = (uint16_t)sizeof(*snap);
+            wd_fbuf_put(&fb, &hdr, sizeof(hdr));
+            wd_fbuf_put(&fb, snap, sizeof(*snap));
+            break;
+        }
+        case WD_FORMAT_TEXT:
+        default:
+            WD_ERROR("Unsupported format\n", -1, "");
+    }
+
+    if (fb.overflow)
+        WD_ERROR("Buffer too small\n", -1, "");
+
+    return (ssize_t)fb.len;
+}
@@ -0,0 +1,229 @@
+#include <wd_handover.h>
+#include <wd_log.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+/* new daemon does not wait forever for old one */
+#define WD_HANDOVER_RECV_TIMEOUT_SEC 2
+
+static int wd_handover_addr(const char *path, struct sockaddr_un *addr);
+
+static int wd_handover_addr(const char *path, struct sockaddr_un *addr)
+{
+    (void)memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+
+    if (path == NULL || strlen(path) >= sizeof(addr->sun_path))
+        WD_ERROR("Incorrect handover socket path\n", 1, "");
+
+    (void)strcpy(addr->sun_path, path);
+
+    return 0;
+}
+
+int wd_handover_listen(struct wd_handover_listener *l, const char *path)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+
+    WD_TRACE("");
+
+    if (l == NULL)
+        WD_ERROR("l == NULL\n", 1, "");
+
+    (void)memset(l, 0, sizeof(*l));
+    l->fd = -1;
+
+    if (wd_handover_addr(path, &addr))
+        return 1;
+
+    l->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (l->fd == -1)
+        WD_ERROR("Cannot create handover socket\n", 1, "");
+
+    /* old daemon is gone or already took its descriptors back */
+    (void)unlink(path);
+    if (bind(l->fd, (const struct sockaddr *)&addr, sizeof(addr)) == -1)
+        WD_ERROR("Cannot bind handover socket %s\n", 1, path);
+
+    l->path = path;
+    if (stat(path, &st) == 0)
+    {
+        l->st_dev = st.st_dev;
+        l->st_ino = st.st_ino;
+    }
+
+    /* descriptors open the box to reset, only owner can connect */
+    if (chmod(path, S_IRUSR | S_IWUSR) == -1 || listen(l->fd, 1) == -1)
+        WD_ERROR("Cannot listen on handover socket %s\n", 1, path);
+
+    return 0;
+}
+
+void wd_handover_unlisten(struct wd_handover_listener *l)
+{
+    struct stat st;
+
+    WD_TRACE("");
+
+    if (l == NULL || l->fd == -1)
+        return;
+
+    (void)close(l->fd);
+    l->fd = -1;
+
+    if (l->path && stat(l->path, &st) == 0 && st.st_dev == l->st_dev && st.st_ino == l->st_ino)
+        (void)unlink(l->path);
+}
+
+int wd_handover_connect(const char *path)
+{
+    struct sockaddr_un addr;
+    const struct timeval tv = { .tv_sec = WD_HANDOVER_RECV_TIMEOUT_SEC, .tv_usec = 0 };
+    int fd;
+
+    WD_TRACE("");
+
+    if (wd_handover_addr(path, &addr))
+        return -1;
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        WD_ERROR("Cannot create handover socket\n", -1, "");
+
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == -1 ||
+        connect(fd, (const struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        (void)close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int wd_handover_send(int fd, const struct wd_handover_msg *msg, const int *fds)
+{
+    union
+    {
+        struct cmsghdr  hdr;
+        char            buf[CMSG_SPACE(sizeof(int) * WD_HANDOVER_MAX_DEVS)];
+    } ctrl;
+    struct msghdr mh;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+
+    WD_TRACE("");
+
+    if (msg == NULL || fds == NULL || msg->ndevs == 0 || msg->ndevs > WD_HANDOVER_MAX_DEVS)
+        WD_ERROR("msg == NULL || fds == NULL || incorrect ndevs\n", 1, "");
+
+    (void)memset(&ctrl, 0, sizeof(ctrl));
+    (void)memset(&mh, 0, sizeof(mh));
+
+    iov.iov_base = (void *)(uintptr_t)msg;
+    iov.iov_len = sizeof(*msg);
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = ctrl.buf;
+    mh.msg_controllen = CMSG_SPACE(sizeof(int) * msg->ndevs);
+
+    cmsg = CMSG_FIRSTHDR(&mh);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * msg->ndevs);
+    (void)memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * msg->ndevs);
+
+    if (sendmsg(fd, &mh, MSG_NOSIGNAL) != (ssize_t)sizeof(*msg))
+        WD_ERROR("Cannot send handover state\n", 1, "");
+
+    return 0;
+}
+
+int wd_handover_recv(int fd, struct wd_handover_msg *msg, int *fds)
+{
+    union
+    {
+        struct cmsghdr  hdr;
+        char            buf[CMSG_SPACE(sizeof(int) * WD_HANDOVER_MAX_DEVS)];
+    } ctrl;
+    struct msghdr mh;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+    size_t nfds = 0;
+    size_t i;
+    ssize_t len;
+
+    WD_TRACE("");
+
+    if (msg == NULL || fds == NULL)
+        WD_ERROR("msg == NULL || fds == NULL\n", 1, "");
+
+    for (i = 0; i < WD_HANDOVER_MAX_DEVS; ++i)
+        fds[i] = -1;
+
+    (void)memset(&mh, 0, sizeof(mh));
+    iov.iov_base = msg;
+    iov.iov_len = sizeof(*msg);
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = ctrl.buf;
+    mh.msg_controllen = sizeof(ctrl.buf);
+
+    len = recvmsg(fd, &mh, MSG_CMSG_CLOEXEC);
+    if (len <= 0)
+        WD_ERROR("Running daemon refused handover\n", 1, "");
+
+    for (cmsg = CMSG_FIRSTHDR(&mh); cmsg != NULL; cmsg = CMSG_NXTHDR(&mh, cmsg))
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            if (nfds > WD_HANDOVER_MAX_DEVS)
+                nfds = WD_HANDOVER_MAX_DEVS;
+
+            (void)memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * nfds);
+        }
+
+    if (len != (ssize_t)sizeof(*msg) || (mh.msg_flags & MSG_CTRUNC) || msg->magic != WD_HANDOVER_MAGIC ||
+        msg->version != WD_HANDOVER_VERSION || msg->ndevs == 0 || msg->ndevs != nfds)
+    {
+        /* never leak WatchDog descriptors, closing them without magic keeps WD running */
+        for (i = 0; i < nfds; ++i)
+            (void)close(fds[i]);
+
+        WD_ERROR("Malformed handover state\n", 1, "");
+    }
+
+    return 0;
+}
+
+int wd_handover_send_ack(int fd, const struct wd_handover_ack *ack)
+{
+    WD_TRACE("");
+
+    if (ack == NULL)
+        WD_ERROR("ack == NULL\n", 1, "");
+
+    if (send(fd, ack, sizeof(*ack), MSG_NOSIGNAL) != (ssize_t)sizeof(*ack))
+        WD_ERROR("Cannot send handover ack\n", 1, "");
+
+    return 0;
+}
+
+int wd_handover_recv_ack(int fd, struct wd_handover_ack *ack)
+{
+    WD_TRACE("");
+
+    if (ack == NULL)
+        WD_ERROR("ack == NULL\n", 1, "");
+
+    if (recv(fd, ack, sizeof(*ack), MSG_DONTWAIT) != (ssize_t)sizeof(*ack) ||
+        ack->magic != WD_HANDOVER_MAGIC || ack->version != WD_HANDOVER_VERSION)
+        return 1;
+
+    return 0;
+}
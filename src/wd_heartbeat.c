@@ -0,0 +1,285 @@
+#include <wd_heartbeat.h>
+#include <wd_log.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+static int wd_hb_map(const char *shm, int oflag, size_t nslots, struct wd_hb_hdr **hdr, size_t *size);
+static struct wd_hb_slot *wd_hb_slots(const struct wd_hb_hdr *hdr);
+static struct wd_hb_slot *wd_hb_find(const struct wd_hb_hdr *hdr, const char *name);
+static struct wd_hb_slot *wd_hb_claim(struct wd_hb_hdr *hdr);
+
+static struct wd_hb_slot *wd_hb_slots(const struct wd_hb_hdr *hdr)
+{
+    return (struct wd_hb_slot *)(hdr + 1);
+}
+
+/* nslots == 0 means attach to existing segment */
+static int wd_hb_map(const char *shm, int oflag, size_t nslots, struct wd_hb_hdr **hdr, size_t *size)
+{
+    struct wd_hb_hdr *h;
+    struct stat st;
+    const int prot = (oflag & O_ACCMODE) == O_RDONLY ? PROT_READ : PROT_READ | PROT_WRITE;
+    int fd;
+
+    fd = shm_open(shm, oflag | O_CLOEXEC, 0600);
+    if (fd == -1)
+        WD_ERROR("Cannot open heartbeat registry %s\n", 1, shm);
+
+    if (fstat(fd, &st) == -1)
+    {
+        (void)close(fd);
+        WD_ERROR("Cannot stat heartbeat registry %s\n", 1, shm);
+    }
+
+    if (st.st_size == 0 && nslots)
+    {
+        *size = sizeof(*h) + nslots * sizeof(struct wd_hb_slot);
+        if (ftruncate(fd, (off_t)*size) == -1)
+        {
+            (void)close(fd);
+            WD_ERROR("Cannot resize heartbeat registry %s\n", 1, shm);
+        }
+    }
+    else if ((size_t)st.st_size >= sizeof(*h))
+        *size = (size_t)st.st_size;
+    else
+    {
+        (void)close(fd);
+        WD_ERROR("Heartbeat registry %s is not initialized\n", 1, shm);
+    }
+
+    h = mmap(NULL, *size, prot, MAP_SHARED, fd, 0);
+    (void)close(fd);
+    if (h == MAP_FAILED)
+        WD_ERROR("Cannot map heartbeat registry %s\n", 1, shm);
+
+    /* fresh segment, feeder owns initialization */
+    if (nslots && __atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) == 0)
+    {
+        h->version = WD_HB_VERSION;
+        h->slot_size = (uint16_t)sizeof(struct wd_hb_slot);
+        h->nslots = (uint32_t)((*size - sizeof(*h)) / sizeof(struct wd_hb_slot));
+        __atomic_store_n(&h->magic, WD_HB_MAGIC, __ATOMIC_RELEASE);
+    }
+
+    if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != WD_HB_MAGIC || h->version != WD_HB_VERSION ||
+        h->slot_size != sizeof(struct wd_hb_slot) ||
+        *size < sizeof(*h) + (size_t)h->nslots * sizeof(struct wd_hb_slot))
+    {
+        (void)munmap(h, *size);
+        WD_ERROR("%s is not a heartbeat registry\n", 1, shm);
+    }
+
+    *hdr = h;
+
+    return 0;
+}
+
+static struct wd_hb_slot *wd_hb_find(const struct wd_hb_hdr *hdr, const char *name)
+{
+    struct wd_hb_slot *slots = wd_hb_slots(hdr);
+    const uint32_t used = __atomic_load_n(&hdr->used, __ATOMIC_ACQUIRE);
+    uint32_t i;
+
+    for (i = 0; i < used; ++i)
+        if (__atomic_load_n(&slots[i].state, __ATOMIC_ACQUIRE) == WD_HB_SLOT_ACTIVE &&
+            strncmp(slots[i].name, name, sizeof(slots[i].name)) == 0)
+            return &slots[i];
+
+    return NULL;
+}
+
+static struct wd_hb_slot *wd_hb_claim(struct wd_hb_hdr *hdr)
+{
+    struct wd_hb_slot *slots = wd_hb_slots(hdr);
+    uint32_t expected;
+    uint32_t used;
+    uint32_t i;
+
+    for (i = 0; i < hdr->nslots; ++i)
+    {
+        expected = WD_HB_SLOT_FREE;
+        if (!__atomic_compare_exchange_n(&slots[i].state, &expected, WD_HB_SLOT_CLAIMED,
+                                         false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            continue;
+
+        /* raise high water mark so feeder scans this slot */
+        used = __atomic_load_n(&hdr->used, __ATOMIC_RELAXED);
+        while (used < i + 1 &&
+               !__atomic_compare_exchange_n(&hdr->used, &used, i + 1, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+
+        return &slots[i];
+    }
+
+    return NULL;
+}
+
+int wd_hb_register(struct wd_hb_client *client, const char *shm, const char *name, uint64_t deadline_ns)
+{
+    struct wd_hb_slot *slot;
+
+    WD_TRACE("");
+
+    if (client == NULL || name == NULL || *name == '\0')
+        WD_ERROR("client == NULL || name == NULL\n", 1, "");
+
+    if (deadline_ns == 0)
+        WD_ERROR("Heartbeat deadline == 0\n", 1, "");
+
+    (void)memset(client, 0, sizeof(*client));
+    if (wd_hb_map(shm ? shm : WD_HB_DEFAULT_SHM, O_RDWR, 0, &client->hdr, &client->size))
+        return 1;
+
+    /* restarted client takes over own slot, there is no gap in watching */
+    slot = wd_hb_find(client->hdr, name);
+    if (slot != NULL)
+    {
+        __atomic_store_n(&slot->deadline_ns, deadline_ns, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->pid, (uint32_t)getpid(), __ATOMIC_RELAXED);
+        client->slot = slot;
+        wd_hb_beat(client);
+
+        return 0;
+    }
+
+    slot = wd_hb_claim(client->hdr);
+    if (slot == NULL)
+    {
+        wd_hb_detach(client);
+        WD_ERROR("Heartbeat registry is full\n", 1, "");
+    }
+
+    (void)memset(slot->name, 0, sizeof(slot->name));
+    (void)strncpy(slot->name, name, sizeof(slot->name) - 1);
+    slot->deadline_ns = deadline_ns;
+    slot->pid = (uint32_t)getpid();
+    slot->beat_ns = wd_time_now_ns();
+    __atomic_store_n(&slot->state, WD_HB_SLOT_ACTIVE, __ATOMIC_RELEASE);
+
+    client->slot = slot;
+
+    return 0;
+}
+
+void wd_hb_unregister(struct wd_hb_client *client)
+{
+    WD_TRACE("");
+
+    if (client == NULL || client->slot == NULL)
+        return;
+
+    __atomic_store_n(&client->slot->state, WD_HB_SLOT_FREE, __ATOMIC_RELEASE);
+    wd_hb_detach(client);
+}
+
+void wd_hb_detach(struct wd_hb_client *client)
+{
+    WD_TRACE("");
+
+    if (client == NULL || client->hdr == NULL)
+        return;
+
+    (void)munmap(client->hdr, client->size);
+    (void)memset(client, 0, sizeof(*client));
+}
+
+int wd_hb_registry_create(struct wd_hb_registry *reg, const char *shm, size_t nslots)
+{
+    WD_TRACE("");
+
+    if (reg == NULL)
+        WD_ERROR("reg == NULL\n", 1, "");
+
+    (void)memset(reg, 0, sizeof(*reg));
+    reg->shm = shm ? shm : WD_HB_DEFAULT_SHM;
+
+    return wd_hb_map(reg->shm, O_RDWR | O_CREAT, nslots ? nslots : WD_HB_DEFAULT_SLOTS, &reg->hdr, &reg->size);
+}
+
+int wd_hb_registry_attach(struct wd_hb_registry *reg, const char *shm)
+{
+    WD_TRACE("");
+
+    if (reg == NULL)
+        WD_ERROR("reg == NULL\n", 1, "");
+
+    (void)memset(reg, 0, sizeof(*reg));
+    reg->shm = shm ? shm : WD_HB_DEFAULT_SHM;
+
+    return wd_hb_map(reg->shm, O_RDONLY, 0, &reg->hdr, &reg->size);
+}
+
+void wd_hb_registry_destroy(struct wd_hb_registry *reg, bool unlink)
+{
+    WD_TRACE("");
+
+    if (reg == NULL || reg->hdr == NULL)
+        return;
+
+    (void)munmap(reg->hdr, reg->size);
+    if (unlink)
+        (void)shm_unlink(reg->shm);
+
+    reg->hdr = NULL;
+}
+
+uint32_t wd_hb_registry_scan(struct wd_hb_registry *reg, uint64_t now, struct wd_hb_stale *stale)
+{
+    const struct wd_hb_slot *slots = wd_hb_slots(reg->hdr);
+    const struct wd_hb_slot *slot;
+    uint32_t used = __atomic_load_n(&reg->hdr->used, __ATOMIC_ACQUIRE);
+    uint32_t nstale = 0;
+    uint64_t beat;
+    uint64_t deadline;
+    uint32_t i;
+
+    if (used > reg->hdr->nslots)
+        used = reg->hdr->nslots;
+
+    for (i = 0; i < used; ++i)
+    {
+        slot = &slots[i];
+        if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != WD_HB_SLOT_ACTIVE)
+            continue;
+
+        beat = __atomic_load_n(&slot->beat_ns, __ATOMIC_ACQUIRE);
+        deadline = __atomic_load_n(&slot->deadline_ns, __ATOMIC_RELAXED);
+
+        /* beat newer than now means client is fresh, not stale */
+        if (beat >= now || now - beat <= deadline)
+            continue;
+
+        if (nstale++ == 0 && stale != NULL)
+        {
+            stale->slot = i;
+            stale->pid = __atomic_load_n(&slot->pid, __ATOMIC_RELAXED);
+            stale->late_ns = now - beat - deadline;
+            (void)memcpy(stale->name, slot->name, sizeof(stale->name));
+            stale->name[sizeof(stale->name) - 1] = '\0';
+        }
+    }
+
+    reg->stale = nstale;
+    if (nstale)
+        ++reg->withheld;
+
+    return nstale;
+}
+
+const struct wd_hb_slot *wd_hb_registry_slot(const struct wd_hb_registry *reg, uint32_t i)
+{
+    const struct wd_hb_slot *slot;
+
+    if (reg == NULL || reg->hdr == NULL || i >= reg->hdr->nslots)
+        return NULL;
+
+    slot = &wd_hb_slots(reg->hdr)[i];
+    if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != WD_HB_SLOT_ACTIVE)
+        return NULL;
+
+    return slot;
+}
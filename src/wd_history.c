@@ -0,0 +1,690 @@
+#include <wd_history.h>
+#include <wd_stats.h>
+#include <wd_time.h>
+#include <wd_log.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <inttypes.h>
+
+#define WD_HISTORY_BOOT_ID      "/proc/sys/kernel/random/boot_id"
+#define WD_HISTORY_FLAG_BITS    32
+#define WD_HISTORY_ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+#define WD_HISTORY_FILE_SIZE(capacity) \
+    (sizeof(struct wd_history_hdr) + (size_t)(capacity) * sizeof(struct wd_history_rec))
+
+/* per device result of query */
+struct wd_history_agg
+{
+    char        dev[WD_HISTORY_DEV_LEN];
+    uint64_t    boots;
+    uint64_t    clean;                          /* bootstatus without any bit */
+    uint64_t    causes[WD_HISTORY_FLAG_BITS];   /* boots per bootstatus bit */
+    uint64_t    first_ns;
+    uint64_t    last_ns;
+    int32_t     last_bootstatus;
+    uint32_t    min_timeleft;                   /* UINT32_MAX means never seen */
+    uint64_t    prev_errors;
+    uint64_t    prev_near_misses;
+};
+
+static uint64_t wd_history_realtime_ns(void);
+static uint64_t wd_history_boot_ns(void);
+static int wd_history_boot_id(uint8_t *id);
+static int wd_history_map(struct wd_history *history, int fd, size_t size, int prot);
+static void wd_history_add(struct wd_history_agg *agg, const struct wd_history_rec *rec);
+static size_t wd_history_aggregate(const struct wd_history *history, struct wd_history_agg *aggs, size_t n, uint64_t *records);
+static void wd_history_date(struct wd_fbuf *fb, uint64_t ns);
+static void wd_history_kv_key(struct wd_fbuf *fb, size_t i, const char *key);
+
+static uint64_t wd_history_realtime_ns(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (uint64_t)ts.tv_sec * WD_NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t wd_history_boot_ns(void)
+{
+    struct timespec ts;
+    uint64_t since_boot;
+
+    (void)clock_gettime(CLOCK_BOOTTIME, &ts);
+    since_boot = (uint64_t)ts.tv_sec * WD_NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+
+    return wd_history_realtime_ns() - since_boot;
+}
+
+static int wd_history_boot_id(uint8_t *id)
+{
+    char buf[64];
+    unsigned int byte;
+    ssize_t len;
+    size_t i;
+    size_t j = 0;
+    int fd;
+
+    (void)memset(id, 0, 16);
+
+    fd = open(WD_HISTORY_BOOT_ID, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        WD_ERROR("Cannot open %s\n", 1, WD_HISTORY_BOOT_ID);
+
+    len = read(fd, buf, sizeof(buf) - 1);
+    (void)close(fd);
+    if (len <= 0)
+        WD_ERROR("Cannot read %s\n", 1, WD_HISTORY_BOOT_ID);
+
+    buf[len] = '\0';
+
+    /* uuid text, dashes are skipped */
+    for (i = 0; buf[i] != '\0' && buf[i + 1] != '\0' && j < 16; )
+    {
+        if (buf[i] == '-')
+        {
+            ++i;
+            continue;
+        }
+
+        if (sscanf(&buf[i], "%2x", &byte) != 1)
+            break;
+
+        id[j++] = (uint8_t)byte;
+        i += 2;
+    }
+
+    if (j != 16)
+        WD_ERROR("Incorrect boot id %s\n", 1, buf);
+
+    return 0;
+}
+
+static int wd_history_map(struct wd_history *history, int fd, size_t size, int prot)
+{
+    void *addr;
+
+    addr = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+        WD_ERROR("Cannot map history\n", 1, "");
+
+    history->hdr = (struct wd_history_hdr *)addr;
+    history->recs = (struct wd_history_rec *)(history->hdr + 1);
+    history->size = size;
+
+    return 0;
+}
+
+static void wd_history_add(struct wd_history_agg *agg, const struct wd_history_rec *rec)
+{
+    uint32_t bits;
+
+    ++agg->boots;
+    if (agg->first_ns == 0 || rec->time_ns < agg->first_ns)
+        agg->first_ns = rec->time_ns;
+
+    if (rec->time_ns >= agg->last_ns)
+    {
+        agg->last_ns = rec->time_ns;
+        agg->last_bootstatus = rec->bootstatus;
+    }
+
+    if (rec->fields & WD_HISTORY_HAS_BOOTSTATUS)
+    {
+        bits = (uint32_t)rec->bootstatus;
+        if (bits == 0)
+            ++agg->clean;
+
+        for (; bits != 0; bits &= bits - 1)
+            ++agg->causes[__builtin_ctz(bits)];
+    }
+
+    if ((rec->fields & WD_HISTORY_HAS_TIMELEFT) && rec->prev_timeleft < agg->min_timeleft)
+        agg->min_timeleft = rec->prev_timeleft;
+
+    if (rec->fields & WD_HISTORY_HAS_PREV)
+    {
+        agg->prev_errors += rec->prev_errors;
+        agg->prev_near_misses += rec->prev_near_misses;
+    }
+}
+
+static size_t wd_history_aggregate(const struct wd_history *history, struct wd_history_agg *aggs, size_t n, uint64_t *records)
+{
+    const struct wd_history_rec *slot;
+    struct wd_history_rec rec;
+    const uint64_t capacity = history->hdr->capacity;
+    uint64_t head;
+    uint64_t i;
+    size_t nagg = 0;
+    size_t last = 0;
+    size_t j;
+
+    *records = 0;
+    head = __atomic_load_n(&history->hdr->head, __ATOMIC_ACQUIRE);
+    for (i = head > capacity ? head - capacity : 0; i < head; ++i)
+    {
+        slot = &history->recs[i % capacity];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != i + 1)
+            continue;
+
+        rec = *slot;
+
+        /* record overwritten while copied */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != i + 1)
+            continue;
+
+        ++*records;
+
+        /* records of one boot come in device order, last match is usually next one */
+        j = last;
+        if (j >= nagg || strncmp(aggs[j].dev, rec.dev, sizeof(rec.dev)) != 0)
+            for (j = 0; j < nagg && strncmp(aggs[j].dev, rec.dev, sizeof(rec.dev)) != 0; ++j)
+                ;
+
+        if (j == nagg)
+        {
+            if (nagg == n)
+                continue;
+
+            (void)memset(&aggs[nagg], 0, sizeof(aggs[nagg]));
+            (void)memcpy(aggs[nagg].dev, rec.dev, sizeof(rec.dev));
+            aggs[nagg].dev[sizeof(aggs[nagg].dev) - 1] = '\0';
+            aggs[nagg].min_timeleft = UINT32_MAX;
+            ++nagg;
+        }
+
+        wd_history_add(&aggs[j], &rec);
+        last = j + 1;
+    }
+
+    return nagg;
+}
+
+static void wd_history_date(struct wd_fbuf *fb, uint64_t ns)
+{
+    const time_t sec = (time_t)(ns / WD_NSEC_PER_SEC);
+    struct tm tm;
+    char buf[32];
+
+    if (ns == 0 || gmtime_r(&sec, &tm) == NULL || strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm) == 0)
+    {
+        wd_fbuf_str(fb, "-");
+        return;
+    }
+
+    wd_fbuf_str(fb, buf);
+}
+
+/* keys are prefixed by device index like feed stats */
+static void wd_history_kv_key(struct wd_fbuf *fb, size_t i, const char *key)
+{
+    wd_fbuf_str(fb, "dev");
+    wd_fbuf_u64(fb, i);
+    wd_fbuf_put(fb, "_", 1);
+    wd_fbuf_str(fb, key);
+}
+
+int wd_history_open(struct wd_history *history, const char *path, size_t capacity)
+{
+    struct stat st;
+    const struct wd_history_hdr *hdr;
+    int fd;
+
+    WD_TRACE("");
+
+    if (history == NULL || path == NULL)
+        WD_ERROR("history == NULL || path == NULL\n", 1, "");
+
+    (void)memset(history, 0, sizeof(*history));
+    history->fd = -1;
+
+    if (capacity == 0)
+        capacity = WD_HISTORY_DEFAULT_RECORDS;
+
+    if (capacity > WD_HISTORY_MAX_RECORDS)
+        WD_ERROR("Too many history records, max is %d\n", 1, WD_HISTORY_MAX_RECORDS);
+
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1)
+        WD_ERROR("Cannot open %s\n", 1, path);
+
+    /* tool and daemon may start together, only one of them creates file */
+    if (flock(fd, LOCK_EX) == -1 || fstat(fd, &st) == -1)
+    {
+        (void)close(fd);
+        WD_ERROR("Cannot lock %s\n", 1, path);
+    }
+
+    if (st.st_size == 0)
+    {
+        if (ftruncate(fd, (off_t)WD_HISTORY_FILE_SIZE(capacity)) == -1 ||
+            wd_history_map(history, fd, WD_HISTORY_FILE_SIZE(capacity), PROT_READ | PROT_WRITE))
+        {
+            (void)close(fd);
+            WD_ERROR("Cannot create %s\n", 1, path);
+        }
+
+        history->hdr->version = WD_HISTORY_VERSION;
+        history->hdr->rec_size = (uint16_t)sizeof(struct wd_history_rec);
+        history->hdr->capacity = (uint32_t)capacity;
+
+        /* readers check magic last */
+        __atomic_store_n(&history->hdr->magic, WD_HISTORY_MAGIC, __ATOMIC_RELEASE);
+        (void)msync(history->hdr, sizeof(*history->hdr), MS_ASYNC);
+    }
+    else
+    {
+        if ((size_t)st.st_size < sizeof(*hdr) ||
+            wd_history_map(history, fd, (size_t)st.st_size, PROT_READ | PROT_WRITE))
+        {
+            (void)close(fd);
+            WD_ERROR("%s is not a history file\n", 1, path);
+        }
+
+        hdr = history->hdr;
+        if (hdr->magic != WD_HISTORY_MAGIC || hdr->version != WD_HISTORY_VERSION ||
+            hdr->rec_size != sizeof(struct wd_history_rec) || hdr->capacity == 0 ||
+            WD_HISTORY_FILE_SIZE(hdr->capacity) != (size_t)st.st_size)
+        {
+            wd_history_close(history);
+            (void)close(fd);
+            WD_ERROR("%s is not a history file\n", 1, path);
+        }
+    }
+
+    (void)flock(fd, LOCK_UN);
+    history->fd = fd;
+
+    return 0;
+}
+
+int wd_history_attach(struct wd_history *history, const char *path)
+{
+    struct stat st;
+    const struct wd_history_hdr *hdr;
+    int fd;
+
+    WD_TRACE("");
+
+    if (history == NULL || path == NULL)
+        WD_ERROR("history == NULL || path == NULL\n", 1, "");
+
+    (void)memset(history, 0, sizeof(*history));
+    history->fd = -1;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        WD_ERROR("Cannot open %s\n", 1, path);
+
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(*hdr) ||
+        wd_history_map(history, fd, (size_t)st.st_size, PROT_READ))
+    {
+        (void)close(fd);
+        WD_ERROR("%s is not a history file\n", 1, path);
+    }
+
+    (void)close(fd);
+
+    hdr = history->hdr;
+    if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != WD_HISTORY_MAGIC || hdr->version != WD_HISTORY_VERSION ||
+        hdr->rec_size != sizeof(struct wd_history_rec) || hdr->capacity == 0 ||
+        WD_HISTORY_FILE_SIZE(hdr->capacity) != (size_t)st.st_size)
+    {
+        wd_history_close(history);
+        WD_ERROR("%s is not a history file\n", 1, path);
+    }
+
+    return 0;
+}
+
+void wd_history_close(struct wd_history *history)
+{
+    WD_TRACE("");
+
+    if (history == NULL)
+        return;
+
+    if (history->hdr != NULL)
+        (void)munmap(history->hdr, history->size);
+
+    if (history->fd != -1)
+        (void)close(history->fd);
+
+    history->hdr = NULL;
+    history->recs = NULL;
+    history->fd = -1;
+}
+
+size_t wd_history_prev_load(const char *stats_path, struct wd_history_prev *prev, size_t n)
+{
+    const struct wd_stats_file *file;
+    const struct wd_stats *stats;
+    struct wd_feed_sample sample;
+    struct stat st;
+    uint64_t seen_ns;
+    size_t i;
+
+    WD_TRACE("");
+
+    if (stats_path == NULL || prev == NULL || stat(stats_path, &st) == -1)
+        return 0;
+
+    /* file of feeder restarted in this boot tells nothing about last reset */
+    seen_ns = (uint64_t)st.st_mtim.tv_sec * WD_NSEC_PER_SEC + (uint64_t)st.st_mtim.tv_nsec;
+    if (seen_ns >= wd_history_boot_ns())
+        return 0;
+
+    file = wd_stats_attach(stats_path);
+    if (file == NULL)
+        return 0;
+
+    for (i = 0; i < n && i < file->ndevs && i < WD_STATS_MAX_DEVS; ++i)
+    {
+        stats = &file->devs[i];
+        (void)memset(&prev[i], 0, sizeof(prev[i]));
+        (void)memcpy(prev[i].dev, stats->dev, sizeof(prev[i].dev) < sizeof(stats->dev) ? sizeof(prev[i].dev) : sizeof(stats->dev));
+        prev[i].dev[sizeof(prev[i].dev) - 1] = '\0';
+        prev[i].fields = WD_HISTORY_HAS_PREV;
+        prev[i].feeds = stats->feeds;
+        prev[i].errors = stats->errors;
+        prev[i].near_misses = stats->near_misses;
+        prev[i].min_slack_ns = stats->min_slack_ns;
+        prev[i].seen_ns = seen_ns;
+
+        if (wd_stats_last(stats, &sample, 1) == 1 && sample.timeleft != WD_STATS_TIMELEFT_NONE)
+        {
+            prev[i].fields |= WD_HISTORY_HAS_TIMELEFT;
+            prev[i].timeleft = sample.timeleft;
+        }
+    }
+
+    wd_stats_destroy(file);
+
+    return i;
+}
+
+int wd_history_record(struct wd_history *history, const char *dev, uint32_t fields, int bootstatus,
+                      unsigned int timeout, const struct wd_history_prev *prev)
+{
+    struct wd_history_hdr *hdr;
+    struct wd_history_rec *rec;
+    uint8_t boot_id[16];
+    uint64_t head;
+    uint64_t i;
+    uintptr_t page;
+    const uintptr_t page_mask = ~((uintptr_t)sysconf(_SC_PAGESIZE) - 1);
+
+    WD_TRACE("");
+
+    if (history == NULL || history->hdr == NULL || history->fd == -1)
+        WD_ERROR("History is not opened for recording\n", 1, "");
+
+    if (wd_history_boot_id(boot_id))
+        return 1;
+
+    if (dev == NULL)
+        dev = WD_HISTORY_DEFAULT_DEV;
+
+    if (flock(history->fd, LOCK_EX) == -1)
+        WD_ERROR("Cannot lock history\n", 1, "");
+
+    hdr = history->hdr;
+    head = hdr->head;
+
+    /* records of this boot are the newest ones */
+    for (i = head; i > 0 && head - i < hdr->capacity; --i)
+    {
+        rec = &history->recs[(i - 1) % hdr->capacity];
+        if (memcmp(rec->boot_id, boot_id, sizeof(boot_id)) != 0)
+            break;
+
+        if (strncmp(rec->dev, dev, sizeof(rec->dev)) == 0)
+        {
+            (void)flock(history->fd, LOCK_UN);
+            return 0;
+        }
+    }
+
+    rec = &history->recs[head % hdr->capacity];
+    __atomic_store_n(&rec->seq, 0, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    rec->time_ns = wd_history_realtime_ns();
+    rec->boot_ns = wd_history_boot_ns();
+    (void)memcpy(rec->boot_id, boot_id, sizeof(boot_id));
+    (void)snprintf(rec->dev, sizeof(rec->dev), "%s", dev);
+    rec->fields = fields & (WD_HISTORY_HAS_BOOTSTATUS | WD_HISTORY_HAS_TIMEOUT);
+    rec->bootstatus = (int32_t)bootstatus;
+    rec->timeout = timeout;
+    rec->prev_timeleft = 0;
+    rec->prev_feeds = 0;
+    rec->prev_errors = 0;
+    rec->prev_near_misses = 0;
+    rec->prev_min_slack_ns = 0;
+    rec->prev_seen_ns = 0;
+
+    if (prev != NULL)
+    {
+        rec->fields |= prev->fields & (WD_HISTORY_HAS_PREV | WD_HISTORY_HAS_TIMELEFT);
+        rec->prev_timeleft = prev->timeleft;
+        rec->prev_feeds = prev->feeds;
+        rec->prev_errors = prev->errors;
+        rec->prev_near_misses = prev->near_misses;
+        rec->prev_min_slack_ns = prev->min_slack_ns;
+        rec->prev_seen_ns = prev->seen_ns;
+    }
+
+    __atomic_store_n(&rec->seq, head + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&hdr->head, head + 1, __ATOMIC_RELEASE);
+
+    /* record must survive the reset it may be followed by, but never block the caller */
+    page = (uintptr_t)rec & page_mask;
+    (void)msync((void *)page, (uintptr_t)(rec + 1) - page, MS_ASYNC);
+    (void)msync(hdr, sizeof(*hdr), MS_ASYNC);
+
+    (void)flock(history->fd, LOCK_UN);
+
+    return 0;
+}
+
+ssize_t wd_history_format(char *buf, size_t size, const struct wd_history *history, wd_format_t fmt)
+{
+    struct wd_history_agg aggs[WD_HISTORY_MAX_DEVS];
+    const char *names[WD_HISTORY_FLAG_BITS];
+    const struct wd_flag_desc *flags;
+    const struct wd_history_agg *agg;
+    struct wd_fbuf fb;
+    uint64_t records;
+    size_t nflags;
+    size_t nagg;
+    size_t i;
+    size_t b;
+    char line[160];
+    bool first;
+
+    WD_TRACE("");
+
+    if (buf == NULL || history == NULL || history->hdr == NULL)
+        WD_ERROR("buf == NULL || history == NULL\n", -1, "");
+
+    if (fmt == WD_FORMAT_BIN)
+        WD_ERROR("Binary format is not supported, read history file directly\n", -1, "");
+
+    /* bootstatus bits use WDIOF_* names */
+    flags = wd_format_flag_table(&nflags);
+    for (b = 0; b < WD_HISTORY_FLAG_BITS; ++b)
+    {
+        names[b] = NULL;
+        for (i = 0; i < nflags; ++i)
+            if ((uint32_t)flags[i].flag == (1U << b))
+                names[b] = flags[i].name;
+    }
+
+    nagg = wd_history_aggregate(history, aggs, WD_HISTORY_ARRAY_SIZE(aggs), &records);
+
+    wd_fbuf_init(&fb, buf, size);
+    if (fmt == WD_FORMAT_JSON)
+        wd_fbuf_put(&fb, "[", 1);
+    else if (fmt == WD_FORMAT_TEXT)
+    {
+        (void)snprintf(line, sizeof(line), "%-32s %6s %6s %-20s %8s %8s %8s %8s  %s\n",
+                       "DEV", "BOOTS", "CLEAN", "LAST BOOT", "STATUS", "MIN LEFT", "ERRORS", "NEAR", "CAUSES");
+        wd_fbuf_str(&fb, line);
+    }
+
+    for (i = 0; i < nagg; ++i)
+    {
+        agg = &aggs[i];
+        switch (fmt)
+        {
+            case WD_FORMAT_JSON:
+            {
+                wd_fbuf_str(&fb, i ? ",{\"dev\":" : "{\"dev\":");
+                wd_fbuf_quoted(&fb, agg->dev, sizeof(agg->dev));
+                wd_fbuf_str(&fb, ",\"boots\":");
+                wd_fbuf_u64(&fb, agg->boots);
+                wd_fbuf_str(&fb, ",\"clean\":");
+                wd_fbuf_u64(&fb, agg->clean);
+                wd_fbuf_str(&fb, ",\"first_ns\":");
+                wd_fbuf_u64(&fb, agg->first_ns);
+                wd_fbuf_str(&fb, ",\"last_ns\":");
+                wd_fbuf_u64(&fb, agg->last_ns);
+                wd_fbuf_str(&fb, ",\"last_bootstatus\":");
+                wd_fbuf_i64(&fb, agg->last_bootstatus);
+                if (agg->min_timeleft != UINT32_MAX)
+                {
+                    wd_fbuf_str(&fb, ",\"min_timeleft\":");
+                    wd_fbuf_u64(&fb, agg->min_timeleft);
+                }
+                wd_fbuf_str(&fb, ",\"prev_errors\":");
+                wd_fbuf_u64(&fb, agg->prev_errors);
+                wd_fbuf_str(&fb, ",\"prev_near_misses\":");
+                wd_fbuf_u64(&fb, agg->prev_near_misses);
+                wd_fbuf_str(&fb, ",\"causes\":{");
+                first = true;
+                for (b = 0; b < WD_HISTORY_FLAG_BITS; ++b)
+                {
+                    if (agg->causes[b] == 0)
+                        continue;
+
+                    if (!first)
+                        wd_fbuf_put(&fb, ",", 1);
+
+                    first = false;
+                    if (names[b] != NULL)
+                        wd_fbuf_quoted(&fb, names[b], strlen(names[b]));
+                    else
+                    {
+                        wd_fbuf_str(&fb, "\"BIT");
+                        wd_fbuf_u64(&fb, b);
+                        wd_fbuf_put(&fb, "\"", 1);
+                    }
+                    wd_fbuf_put(&fb, ":", 1);
+                    wd_fbuf_u64(&fb, agg->causes[b]);
+                }
+                wd_fbuf_str(&fb, "}}");
+                break;
+            }
+            case WD_FORMAT_KV:
+            {
+                /* names and counters have no fixed width, append them field by field */
+                wd_history_kv_key(&fb, i, "name=");
+                wd_fbuf_quoted(&fb, agg->dev, sizeof(agg->dev));
+                wd_fbuf_put(&fb, "\n", 1);
+                wd_history_kv_key(&fb, i, "boots=");
+                wd_fbuf_u64(&fb, agg->boots);
+                wd_fbuf_put(&fb, "\n", 1);
+                wd_history_kv_key(&fb, i, "clean=");
+                wd_fbuf_u64(&fb, agg->clean);
+                wd_fbuf_put(&fb, "\n", 1);
+                wd_history_kv_key(&fb, i, "last_ns=");
+                wd_fbuf_u64(&fb, agg->last_ns);
+                wd_fbuf_put(&fb, "\n", 1);
+                wd_history_kv_key(&fb, i, "last_bootstatus=");
+                wd_fbuf_hex(&fb, (uint32_t)agg->last_bootstatus);
+                wd_fbuf_put(&fb, "\n", 1);
+                wd_history_kv_key(&fb, i, "prev_errors=");
+                wd_fbuf_u64(&fb, agg->prev_errors);
+                wd_fbuf_put(&fb, "\n", 1);
+                wd_history_kv_key(&fb, i, "prev_near_misses=");
+                wd_fbuf_u64(&fb, agg->prev_near_misses);
+                wd_fbuf_put(&fb, "\n", 1);
+                if (agg->min_timeleft != UINT32_MAX)
+                {
+                    wd_history_kv_key(&fb, i, "min_timeleft=");
+                    wd_fbuf_u64(&fb, agg->min_timeleft);
+                    wd_fbuf_put(&fb, "\n", 1);
+                }
+
+                for (b = 0; b < WD_HISTORY_FLAG_BITS; ++b)
+                    if (agg->causes[b] != 0)
+                    {
+                        wd_history_kv_key(&fb, i, "cause_");
+                        if (names[b] != NULL)
+                            wd_fbuf_str(&fb, names[b]);
+                        else
+                        {
+                            wd_fbuf_str(&fb, "BIT");
+                            wd_fbuf_u64(&fb, b);
+                        }
+                        wd_fbuf_put(&fb, "=", 1);
+                        wd_fbuf_u64(&fb, agg->causes[b]);
+                        wd_fbuf_put(&fb, "\n", 1);
+                    }
+
+                break;
+            }
+            default:
+            {
+                (void)snprintf(line, sizeof(line), "%-32.*s %6" PRIu64 " %6" PRIu64 " ", (int)sizeof(agg->dev) - 1, agg->dev, agg->boots, agg->clean);
+                wd_fbuf_str(&fb, line);
+                wd_history_date(&fb, agg->last_ns);
+                if (agg->min_timeleft != UINT32_MAX)
+                    (void)snprintf(line, sizeof(line), " %#8x %8" PRIu32, (unsigned int)agg->last_bootstatus, agg->min_timeleft);
+                else
+                    (void)snprintf(line, sizeof(line), " %#8x %8s", (unsigned int)agg->last_bootstatus, "-");
+
+                wd_fbuf_str(&fb, line);
+                (void)snprintf(line, sizeof(line), " %8" PRIu64 " %8" PRIu64 "  ", agg->prev_errors, agg->prev_near_misses);
+                wd_fbuf_str(&fb, line);
+
+                first = true;
+                for (b = 0; b < WD_HISTORY_FLAG_BITS; ++b)
+                    if (agg->causes[b] != 0)
+                    {
+                        if (names[b] != NULL)
+                            (void)snprintf(line, sizeof(line), "%s%s=%" PRIu64, first ? "" : ",", names[b], agg->causes[b]);
+                        else
+                            (void)snprintf(line, sizeof(line), "%sBIT%zu=%" PRIu64, first ? "" : ",", b, agg->causes[b]);
+
+                        wd_fbuf_str(&fb, line);
+                        first = false;
+                    }
+
+                wd_fbuf_str(&fb, first ? "-\n" : "\n");
+                break;
+            }
+        }
+    }
+
+    if (fmt == WD_FORMAT_JSON)
+        wd_fbuf_str(&fb, "]\n");
+    else if (fmt == WD_FORMAT_TEXT)
+    {
+        (void)snprintf(line, sizeof(line), "%" PRIu64 " records of %" PRIu32 ", %zu devices\n",
+                       records, history->hdr->capacity, nagg);
+        wd_fbuf_str(&fb, line);
+    }
+
+    return fb.overflow ? -1 : (ssize_t)fb.len;
+}
@@ -0,0 +1,180 @@
+#include <wd_loop.h>
+#include <wd_time.h>
+#include <wd_log.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#define WD_LOOP_MAX_EVENTS  16
+
+int wd_loop_init(struct wd_loop *loop)
+{
+    WD_TRACE("");
+
+    if (loop == NULL)
+        WD_ERROR("loop == NULL\n", 1, "");
+
+    loop->running = false;
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd == -1)
+        WD_ERROR("Cannot create epoll\n", 1, "");
+
+    return 0;
+}
+
+void wd_loop_deinit(struct wd_loop *loop)
+{
+    WD_TRACE("");
+
+    if (loop == NULL || loop->epfd == -1)
+        return;
+
+    (void)close(loop->epfd);
+    loop->epfd = -1;
+}
+
+int wd_loop_add(struct wd_loop *loop, struct wd_event *ev, uint32_t events)
+{
+    struct epoll_event epev;
+
+    WD_TRACE("");
+
+    if (loop == NULL || ev == NULL)
+        WD_ERROR("loop == NULL || ev == NULL\n", 1, "");
+
+    (void)memset(&epev, 0, sizeof(epev));
+    epev.events = events;
+    epev.data.ptr = ev;
+
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, ev->fd, &epev) == -1)
+        WD_ERROR("Cannot add fd %d to loop\n", 1, ev->fd);
+
+    return 0;
+}
+
+int wd_loop_del(struct wd_loop *loop, struct wd_event *ev)
+{
+    WD_TRACE("");
+
+    if (loop == NULL || ev == NULL)
+        WD_ERROR("loop == NULL || ev == NULL\n", 1, "");
+
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_DEL, ev->fd, NULL) == -1)
+        WD_ERROR("Cannot remove fd %d from loop\n", 1, ev->fd);
+
+    return 0;
+}
+
+int wd_loop_mod(struct wd_loop *loop, struct wd_event *ev, uint32_t events)
+{
+    struct epoll_event epev;
+
+    WD_TRACE("");
+
+    if (loop == NULL || ev == NULL)
+        WD_ERROR("loop == NULL || ev == NULL\n", 1, "");
+
+    (void)memset(&epev, 0, sizeof(epev));
+    epev.events = events;
+    epev.data.ptr = ev;
+
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_MOD, ev->fd, &epev) == -1)
+        WD_ERROR("Cannot modify fd %d in loop\n", 1, ev->fd);
+
+    return 0;
+}
+
+int wd_loop_run(struct wd_loop *loop)
+{
+    struct epoll_event events[WD_LOOP_MAX_EVENTS];
+    struct wd_event *ev;
+    int n;
+    int i;
+
+    WD_TRACE("");
+
+    if (loop == NULL)
+        WD_ERROR("loop == NULL\n", 1, "");
+
+    loop->running = true;
+    while (loop->running)
+    {
+        n = epoll_wait(loop->epfd, events, WD_LOOP_MAX_EVENTS, -1);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+
+            WD_ERROR("epoll_wait failed\n", 1, "");
+        }
+
+        for (i = 0; i < n; ++i)
+        {
+            ev = (struct wd_event *)events[i].data.ptr;
+            ev->cb(ev, events[i].events);
+        }
+    }
+
+    return 0;
+}
+
+void wd_loop_stop(struct wd_loop *loop)
+{
+    WD_TRACE("");
+
+    if (loop == NULL)
+        return;
+
+    loop->running = false;
+}
+
+int wd_timer_create(void)
+{
+    int tfd;
+
+    WD_TRACE("");
+
+    tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tfd == -1)
+        WD_ERROR("Cannot create timer\n", -1, "");
+
+    return tfd;
+}
+
+int wd_timer_arm(int tfd, uint64_t deadline_ns)
+{
+    struct itimerspec its;
+
+    WD_TRACE("");
+
+    (void)memset(&its, 0, sizeof(its));
+    wd_time_to_timespec(deadline_ns, &its.it_value);
+
+    if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) == -1)
+        WD_ERROR("Cannot arm timer\n", 1, "");
+
+    return 0;
+}
+
+int wd_timer_ack(int tfd, uint64_t *expirations)
+{
+    uint64_t exp = 0;
+
+    WD_TRACE("");
+
+    if (read(tfd, &exp, sizeof(exp)) != (ssize_t)sizeof(exp))
+    {
+        /* spurious wakeup */
+        if (errno == EAGAIN)
+            exp = 0;
+        else
+            WD_ERROR("Cannot read timer\n", 1, "");
+    }
+
+    if (expirations != NULL)
+        *expirations = exp;
+
+    return 0;
+}
@@ -0,0 +1,228 @@
+#include <wd_psi.h>
+#include <wd_time.h>
+#include <wd_log.h>
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define WD_PSI_ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+/* trigger fires at most once per window, missing next one ends episode */
+#define WD_PSI_EPISODE_GAP_NS(conf) (2 * (conf)->window_ns)
+
+static const char *const wd_psi_res[] =
+{
+    [WD_PSI_CPU]    = "cpu",
+    [WD_PSI_MEMORY] = "memory",
+    [WD_PSI_IO]     = "io"
+};
+
+static void wd_psi_event(struct wd_event *ev, uint32_t events);
+static int wd_psi_trigger_init(struct wd_psi_trigger *trigger, struct wd_loop *loop);
+
+static void wd_psi_event(struct wd_event *ev, uint32_t events)
+{
+    struct wd_psi_trigger *trigger = (struct wd_psi_trigger *)ev->arg;
+    const uint64_t now = wd_time_now_ns();
+    char name[256];
+
+    /* cgroup was removed, epoll forgets closed descriptor */
+    if (events & EPOLLERR)
+    {
+        WD_LOG("PSI trigger %s is gone\n", wd_psi_name(trigger, name, sizeof(name)));
+        (void)close(ev->fd);
+        ev->fd = -1;
+        trigger->last_ns = 0;
+
+        return;
+    }
+
+    if (!(events & EPOLLPRI))
+        return;
+
+    ++trigger->events;
+    if (trigger->last_ns == 0 || now - trigger->last_ns > WD_PSI_EPISODE_GAP_NS(&trigger->conf))
+    {
+        trigger->since_ns = now;
+        ++trigger->episodes;
+    }
+
+    trigger->last_ns = now;
+    if (now - trigger->since_ns > trigger->max_ns)
+        trigger->max_ns = now - trigger->since_ns;
+}
+
+static int wd_psi_trigger_init(struct wd_psi_trigger *trigger, struct wd_loop *loop)
+{
+    const struct wd_psi_conf *conf = &trigger->conf;
+    char path[512];
+    char buf[64];
+    int len;
+
+    if (conf->cgroup)
+        (void)snprintf(path, sizeof(path), "%s/%s.pressure", conf->cgroup, wd_psi_res[conf->res]);
+    else
+        (void)snprintf(path, sizeof(path), "/proc/pressure/%s", wd_psi_res[conf->res]);
+
+    trigger->ev.fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (trigger->ev.fd == -1)
+        WD_ERROR("Cannot open %s, kernel without PSI?\n", 1, path);
+
+    /* kernel takes stall and window in us, with terminating NUL */
+    len = snprintf(buf, sizeof(buf), "%s %" PRIu64 " %" PRIu64,
+                   conf->full ? "full" : "some", conf->stall_ns / WD_NSEC_PER_USEC, conf->window_ns / WD_NSEC_PER_USEC);
+    if (write(trigger->ev.fd, buf, (size_t)len + 1) < 0)
+        WD_ERROR("Cannot register trigger \"%s\" in %s, without CAP_SYS_RESOURCE window must be multiple of 2 s\n", 1, buf, path);
+
+    trigger->ev.cb = wd_psi_event;
+    trigger->ev.arg = trigger;
+
+    return wd_loop_add(loop, &trigger->ev, EPOLLPRI);
+}
+
+int wd_psi_parse(char *spec, struct wd_psi_conf *conf)
+{
+    char *opt;
+    char *sep;
+    char *end;
+    size_t i;
+
+    WD_TRACE("");
+
+    if (spec == NULL || conf == NULL)
+        WD_ERROR("spec == NULL || conf == NULL\n", 1, "");
+
+    (void)memset(conf, 0, sizeof(*conf));
+
+    /* cgroup is last, dir can contain anything but ",cgroup=" */
+    opt = strstr(spec, ",cgroup=");
+    if (opt != NULL)
+    {
+        *opt = '\0';
+        conf->cgroup = opt + strlen(",cgroup=");
+        if (*conf->cgroup == '\0')
+            WD_ERROR("Empty cgroup in PSI trigger %s\n", 1, spec);
+    }
+
+    sep = strchr(spec, ':');
+    if (sep == NULL)
+        WD_ERROR("PSI trigger %s has no threshold\n", 1, spec);
+
+    *sep++ = '\0';
+    for (i = 0; i < WD_PSI_ARRAY_SIZE(wd_psi_res); ++i)
+        if (strcmp(spec, wd_psi_res[i]) == 0)
+            break;
+
+    if (i == WD_PSI_ARRAY_SIZE(wd_psi_res))
+        WD_ERROR("Unknown PSI resource %s\n", 1, spec);
+
+    conf->res = (wd_psi_res_t)i;
+
+    if (strncmp(sep, "some=", strlen("some=")) == 0)
+        conf->full = false;
+    else if (strncmp(sep, "full=", strlen("full=")) == 0)
+        conf->full = true;
+    else
+        WD_ERROR("PSI threshold %s is neither some= nor full=\n", 1, sep);
+
+    sep += strlen("some=");
+    conf->stall_ns = strtoull(sep, &end, 0) * WD_NSEC_PER_MSEC;
+    if (end == sep || *end != '/')
+        WD_ERROR("Incorrect PSI stall time in %s\n", 1, sep);
+
+    sep = end + 1;
+    conf->window_ns = strtoull(sep, &end, 0) * WD_NSEC_PER_MSEC;
+    if (end == sep || *end != '\0')
+        WD_ERROR("Incorrect PSI window in %s\n", 1, sep);
+
+    if (conf->window_ns < WD_PSI_MIN_WINDOW_MS * WD_NSEC_PER_MSEC ||
+        conf->window_ns > WD_PSI_MAX_WINDOW_MS * WD_NSEC_PER_MSEC)
+        WD_ERROR("PSI window must be in %d .. %d ms\n", 1, WD_PSI_MIN_WINDOW_MS, WD_PSI_MAX_WINDOW_MS);
+
+    if (conf->stall_ns == 0 || conf->stall_ns > conf->window_ns)
+        WD_ERROR("PSI stall time must be in 1 .. window ms\n", 1, "");
+
+    return 0;
+}
+
+int wd_psi_init(struct wd_psi *psi, const struct wd_psi_conf *confs, size_t n, uint64_t hold_ns, struct wd_loop *loop)
+{
+    struct wd_psi_trigger *trigger;
+
+    WD_TRACE("");
+
+    if (psi == NULL || (confs == NULL && n) || loop == NULL)
+        WD_ERROR("psi == NULL || confs == NULL || loop == NULL\n", 1, "");
+
+    if (n > WD_PSI_MAX)
+        WD_ERROR("Too many PSI triggers, max is %d\n", 1, WD_PSI_MAX);
+
+    (void)memset(psi, 0, sizeof(*psi));
+    psi->hold_ns = hold_ns;
+
+    /* n grows with every trigger, so deinit closes only opened ones */
+    for (psi->n = 0; psi->n < n; )
+    {
+        trigger = &psi->triggers[psi->n++];
+        trigger->conf = confs[psi->n - 1];
+        trigger->ev.fd = -1;
+
+        if (wd_psi_trigger_init(trigger, loop))
+            return 1;
+    }
+
+    return 0;
+}
+
+void wd_psi_deinit(struct wd_psi *psi)
+{
+    size_t i;
+
+    WD_TRACE("");
+
+    if (psi == NULL)
+        return;
+
+    for (i = 0; i < psi->n; ++i)
+        if (psi->triggers[i].ev.fd != -1)
+            (void)close(psi->triggers[i].ev.fd);
+
+    psi->n = 0;
+}
+
+const struct wd_psi_trigger *wd_psi_starving(const struct wd_psi *psi, uint64_t now)
+{
+    const struct wd_psi_trigger *trigger;
+    size_t i;
+
+    if (psi == NULL)
+        return NULL;
+
+    for (i = 0; i < psi->n; ++i)
+    {
+        trigger = &psi->triggers[i];
+        if (trigger->last_ns == 0 || now - trigger->last_ns > WD_PSI_EPISODE_GAP_NS(&trigger->conf))
+            continue;
+
+        if (now - trigger->since_ns >= psi->hold_ns)
+            return trigger;
+    }
+
+    return NULL;
+}
+
+const char *wd_psi_name(const struct wd_psi_trigger *trigger, char *buf, size_t size)
+{
+    const struct wd_psi_conf *conf = &trigger->conf;
+
+    (void)snprintf(buf, size, "%s %s %" PRIu64 "/%" PRIu64 " ms%s%s",
+                   wd_psi_res[conf->res], conf->full ? "full" : "some",
+                   conf->stall_ns / WD_NSEC_PER_MSEC, conf->window_ns / WD_NSEC_PER_MSEC,
+                   conf->cgroup ? " in " : "", conf->cgroup ? conf->cgroup : "");
+
+    return buf;
+}
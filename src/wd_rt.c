@@ -0,0 +1,192 @@
+#define _GNU_SOURCE
+#include <wd_rt.h>
+#include <wd_log.h>
+#include <sched.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#include <alloca.h>
+#include <inttypes.h>
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+
+#define WD_RT_NSEC_PER_USEC ((uint64_t)1000)
+
+/* glibc does not wrap sched_setattr, layout from include/uapi/linux/sched/types.h */
+struct wd_sched_attr
+{
+    uint32_t    size;
+    uint32_t    sched_policy;
+    uint64_t    sched_flags;
+    int32_t     sched_nice;
+    uint32_t    sched_priority;
+    uint64_t    sched_runtime;
+    uint64_t    sched_deadline;
+    uint64_t    sched_period;
+};
+
+static int wd_rt_set_deadline(const struct wd_rt_conf *conf);
+static int wd_rt_set_fifo(const struct wd_rt_conf *conf);
+static int wd_rt_pin(int cpu);
+static int wd_rt_lock(size_t stack_prefault);
+static void wd_rt_prefault_stack(size_t size) __attribute__((noinline));
+
+static int wd_rt_set_deadline(const struct wd_rt_conf *conf)
+{
+    struct wd_sched_attr attr;
+
+    (void)memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.sched_policy = SCHED_DEADLINE;
+    attr.sched_runtime = conf->dl_runtime_us * WD_RT_NSEC_PER_USEC;
+    attr.sched_deadline = conf->dl_period_us * WD_RT_NSEC_PER_USEC;
+    attr.sched_period = conf->dl_period_us * WD_RT_NSEC_PER_USEC;
+
+    if (syscall(SYS_sched_setattr, 0, &attr, 0) == -1)
+        WD_ERROR("Cannot set SCHED_DEADLINE %" PRIu64 "/%" PRIu64 " us\n", 1, conf->dl_runtime_us, conf->dl_period_us);
+
+    return 0;
+}
+
+static int wd_rt_set_fifo(const struct wd_rt_conf *conf)
+{
+    struct sched_param param;
+
+    (void)memset(&param, 0, sizeof(param));
+    param.sched_priority = conf->prio;
+
+    if (sched_setscheduler(0, SCHED_FIFO, &param) == -1)
+        WD_ERROR("Cannot set SCHED_FIFO priority %d\n", 1, conf->prio);
+
+    return 0;
+}
+
+static int wd_rt_pin(int cpu)
+{
+    cpu_set_t set;
+
+    if (cpu < 0 || cpu >= CPU_SETSIZE)
+        WD_ERROR("Incorrect CPU %d\n", 1, cpu);
+
+    CPU_ZERO(&set);
+    CPU_SET((size_t)cpu, &set);
+
+    if (sched_setaffinity(0, sizeof(set), &set) == -1)
+        WD_ERROR("Cannot pin to CPU %d\n", 1, cpu);
+
+    return 0;
+}
+
+static void wd_rt_prefault_stack(size_t size)
+{
+    volatile char *stack = alloca(size);
+    size_t i;
+    const long page = sysconf(_SC_PAGESIZE);
+
+    /* touch every page, mlockall keeps them resident from now on */
+    for (i = 0; i < size; i += (size_t)page)
+        stack[i] = 0;
+}
+
+static int wd_rt_lock(size_t stack_prefault)
+{
+    /* freed memory stays in process, next malloc cannot fault */
+    (void)mallopt(M_TRIM_THRESHOLD, -1);
+    (void)mallopt(M_MMAP_MAX, 0);
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1)
+        WD_ERROR("Cannot lock memory\n", 1, "");
+
+    if (stack_prefault)
+        wd_rt_prefault_stack(stack_prefault);
+
+    return 0;
+}
+
+void wd_rt_conf_init(struct wd_rt_conf *conf)
+{
+    WD_TRACE("");
+
+    if (conf == NULL)
+        return;
+
+    (void)memset(conf, 0, sizeof(*conf));
+    conf->sched = WD_RT_SCHED_NONE;
+    conf->prio = WD_RT_DEFAULT_FIFO_PRIO;
+    conf->dl_runtime_us = WD_RT_DEFAULT_DL_RUNTIME_US;
+    conf->dl_period_us = WD_RT_DEFAULT_DL_PERIOD_US;
+    conf->cpu = -1;
+    conf->stack_prefault = WD_RT_DEFAULT_STACK_PREFAULT;
+}
+
+bool wd_rt_enabled(const struct wd_rt_conf *conf)
+{
+    return conf != NULL && (conf->sched != WD_RT_SCHED_NONE || conf->cpu != -1 || conf->mlock);
+}
+
+int wd_rt_apply(const struct wd_rt_conf *conf)
+{
+    WD_TRACE("");
+
+    if (conf == NULL)
+        WD_ERROR("conf == NULL\n", 1, "");
+
+    /* admission control of SCHED_DEADLINE rejects tasks with reduced affinity */
+    if (conf->sched == WD_RT_SCHED_DEADLINE && conf->cpu != -1)
+        WD_ERROR("SCHED_DEADLINE cannot be pinned to CPU\n", 1, "");
+
+    if (conf->sched == WD_RT_SCHED_DEADLINE &&
+        (conf->dl_runtime_us == 0 || conf->dl_runtime_us > conf->dl_period_us))
+        WD_ERROR("Incorrect SCHED_DEADLINE runtime %" PRIu64 " us period %" PRIu64 " us\n", 1,
+                 conf->dl_runtime_us, conf->dl_period_us);
+
+    if (conf->cpu != -1 && wd_rt_pin(conf->cpu))
+        return 1;
+
+    if (conf->mlock && wd_rt_lock(conf->stack_prefault))
+        return 1;
+
+    switch (conf->sched)
+    {
+        case WD_RT_SCHED_FIFO:
+            return wd_rt_set_fifo(conf);
+        case WD_RT_SCHED_DEADLINE:
+            return wd_rt_set_deadline(conf);
+        case WD_RT_SCHED_NONE:
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+int wd_rt_usage_get(struct wd_rt_usage *usage)
+{
+    struct rusage ru;
+
+    if (usage == NULL)
+        WD_ERROR("usage == NULL\n", 1, "");
+
+    if (getrusage(RUSAGE_THREAD, &ru) == -1)
+        WD_ERROR("Cannot get thread usage\n", 1, "");
+
+    usage->minflt = ru.ru_minflt;
+    usage->majflt = ru.ru_majflt;
+    usage->nvcsw = ru.ru_nvcsw;
+    usage->nivcsw = ru.ru_nivcsw;
+
+    return 0;
+}
+
+void wd_rt_usage_diff(const struct wd_rt_usage *start, const struct wd_rt_usage *end, struct wd_rt_usage *diff)
+{
+    diff->minflt = end->minflt - start->minflt;
+    diff->majflt = end->majflt - start->majflt;
+    diff->nvcsw = end->nvcsw - start->nvcsw;
+    diff->nivcsw = end->nivcsw - start->nivcsw;
+}
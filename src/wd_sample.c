@@ -0,0 +1,707 @@
+#include <wd_sample.h>
+#include <wd_time.h>
+#include <wd_log.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <sched.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
+
+#define WD_SAMPLE_ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define WD_SAMPLE_EVENTS        64      /* queued trips and clears, power of 2 */
+#define WD_SAMPLE_REAP_MS       1000    /* notifier reaps hooks at least this often */
+
+extern char **environ;
+
+typedef enum
+{
+    WD_SAMPLE_EV_CLEAR = 0,
+    WD_SAMPLE_EV_TRIP,
+    WD_SAMPLE_EV_PANIC
+} wd_sample_ev_t;
+
+struct wd_sample_event
+{
+    struct wd_sampler   *sampler;
+    size_t              rule;
+    wd_sample_ev_t      type;
+    double              val;
+};
+
+/* single producer (loop) single consumer (thread) ring */
+struct wd_sample_notifier
+{
+    struct wd_sample_event  events[WD_SAMPLE_EVENTS];
+    uint64_t                head;       /* written only by loop */
+    uint64_t                tail;       /* written only by thread */
+    uint64_t                dropped;    /* ring was full, written only by loop */
+    int                     efd;
+    pthread_t               thread;
+    bool                    stop;
+    size_t                  n;
+    struct wd_sampler       *samplers[];
+};
+
+static const char *const wd_sample_metrics[] =
+{
+    [WD_SAMPLE_TEMP]    = "temp",
+    [WD_SAMPLE_RATE]    = "rate",
+    [WD_SAMPLE_STATUS]  = "status"
+};
+
+static const char *const wd_sample_cmps[] =
+{
+    [WD_SAMPLE_GE]      = ">=",
+    [WD_SAMPLE_LE]      = "<=",
+    [WD_SAMPLE_ANY]     = "&"
+};
+
+static void wd_sample_push(struct wd_sample_window *window, int val);
+static bool wd_sampler_read(struct wd_sampler *sampler, uint64_t now);
+static bool wd_sampler_match(const struct wd_sampler *sampler, const struct wd_sample_rule *rule, bool tripped,
+                             double *val);
+static void wd_sampler_report(struct wd_sampler *sampler, size_t i, wd_sample_ev_t type, double val);
+static void wd_sampler_event(struct wd_sampler *sampler, size_t i, wd_sample_ev_t type, double val);
+static bool wd_sampler_rules(struct wd_sampler *sampler);
+static bool wd_sampler_heading(const struct wd_sampler *sampler);
+static pid_t wd_sampler_hook(const struct wd_sampler *sampler, const struct wd_sample_rule *rule, double val);
+static void wd_sampler_reap(struct wd_sampler *sampler);
+static void wd_sampler_tick(struct wd_event *ev, uint32_t events);
+static void *wd_sample_notifier_run(void *arg);
+
+static void wd_sample_push(struct wd_sample_window *window, int val)
+{
+    bool rescan = false;
+    int old;
+    size_t i;
+
+    if (window->n == WD_SAMPLE_WINDOW)
+    {
+        old = window->vals[window->head];
+        window->sum -= old;
+        rescan = old == window->min || old == window->max;
+    }
+    else
+        ++window->n;
+
+    window->vals[window->head] = val;
+    window->head = (window->head + 1) % WD_SAMPLE_WINDOW;
+    window->sum += val;
+    window->last = val;
+    window->ewma = window->n == 1 ? (double)val : window->ewma + WD_SAMPLE_EWMA_ALPHA * ((double)val - window->ewma);
+
+    if (window->n == 1)
+    {
+        window->min = val;
+        window->max = val;
+    }
+    else if (rescan)
+    {
+        /* evicted extreme, window is small and this is rare */
+        window->min = window->vals[0];
+        window->max = window->vals[0];
+        for (i = 1; i < window->n; ++i)
+        {
+            if (window->vals[i] < window->min)
+                window->min = window->vals[i];
+
+            if (window->vals[i] > window->max)
+                window->max = window->vals[i];
+        }
+    }
+    else
+    {
+        if (val < window->min)
+            window->min = val;
+
+        if (val > window->max)
+            window->max = val;
+    }
+}
+
+/* returns true iff anything changed more than noise */
+static bool wd_sampler_read(struct wd_sampler *sampler, uint64_t now)
+{
+    bool changed = false;
+    double slope;
+    int status;
+    int temp;
+
+    ++sampler->samples;
+
+    if (sampler->has_temp)
+    {
+        if (wd_get_temp(sampler->wd, &temp) == 0)
+        {
+            if (sampler->temp.n > 0 && now > sampler->last_ns)
+            {
+                slope = (double)(temp - sampler->temp.last) * 60.0 * (double)WD_NSEC_PER_SEC /
+                        (double)(now - sampler->last_ns);
+                sampler->rate = sampler->temp.n == 1 ? slope :
+                                sampler->rate + WD_SAMPLE_EWMA_ALPHA * (slope - sampler->rate);
+
+                changed = (double)temp > sampler->temp.ewma + sampler->conf->stable ||
+                          (double)temp < sampler->temp.ewma - sampler->conf->stable;
+            }
+
+            wd_sample_push(&sampler->temp, temp);
+            sampler->last_ns = now;
+        }
+        else
+        {
+            ++sampler->errors;
+            changed = true;
+        }
+    }
+
+    if (sampler->has_status)
+    {
+        if (wd_get_status(sampler->wd, &status) == 0)
+        {
+            changed |= status != sampler->status;
+            sampler->status = status;
+        }
+        else
+        {
+            ++sampler->errors;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+static bool wd_sampler_match(const struct wd_sampler *sampler, const struct wd_sample_rule *rule, bool tripped,
+                             double *val)
+{
+    /* tripped temp rule clears only below threshold - stable, no flapping on noise */
+    const double hyst = tripped ? (double)sampler->conf->stable : 0.0;
+
+    switch (rule->metric)
+    {
+        case WD_SAMPLE_TEMP:
+        {
+            if (!sampler->has_temp || sampler->temp.n == 0)
+                return false;
+
+            *val = (double)sampler->temp.last;
+            break;
+        }
+        case WD_SAMPLE_RATE:
+        {
+            if (!sampler->has_temp || sampler->temp.n < 2)
+                return false;
+
+            *val = sampler->rate;
+            if (rule->cmp == WD_SAMPLE_GE)
+                return *val >= (double)rule->threshold;
+
+            return *val <= (double)rule->threshold;
+        }
+        case WD_SAMPLE_STATUS:
+        {
+            if (!sampler->has_status)
+                return false;
+
+            *val = (double)sampler->status;
+            return (sampler->status & (int)rule->threshold) != 0;
+        }
+        default:
+        {
+            return false;
+        }
+    }
+
+    if (rule->cmp == WD_SAMPLE_GE)
+        return *val >= (double)rule->threshold - hyst;
+
+    return *val <= (double)rule->threshold + hyst;
+}
+
+/* does stdio and may spawn, runs in loop or on notifier thread */
+static void wd_sampler_report(struct wd_sampler *sampler, size_t i, wd_sample_ev_t type, double val)
+{
+    const struct wd_sample_rule *rule = &sampler->conf->rules[i];
+    struct wd_sample_trip *trip = &sampler->trips[i];
+    char name[64];
+
+    switch (type)
+    {
+        case WD_SAMPLE_EV_CLEAR:
+        {
+            WD_LOG("%s: %s cleared, value %.1f\n", sampler->dev, wd_sample_rule_name(rule, name, sizeof(name)), val);
+            break;
+        }
+        case WD_SAMPLE_EV_TRIP:
+        {
+            WD_LOG("%s: %s tripped, value %.1f\n", sampler->dev, wd_sample_rule_name(rule, name, sizeof(name)), val);
+            if (rule->exec != NULL && trip->hook == 0)
+                trip->hook = wd_sampler_hook(sampler, rule, val);
+
+            break;
+        }
+        case WD_SAMPLE_EV_PANIC:
+        {
+            WD_LOG("%s: temperature panic enabled\n", sampler->dev);
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+}
+
+/* never blocks, full ring drops event, trip counters in sampler stay exact */
+static void wd_sampler_event(struct wd_sampler *sampler, size_t i, wd_sample_ev_t type, double val)
+{
+    struct wd_sample_notifier *notifier = sampler->notifier;
+    const uint64_t one = 1;
+    uint64_t head;
+
+    if (notifier == NULL)
+    {
+        wd_sampler_report(sampler, i, type, val);
+        return;
+    }
+
+    head = notifier->head;
+    if (head - __atomic_load_n(&notifier->tail, __ATOMIC_ACQUIRE) == WD_SAMPLE_EVENTS)
+    {
+        ++notifier->dropped;
+        return;
+    }
+
+    notifier->events[head % WD_SAMPLE_EVENTS] = (struct wd_sample_event){.sampler = sampler, .rule = i,
+                                                                         .type = type, .val = val};
+    __atomic_store_n(&notifier->head, head + 1, __ATOMIC_RELEASE);
+    (void)write(notifier->efd, &one, sizeof(one));
+}
+
+/* returns true iff any rule is tripped */
+static bool wd_sampler_rules(struct wd_sampler *sampler)
+{
+    const struct wd_sample_rule *rule;
+    struct wd_sample_trip *trip;
+    bool any = false;
+    bool match;
+    double val = 0.0;
+    size_t i;
+
+    for (i = 0; i < sampler->conf->nrules; ++i)
+    {
+        rule = &sampler->conf->rules[i];
+        trip = &sampler->trips[i];
+        match = wd_sampler_match(sampler, rule, trip->tripped, &val);
+        any |= match;
+
+        if (match == trip->tripped)
+            continue;
+
+        trip->tripped = match;
+        if (!match)
+        {
+            wd_sampler_event(sampler, i, WD_SAMPLE_EV_CLEAR, val);
+            continue;
+        }
+
+        ++trip->trips;
+        wd_sampler_event(sampler, i, WD_SAMPLE_EV_TRIP, val);
+
+        /* kernel panics on next overheat instead of waiting for reset */
+        if (rule->panic && !sampler->panic_set)
+        {
+            if (wd_set_options(sampler->wd, WDIOS_TEMPPANIC) == 0)
+            {
+                sampler->panic_set = true;
+                wd_sampler_event(sampler, i, WD_SAMPLE_EV_PANIC, val);
+            }
+        }
+    }
+
+    return any;
+}
+
+/* temperature moving towards threshold it can cross before next sample */
+static bool wd_sampler_heading(const struct wd_sampler *sampler)
+{
+    const struct wd_sample_rule *rule;
+    const double minutes = 2.0 * (double)sampler->period_ns / (60.0 * (double)WD_NSEC_PER_SEC);
+    const double next = (double)sampler->temp.last + sampler->rate * minutes;
+    size_t i;
+
+    if (!sampler->has_temp || sampler->temp.n < 2)
+        return false;
+
+    for (i = 0; i < sampler->conf->nrules; ++i)
+    {
+        rule = &sampler->conf->rules[i];
+        if (rule->metric != WD_SAMPLE_TEMP)
+            continue;
+
+        if ((rule->cmp == WD_SAMPLE_GE && next >= (double)rule->threshold) ||
+            (rule->cmp == WD_SAMPLE_LE && next <= (double)rule->threshold))
+            return true;
+    }
+
+    return false;
+}
+
+static pid_t wd_sampler_hook(const struct wd_sampler *sampler, const struct wd_sample_rule *rule, double val)
+{
+    posix_spawnattr_t attr;
+    struct sched_param param;
+    sigset_t none;
+    char name[64];
+    char value[32];
+    char *const argv[] = {(char *)"sh", (char *)"-c", (char *)rule->exec, (char *)"wd-sample",
+                          (char *)sampler->dev, name, value, NULL};
+    pid_t pid;
+    int err;
+
+    (void)wd_sample_rule_name(rule, name, sizeof(name));
+    (void)snprintf(value, sizeof(value), "%.1f", val);
+
+    if (posix_spawnattr_init(&attr) != 0)
+        return 0;
+
+    /* feeder blocks signals for signalfd and may run RT, hook gets neither */
+    (void)sigemptyset(&none);
+    (void)memset(&param, 0, sizeof(param));
+    (void)posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSCHEDULER);
+    (void)posix_spawnattr_setpgroup(&attr, 0);
+    (void)posix_spawnattr_setsigmask(&attr, &none);
+    (void)posix_spawnattr_setschedpolicy(&attr, SCHED_OTHER);
+    (void)posix_spawnattr_setschedparam(&attr, &param);
+    err = posix_spawn(&pid, "/bin/sh", NULL, &attr, argv, environ);
+    (void)posix_spawnattr_destroy(&attr);
+    if (err != 0)
+    {
+        errno = err;
+        WD_ERROR("%s: Cannot run hook %s\n", 0, sampler->dev, rule->exec);
+    }
+
+    return pid;
+}
+
+static void wd_sampler_reap(struct wd_sampler *sampler)
+{
+    size_t i;
+    int status;
+
+    for (i = 0; i < sampler->conf->nrules; ++i)
+        if (sampler->trips[i].hook > 0 && waitpid(sampler->trips[i].hook, &status, WNOHANG) != 0)
+            sampler->trips[i].hook = 0;
+}
+
+static void wd_sampler_tick(struct wd_event *ev, uint32_t events)
+{
+    struct wd_sampler *sampler = (struct wd_sampler *)ev->arg;
+    const uint64_t now = wd_time_now_ns();
+    uint64_t exp;
+    bool busy;
+
+    (void)events;
+
+    if (wd_timer_ack(ev->fd, &exp) || exp == 0)
+        return;
+
+    busy = wd_sampler_read(sampler, now);
+
+    /* hooks spawned by notifier are reaped by notifier */
+    if (sampler->notifier == NULL)
+        wd_sampler_reap(sampler);
+
+    busy |= wd_sampler_rules(sampler);
+    busy |= wd_sampler_heading(sampler);
+
+    /* stable box is sampled less and less often, anything interesting resets it */
+    if (busy)
+    {
+        sampler->stable = 0;
+        sampler->period_ns = sampler->conf->min_period_ns;
+    }
+    else if (++sampler->stable >= WD_SAMPLE_STABLE_TICKS)
+    {
+        sampler->stable = 0;
+        sampler->period_ns *= 2;
+        if (sampler->period_ns > sampler->conf->max_period_ns)
+            sampler->period_ns = sampler->conf->max_period_ns;
+    }
+
+    (void)wd_timer_arm(ev->fd, now + sampler->period_ns);
+}
+
+static void *wd_sample_notifier_run(void *arg)
+{
+    struct wd_sample_notifier *notifier = (struct wd_sample_notifier *)arg;
+    struct pollfd pfd = {.fd = notifier->efd, .events = POLLIN};
+    const struct wd_sample_event *ev;
+    uint64_t head;
+    uint64_t cnt;
+    bool stop;
+    size_t i;
+
+    do
+    {
+        (void)poll(&pfd, 1, WD_SAMPLE_REAP_MS);
+        (void)read(notifier->efd, &cnt, sizeof(cnt));
+
+        /* stop is seen only after events queued before it are reported */
+        stop = __atomic_load_n(&notifier->stop, __ATOMIC_ACQUIRE);
+        head = __atomic_load_n(&notifier->head, __ATOMIC_ACQUIRE);
+        while (notifier->tail != head)
+        {
+            ev = &notifier->events[notifier->tail % WD_SAMPLE_EVENTS];
+            wd_sampler_report(ev->sampler, ev->rule, ev->type, ev->val);
+            __atomic_store_n(&notifier->tail, notifier->tail + 1, __ATOMIC_RELEASE);
+        }
+
+        for (i = 0; i < notifier->n; ++i)
+            wd_sampler_reap(notifier->samplers[i]);
+    } while (!stop);
+
+    return NULL;
+}
+
+void wd_sample_conf_init(struct wd_sample_conf *conf)
+{
+    WD_TRACE("");
+
+    if (conf == NULL)
+        return;
+
+    (void)memset(conf, 0, sizeof(*conf));
+    conf->min_period_ns = WD_SAMPLE_DEFAULT_MIN_MS * WD_NSEC_PER_MSEC;
+    conf->max_period_ns = WD_SAMPLE_DEFAULT_MAX_MS * WD_NSEC_PER_MSEC;
+    conf->stable = WD_SAMPLE_DEFAULT_STABLE;
+}
+
+int wd_sample_parse(char *spec, struct wd_sample_rule *rule)
+{
+    char *opt;
+    char *val;
+    char *end;
+    size_t len;
+    size_t i;
+    size_t j;
+
+    WD_TRACE("");
+
+    if (spec == NULL || rule == NULL)
+        WD_ERROR("spec == NULL || rule == NULL\n", 1, "");
+
+    (void)memset(rule, 0, sizeof(*rule));
+
+    /* exec is last, command can contain anything but ",exec=" */
+    opt = strstr(spec, ",exec=");
+    if (opt != NULL)
+    {
+        *opt = '\0';
+        rule->exec = opt + strlen(",exec=");
+        if (*rule->exec == '\0')
+            WD_ERROR("Empty hook in sample rule %s\n", 1, spec);
+    }
+
+    opt = strstr(spec, ",panic");
+    if (opt != NULL)
+    {
+        if (opt[strlen(",panic")] != '\0')
+            WD_ERROR("Unknown option %s in sample rule\n", 1, opt + 1);
+
+        *opt = '\0';
+        rule->panic = true;
+    }
+
+    for (i = 0; i < WD_SAMPLE_ARRAY_SIZE(wd_sample_metrics); ++i)
+        if (strncmp(spec, wd_sample_metrics[i], strlen(wd_sample_metrics[i])) == 0)
+            break;
+
+    if (i == WD_SAMPLE_ARRAY_SIZE(wd_sample_metrics))
+        WD_ERROR("Unknown sample metric in %s\n", 1, spec);
+
+    val = spec + strlen(wd_sample_metrics[i]);
+    for (j = 0; j < WD_SAMPLE_ARRAY_SIZE(wd_sample_cmps); ++j)
+        if (strncmp(val, wd_sample_cmps[j], strlen(wd_sample_cmps[j])) == 0)
+            break;
+
+    if (j == WD_SAMPLE_ARRAY_SIZE(wd_sample_cmps))
+        WD_ERROR("Sample rule %s has no >=, <= or &\n", 1, spec);
+
+    rule->metric = (wd_sample_metric_t)i;
+    rule->cmp = (wd_sample_cmp_t)j;
+
+    /* status is bit set, temperature and rate are values */
+    if ((rule->metric == WD_SAMPLE_STATUS) != (rule->cmp == WD_SAMPLE_ANY))
+        WD_ERROR("Sample rule %s: status takes &, temp and rate take >= or <=\n", 1, spec);
+
+    len = strlen(wd_sample_cmps[j]);
+    errno = 0;
+    rule->threshold = (int64_t)strtoll(val + len, &end, 0);
+    if (end == val + len || *end != '\0' || errno != 0)
+        WD_ERROR("Incorrect value in sample rule %s\n", 1, spec);
+
+    if (rule->metric == WD_SAMPLE_STATUS && rule->threshold <= 0)
+        WD_ERROR("Sample rule %s needs non-zero mask\n", 1, spec);
+
+    if (rule->panic && rule->metric == WD_SAMPLE_STATUS)
+        WD_ERROR("Temperature panic needs temp or rate rule\n", 1, "");
+
+    return 0;
+}
+
+int wd_sampler_init(struct wd_sampler *sampler, const struct wd_sample_conf *conf, watchdog_t wd,
+                    const char *dev, struct wd_loop *loop)
+{
+    struct wd_snapshot snap;
+    size_t i;
+
+    WD_TRACE("");
+
+    if (sampler == NULL || conf == NULL || loop == NULL || dev == NULL)
+        WD_ERROR("sampler == NULL || conf == NULL || loop == NULL || dev == NULL\n", 1, "");
+
+    if (conf->min_period_ns == 0 || conf->max_period_ns < conf->min_period_ns)
+        WD_ERROR("Sample period must be 0 < min <= max\n", 1, "");
+
+    (void)memset(sampler, 0, sizeof(*sampler));
+    sampler->timer.fd = -1;
+    sampler->conf = conf;
+    sampler->wd = wd;
+    sampler->dev = dev;
+    sampler->period_ns = conf->min_period_ns;
+
+    /* unsupported fields are never polled, first sample is taken here */
+    snap.valid = 0;
+    (void)wd_get_snapshot(wd, &snap, WD_SNAP_TEMP | WD_SNAP_STATUS);
+    sampler->has_temp = (snap.valid & WD_SNAP_TEMP) != 0;
+    sampler->has_status = (snap.valid & WD_SNAP_STATUS) != 0;
+    if (!sampler->has_temp && !sampler->has_status)
+        WD_ERROR("%s: Device reports neither temperature nor status, nothing to sample\n", 1, dev);
+
+    for (i = 0; i < conf->nrules; ++i)
+        if (conf->rules[i].metric != WD_SAMPLE_STATUS && !sampler->has_temp)
+            WD_LOG("%s: No temperature, temp and rate rules never trip\n", dev);
+
+    sampler->last_ns = wd_time_now_ns();
+    if (sampler->has_temp)
+        wd_sample_push(&sampler->temp, snap.temp);
+
+    if (sampler->has_status)
+        sampler->status = snap.status;
+
+    sampler->timer.fd = wd_timer_create();
+    if (sampler->timer.fd == -1)
+        return 1;
+
+    sampler->timer.cb = wd_sampler_tick;
+    sampler->timer.arg = sampler;
+
+    if (wd_timer_arm(sampler->timer.fd, sampler->last_ns + sampler->period_ns))
+        return 1;
+
+    return wd_loop_add(loop, &sampler->timer, EPOLLIN);
+}
+
+void wd_sampler_deinit(struct wd_sampler *sampler)
+{
+    WD_TRACE("");
+
+    if (sampler == NULL || sampler->timer.fd == -1)
+        return;
+
+    /* running hooks are not waited for, init reaps them */
+    (void)close(sampler->timer.fd);
+    sampler->timer.fd = -1;
+}
+
+struct wd_sample_notifier *wd_sample_notifier_start(struct wd_sampler *const *samplers, size_t n)
+{
+    struct wd_sample_notifier *notifier;
+    size_t i;
+
+    WD_TRACE("");
+
+    if (samplers == NULL || n == 0)
+        WD_ERROR("samplers == NULL || n == 0\n", NULL, "");
+
+    notifier = calloc(1, sizeof(*notifier) + n * sizeof(notifier->samplers[0]));
+    if (notifier == NULL)
+        WD_ERROR("Cannot allocate sample notifier\n", NULL, "");
+
+    notifier->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (notifier->efd == -1)
+    {
+        free(notifier);
+        WD_ERROR("Cannot create eventfd\n", NULL, "");
+    }
+
+    notifier->n = n;
+    for (i = 0; i < n; ++i)
+        notifier->samplers[i] = samplers[i];
+
+    if (pthread_create(&notifier->thread, NULL, wd_sample_notifier_run, notifier) != 0)
+    {
+        (void)close(notifier->efd);
+        free(notifier);
+        WD_ERROR("Cannot start sample notifier\n", NULL, "");
+    }
+
+    for (i = 0; i < n; ++i)
+        samplers[i]->notifier = notifier;
+
+    return notifier;
+}
+
+void wd_sample_notifier_stop(struct wd_sample_notifier *notifier)
+{
+    const uint64_t one = 1;
+    size_t i;
+
+    WD_TRACE("");
+
+    if (notifier == NULL)
+        return;
+
+    __atomic_store_n(&notifier->stop, true, __ATOMIC_RELEASE);
+    (void)write(notifier->efd, &one, sizeof(one));
+    (void)pthread_join(notifier->thread, NULL);
+
+    if (notifier->dropped)
+        WD_LOG("%" PRIu64 " sample events dropped, notifier was behind\n", notifier->dropped);
+
+    for (i = 0; i < notifier->n; ++i)
+        notifier->samplers[i]->notifier = NULL;
+
+    (void)close(notifier->efd);
+    free(notifier);
+}
+
+double wd_sample_mean(const struct wd_sample_window *window)
+{
+    if (window == NULL || window->n == 0)
+        return 0.0;
+
+    return (double)window->sum / (double)window->n;
+}
+
+const char *wd_sample_rule_name(const struct wd_sample_rule *rule, char *buf, size_t size)
+{
+    if (rule->metric == WD_SAMPLE_STATUS)
+        (void)snprintf(buf, size, "%s %s 0x%" PRIx64, wd_sample_metrics[rule->metric], wd_sample_cmps[rule->cmp],
+                       (uint64_t)rule->threshold);
+    else
+        (void)snprintf(buf, size, "%s %s %" PRId64, wd_sample_metrics[rule->metric], wd_sample_cmps[rule->cmp],
+                       rule->threshold);
+
+    return buf;
+}
@@ -0,0 +1,479 @@
+#include <wd_scan.h>
+#include <wd_sysfs.h>
+#include <wd_time.h>
+#include <wd_log.h>
+#include <pthread.h>
+#include <glob.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <errno.h>
+
+#define WD_SCAN_SIM_PREFIX  "sim:"
+#define WD_SCAN_SYSFS_GLOB  WD_SYSFS_CLASS "/watchdog*"
+#define WD_SCAN_SYSFS_CHAR  "/sys/dev/char"
+
+/* legacy /dev/watchdog is misc device 10:130 and belongs to watchdog0 */
+#define WD_SCAN_MISC_MAJOR      10
+#define WD_SCAN_LEGACY_MINOR    130
+
+static int wd_scan_add(struct wd_scan *scan, const char *dev, wd_backend_type_t backend);
+static int wd_scan_node(struct wd_scan_dev *sdev, const struct stat *st);
+static int wd_scan_glob(struct wd_scan *scan, const char *pattern, wd_backend_type_t backend);
+static void wd_scan_query(struct wd_scan_dev *sdev);
+static void *wd_scan_worker(void *arg);
+static const char *wd_scan_field(char *buf, size_t size, const struct wd_snapshot *snap, unsigned int field, long val, bool hex);
+static const char *wd_scan_error(const struct wd_scan_dev *sdev);
+static void wd_scan_text(struct wd_fbuf *fb, const struct wd_scan_dev *sdev);
+static void wd_scan_json(struct wd_fbuf *fb, const struct wd_scan_dev *sdev);
+static void wd_scan_kv(struct wd_fbuf *fb, const struct wd_scan_dev *sdev, size_t i);
+
+/* node of WatchDog is read via its sysfs dir, 0 iff found */
+static int wd_scan_node(struct wd_scan_dev *sdev, const struct stat *st)
+{
+    char path[PATH_MAX];
+    char dir[PATH_MAX];
+
+    if (major(st->st_rdev) == WD_SCAN_MISC_MAJOR && minor(st->st_rdev) == WD_SCAN_LEGACY_MINOR)
+        (void)snprintf(path, sizeof(path), "%s/watchdog0", WD_SYSFS_CLASS);
+    else
+        (void)snprintf(path, sizeof(path), "%s/%u:%u", WD_SCAN_SYSFS_CHAR, major(st->st_rdev), minor(st->st_rdev));
+
+    if (realpath(path, dir) == NULL || strlen(dir) >= sizeof(sdev->path))
+        return 1;
+
+    if (snprintf(path, sizeof(path), "%s/identity", dir) >= (int)sizeof(path) || access(path, R_OK) != 0)
+        return 1;
+
+    (void)strcpy(sdev->path, dir);
+    sdev->backend = WD_BACKEND_SYSFS;
+
+    return 0;
+}
+
+static int wd_scan_add(struct wd_scan *scan, const char *dev, wd_backend_type_t backend)
+{
+    struct wd_scan_dev *sdev;
+    const struct wd_scan_dev *other;
+    struct stat st;
+    size_t i;
+
+    if (scan->ndevs == WD_SCAN_MAX_DEVS)
+        WD_ERROR("Too many devices, max is %d\n", 1, WD_SCAN_MAX_DEVS);
+
+    if (strlen(dev) >= WD_SCAN_DEV_LEN)
+        WD_ERROR("Device path %s too long\n", 1, dev);
+
+    sdev = &scan->devs[scan->ndevs];
+    (void)memset(sdev, 0, sizeof(*sdev));
+    (void)strcpy(sdev->dev, dev);
+    sdev->backend = backend;
+
+    if ((backend == WD_BACKEND_AUTO || backend == WD_BACKEND_CHARDEV) && stat(dev, &st) == 0 && S_ISCHR(st.st_mode))
+    {
+        sdev->rdev = st.st_rdev;
+        /* scan is read-only, on nowayout device open alone reboots the machine */
+        if (wd_scan_node(sdev, &st))
+        {
+            sdev->unprobed = true;
+            WD_LOG("Scan: no sysfs for %s, not probed\n", dev);
+        }
+    }
+
+    /* two workers opening the same WatchDog at once, one would get EBUSY */
+    for (i = 0; i < scan->ndevs; ++i)
+    {
+        other = &scan->devs[i];
+        if ((sdev->path[0] != '\0' && strcmp(sdev->path, other->path) == 0) ||
+            (sdev->rdev != 0 && sdev->rdev == other->rdev))
+        {
+            WD_LOG("Scan: %s is the same WatchDog as %s\n", dev, other->dev);
+            return 0;
+        }
+    }
+
+    ++scan->ndevs;
+
+    return 0;
+}
+
+static int wd_scan_glob(struct wd_scan *scan, const char *pattern, wd_backend_type_t backend)
+{
+    glob_t g;
+    size_t i;
+    int ret;
+
+    ret = glob(pattern, 0, NULL, &g);
+    if (ret == GLOB_NOMATCH)
+    {
+        WD_LOG("Scan: nothing matches %s\n", pattern);
+        return 0;
+    }
+
+    if (ret)
+        WD_ERROR("Cannot expand %s\n", 1, pattern);
+
+    for (i = 0; i < g.gl_pathc; ++i)
+        if (wd_scan_add(scan, g.gl_pathv[i], backend))
+        {
+            globfree(&g);
+            return 1;
+        }
+
+    globfree(&g);
+
+    return 0;
+}
+
+static void wd_scan_query(struct wd_scan_dev *sdev)
+{
+    const uint64_t start = wd_time_now_ns();
+    watchdog_t wd;
+
+    if (sdev->unprobed)
+        return;
+
+    errno = 0;
+    wd = wd_open_backend(sdev->backend, sdev->path[0] != '\0' ? sdev->path : sdev->dev);
+    if (wd == -1)
+        sdev->err = errno ? errno : ENODEV;
+    else
+    {
+        /* partial snapshot is still an answer, nothing readable means it is no WatchDog */
+        (void)wd_get_snapshot(wd, &sdev->snap, WD_SNAP_ALL);
+        if (sdev->snap.valid == 0)
+            sdev->err = errno ? errno : ENOTTY;
+
+        (void)wd_close(wd);
+    }
+
+    sdev->latency_ns = wd_time_now_ns() - start;
+}
+
+static void *wd_scan_worker(void *arg)
+{
+    struct wd_scan *scan = (struct wd_scan *)arg;
+    size_t i;
+
+    while ((i = __atomic_fetch_add(&scan->next, 1, __ATOMIC_RELAXED)) < scan->ndevs)
+        wd_scan_query(&scan->devs[i]);
+
+    return NULL;
+}
+
+static const char *wd_scan_field(char *buf, size_t size, const struct wd_snapshot *snap, unsigned int field, long val, bool hex)
+{
+    if (!(snap->valid & field))
+        return "-";
+
+    (void)snprintf(buf, size, hex ? "0x%lx" : "%ld", val);
+
+    return buf;
+}
+
+static const char *wd_scan_error(const struct wd_scan_dev *sdev)
+{
+    return sdev->unprobed ? "no sysfs, not probed" : strerror(sdev->err);
+}
+
+static void wd_scan_text(struct wd_fbuf *fb, const struct wd_scan_dev *sdev)
+{
+    const struct wd_snapshot *snap = &sdev->snap;
+    char line[512];
+    char timeout[16];
+    char pretimeout[16];
+    char timeleft[16];
+    char status[16];
+    char bootstatus[16];
+    char temp[16];
+
+    if (sdev->unprobed || sdev->err)
+    {
+        (void)snprintf(line, sizeof(line), "%-40s %s\n", sdev->dev, wd_scan_error(sdev));
+        wd_fbuf_str(fb, line);
+        return;
+    }
+
+    (void)snprintf(line, sizeof(line), "%-40s %-24.*s %8s %10s %8s %8s %10s %6s %8" PRIu64 "\n",
+                   sdev->dev, (int)sizeof(snap->info.identity),
+                   (snap->valid & WD_SNAP_INFO) ? (const char *)snap->info.identity : "-",
+                   wd_scan_field(timeout, sizeof(timeout), snap, WD_SNAP_TIMEOUT, (long)snap->timeout, false),
+                   wd_scan_field(pretimeout, sizeof(pretimeout), snap, WD_SNAP_PRETIMEOUT, (long)snap->pretimeout, false),
+                   wd_scan_field(timeleft, sizeof(timeleft), snap, WD_SNAP_TIMELEFT, (long)snap->timeleft, false),
+                   wd_scan_field(status, sizeof(status), snap, WD_SNAP_STATUS, (long)snap->status, true),
+                   wd_scan_field(bootstatus, sizeof(bootstatus), snap, WD_SNAP_BOOTSTATUS, (long)snap->bootstatus, true),
+                   wd_scan_field(temp, sizeof(temp), snap, WD_SNAP_TEMP, (long)snap->temp, false),
+                   sdev->latency_ns / WD_NSEC_PER_USEC);
+    wd_fbuf_str(fb, line);
+}
+
+static void wd_scan_json(struct wd_fbuf *fb, const struct wd_scan_dev *sdev)
+{
+    ssize_t len;
+
+    wd_fbuf_str(fb, "{\"dev\":");
+    wd_fbuf_quoted(fb, sdev->dev, sizeof(sdev->dev));
+    wd_fbuf_str(fb, ",\"latency_us\":");
+    wd_fbuf_u64(fb, sdev->latency_ns / WD_NSEC_PER_USEC);
+
+    if (sdev->unprobed || sdev->err)
+    {
+        wd_fbuf_str(fb, ",\"error\":");
+        wd_fbuf_quoted(fb, wd_scan_error(sdev), WD_SCAN_DEV_LEN);
+        wd_fbuf_str(fb, "}");
+        return;
+    }
+
+    wd_fbuf_str(fb, ",\"snapshot\":");
+    if (fb->overflow)
+        return;
+
+    len = wd_format_snapshot(fb->buf + fb->len, fb->size - fb->len, &sdev->snap, WD_FORMAT_JSON);
+    if (len <= 0)
+    {
+        fb->overflow = true;
+        return;
+    }
+
+    /* snapshot object ends with new line */
+    fb->len += (size_t)len - 1;
+    wd_fbuf_str(fb, "}");
+}
+
+static void wd_scan_kv(struct wd_fbuf *fb, const struct wd_scan_dev *sdev, size_t i)
+{
+    char snap[2048];
+    const char *line;
+    const char *end;
+    ssize_t len;
+
+    wd_fbuf_str(fb, "dev");
+    wd_fbuf_u64(fb, i);
+    wd_fbuf_str(fb, "_name=");
+    wd_fbuf_quoted(fb, sdev->dev, sizeof(sdev->dev));
+    wd_fbuf_str(fb, "\ndev");
+    wd_fbuf_u64(fb, i);
+    wd_fbuf_str(fb, "_latency_us=");
+    wd_fbuf_u64(fb, sdev->latency_ns / WD_NSEC_PER_USEC);
+    wd_fbuf_str(fb, "\n");
+
+    if (sdev->unprobed || sdev->err)
+    {
+        wd_fbuf_str(fb, "dev");
+        wd_fbuf_u64(fb, i);
+        wd_fbuf_str(fb, "_error=");
+        wd_fbuf_quoted(fb, wd_scan_error(sdev), WD_SCAN_DEV_LEN);
+        wd_fbuf_str(fb, "\n");
+        return;
+    }
+
+    len = wd_format_snapshot(snap, sizeof(snap), &sdev->snap, WD_FORMAT_KV);
+    if (len < 0)
+    {
+        fb->overflow = true;
+        return;
+    }
+
+    /* the same keys as single snapshot, prefixed like feed stats */
+    for (line = snap; line < snap + len; line = end + 1)
+    {
+        end = memchr(line, '\n', (size_t)(snap + len - line));
+        if (end == NULL)
+            break;
+
+        wd_fbuf_str(fb, "dev");
+        wd_fbuf_u64(fb, i);
+        wd_fbuf_put(fb, "_", 1);
+        wd_fbuf_put(fb, line, (size_t)(end - line) + 1);
+    }
+}
+
+struct wd_scan *wd_scan_create(const char *const *roots, size_t n, wd_backend_type_t backend)
+{
+    struct wd_scan *scan;
+    struct stat st;
+    char pattern[PATH_MAX];
+    const char *root;
+    size_t len;
+    size_t i;
+    int ret = 0;
+
+    WD_TRACE("");
+
+    if (roots == NULL || n == 0)
+        WD_ERROR("roots == NULL || n == 0\n", NULL, "");
+
+    scan = calloc(1, sizeof(*scan));
+    if (scan == NULL || (scan->devs = calloc(WD_SCAN_MAX_DEVS, sizeof(*scan->devs))) == NULL)
+    {
+        wd_scan_destroy(scan);
+        WD_ERROR("Cannot allocate scan\n", NULL, "");
+    }
+
+    for (i = 0; i < n && ret == 0; ++i)
+    {
+        root = roots[i];
+        if (strncmp(root, WD_SCAN_SIM_PREFIX, strlen(WD_SCAN_SIM_PREFIX)) == 0)
+            ret = wd_scan_add(scan, root, WD_BACKEND_SIM);
+        else if (stat(root, &st) == 0 && S_ISDIR(st.st_mode))
+        {
+            /* sysfs never arms the timer and works while daemon holds the node */
+            len = strlen(root);
+            while (len > 0 && root[len - 1] == '/')
+                --len;
+
+            if (snprintf(pattern, sizeof(pattern), "%.*s%s", (int)len, root, WD_SCAN_SYSFS_GLOB) >= (int)sizeof(pattern))
+                ret = 1;
+            else
+                ret = wd_scan_glob(scan, pattern, WD_BACKEND_SYSFS);
+        }
+        else
+            ret = wd_scan_glob(scan, root, backend);
+    }
+
+    if (ret || scan->ndevs == 0)
+    {
+        wd_scan_destroy(scan);
+        WD_ERROR("No WatchDog found\n", NULL, "");
+    }
+
+    return scan;
+}
+
+int wd_scan_run(struct wd_scan *scan, unsigned int workers)
+{
+    pthread_t threads[WD_SCAN_MAX_WORKERS];
+    unsigned int started = 0;
+    uint64_t start;
+    long cpus;
+    size_t i;
+
+    WD_TRACE("");
+
+    if (scan == NULL)
+        WD_ERROR("scan == NULL\n", 1, "");
+
+    if (workers == 0)
+    {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (unsigned int)cpus : 1;
+    }
+
+    if (workers > WD_SCAN_MAX_WORKERS)
+        workers = WD_SCAN_MAX_WORKERS;
+
+    if (workers > scan->ndevs)
+        workers = (unsigned int)scan->ndevs;
+
+    for (i = 0; i < scan->ndevs; ++i)
+    {
+        scan->devs[i].err = 0;
+        (void)memset(&scan->devs[i].snap, 0, sizeof(scan->devs[i].snap));
+    }
+
+    start = wd_time_now_ns();
+    scan->next = 0;
+
+    /* caller is a worker too, so scan finishes even if no thread starts */
+    for (; started + 1 < workers; ++started)
+        if (pthread_create(&threads[started], NULL, wd_scan_worker, scan) != 0)
+            break;
+
+    (void)wd_scan_worker(scan);
+
+    for (i = 0; i < started; ++i)
+        (void)pthread_join(threads[i], NULL);
+
+    scan->workers = started + 1;
+    scan->elapsed_ns = wd_time_now_ns() - start;
+
+    /* not probed is no failure, it was never asked */
+    scan->failed = 0;
+    scan->unprobed = 0;
+    for (i = 0; i < scan->ndevs; ++i)
+    {
+        if (scan->devs[i].err)
+            ++scan->failed;
+        else if (scan->devs[i].unprobed)
+            ++scan->unprobed;
+    }
+
+    return scan->failed != 0;
+}
+
+ssize_t wd_scan_format(char *buf, size_t size, const struct wd_scan *scan, wd_format_t fmt)
+{
+    struct wd_fbuf fb;
+    char line[256];
+    size_t i;
+
+    WD_TRACE("");
+
+    if (buf == NULL || scan == NULL)
+        WD_ERROR("buf == NULL || scan == NULL\n", -1, "");
+
+    if (fmt == WD_FORMAT_BIN)
+        WD_ERROR("Binary format is not supported for scan\n", -1, "");
+
+    wd_fbuf_init(&fb, buf, size);
+    if (fmt == WD_FORMAT_JSON)
+        wd_fbuf_str(&fb, "[\n");
+    else if (fmt == WD_FORMAT_TEXT)
+    {
+        (void)snprintf(line, sizeof(line), "%-40s %-24s %8s %10s %8s %8s %10s %6s %8s\n",
+                       "DEV", "IDENTITY", "TIMEOUT", "PRETIMEOUT", "TIMELEFT", "STATUS", "BOOTSTATUS", "TEMP", "US");
+        wd_fbuf_str(&fb, line);
+    }
+
+    for (i = 0; i < scan->ndevs; ++i)
+    {
+        switch (fmt)
+        {
+            case WD_FORMAT_JSON:
+            {
+                if (i)
+                    wd_fbuf_str(&fb, ",\n");
+
+                wd_scan_json(&fb, &scan->devs[i]);
+                break;
+            }
+            case WD_FORMAT_KV:
+            {
+                wd_scan_kv(&fb, &scan->devs[i], i);
+                break;
+            }
+            default:
+            {
+                wd_scan_text(&fb, &scan->devs[i]);
+                break;
+            }
+        }
+    }
+
+    if (fmt == WD_FORMAT_JSON)
+        wd_fbuf_str(&fb, "\n]\n");
+    else if (fmt == WD_FORMAT_TEXT)
+    {
+        (void)snprintf(line, sizeof(line), "%zu devices, %zu failed, %zu not probed, %u workers, %" PRIu64 " ms\n",
+                       scan->ndevs, scan->failed, scan->unprobed, scan->workers, scan->elapsed_ns / WD_NSEC_PER_MSEC);
+        wd_fbuf_str(&fb, line);
+    }
+
+    return fb.overflow ? -1 : (ssize_t)fb.len;
+}
+
+void wd_scan_destroy(struct wd_scan *scan)
+{
+    WD_TRACE("");
+
+    if (scan == NULL)
+        return;
+
+    free(scan->devs);
+    free(scan);
+}
@@ -0,0 +1,143 @@
+#include <wd_sched.h>
+#include <wd_time.h>
+#include <wd_log.h>
+#include <string.h>
+
+/* never feed more often than this % of timeout */
+#define WD_SCHED_MIN_PERIOD_PCT 5
+
+static uint64_t wd_sched_pct(uint64_t val, unsigned int pct);
+static void wd_sched_adapt(struct wd_sched *sched);
+
+static uint64_t wd_sched_pct(uint64_t val, unsigned int pct)
+{
+    return val / 100 * pct + val % 100 * pct / 100;
+}
+
+static void wd_sched_adapt(struct wd_sched *sched)
+{
+    uint64_t min_slack = wd_sched_pct(sched->timeout_ns, sched->conf.slack_min_pct);
+    uint64_t max_slack = wd_sched_pct(sched->timeout_ns, sched->conf.slack_max_pct);
+    uint64_t lo = wd_sched_pct(sched->timeout_ns, WD_SCHED_MIN_PERIOD_PCT);
+    uint64_t hi;
+    uint64_t target;
+    uint64_t period = sched->period_ns;
+
+    /* longest period that still keeps min slack when we wake up late again */
+    hi = sched->timeout_ns - min_slack;
+    hi = hi > sched->late_ns ? hi - sched->late_ns : 0;
+    if (hi < lo)
+        hi = lo;
+
+    target = sched->timeout_ns - (min_slack + max_slack) / 2;
+    target = target > sched->late_ns ? target - sched->late_ns : lo;
+
+    if (sched->slack_ns < (int64_t)min_slack)
+        period = period / 2 < target ? period / 2 : target;   /* back off fast */
+    else if (sched->slack_ns > (int64_t)max_slack && period < target)
+        period += (target - period) / 4;                        /* grow slowly */
+
+    if (period < lo)
+        period = lo;
+
+    if (period > hi)
+        period = hi;
+
+    if (period != sched->period_ns)
+    {
+        sched->period_ns = period;
+        ++sched->adjustments;
+    }
+}
+
+void wd_sched_conf_init(struct wd_sched_conf *conf)
+{
+    WD_TRACE("");
+
+    if (conf == NULL)
+        return;
+
+    conf->mode = WD_SCHED_FIXED;
+    conf->feed_pct = WD_SCHED_DEFAULT_FEED_PCT;
+    conf->slack_min_pct = WD_SCHED_DEFAULT_SLACK_MIN_PCT;
+    conf->slack_max_pct = WD_SCHED_DEFAULT_SLACK_MAX_PCT;
+}
+
+int wd_sched_init(struct wd_sched *sched, const struct wd_sched_conf *conf, watchdog_t wd, unsigned int timeout)
+{
+    unsigned int timeleft;
+
+    WD_TRACE("");
+
+    if (sched == NULL || conf == NULL)
+        WD_ERROR("sched == NULL || conf == NULL\n", 1, "");
+
+    if (timeout == 0)
+        WD_ERROR("Timeout == 0\n", 1, "");
+
+    if (conf->feed_pct == 0 || conf->feed_pct >= 100)
+        WD_ERROR("Incorrect feed ratio %u\n", 1, conf->feed_pct);
+
+    if (conf->slack_min_pct >= conf->slack_max_pct || conf->slack_max_pct >= 100)
+        WD_ERROR("Incorrect slack band %u:%u\n", 1, conf->slack_min_pct, conf->slack_max_pct);
+
+    (void)memset(sched, 0, sizeof(*sched));
+    sched->conf = *conf;
+    sched->timeout_ns = (uint64_t)timeout * WD_NSEC_PER_SEC;
+    sched->period_ns = wd_sched_pct(sched->timeout_ns, conf->feed_pct);
+    sched->min_slack_ns = INT64_MAX;
+    sched->timeleft = WD_SCHED_TIMELEFT_NONE;
+
+    if (conf->mode == WD_SCHED_ADAPTIVE)
+    {
+        sched->has_timeleft = wd_get_timeleft(wd, &timeleft) == 0;
+        if (!sched->has_timeleft)
+            WD_LOG("No GETTIMELEFT support, using fixed %u%% feed period\n", conf->feed_pct);
+    }
+
+    return 0;
+}
+
+void wd_sched_sample(struct wd_sched *sched, watchdog_t wd, uint64_t now)
+{
+    unsigned int timeleft;
+    int64_t slack;
+
+    ++sched->wakeups;
+
+    /* without GETTIMELEFT slack is what is left from previous feed */
+    slack = (int64_t)sched->timeout_ns;
+    if (sched->last_feed_ns)
+        slack -= (int64_t)(now - sched->last_feed_ns);
+
+    /* driver counts in whole seconds, truncation keeps estimate conservative */
+    sched->timeleft = WD_SCHED_TIMELEFT_NONE;
+    if (sched->has_timeleft && wd_get_timeleft(wd, &timeleft) == 0)
+    {
+        sched->timeleft = timeleft;
+        if ((int64_t)timeleft * (int64_t)WD_NSEC_PER_SEC < slack)
+            slack = (int64_t)timeleft * (int64_t)WD_NSEC_PER_SEC;
+    }
+
+    sched->slack_ns = slack;
+    if (slack < sched->min_slack_ns)
+        sched->min_slack_ns = slack;
+}
+
+uint64_t wd_sched_next(struct wd_sched *sched, uint64_t scheduled, uint64_t fed)
+{
+    /* scheduled == 0 means first feed, there is no schedule to be late for */
+    uint64_t late = scheduled && fed > scheduled ? fed - scheduled : 0;
+
+    sched->last_feed_ns = fed;
+
+    /* decaying max, one bad wakeup is remembered for a while */
+    sched->late_ns -= sched->late_ns / 8;
+    if (late > sched->late_ns)
+        sched->late_ns = late;
+
+    if (scheduled && sched->conf.mode == WD_SCHED_ADAPTIVE && sched->has_timeleft)
+        wd_sched_adapt(sched);
+
+    return fed + sched->period_ns;
+}
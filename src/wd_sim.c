@@ -0,0 +1,562 @@
+#include <wd_sim.h>
+#include <wd_time.h>
+#include <wd_log.h>
+#include <common.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <stdbool.h>
+
+#define WD_SIM_IDENTITY     "Simulated Watchdog"
+#define WD_SIM_OPTIONS      (WDIOF_SETTIMEOUT | WDIOF_MAGICCLOSE | WDIOF_PRETIMEOUT | WDIOF_KEEPALIVEPING)
+#define WD_SIM_STATE_LEN    128
+
+struct wd_sim
+{
+    /* device model */
+    unsigned int    timeout;
+    unsigned int    pretimeout;
+    int             bootstatus;
+    int             temp;
+    int             temp_ramp;      /* degrees F per second since open */
+    uint64_t        open_ns;
+    int             options;        /* last WDIOS_* options */
+    bool            has_timeleft;
+    bool            nowayout;       /* magic close is ignored */
+    bool            running;
+    uint64_t        last_ping_ns;
+    char            state[WD_SIM_STATE_LEN];    /* state file or empty */
+
+    /* clock */
+    bool            manual_clock;
+    uint64_t        now_ns;
+
+    /* fault injection */
+    unsigned int    fault_mask;
+    unsigned int    fault_count;    /* 0 means forever */
+    int             fault_err;
+    uint64_t        latency_ns;
+
+    struct wd_sim_stats stats;
+};
+
+static uint64_t wd_sim_now(const struct wd_sim *sim);
+static void wd_sim_update(struct wd_sim *sim, uint64_t now);
+static int wd_sim_enter(struct wd_sim *sim, wd_op_t op);
+static int wd_sim_parse(struct wd_sim *sim, const char *opts);
+static void wd_sim_state_load(struct wd_sim *sim);
+static int wd_sim_state_save(const struct wd_sim *sim);
+static struct wd_sim *wd_sim_get(watchdog_t wd);
+
+static int wd_sim_open(struct wd_backend_ctx *ctx, const char *dev);
+static int wd_sim_close(struct wd_backend_ctx *ctx, bool magic);
+static int wd_sim_keepalive(struct wd_backend_ctx *ctx);
+static int wd_sim_get_timeout(struct wd_backend_ctx *ctx, unsigned int *timeout);
+static int wd_sim_set_timeout(struct wd_backend_ctx *ctx, unsigned int timeout);
+static int wd_sim_get_pretimeout(struct wd_backend_ctx *ctx, unsigned int *timeout);
+static int wd_sim_set_pretimeout(struct wd_backend_ctx *ctx, unsigned int timeout);
+static int wd_sim_get_timeleft(struct wd_backend_ctx *ctx, unsigned int *time);
+static int wd_sim_get_bootstatus(struct wd_backend_ctx *ctx, int *status);
+static int wd_sim_get_status(struct wd_backend_ctx *ctx, int *status);
+static int wd_sim_get_temp(struct wd_backend_ctx *ctx, int *temp);
+static int wd_sim_set_options(struct wd_backend_ctx *ctx, int options);
+static int wd_sim_get_info(struct wd_backend_ctx *ctx, struct watchdog_info *wd_info);
+
+const struct wd_backend_ops wd_backend_sim =
+{
+    .name           = "sim",
+    .open           = wd_sim_open,
+    .close          = wd_sim_close,
+    .keepalive      = wd_sim_keepalive,
+    .get_timeout    = wd_sim_get_timeout,
+    .set_timeout    = wd_sim_set_timeout,
+    .get_pretimeout = wd_sim_get_pretimeout,
+    .set_pretimeout = wd_sim_set_pretimeout,
+    .get_timeleft   = wd_sim_get_timeleft,
+    .get_bootstatus = wd_sim_get_bootstatus,
+    .get_status     = wd_sim_get_status,
+    .get_temp       = wd_sim_get_temp,
+    .set_options    = wd_sim_set_options,
+    .get_info       = wd_sim_get_info
+};
+
+static uint64_t wd_sim_now(const struct wd_sim *sim)
+{
+    return sim->manual_clock ? sim->now_ns : wd_time_now_ns();
+}
+
+/* count expirations that happened since last call */
+static void wd_sim_update(struct wd_sim *sim, uint64_t now)
+{
+    uint64_t timeout_ns = (uint64_t)sim->timeout * WD_NSEC_PER_SEC;
+
+    if (!sim->running || now - sim->last_ping_ns < timeout_ns)
+        return;
+
+    /* simulated system reboots and WD starts again */
+    ++sim->stats.expirations;
+    sim->bootstatus |= WDIOF_CARDRESET;
+    sim->last_ping_ns = now;
+}
+
+static int wd_sim_enter(struct wd_sim *sim, wd_op_t op)
+{
+    uint64_t end;
+
+    if (sim->latency_ns)
+    {
+        end = wd_time_now_ns() + sim->latency_ns;
+        while (wd_time_now_ns() < end)
+            ;
+    }
+
+    wd_sim_update(sim, wd_sim_now(sim));
+
+    if (!GET_FLAG(sim->fault_mask, WD_OP_BIT(op)))
+        return 0;
+
+    if (sim->fault_count && --sim->fault_count == 0)
+        sim->fault_mask = 0;
+
+    ++sim->stats.faults;
+
+    return -sim->fault_err;
+}
+
+static int wd_sim_parse(struct wd_sim *sim, const char *opts)
+{
+    char buf[128];
+    char *save;
+    char *tok;
+    char *val;
+
+    if (strlen(opts) >= sizeof(buf))
+        return -EINVAL;
+
+    (void)strcpy(buf, opts);
+    for (tok = strtok_r(buf, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save))
+    {
+        val = strchr(tok, '=');
+        if (val != NULL)
+            *val++ = '\0';
+
+        if (strcmp(tok, "notimeleft") == 0)
+            sim->has_timeleft = false;
+        else if (strcmp(tok, "nowayout") == 0)
+            sim->nowayout = true;
+        else if (val == NULL)
+            return -EINVAL;
+        else if (strcmp(tok, "timeout") == 0)
+            sim->timeout = (unsigned int)strtoul(val, NULL, 0);
+        else if (strcmp(tok, "pretimeout") == 0)
+            sim->pretimeout = (unsigned int)strtoul(val, NULL, 0);
+        else if (strcmp(tok, "bootstatus") == 0)
+            sim->bootstatus = (int)strtol(val, NULL, 0);
+        else if (strcmp(tok, "temp") == 0)
+            sim->temp = (int)strtol(val, NULL, 0);
+        else if (strcmp(tok, "tempramp") == 0)
+            sim->temp_ramp = (int)strtol(val, NULL, 0);
+        else if (strcmp(tok, "state") == 0 && *val != '\0')
+            (void)strcpy(sim->state, val);
+        else
+            return -EINVAL;
+    }
+
+    if (sim->timeout == 0 || sim->pretimeout >= sim->timeout)
+        return -EINVAL;
+
+    return 0;
+}
+
+/* previous holder that did not disarm WD left the simulated system to be reset */
+static void wd_sim_state_load(struct wd_sim *sim)
+{
+    FILE *f;
+    int running = 0;
+    uint64_t expirations = 0;
+
+    f = fopen(sim->state, "r");
+    if (f == NULL)
+        return;
+
+    if (fscanf(f, "running %d expirations %" SCNu64, &running, &expirations) != 2)
+        running = 0;
+
+    (void)fclose(f);
+
+    sim->stats.expirations = expirations;
+    if (running)
+    {
+        ++sim->stats.expirations;
+        sim->bootstatus |= WDIOF_CARDRESET;
+    }
+}
+
+static int wd_sim_state_save(const struct wd_sim *sim)
+{
+    FILE *f;
+    int ret;
+
+    f = fopen(sim->state, "w");
+    if (f == NULL)
+        return -errno;
+
+    ret = fprintf(f, "running %d expirations %" PRIu64 "\n", sim->running ? 1 : 0, sim->stats.expirations) < 0;
+    ret |= fclose(f) != 0;
+
+    return ret ? -EIO : 0;
+}
+
+static struct wd_sim *wd_sim_get(watchdog_t wd)
+{
+    return (struct wd_sim *)wd_backend_priv(wd, &wd_backend_sim);
+}
+
+static int wd_sim_open(struct wd_backend_ctx *ctx, const char *dev)
+{
+    struct wd_sim *sim;
+    int ret;
+
+    sim = calloc(1, sizeof(*sim));
+    if (sim == NULL)
+        return -ENOMEM;
+
+    sim->timeout = WD_SIM_DEFAULT_TIMEOUT;
+    sim->has_timeleft = true;
+    sim->stats.min_slack_ns = INT64_MAX;
+
+    if (dev != NULL && strncmp(dev, WD_BACKEND_SIM_PREFIX, strlen(WD_BACKEND_SIM_PREFIX)) == 0)
+        dev += strlen(WD_BACKEND_SIM_PREFIX);
+
+    ret = dev != NULL ? wd_sim_parse(sim, dev) : 0;
+    if (ret)
+    {
+        free(sim);
+        return ret;
+    }
+
+    if (sim->state[0] != '\0')
+        wd_sim_state_load(sim);
+
+    /* like real driver, open starts WD */
+    sim->running = true;
+    sim->last_ping_ns = wd_sim_now(sim);
+    sim->open_ns = sim->last_ping_ns;
+
+    /* armed from now on, holder killed before close is seen by next open */
+    if (sim->state[0] != '\0' && (ret = wd_sim_state_save(sim)) != 0)
+    {
+        free(sim);
+        return ret;
+    }
+
+    ctx->priv = sim;
+
+    return 0;
+}
+
+static int wd_sim_close(struct wd_backend_ctx *ctx, bool magic)
+{
+    struct wd_sim *sim = (struct wd_sim *)ctx->priv;
+    int ret = 0;
+
+    wd_sim_update(sim, wd_sim_now(sim));
+
+    /* magic close disarms, release (or nowayout) leaves WD to reset the simulated system */
+    if (magic && !sim->nowayout)
+        sim->running = false;
+    else if (sim->running && sim->state[0] == '\0')
+        WD_LOG("Simulated WatchDog released while running, system would be reset\n");
+
+    if (sim->state[0] != '\0')
+        ret = wd_sim_state_save(sim);
+
+    free(sim);
+    ctx->priv = NULL;
+
+    return ret;
+}
+
+static int wd_sim_keepalive(struct wd_backend_ctx *ctx)
+{
+    struct wd_sim *sim = (struct wd_sim *)ctx->priv;
+    int64_t slack;
+    uint64_t now;
+    int ret;
+
+    ret = wd_sim_enter(sim, WD_OP_KEEPALIVE);
+    if (ret)
+        return ret;
+
+    now = wd_sim_now(sim);
+    slack = (int64_t)((uint64_t)sim->timeout * WD_NSEC_PER_SEC) - (int64_t)(now - sim->last_ping_ns);
+    if (slack < sim->stats.min_slack_ns)
+        sim->stats.min_slack_ns = slack;
+
+    sim->last_ping_ns = now;
+    ++sim->stats.keepalives;
+
+    return 0;
+}
+
+static int wd_sim_get_timeout(struct wd_backend_ctx *ctx, unsigned int *timeout)
+{
+    struct wd_sim *sim = (struct wd_sim *)ctx->priv;
+    int ret;
+
+    ret = wd_sim_enter(sim, WD_OP_GET_TIMEOUT);
+    if (ret)
+        return ret;
+
+    *timeout = sim->timeout;
+
+    return 0;
+}
+
+static int wd_sim_set_timeout(struct wd_backend_ctx *ctx, unsigned int timeout)
+{
+    struct wd_sim *sim = (struct wd_sim *)ctx->priv;
+    int ret;
+
+    ret = wd_sim_enter(sim, WD_OP_SET_TIMEOUT);
+    if (ret)
+        return ret;
+
+    if (timeout == 0 || timeout <= sim->pretimeout)
+        return -EINVAL;
+
+    /* driver pings on new timeout */
+    sim->timeout = timeout;
+    sim->last_ping_ns = wd_sim_now(sim);
+
+    return 0;
+}
+
+static int wd_sim_get_pretimeout(struct wd_backend_ctx *ctx, unsigned int *timeout)
+{
+    struct wd_sim *sim = (struct wd_sim *)ctx->priv;
+    int ret;
+
+    ret = wd_sim_enter(sim, WD_OP_GET_PRETIMEOUT);
+    if (ret)
+        return ret;
+
+    *timeout = sim->pretimeout;
+
+    return 0;
+}
+
+static int wd_sim_set_pretimeout(struct wd_backend_ctx *ctx, unsigned int timeout)
+{
+    struct wd_sim *sim = (struct wd_sim *)ctx->priv;
+    int ret;
+
+    ret = wd_sim_enter(sim, WD_OP_SET_PRETIMEOUT);
+    if (ret)
+        return ret;
+
+    if (timeout >= sim->timeout)
+        return -EINVAL;
+
+    sim->pretimeout = timeout;
+
+    return 0;
+}
+
+static int wd_sim_get_timeleft(struct wd_backend_ctx *ctx, unsigned int *time)
+{
+    struct wd_sim *sim = (struct wd_sim *)ctx->priv;
+    uint64_t elapsed;
+    int ret;
+
+    if (!sim->has_timeleft)
+        return -EOPNOTSUPP;
+
+    ret = wd_sim_enter(sim, WD_OP_GET_TIMELEFT);
+    if (ret)
+        return ret;
+
+    elapsed = (wd_sim_now(sim) - sim->last_ping_ns) / WD_NSEC_PER_SEC;
+    *time = sim->running && elapsed < sim->timeout ? sim->timeout - (unsigned int)elapsed : 0;
+
+    return 0;
+}
+
+static int wd_sim_get_bootstatus(struct wd_backend_ctx *ctx, int *status)
+{
+    struct wd_sim *sim = (struct wd_sim *)ctx->priv;
+    int ret;
+
+    ret = wd_sim_enter(sim, WD_OP_GET_BOOTSTATUS);
+    if (ret)
+        return ret;
+
+    *status = sim->bootstatus;
+
+    return 0;
+}
+
+static int wd_sim_get_status(struct wd_backend_ctx *ctx, int *status)
+{
+    struct wd_sim *sim = (struct wd_sim *)ctx->priv;
+    int ret;
+
+    ret = wd_sim_enter(sim, WD_OP_GET_STATUS);
+    if (ret)
+        return ret;
+
+    *status = sim->running ? WDIOF_KEEPALIVEPING : 0;
+
+    return 0;
+}
+
+static int wd_sim_get_temp(struct wd_backend_ctx *ctx, int *temp)
+{
+    struct wd_sim *sim = (struct wd_sim *)ctx->priv;
+    uint64_t now;
+    int ret;
+
+    ret = wd_sim_enter(sim, WD_OP_GET_TEMP);
+    if (ret)
+        return ret;
+
+    now = wd_sim_now(sim);
+    *temp = sim->temp;
+    if (now > sim->open_ns)
+        *temp += sim->temp_ramp * (int)((now - sim->open_ns) / WD_NSEC_PER_SEC);
+
+    return 0;
+}
+
+static int wd_sim_set_options(struct wd_backend_ctx *ctx, int options)
+{
+    struct wd_sim *sim = (struct wd_sim *)ctx->priv;
+    int ret;
+
+    ret = wd_sim_enter(sim, WD_OP_SET_OPTIONS);
+    if (ret)
+        return ret;
+
+    if (GET_FLAG(options, WDIOS_DISABLECARD))
+        sim->running = false;
+
+    if (GET_FLAG(options, WDIOS_ENABLECARD) && !sim->running)
+    {
+        sim->running = true;
+        sim->last_ping_ns = wd_sim_now(sim);
+    }
+
+    sim->options = options;
+
+    return 0;
+}
+
+static int wd_sim_get_info(struct wd_backend_ctx *ctx, struct watchdog_info *wd_info)
+{
+    struct wd_sim *sim = (struct wd_sim *)ctx->priv;
+    int ret;
+
+    ret = wd_sim_enter(sim, WD_OP_GET_INFO);
+    if (ret)
+        return ret;
+
+    (void)memset(wd_info, 0, sizeof(*wd_info));
+    wd_info->options = WD_SIM_OPTIONS;
+    (void)strncpy((char *)wd_info->identity, WD_SIM_IDENTITY, sizeof(wd_info->identity) - 1);
+
+    return 0;
+}
+
+int wd_sim_manual_clock(watchdog_t wd, uint64_t start_ns)
+{
+    struct wd_sim *sim;
+
+    WD_TRACE("");
+
+    sim = wd_sim_get(wd);
+    if (sim == NULL)
+        WD_ERROR("Not a simulated WatchDog\n", 1, "");
+
+    sim->manual_clock = true;
+    sim->now_ns = start_ns;
+    sim->last_ping_ns = start_ns;
+    sim->open_ns = start_ns;
+
+    return 0;
+}
+
+int wd_sim_advance(watchdog_t wd, uint64_t delta_ns)
+{
+    struct wd_sim *sim;
+
+    WD_TRACE("");
+
+    sim = wd_sim_get(wd);
+    if (sim == NULL)
+        WD_ERROR("Not a simulated WatchDog\n", 1, "");
+
+    if (!sim->manual_clock)
+        WD_ERROR("Simulator does not use manual clock\n", 1, "");
+
+    sim->now_ns += delta_ns;
+    wd_sim_update(sim, sim->now_ns);
+
+    return 0;
+}
+
+int wd_sim_inject_fault(watchdog_t wd, unsigned int ops_mask, int err, unsigned int count)
+{
+    struct wd_sim *sim;
+
+    WD_TRACE("");
+
+    sim = wd_sim_get(wd);
+    if (sim == NULL)
+        WD_ERROR("Not a simulated WatchDog\n", 1, "");
+
+    if (ops_mask && err <= 0)
+        WD_ERROR("Incorrect errno %d\n", 1, err);
+
+    sim->fault_mask = ops_mask;
+    sim->fault_err = err;
+    sim->fault_count = count;
+
+    return 0;
+}
+
+int wd_sim_set_latency(watchdog_t wd, uint64_t latency_ns)
+{
+    struct wd_sim *sim;
+
+    WD_TRACE("");
+
+    sim = wd_sim_get(wd);
+    if (sim == NULL)
+        WD_ERROR("Not a simulated WatchDog\n", 1, "");
+
+    sim->latency_ns = latency_ns;
+
+    return 0;
+}
+
+int wd_sim_get_stats(watchdog_t wd, struct wd_sim_stats *stats)
+{
+    struct wd_sim *sim;
+
+    WD_TRACE("");
+
+    sim = wd_sim_get(wd);
+    if (sim == NULL)
+        WD_ERROR("Not a simulated WatchDog\n", 1, "");
+
+    if (stats == NULL)
+        WD_ERROR("stats == NULL\n", 1, "");
+
+    *stats = sim->stats;
+    wd_sim_update(sim, wd_sim_now(sim));
+    stats->expirations = sim->stats.expirations;
+
+    return 0;
+}
@@ -0,0 +1,553 @@
+#include <wd_soft.h>
+#include <wd_sched.h>
+#include <wd_log.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WD_SOFT_LEVELS      4
+#define WD_SOFT_SLOT_BITS   8
+#define WD_SOFT_SLOTS       (1U << WD_SOFT_SLOT_BITS)
+#define WD_SOFT_SLOT_MASK   (WD_SOFT_SLOTS - 1)
+#define WD_SOFT_MAX_DELTA   ((1ULL << (WD_SOFT_LEVELS * WD_SOFT_SLOT_BITS)) - 1)
+
+/* intrusive doubly linked list, head is a sentinel */
+struct wd_soft_link
+{
+    struct wd_soft_link *next;
+    struct wd_soft_link *prev;
+};
+
+struct wd_soft_timer
+{
+    struct wd_soft_link link;       /* wheel slot or expired list, must be first */
+    struct wd_soft      *ctx;
+    uint64_t            timeout_ns;
+    uint64_t            armed_ns;   /* deadline is armed_ns + timeout_ns */
+    uint64_t            kicked_ns;  /* last kick, written by any thread */
+    uint64_t            expires;    /* deadline in ticks */
+    uint64_t            expired_ns; /* when it expired (coarse, after last seen kick), 0 if alive */
+    wd_soft_cb_t        cb;
+    void                *arg;
+    unsigned int        flags;
+};
+
+struct wd_soft
+{
+    pthread_mutex_t     lock;
+    uint64_t            tick_ns;
+    uint64_t            start_ns;
+    uint64_t            now_tick;   /* last processed tick */
+    struct wd_soft_link wheel[WD_SOFT_LEVELS][WD_SOFT_SLOTS];
+    struct wd_soft_link expired;
+    struct wd_soft_stats stats;
+    int                 efd;
+
+    /* hardware feed */
+    watchdog_t          wd;
+    uint64_t            feed_period_ns;
+    uint64_t            next_feed_ns;
+
+    /* tick source */
+    struct wd_loop      *loop;
+    struct wd_loop      own_loop;
+    struct wd_event     tick;
+    pthread_t           thread;
+    bool                has_thread;
+    bool                stop;
+};
+
+static void wd_soft_link_init(struct wd_soft_link *head);
+static void wd_soft_link_add(struct wd_soft_link *head, struct wd_soft_link *link);
+static void wd_soft_link_del(struct wd_soft_link *link);
+static uint64_t wd_soft_ns_to_tick(const struct wd_soft *ctx, uint64_t ns);
+static void wd_soft_enqueue(struct wd_soft *ctx, struct wd_soft_timer *timer);
+static void wd_soft_cascade(struct wd_soft *ctx, unsigned int level);
+static size_t wd_soft_run_slot(struct wd_soft *ctx, struct wd_soft_link *slot, uint64_t now);
+static void wd_soft_revive(struct wd_soft *ctx);
+static void wd_soft_tick(struct wd_event *ev, uint32_t events);
+static void *wd_soft_thread(void *arg);
+
+static void wd_soft_link_init(struct wd_soft_link *head)
+{
+    head->next = head;
+    head->prev = head;
+}
+
+static void wd_soft_link_add(struct wd_soft_link *head, struct wd_soft_link *link)
+{
+    link->next = head->next;
+    link->prev = head;
+    head->next->prev = link;
+    head->next = link;
+}
+
+static void wd_soft_link_del(struct wd_soft_link *link)
+{
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->next = link;
+    link->prev = link;
+}
+
+/* rounds up, timer never fires before its deadline */
+static uint64_t wd_soft_ns_to_tick(const struct wd_soft *ctx, uint64_t ns)
+{
+    if (ns <= ctx->start_ns)
+        return 0;
+
+    return (ns - ctx->start_ns + ctx->tick_ns - 1) / ctx->tick_ns;
+}
+
+static void wd_soft_enqueue(struct wd_soft *ctx, struct wd_soft_timer *timer)
+{
+    uint64_t expires = wd_soft_ns_to_tick(ctx, timer->armed_ns + timer->timeout_ns);
+    uint64_t delta;
+    unsigned int level;
+
+    /* slot of current tick was already run */
+    if (expires <= ctx->now_tick)
+        expires = ctx->now_tick + 1;
+
+    delta = expires - ctx->now_tick;
+    if (delta > WD_SOFT_MAX_DELTA)
+    {
+        delta = WD_SOFT_MAX_DELTA;
+        expires = ctx->now_tick + delta;
+    }
+
+    for (level = 0; level < WD_SOFT_LEVELS - 1; ++level)
+        if (delta < (1ULL << ((level + 1) * WD_SOFT_SLOT_BITS)))
+            break;
+
+    timer->expires = expires;
+    wd_soft_link_add(&ctx->wheel[level][(expires >> (level * WD_SOFT_SLOT_BITS)) & WD_SOFT_SLOT_MASK], &timer->link);
+}
+
+/* move timers of current slot of given level one level down */
+static void wd_soft_cascade(struct wd_soft *ctx, unsigned int level)
+{
+    struct wd_soft_link list;
+    struct wd_soft_link *slot;
+    struct wd_soft_timer *timer;
+
+    slot = &ctx->wheel[level][(ctx->now_tick >> (level * WD_SOFT_SLOT_BITS)) & WD_SOFT_SLOT_MASK];
+    if (slot->next == slot)
+        return;
+
+    /* steal whole slot, enqueue may put timers back to the same level */
+    list = *slot;
+    list.next->prev = &list;
+    list.prev->next = &list;
+    wd_soft_link_init(slot);
+
+    while (list.next != &list)
+    {
+        timer = (struct wd_soft_timer *)list.next;
+        wd_soft_link_del(&timer->link);
+        wd_soft_enqueue(ctx, timer);
+    }
+}
+
+static size_t wd_soft_run_slot(struct wd_soft *ctx, struct wd_soft_link *slot, uint64_t now)
+{
+    struct wd_soft_link list;
+    struct wd_soft_timer *timer;
+    uint64_t kicked;
+    uint64_t expired;
+    size_t fired = 0;
+
+    if (slot->next == slot)
+        return 0;
+
+    list = *slot;
+    list.next->prev = &list;
+    list.prev->next = &list;
+    wd_soft_link_init(slot);
+
+    while (list.next != &list)
+    {
+        timer = (struct wd_soft_timer *)list.next;
+        wd_soft_link_del(&timer->link);
+
+        /* lazy kick: deadline moved while timer was waiting in wheel */
+        kicked = __atomic_load_n(&timer->kicked_ns, __ATOMIC_ACQUIRE);
+        if (kicked > timer->armed_ns)
+            timer->armed_ns = kicked;
+
+        if (timer->armed_ns + timer->timeout_ns > now)
+        {
+            ++ctx->stats.requeues;
+            wd_soft_enqueue(ctx, timer);
+            continue;
+        }
+
+        /* same clock as kicks, so any kick made after this point compares >= */
+        expired = wd_time_coarse_ns();
+        if (expired <= kicked)
+            expired = kicked + 1;
+
+        __atomic_store_n(&timer->expired_ns, expired, __ATOMIC_RELEASE);
+        wd_soft_link_add(&ctx->expired, &timer->link);
+        ++ctx->stats.expired;
+        ++ctx->stats.expirations;
+        if (timer->flags & WD_SOFT_CRITICAL)
+            ++ctx->stats.critical_expired;
+
+        if (timer->cb != NULL)
+            timer->cb(timer, timer->arg);
+        else
+            ++fired;
+    }
+
+    return fired;
+}
+
+/* expired timers kicked again are alive */
+static void wd_soft_revive(struct wd_soft *ctx)
+{
+    struct wd_soft_link *link = ctx->expired.next;
+    struct wd_soft_timer *timer;
+    uint64_t kicked;
+
+    while (link != &ctx->expired)
+    {
+        timer = (struct wd_soft_timer *)link;
+        link = link->next;
+
+        kicked = __atomic_load_n(&timer->kicked_ns, __ATOMIC_ACQUIRE);
+        if (kicked < timer->expired_ns)
+            continue;
+
+        wd_soft_link_del(&timer->link);
+        __atomic_store_n(&timer->expired_ns, 0, __ATOMIC_RELEASE);
+        timer->armed_ns = kicked;
+        --ctx->stats.expired;
+        if (timer->flags & WD_SOFT_CRITICAL)
+            --ctx->stats.critical_expired;
+
+        wd_soft_enqueue(ctx, timer);
+    }
+}
+
+size_t wd_soft_ctx_process(struct wd_soft *ctx, uint64_t now)
+{
+    const uint64_t target = now > ctx->start_ns ? (now - ctx->start_ns) / ctx->tick_ns : 0;
+    uint64_t events;
+    uint64_t expirations;
+    unsigned int level;
+    size_t fired = 0;
+    bool healthy;
+
+    (void)pthread_mutex_lock(&ctx->lock);
+
+    expirations = ctx->stats.expirations;
+
+    wd_soft_revive(ctx);
+
+    while (ctx->now_tick < target)
+    {
+        ++ctx->now_tick;
+
+        /* upper level slot is due when all lower level bits wrap */
+        for (level = 1; level < WD_SOFT_LEVELS; ++level)
+        {
+            if ((ctx->now_tick & ((1ULL << (level * WD_SOFT_SLOT_BITS)) - 1)) != 0)
+                break;
+
+            wd_soft_cascade(ctx, level);
+        }
+
+        fired += wd_soft_run_slot(ctx, &ctx->wheel[0][ctx->now_tick & WD_SOFT_SLOT_MASK], now);
+    }
+
+    expirations = ctx->stats.expirations - expirations;
+    healthy = ctx->stats.critical_expired == 0;
+
+    (void)pthread_mutex_unlock(&ctx->lock);
+
+    if (fired)
+    {
+        events = fired;
+        (void)write(ctx->efd, &events, sizeof(events));
+    }
+
+    if (ctx->wd != -1 && now >= ctx->next_feed_ns)
+    {
+        /* unhealthy: try again next tick, so recovery feeds at once */
+        if (!healthy)
+            __atomic_add_fetch(&ctx->stats.withheld, 1, __ATOMIC_RELAXED);
+        else if (wd_keepalive(ctx->wd) == 0)
+        {
+            __atomic_add_fetch(&ctx->stats.feeds, 1, __ATOMIC_RELAXED);
+            ctx->next_feed_ns = now + ctx->feed_period_ns;
+        }
+    }
+
+    return (size_t)expirations;
+}
+
+static void wd_soft_tick(struct wd_event *ev, uint32_t events)
+{
+    struct wd_soft *ctx = (struct wd_soft *)ev->arg;
+    uint64_t exp;
+    uint64_t now;
+
+    (void)events;
+
+    if (wd_timer_ack(ev->fd, &exp) || exp == 0)
+        return;
+
+    if (__atomic_load_n(&ctx->stop, __ATOMIC_ACQUIRE))
+    {
+        wd_loop_stop(ctx->loop);
+        return;
+    }
+
+    now = wd_time_now_ns();
+    (void)wd_soft_ctx_process(ctx, now);
+
+    /* next tick boundary, ticks do not drift */
+    (void)wd_timer_arm(ev->fd, ctx->start_ns + ((now - ctx->start_ns) / ctx->tick_ns + 1) * ctx->tick_ns);
+}
+
+static void *wd_soft_thread(void *arg)
+{
+    struct wd_soft *ctx = (struct wd_soft *)arg;
+
+    (void)wd_loop_run(&ctx->own_loop);
+
+    return NULL;
+}
+
+struct wd_soft *wd_soft_ctx_create(uint64_t tick_ns, watchdog_t wd)
+{
+    struct wd_soft *ctx;
+    unsigned int timeout;
+    unsigned int level;
+    unsigned int slot;
+
+    WD_TRACE("");
+
+    if (wd != -1 && (wd_get_timeout(wd, &timeout) || timeout == 0))
+        WD_ERROR("Cannot get timeout, feed period unknown\n", NULL, "");
+
+    ctx = calloc(1, sizeof(*ctx));
+    if (ctx == NULL)
+        WD_ERROR("Cannot allocate soft WatchDog context\n", NULL, "");
+
+    ctx->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ctx->efd == -1)
+    {
+        free(ctx);
+        WD_ERROR("Cannot create eventfd\n", NULL, "");
+    }
+
+    (void)pthread_mutex_init(&ctx->lock, NULL);
+    ctx->tick_ns = tick_ns ? tick_ns : WD_SOFT_DEFAULT_TICK_NS;
+    ctx->start_ns = wd_time_now_ns();
+    ctx->wd = wd;
+    ctx->tick.fd = -1;
+    if (wd != -1)
+        ctx->feed_period_ns = (uint64_t)timeout * WD_NSEC_PER_SEC / 100 * WD_SCHED_DEFAULT_FEED_PCT;
+
+    for (level = 0; level < WD_SOFT_LEVELS; ++level)
+        for (slot = 0; slot < WD_SOFT_SLOTS; ++slot)
+            wd_soft_link_init(&ctx->wheel[level][slot]);
+
+    wd_soft_link_init(&ctx->expired);
+
+    return ctx;
+}
+
+void wd_soft_ctx_destroy(struct wd_soft *ctx)
+{
+    struct wd_soft_timer *timer;
+    unsigned int level;
+    unsigned int slot;
+
+    WD_TRACE("");
+
+    if (ctx == NULL)
+        return;
+
+    if (ctx->has_thread)
+    {
+        __atomic_store_n(&ctx->stop, true, __ATOMIC_RELEASE);
+        (void)pthread_join(ctx->thread, NULL);
+        wd_loop_deinit(&ctx->own_loop);
+    }
+    else if (ctx->loop != NULL)
+        (void)wd_loop_del(ctx->loop, &ctx->tick);
+
+    if (ctx->tick.fd != -1)
+        (void)close(ctx->tick.fd);
+
+    for (level = 0; level < WD_SOFT_LEVELS; ++level)
+        for (slot = 0; slot < WD_SOFT_SLOTS; ++slot)
+            while (ctx->wheel[level][slot].next != &ctx->wheel[level][slot])
+            {
+                timer = (struct wd_soft_timer *)ctx->wheel[level][slot].next;
+                wd_soft_link_del(&timer->link);
+                free(timer);
+            }
+
+    while (ctx->expired.next != &ctx->expired)
+    {
+        timer = (struct wd_soft_timer *)ctx->expired.next;
+        wd_soft_link_del(&timer->link);
+        free(timer);
+    }
+
+    (void)close(ctx->efd);
+    (void)pthread_mutex_destroy(&ctx->lock);
+    free(ctx);
+}
+
+int wd_soft_ctx_attach(struct wd_soft *ctx, struct wd_loop *loop)
+{
+    WD_TRACE("");
+
+    if (ctx == NULL || loop == NULL)
+        WD_ERROR("ctx == NULL || loop == NULL\n", 1, "");
+
+    if (ctx->loop != NULL)
+        WD_ERROR("Soft WatchDog context is already driven\n", 1, "");
+
+    ctx->tick.fd = wd_timer_create();
+    if (ctx->tick.fd == -1)
+        return 1;
+
+    ctx->tick.cb = wd_soft_tick;
+    ctx->tick.arg = ctx;
+
+    if (wd_timer_arm(ctx->tick.fd, ctx->start_ns + ctx->tick_ns) || wd_loop_add(loop, &ctx->tick, EPOLLIN))
+    {
+        (void)close(ctx->tick.fd);
+        ctx->tick.fd = -1;
+        return 1;
+    }
+
+    ctx->loop = loop;
+
+    return 0;
+}
+
+int wd_soft_ctx_start(struct wd_soft *ctx)
+{
+    WD_TRACE("");
+
+    if (ctx == NULL)
+        WD_ERROR("ctx == NULL\n", 1, "");
+
+    if (wd_loop_init(&ctx->own_loop))
+        return 1;
+
+    if (wd_soft_ctx_attach(ctx, &ctx->own_loop))
+    {
+        wd_loop_deinit(&ctx->own_loop);
+        return 1;
+    }
+
+    if (pthread_create(&ctx->thread, NULL, wd_soft_thread, ctx) != 0)
+    {
+        (void)close(ctx->tick.fd);
+        ctx->tick.fd = -1;
+        ctx->loop = NULL;
+        wd_loop_deinit(&ctx->own_loop);
+        WD_ERROR("Cannot start soft WatchDog thread\n", 1, "");
+    }
+
+    ctx->has_thread = true;
+
+    return 0;
+}
+
+int wd_soft_ctx_fd(const struct wd_soft *ctx)
+{
+    return ctx ? ctx->efd : -1;
+}
+
+bool wd_soft_ctx_healthy(struct wd_soft *ctx)
+{
+    bool healthy;
+
+    (void)pthread_mutex_lock(&ctx->lock);
+    healthy = ctx->stats.critical_expired == 0;
+    (void)pthread_mutex_unlock(&ctx->lock);
+
+    return healthy;
+}
+
+void wd_soft_ctx_stats(struct wd_soft *ctx, struct wd_soft_stats *stats)
+{
+    (void)pthread_mutex_lock(&ctx->lock);
+    *stats = ctx->stats;
+    (void)pthread_mutex_unlock(&ctx->lock);
+
+    stats->feeds = __atomic_load_n(&ctx->stats.feeds, __ATOMIC_RELAXED);
+    stats->withheld = __atomic_load_n(&ctx->stats.withheld, __ATOMIC_RELAXED);
+}
+
+struct wd_soft_timer *wd_soft_create(struct wd_soft *ctx, uint64_t timeout_ns, unsigned int flags, wd_soft_cb_t cb, void *arg)
+{
+    struct wd_soft_timer *timer;
+
+    if (ctx == NULL || timeout_ns == 0)
+        WD_ERROR("ctx == NULL || timeout == 0\n", NULL, "");
+
+    timer = calloc(1, sizeof(*timer));
+    if (timer == NULL)
+        WD_ERROR("Cannot allocate soft WatchDog timer\n", NULL, "");
+
+    timer->ctx = ctx;
+    timer->timeout_ns = timeout_ns;
+    timer->flags = flags;
+    timer->cb = cb;
+    timer->arg = arg;
+    timer->armed_ns = wd_time_coarse_ns();
+
+    (void)pthread_mutex_lock(&ctx->lock);
+    wd_soft_enqueue(ctx, timer);
+    ++ctx->stats.timers;
+    (void)pthread_mutex_unlock(&ctx->lock);
+
+    return timer;
+}
+
+void wd_soft_kick(struct wd_soft_timer *timer)
+{
+    __atomic_store_n(&timer->kicked_ns, wd_time_coarse_ns(), __ATOMIC_RELEASE);
+}
+
+bool wd_soft_expired(const struct wd_soft_timer *timer)
+{
+    return __atomic_load_n(&timer->expired_ns, __ATOMIC_ACQUIRE) != 0 &&
+           __atomic_load_n(&timer->kicked_ns, __ATOMIC_ACQUIRE) < __atomic_load_n(&timer->expired_ns, __ATOMIC_ACQUIRE);
+}
+
+void wd_soft_destroy(struct wd_soft_timer *timer)
+{
+    struct wd_soft *ctx;
+
+    if (timer == NULL)
+        return;
+
+    ctx = timer->ctx;
+
+    (void)pthread_mutex_lock(&ctx->lock);
+    wd_soft_link_del(&timer->link);
+    --ctx->stats.timers;
+    if (timer->expired_ns)
+    {
+        --ctx->stats.expired;
+        if (timer->flags & WD_SOFT_CRITICAL)
+            --ctx->stats.critical_expired;
+    }
+    (void)pthread_mutex_unlock(&ctx->lock);
+
+    free(timer);
+}
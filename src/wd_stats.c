@@ -0,0 +1,415 @@
+#include <wd_stats.h>
+#include <wd_log.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+#define WD_STATS_INC(var) \
+    __atomic_store_n(&(var), __atomic_load_n(&(var), __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED)
+
+#define WD_STATS_SET(var, val) \
+    __atomic_store_n(&(var), (val), __ATOMIC_RELAXED)
+
+#define WD_STATS_ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+struct wd_stats_metric
+{
+    const char  *name;
+    int64_t     val;
+};
+
+static size_t wd_hist_index(uint64_t val);
+static uint64_t wd_hist_upper(size_t index);
+static int64_t wd_hist_pct(const struct wd_hist *hist, double p);
+static size_t wd_stats_metrics(const struct wd_stats *stats, struct wd_stats_metric *metrics, size_t n);
+
+/* values below WD_HIST_SUB are exact, above that 8 sub-buckets per power of 2 */
+static size_t wd_hist_index(uint64_t val)
+{
+    unsigned int power;
+    size_t index;
+
+    if (val < WD_HIST_SUB)
+        return (size_t)val;
+
+    power = 63U - (unsigned int)__builtin_clzll(val);
+    index = (size_t)(power - WD_HIST_SUB_BITS + 1) * WD_HIST_SUB +
+            (size_t)((val >> (power - WD_HIST_SUB_BITS)) & (WD_HIST_SUB - 1));
+
+    return index < WD_HIST_BUCKETS ? index : WD_HIST_BUCKETS - 1;
+}
+
+static uint64_t wd_hist_upper(size_t index)
+{
+    size_t power;
+    uint64_t sub;
+
+    if (index < WD_HIST_SUB)
+        return (uint64_t)index;
+
+    power = index / WD_HIST_SUB + WD_HIST_SUB_BITS - 1;
+    sub = (uint64_t)(index % WD_HIST_SUB);
+
+    return ((WD_HIST_SUB + sub + 1) << (power - WD_HIST_SUB_BITS)) - 1;
+}
+
+void wd_hist_add(struct wd_hist *hist, uint64_t val)
+{
+    WD_STATS_INC(hist->buckets[wd_hist_index(val)]);
+    WD_STATS_INC(hist->count);
+    if (val > hist->max)
+        WD_STATS_SET(hist->max, val);
+}
+
+struct wd_stats_file *wd_stats_create(const char *path, size_t ndevs)
+{
+    struct wd_stats_file *file;
+    int fd = -1;
+    int flags = MAP_SHARED | MAP_ANONYMOUS;
+
+    WD_TRACE("");
+
+    if (ndevs > WD_STATS_MAX_DEVS)
+        WD_ERROR("Too many devices, max is %d\n", NULL, WD_STATS_MAX_DEVS);
+
+    if (path != NULL)
+    {
+        fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd == -1)
+            WD_ERROR("Cannot open %s\n", NULL, path);
+
+        if (ftruncate(fd, (off_t)sizeof(*file)) == -1)
+        {
+            (void)close(fd);
+            WD_ERROR("Cannot resize %s\n", NULL, path);
+        }
+
+        flags = MAP_SHARED;
+    }
+
+    file = mmap(NULL, sizeof(*file), PROT_READ | PROT_WRITE, flags, fd, 0);
+    if (fd != -1)
+        (void)close(fd);
+
+    if (file == MAP_FAILED)
+        WD_ERROR("Cannot map stats\n", NULL, "");
+
+    (void)memset(file, 0, sizeof(*file));
+    file->version = WD_STATS_VERSION;
+    file->ndevs = (uint32_t)ndevs;
+    file->size = (uint32_t)sizeof(*file);
+
+    /* readers check magic last */
+    __atomic_store_n(&file->magic, WD_STATS_MAGIC, __ATOMIC_RELEASE);
+
+    return file;
+}
+
+const struct wd_stats_file *wd_stats_attach(const char *path)
+{
+    const struct wd_stats_file *file;
+    struct stat st;
+    int fd;
+
+    WD_TRACE("");
+
+    if (path == NULL)
+        WD_ERROR("path == NULL\n", NULL, "");
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        WD_ERROR("Cannot open %s\n", NULL, path);
+
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size != sizeof(*file))
+    {
+        (void)close(fd);
+        WD_ERROR("%s is not a stats file\n", NULL, path);
+    }
+
+    file = mmap(NULL, sizeof(*file), PROT_READ, MAP_SHARED, fd, 0);
+    (void)close(fd);
+    if (file == MAP_FAILED)
+        WD_ERROR("Cannot map %s\n", NULL, path);
+
+    if (__atomic_load_n(&file->magic, __ATOMIC_ACQUIRE) != WD_STATS_MAGIC ||
+        file->version != WD_STATS_VERSION || file->size != sizeof(*file))
+    {
+        wd_stats_destroy(file);
+        WD_ERROR("%s is not a stats file\n", NULL, path);
+    }
+
+    return file;
+}
+
+void wd_stats_destroy(const struct wd_stats_file *file)
+{
+    WD_TRACE("");
+
+    if (file == NULL)
+        return;
+
+    (void)munmap((void *)file, sizeof(*file));
+}
+
+void wd_stats_dev_init(struct wd_stats *stats, const char *dev, uint64_t timeout_ns, unsigned int near_miss_pct)
+{
+    WD_TRACE("");
+
+    if (stats == NULL)
+        return;
+
+    (void)memset(stats, 0, sizeof(*stats));
+    (void)strncpy(stats->dev, dev ? dev : "default watchdog", sizeof(stats->dev) - 1);
+    stats->timeout_ns = timeout_ns;
+    stats->near_miss_ns = timeout_ns / 100 * near_miss_pct;
+    stats->min_slack_ns = INT64_MAX;
+}
+
+void wd_stats_record(struct wd_stats *stats, const struct wd_feed_sample *sample, bool ok)
+{
+    uint64_t seq = stats->seq;
+
+    stats->ring[seq & (WD_STATS_RING_SIZE - 1)] = *sample;
+    __atomic_store_n(&stats->seq, seq + 1, __ATOMIC_RELEASE);
+
+    if (!ok)
+    {
+        WD_STATS_INC(stats->errors);
+        return;
+    }
+
+    WD_STATS_INC(stats->feeds);
+    wd_hist_add(&stats->jitter, sample->actual_ns > sample->sched_ns ? sample->actual_ns - sample->sched_ns : 0);
+    wd_hist_add(&stats->ioctl, sample->ioctl_ns);
+    wd_hist_add(&stats->slack, sample->slack_ns > 0 ? (uint64_t)sample->slack_ns : 0);
+
+    if (sample->slack_ns < stats->min_slack_ns)
+        WD_STATS_SET(stats->min_slack_ns, sample->slack_ns);
+
+    if (sample->slack_ns < (int64_t)stats->near_miss_ns)
+        WD_STATS_INC(stats->near_misses);
+}
+
+uint64_t wd_hist_percentile(const struct wd_hist *hist, double p)
+{
+    uint64_t count = __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+    uint64_t rank;
+    uint64_t seen = 0;
+    size_t i;
+
+    if (count == 0)
+        return 0;
+
+    rank = (uint64_t)((double)count * p / 100.0);
+    if (rank >= count)
+        rank = count - 1;
+
+    for (i = 0; i < WD_HIST_BUCKETS; ++i)
+    {
+        seen += __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+        if (seen > rank)
+            break;
+    }
+
+    /* upper bound of last bucket can be far above real max */
+    if (i == WD_HIST_BUCKETS || wd_hist_upper(i) > hist->max)
+        return __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+
+    return wd_hist_upper(i);
+}
+
+uint64_t wd_hist_count_le(const struct wd_hist *hist, uint64_t val)
+{
+    uint64_t count = 0;
+    size_t i;
+
+    for (i = 0; i < WD_HIST_BUCKETS && wd_hist_upper(i) <= val; ++i)
+        count += __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+
+    return count;
+}
+
+uint64_t wd_hist_sum(const struct wd_hist *hist)
+{
+    uint64_t sum = 0;
+    uint64_t lower = 0;
+    uint64_t upper;
+    size_t i;
+
+    for (i = 0; i < WD_HIST_BUCKETS; ++i)
+    {
+        upper = wd_hist_upper(i);
+        sum += __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED) * (lower + (upper - lower) / 2);
+        lower = upper + 1;
+    }
+
+    return sum;
+}
+
+size_t wd_stats_last(const struct wd_stats *stats, struct wd_feed_sample *samples, size_t n)
+{
+    uint64_t seq;
+    uint64_t first;
+    uint64_t i;
+    size_t copied = 0;
+
+    WD_TRACE("");
+
+    if (stats == NULL || samples == NULL)
+        return 0;
+
+    seq = __atomic_load_n(&stats->seq, __ATOMIC_ACQUIRE);
+    if (n > WD_STATS_RING_SIZE / 2)
+        n = WD_STATS_RING_SIZE / 2;
+
+    first = seq > n ? seq - n : 0;
+    for (i = first; i < seq; ++i)
+        samples[copied++] = stats->ring[i & (WD_STATS_RING_SIZE - 1)];
+
+    /* drop samples overwritten by writer while copying */
+    seq = __atomic_load_n(&stats->seq, __ATOMIC_ACQUIRE);
+    if (seq > first + WD_STATS_RING_SIZE)
+    {
+        i = seq - WD_STATS_RING_SIZE - first;
+        if (i >= copied)
+            return 0;
+
+        (void)memmove(samples, samples + i, (copied - (size_t)i) * sizeof(*samples));
+        copied -= (size_t)i;
+    }
+
+    return copied;
+}
+
+static int64_t wd_hist_pct(const struct wd_hist *hist, double p)
+{
+    uint64_t val = wd_hist_percentile(hist, p);
+
+    return val > INT64_MAX ? INT64_MAX : (int64_t)val;
+}
+
+static size_t wd_stats_metrics(const struct wd_stats *stats, struct wd_stats_metric *metrics, size_t n)
+{
+    struct wd_feed_sample last;
+    const int64_t min_slack = __atomic_load_n(&stats->min_slack_ns, __ATOMIC_RELAXED);
+    const struct wd_stats_metric all[] =
+    {
+        {"timeout_ns",          (int64_t)stats->timeout_ns},
+        {"feeds",               (int64_t)__atomic_load_n(&stats->feeds, __ATOMIC_RELAXED)},
+        {"errors",              (int64_t)__atomic_load_n(&stats->errors, __ATOMIC_RELAXED)},
+        {"near_misses",         (int64_t)__atomic_load_n(&stats->near_misses, __ATOMIC_RELAXED)},
+        {"near_miss_ns",        (int64_t)stats->near_miss_ns},
+        {"min_slack_ns",        min_slack == INT64_MAX ? 0 : min_slack},
+        {"slack_p1_ns",         wd_hist_pct(&stats->slack, 1.0)},
+        {"slack_p50_ns",        wd_hist_pct(&stats->slack, 50.0)},
+        {"jitter_p50_ns",       wd_hist_pct(&stats->jitter, 50.0)},
+        {"jitter_p99_ns",       wd_hist_pct(&stats->jitter, 99.0)},
+        {"jitter_p999_ns",      wd_hist_pct(&stats->jitter, 99.9)},
+        {"jitter_max_ns",       (int64_t)__atomic_load_n(&stats->jitter.max, __ATOMIC_RELAXED)},
+        {"keepalive_p50_ns",    wd_hist_pct(&stats->ioctl, 50.0)},
+        {"keepalive_p99_ns",    wd_hist_pct(&stats->ioctl, 99.0)},
+        {"keepalive_max_ns",    (int64_t)__atomic_load_n(&stats->ioctl.max, __ATOMIC_RELAXED)},
+        {"last_timeleft",       wd_stats_last(stats, &last, 1) == 1 && last.timeleft != WD_STATS_TIMELEFT_NONE ?
+                                (int64_t)last.timeleft : -1}
+    };
+
+    if (n > WD_STATS_ARRAY_SIZE(all))
+        n = WD_STATS_ARRAY_SIZE(all);
+
+    (void)memcpy(metrics, all, n * sizeof(*metrics));
+
+    return n;
+}
+
+ssize_t wd_stats_format(char *buf, size_t size, const struct wd_stats_file *file, wd_format_t fmt)
+{
+    struct wd_stats_metric metrics[32];
+    struct wd_fbuf fb;
+    const struct wd_stats *stats;
+    size_t ndevs;
+    size_t nmetrics;
+    size_t i;
+    size_t j;
+
+    WD_TRACE("");
+
+    if (buf == NULL || file == NULL)
+        WD_ERROR("buf == NULL || file == NULL\n", -1, "");
+
+    if (fmt == WD_FORMAT_BIN)
+        WD_ERROR("Binary format is not supported, read stats file directly\n", -1, "");
+
+    ndevs = file->ndevs < WD_STATS_MAX_DEVS ? file->ndevs : WD_STATS_MAX_DEVS;
+
+    wd_fbuf_init(&fb, buf, size);
+    if (fmt == WD_FORMAT_JSON)
+        wd_fbuf_put(&fb, "[", 1);
+
+    for (i = 0; i < ndevs; ++i)
+    {
+        stats = &file->devs[i];
+        nmetrics = wd_stats_metrics(stats, metrics, WD_STATS_ARRAY_SIZE(metrics));
+
+        switch (fmt)
+        {
+            case WD_FORMAT_JSON:
+            {
+                wd_fbuf_str(&fb, i ? ",{\"dev\":" : "{\"dev\":");
+                wd_fbuf_quoted(&fb, stats->dev, sizeof(stats->dev));
+                for (j = 0; j < nmetrics; ++j)
+                {
+                    wd_fbuf_str(&fb, ",\"");
+                    wd_fbuf_str(&fb, metrics[j].name);
+                    wd_fbuf_str(&fb, "\":");
+                    wd_fbuf_i64(&fb, metrics[j].val);
+                }
+                wd_fbuf_put(&fb, "}", 1);
+                break;
+            }
+            case WD_FORMAT_KV:
+            {
+                wd_fbuf_str(&fb, "dev");
+                wd_fbuf_u64(&fb, i);
+                wd_fbuf_str(&fb, "_name=");
+                wd_fbuf_quoted(&fb, stats->dev, sizeof(stats->dev));
+                wd_fbuf_put(&fb, "\n", 1);
+                for (j = 0; j < nmetrics; ++j)
+                {
+                    wd_fbuf_str(&fb, "dev");
+                    wd_fbuf_u64(&fb, i);
+                    wd_fbuf_put(&fb, "_", 1);
+                    wd_fbuf_str(&fb, metrics[j].name);
+                    wd_fbuf_put(&fb, "=", 1);
+                    wd_fbuf_i64(&fb, metrics[j].val);
+                    wd_fbuf_put(&fb, "\n", 1);
+                }
+                break;
+            }
+            default:
+            {
+                wd_fbuf_put(&fb, stats->dev, strnlen(stats->dev, sizeof(stats->dev)));
+                wd_fbuf_str(&fb, "\n");
+                for (j = 0; j < nmetrics; ++j)
+                {
+                    wd_fbuf_str(&fb, "\t");
+                    wd_fbuf_str(&fb, metrics[j].name);
+                    wd_fbuf_str(&fb, "\t");
+                    if (strlen(metrics[j].name) < 8)
+                        wd_fbuf_str(&fb, "\t");
+                    if (strlen(metrics[j].name) < 16)
+                        wd_fbuf_str(&fb, "\t");
+                    wd_fbuf_i64(&fb, metrics[j].val);
+                    wd_fbuf_put(&fb, "\n", 1);
+                }
+                break;
+            }
+        }
+    }
+
+    if (fmt == WD_FORMAT_JSON)
+        wd_fbuf_str(&fb, "]\n");
+
+    return fb.overflow ? -1 : (ssize_t)fb.len;
+}
@@ -0,0 +1,353 @@
+#include <wd_sysfs.h>
+#include <wd_backend.h>
+#include <wd_log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+
+#define WD_SYSFS_DEV_PREFIX "/dev/"
+#define WD_SYSFS_LEGACY     "watchdog"
+#define WD_SYSFS_BUF_SIZE   64
+
+static const char *const wd_sysfs_names[WD_SYSFS_ATTRS] =
+{
+    [WD_SYSFS_TIMEOUT]      = "timeout",
+    [WD_SYSFS_PRETIMEOUT]   = "pretimeout",
+    [WD_SYSFS_TIMELEFT]     = "timeleft",
+    [WD_SYSFS_BOOTSTATUS]   = "bootstatus",
+    [WD_SYSFS_STATUS]       = "status",
+    [WD_SYSFS_IDENTITY]     = "identity",
+    [WD_SYSFS_FW_VERSION]   = "fw_version",
+    [WD_SYSFS_OPTIONS]      = "options",
+    [WD_SYSFS_STATE]        = "state"
+};
+
+static int wd_sysfs_read(const struct wd_sysfs *sysfs, wd_sysfs_attr_t attr, char *buf, size_t size);
+static int wd_sysfs_read_ulong(const struct wd_sysfs *sysfs, wd_sysfs_attr_t attr, unsigned long *val);
+
+static int wd_sysfs_read(const struct wd_sysfs *sysfs, wd_sysfs_attr_t attr, char *buf, size_t size)
+{
+    ssize_t len;
+
+    if (sysfs == NULL)
+        WD_ERROR("sysfs == NULL\n", 1, "");
+
+    if (sysfs->fds[attr] == -1)
+        WD_ERROR("Attribute %s not supported\n", 1, wd_sysfs_names[attr]);
+
+    /* read from offset 0 makes sysfs regenerate value */
+    len = pread(sysfs->fds[attr], buf, size - 1, 0);
+    if (len <= 0)
+        WD_ERROR("Cannot read %s\n", 1, wd_sysfs_names[attr]);
+
+    if (buf[len - 1] == '\n')
+        --len;
+
+    buf[len] = '\0';
+
+    return 0;
+}
+
+static int wd_sysfs_read_ulong(const struct wd_sysfs *sysfs, wd_sysfs_attr_t attr, unsigned long *val)
+{
+    char buf[WD_SYSFS_BUF_SIZE];
+    char *end;
+
+    if (wd_sysfs_read(sysfs, attr, buf, sizeof(buf)))
+        return 1;
+
+    /* base 0 accepts both decimal and 0x hex attributes */
+    *val = strtoul(buf, &end, 0);
+    if (end == buf)
+        WD_ERROR("Incorrect value of %s\n", 1, wd_sysfs_names[attr]);
+
+    return 0;
+}
+
+int wd_sysfs_open(const char *dev, struct wd_sysfs *sysfs)
+{
+    char dir[PATH_MAX];
+    char path[PATH_MAX];
+    const char *name;
+    size_t i;
+    int opened = 0;
+
+    WD_TRACE("");
+
+    if (sysfs == NULL)
+        WD_ERROR("sysfs == NULL\n", 1, "");
+
+    if (dev == NULL)
+        dev = WD_SYSFS_DEV_PREFIX WD_SYSFS_LEGACY;
+
+    if (strncmp(dev, WD_SYSFS_DEV_PREFIX, strlen(WD_SYSFS_DEV_PREFIX)) == 0)
+    {
+        name = dev + strlen(WD_SYSFS_DEV_PREFIX);
+
+        /* legacy /dev/watchdog is an alias of first watchdog */
+        if (strcmp(name, WD_SYSFS_LEGACY) == 0)
+            name = WD_SYSFS_LEGACY "0";
+
+        if (snprintf(dir, sizeof(dir), "%s/%s", WD_SYSFS_CLASS, name) >= (int)sizeof(dir))
+            WD_ERROR("Path too long\n", 1, "");
+    }
+    else if (snprintf(dir, sizeof(dir), "%s", dev) >= (int)sizeof(dir))
+        WD_ERROR("Path too long\n", 1, "");
+
+    for (i = 0; i < WD_SYSFS_ATTRS; ++i)
+    {
+        sysfs->fds[i] = -1;
+        if (snprintf(path, sizeof(path), "%s/%s", dir, wd_sysfs_names[i]) >= (int)sizeof(path))
+            continue;
+
+        sysfs->fds[i] = open(path, O_RDONLY | O_CLOEXEC);
+        if (sysfs->fds[i] != -1)
+            ++opened;
+    }
+
+    if (opened == 0)
+        WD_ERROR("Cannot open sysfs of %s\n", 1, dir);
+
+    return 0;
+}
+
+void wd_sysfs_close(struct wd_sysfs *sysfs)
+{
+    size_t i;
+
+    WD_TRACE("");
+
+    if (sysfs == NULL)
+        return;
+
+    for (i = 0; i < WD_SYSFS_ATTRS; ++i)
+        if (sysfs->fds[i] != -1)
+        {
+            (void)close(sysfs->fds[i]);
+            sysfs->fds[i] = -1;
+        }
+}
+
+int wd_sysfs_get_timeout(const struct wd_sysfs *sysfs, unsigned int *timeout)
+{
+    unsigned long val;
+
+    WD_TRACE("");
+
+    if (timeout == NULL)
+        WD_ERROR("timeout == NULL\n", 1, "");
+
+    if (wd_sysfs_read_ulong(sysfs, WD_SYSFS_TIMEOUT, &val))
+        WD_ERROR("Cannot get Watchdog timeout\n", 1, "");
+
+    *timeout = (unsigned int)val;
+
+    return 0;
+}
+
+int wd_sysfs_get_pretimeout(const struct wd_sysfs *sysfs, unsigned int *timeout)
+{
+    unsigned long val;
+
+    WD_TRACE("");
+
+    if (timeout == NULL)
+        WD_ERROR("Timeout == NULL\n", 1, "");
+
+    if (wd_sysfs_read_ulong(sysfs, WD_SYSFS_PRETIMEOUT, &val))
+        WD_ERROR("Cannot get Watchdog pretimeout\n", 1, "");
+
+    *timeout = (unsigned int)val;
+
+    return 0;
+}
+
+int wd_sysfs_get_timeleft(const struct wd_sysfs *sysfs, unsigned int *time)
+{
+    unsigned long val;
+
+    WD_TRACE("");
+
+    if (time == NULL)
+        WD_ERROR("time == NULL\n", 1, "");
+
+    if (wd_sysfs_read_ulong(sysfs, WD_SYSFS_TIMELEFT, &val))
+        WD_ERROR("Cannot get time left to reset by Watchdog\n", 1, "");
+
+    *time = (unsigned int)val;
+
+    return 0;
+}
+
+int wd_sysfs_get_bootstatus(const struct wd_sysfs *sysfs, int *status)
+{
+    unsigned long val;
+
+    WD_TRACE("");
+
+    if (status == NULL)
+        WD_ERROR("status == NULL\n", 1, "");
+
+    if (wd_sysfs_read_ulong(sysfs, WD_SYSFS_BOOTSTATUS, &val))
+        WD_ERROR("Cannot get Bootstatus\n", 1, "");
+
+    *status = (int)val;
+
+    return 0;
+}
+
+int wd_sysfs_get_status(const struct wd_sysfs *sysfs, int *status)
+{
+    unsigned long val;
+
+    WD_TRACE("");
+
+    if (status == NULL)
+        WD_ERROR("status == NULL\n", 1, "");
+
+    if (wd_sysfs_read_ulong(sysfs, WD_SYSFS_STATUS, &val))
+        WD_ERROR("Cannot get Status\n", 1, "");
+
+    *status = (int)val;
+
+    return 0;
+}
+
+int wd_sysfs_get_info(const struct wd_sysfs *sysfs, struct watchdog_info *wd_info)
+{
+    char buf[sizeof(wd_info->identity)];
+    unsigned long val;
+
+    WD_TRACE("");
+
+    if (wd_info == NULL)
+        WD_ERROR("wd_info == NULL\n", 1, "");
+
+    (void)memset(wd_info, 0, sizeof(*wd_info));
+
+    if (wd_sysfs_read(sysfs, WD_SYSFS_IDENTITY, buf, sizeof(buf)))
+        WD_ERROR("Cannot get WatchDog info\n", 1, "");
+
+    (void)memcpy(wd_info->identity, buf, strlen(buf));
+
+    /* older kernels do not export these, identity is enough */
+    if (sysfs->fds[WD_SYSFS_FW_VERSION] != -1 && wd_sysfs_read_ulong(sysfs, WD_SYSFS_FW_VERSION, &val) == 0)
+        wd_info->firmware_version = (__u32)val;
+
+    if (sysfs->fds[WD_SYSFS_OPTIONS] != -1 && wd_sysfs_read_ulong(sysfs, WD_SYSFS_OPTIONS, &val) == 0)
+        wd_info->options = (__u32)val;
+
+    return 0;
+}
+
+int wd_sysfs_get_state(const struct wd_sysfs *sysfs, bool *active)
+{
+    char buf[WD_SYSFS_BUF_SIZE];
+
+    WD_TRACE("");
+
+    if (active == NULL)
+        WD_ERROR("active == NULL\n", 1, "");
+
+    if (wd_sysfs_read(sysfs, WD_SYSFS_STATE, buf, sizeof(buf)))
+        WD_ERROR("Cannot get WatchDog state\n", 1, "");
+
+    *active = strcmp(buf, "active") == 0;
+
+    return 0;
+}
+
+static int wd_sysfs_backend_open(struct wd_backend_ctx *ctx, const char *dev);
+static int wd_sysfs_backend_close(struct wd_backend_ctx *ctx, bool magic);
+static int wd_sysfs_backend_get_timeout(struct wd_backend_ctx *ctx, unsigned int *timeout);
+static int wd_sysfs_backend_get_pretimeout(struct wd_backend_ctx *ctx, unsigned int *timeout);
+static int wd_sysfs_backend_get_timeleft(struct wd_backend_ctx *ctx, unsigned int *time);
+static int wd_sysfs_backend_get_bootstatus(struct wd_backend_ctx *ctx, int *status);
+static int wd_sysfs_backend_get_status(struct wd_backend_ctx *ctx, int *status);
+static int wd_sysfs_backend_get_info(struct wd_backend_ctx *ctx, struct watchdog_info *wd_info);
+
+/* read-only backend, setters and keepalive are not available */
+const struct wd_backend_ops wd_backend_sysfs =
+{
+    .name           = "sysfs",
+    .open           = wd_sysfs_backend_open,
+    .close          = wd_sysfs_backend_close,
+    .get_timeout    = wd_sysfs_backend_get_timeout,
+    .get_pretimeout = wd_sysfs_backend_get_pretimeout,
+    .get_timeleft   = wd_sysfs_backend_get_timeleft,
+    .get_bootstatus = wd_sysfs_backend_get_bootstatus,
+    .get_status     = wd_sysfs_backend_get_status,
+    .get_info       = wd_sysfs_backend_get_info
+};
+
+/* missing attribute means driver does not support it */
+#define WD_SYSFS_BACKEND_CALL(ctx, attr, call) \
+    __extension__ \
+    ({ \
+        const struct wd_sysfs *______sysfs = (const struct wd_sysfs *)(ctx)->priv; \
+        ______sysfs->fds[attr] == -1 ? -EOPNOTSUPP : ((call) ? -EIO : 0); \
+    })
+
+static int wd_sysfs_backend_open(struct wd_backend_ctx *ctx, const char *dev)
+{
+    struct wd_sysfs *sysfs;
+
+    sysfs = malloc(sizeof(*sysfs));
+    if (sysfs == NULL)
+        return -ENOMEM;
+
+    if (wd_sysfs_open(dev, sysfs))
+    {
+        free(sysfs);
+        return -ENOENT;
+    }
+
+    ctx->priv = sysfs;
+
+    return 0;
+}
+
+static int wd_sysfs_backend_close(struct wd_backend_ctx *ctx, bool magic)
+{
+    (void)magic;
+
+    wd_sysfs_close((struct wd_sysfs *)ctx->priv);
+    free(ctx->priv);
+    ctx->priv = NULL;
+
+    return 0;
+}
+
+static int wd_sysfs_backend_get_timeout(struct wd_backend_ctx *ctx, unsigned int *timeout)
+{
+    return WD_SYSFS_BACKEND_CALL(ctx, WD_SYSFS_TIMEOUT, wd_sysfs_get_timeout(______sysfs, timeout));
+}
+
+static int wd_sysfs_backend_get_pretimeout(struct wd_backend_ctx *ctx, unsigned int *timeout)
+{
+    return WD_SYSFS_BACKEND_CALL(ctx, WD_SYSFS_PRETIMEOUT, wd_sysfs_get_pretimeout(______sysfs, timeout));
+}
+
+static int wd_sysfs_backend_get_timeleft(struct wd_backend_ctx *ctx, unsigned int *time)
+{
+    return WD_SYSFS_BACKEND_CALL(ctx, WD_SYSFS_TIMELEFT, wd_sysfs_get_timeleft(______sysfs, time));
+}
+
+static int wd_sysfs_backend_get_bootstatus(struct wd_backend_ctx *ctx, int *status)
+{
+    return WD_SYSFS_BACKEND_CALL(ctx, WD_SYSFS_BOOTSTATUS, wd_sysfs_get_bootstatus(______sysfs, status));
+}
+
+static int wd_sysfs_backend_get_status(struct wd_backend_ctx *ctx, int *status)
+{
+    return WD_SYSFS_BACKEND_CALL(ctx, WD_SYSFS_STATUS, wd_sysfs_get_status(______sysfs, status));
+}
+
+static int wd_sysfs_backend_get_info(struct wd_backend_ctx *ctx, struct watchdog_info *wd_info)
+{
+    return WD_SYSFS_BACKEND_CALL(ctx, WD_SYSFS_IDENTITY, wd_sysfs_get_info(______sysfs, wd_info));
+}
@@ -0,0 +1,148 @@
+#include <wd_trace.h>
+#include <wd_time.h>
+#include <wd_log.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#define WD_TRACE_ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+struct wd_trace_hdr *wd_trace_ring;
+
+static struct wd_trace_rec *wd_trace_recs;
+static size_t wd_trace_size;
+
+static const char *const wd_trace_fn_names[] =
+{
+    [WD_OP_KEEPALIVE]       = "keepalive",
+    [WD_OP_GET_TIMEOUT]     = "get_timeout",
+    [WD_OP_SET_TIMEOUT]     = "set_timeout",
+    [WD_OP_GET_PRETIMEOUT]  = "get_pretimeout",
+    [WD_OP_SET_PRETIMEOUT]  = "set_pretimeout",
+    [WD_OP_GET_TIMELEFT]    = "get_timeleft",
+    [WD_OP_GET_BOOTSTATUS]  = "get_bootstatus",
+    [WD_OP_GET_STATUS]      = "get_status",
+    [WD_OP_GET_TEMP]        = "get_temp",
+    [WD_OP_SET_OPTIONS]     = "set_options",
+    [WD_OP_GET_INFO]        = "get_info",
+    [WD_TRACE_FN_OPEN]      = "open",
+    [WD_TRACE_FN_CLOSE]     = "close",
+    [WD_TRACE_FN_RELEASE]   = "release",
+    [WD_TRACE_FN_SNAPSHOT]  = "get_snapshot"
+};
+
+int wd_trace_open(const char *path, size_t nrecs)
+{
+    struct wd_trace_hdr *hdr;
+    size_t size;
+    size_t n = 1;
+    int fd;
+
+    WD_TRACE("");
+
+    if (path == NULL)
+        WD_ERROR("path == NULL\n", 1, "");
+
+    if (wd_trace_ring != NULL)
+        WD_ERROR("Trace is already enabled\n", 1, "");
+
+    if (nrecs == 0)
+        nrecs = WD_TRACE_DEFAULT_RECS;
+
+    while (n < nrecs)
+        n <<= 1;
+
+    if (n > UINT32_MAX)
+        WD_ERROR("Trace ring too big\n", 1, "");
+
+    size = sizeof(*hdr) + n * sizeof(struct wd_trace_rec);
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+        WD_ERROR("Cannot open %s\n", 1, path);
+
+    if (ftruncate(fd, (off_t)size) == -1)
+    {
+        (void)close(fd);
+        WD_ERROR("Cannot resize %s\n", 1, path);
+    }
+
+    hdr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    (void)close(fd);
+    if (hdr == MAP_FAILED)
+        WD_ERROR("Cannot map %s\n", 1, path);
+
+    hdr->version = WD_TRACE_VERSION;
+    hdr->rec_size = (uint16_t)sizeof(struct wd_trace_rec);
+    hdr->nrecs = (uint32_t)n;
+    hdr->pid = (uint32_t)getpid();
+    hdr->start_ns = wd_time_now_ns();
+    __atomic_store_n(&hdr->magic, WD_TRACE_MAGIC, __ATOMIC_RELEASE);
+
+    wd_trace_recs = (struct wd_trace_rec *)(hdr + 1);
+    wd_trace_size = size;
+    __atomic_store_n(&wd_trace_ring, hdr, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+void wd_trace_close(void)
+{
+    struct wd_trace_hdr *hdr;
+
+    WD_TRACE("");
+
+    hdr = __atomic_exchange_n(&wd_trace_ring, NULL, __ATOMIC_ACQ_REL);
+    if (hdr == NULL)
+        return;
+
+    (void)munmap(hdr, wd_trace_size);
+    wd_trace_recs = NULL;
+}
+
+void wd_trace_record(unsigned int fn, watchdog_t wd, int ret, uint32_t arg, uint64_t start_ns)
+{
+    struct wd_trace_hdr *hdr = wd_trace_ring;
+    struct wd_trace_rec *rec;
+    const int err = errno;
+    uint64_t seq;
+
+    if (hdr == NULL)
+        return;
+
+    seq = __atomic_fetch_add(&hdr->seq, 1, __ATOMIC_RELAXED);
+    rec = &wd_trace_recs[seq & (hdr->nrecs - 1)];
+
+    /* invalidate slot first, reader skips it until it is complete again */
+    __atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    rec->ts_ns = wd_time_now_ns();
+    rec->fn = (uint16_t)fn;
+    rec->wd = (int16_t)wd;
+    rec->ret = ret;
+    rec->err = ret ? err : 0;
+    rec->arg = arg;
+    rec->lat_ns = start_ns == 0 ? 0 : rec->ts_ns - start_ns > UINT32_MAX ? UINT32_MAX : (uint32_t)(rec->ts_ns - start_ns);
+    rec->pad = 0;
+
+    __atomic_store_n(&rec->seq, seq + 1, __ATOMIC_RELEASE);
+
+    /* caller may look at errno after return */
+    errno = err;
+}
+
+uint64_t wd_trace_now(void)
+{
+    return wd_time_now_ns();
+}
+
+const char *wd_trace_fn_name(unsigned int fn)
+{
+    if (fn >= WD_TRACE_ARRAY_SIZE(wd_trace_fn_names) || wd_trace_fn_names[fn] == NULL)
+        return "unknown";
+
+    return wd_trace_fn_names[fn];
+}
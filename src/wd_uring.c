@@ -0,0 +1,287 @@
+#include <wd_uring.h>
+#include <wd_backend.h>
+#include <wd_trace.h>
+#include <wd_log.h>
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+/* any byte but 'V' pings, 'V' would arm magic close */
+static const char wd_uring_ping[1] = {'\0'};
+
+static int wd_uring_setup(struct wd_uring *ring, unsigned int entries);
+static int wd_uring_ioctl(struct wd_uring *ring, const struct wd_uring_dev *dev);
+static unsigned int wd_uring_submit(struct wd_uring *ring, const size_t *idx, size_t n, int *res);
+static unsigned int wd_uring_reap(struct wd_uring *ring, int *res);
+
+static int wd_uring_setup(struct wd_uring *ring, unsigned int entries)
+{
+    struct io_uring_params params;
+    int files[WD_URING_MAX_DEVS];
+    long fd;
+    size_t i;
+
+    WD_TRACE("");
+
+    (void)memset(&params, 0, sizeof(params));
+    fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+        WD_ERROR("Cannot set up io_uring\n", 1, "");
+
+    ring->fd = (int)fd;
+
+    ring->sq_ring_len = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    ring->sq_ring = mmap(NULL, ring->sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ring->fd, (off_t)IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED)
+    {
+        ring->sq_ring = NULL;
+        WD_ERROR("Cannot map io_uring SQ ring\n", 1, "");
+    }
+
+    ring->cq_ring_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->cq_ring = mmap(NULL, ring->cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ring->fd, (off_t)IORING_OFF_CQ_RING);
+    if (ring->cq_ring == MAP_FAILED)
+    {
+        ring->cq_ring = NULL;
+        WD_ERROR("Cannot map io_uring CQ ring\n", 1, "");
+    }
+
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, (off_t)IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        ring->sqes = NULL;
+        WD_ERROR("Cannot map io_uring SQEs\n", 1, "");
+    }
+
+    ring->sq_head = (void *)((char *)ring->sq_ring + params.sq_off.head);
+    ring->sq_tail = (void *)((char *)ring->sq_ring + params.sq_off.tail);
+    ring->sq_array = (void *)((char *)ring->sq_ring + params.sq_off.array);
+    ring->sq_mask = *(const unsigned int *)(void *)((char *)ring->sq_ring + params.sq_off.ring_mask);
+    ring->cq_head = (void *)((char *)ring->cq_ring + params.cq_off.head);
+    ring->cq_tail = (void *)((char *)ring->cq_ring + params.cq_off.tail);
+    ring->cqes = (void *)((char *)ring->cq_ring + params.cq_off.cqes);
+    ring->cq_mask = *(const unsigned int *)(void *)((char *)ring->cq_ring + params.cq_off.ring_mask);
+
+    /* watchdog is not seekable, older kernels just want some offset */
+    ring->off = params.features & IORING_FEAT_RW_CUR_POS ? (uint64_t)-1 : 0;
+
+    /* fixed files skip descriptor lookup and refcount on every write, plain descriptors work too */
+    for (i = 0; i < ring->ndevs; ++i)
+        files[i] = ring->devs[i].fd;
+
+    ring->fixed = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_FILES, files, (unsigned int)ring->ndevs) == 0;
+
+    return 0;
+}
+
+static int wd_uring_ioctl(struct wd_uring *ring, const struct wd_uring_dev *dev)
+{
+    ++ring->ioctls;
+
+    errno = 0;
+    if (wd_keepalive(dev->wd) == 0)
+        return 0;
+
+    return errno ? -errno : -EIO;
+}
+
+/* queues writes, ioctl devices are fed right away, pending writes get res 1 */
+static unsigned int wd_uring_submit(struct wd_uring *ring, const size_t *idx, size_t n, int *res)
+{
+    struct io_uring_sqe *sqe;
+    const struct wd_uring_dev *dev;
+    const unsigned int tail = ring->fd != -1 ? *ring->sq_tail : 0;
+    unsigned int queued = 0;
+    unsigned int slot;
+    size_t i;
+
+    for (i = 0; i < n; ++i)
+    {
+        dev = &ring->devs[idx[i]];
+        if (ring->fd == -1 || dev->fd == -1)
+        {
+            res[i] = wd_uring_ioctl(ring, dev);
+            continue;
+        }
+
+        slot = (tail + queued) & ring->sq_mask;
+        sqe = (struct io_uring_sqe *)ring->sqes + slot;
+        (void)memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = ring->fixed ? (int)idx[i] : dev->fd;
+        sqe->flags = ring->fixed ? IOSQE_FIXED_FILE : 0;
+        sqe->addr = (uint64_t)(uintptr_t)wd_uring_ping;
+        sqe->len = sizeof(wd_uring_ping);
+        sqe->off = ring->off;
+        sqe->user_data = i;
+        ring->sq_array[slot] = slot;
+
+        res[i] = 1;
+        ++queued;
+    }
+
+    /* kernel reads SQEs only after it sees new tail */
+    if (queued)
+        __atomic_store_n(ring->sq_tail, tail + queued, __ATOMIC_RELEASE);
+
+    return queued;
+}
+
+static unsigned int wd_uring_reap(struct wd_uring *ring, int *res)
+{
+    const struct io_uring_cqe *cqe;
+    unsigned int head = *ring->cq_head;
+    unsigned int done = 0;
+
+    while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+    {
+        cqe = (const struct io_uring_cqe *)ring->cqes + (head & ring->cq_mask);
+
+        /* watchdog_write returns length after successful ping */
+        res[cqe->user_data] = cqe->res > 0 ? 0 : (cqe->res < 0 ? cqe->res : -EIO);
+
+        ++head;
+        ++done;
+    }
+
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+    return done;
+}
+
+int wd_uring_init(struct wd_uring *ring, const watchdog_t *wds, size_t n)
+{
+    size_t nfds = 0;
+    size_t i;
+
+    WD_TRACE("");
+
+    if (ring == NULL || wds == NULL)
+        WD_ERROR("ring == NULL || wds == NULL\n", 1, "");
+
+    if (n == 0 || n > WD_URING_MAX_DEVS)
+        WD_ERROR("Incorrect number of devices %zu, max is %d\n", 1, n, WD_URING_MAX_DEVS);
+
+    (void)memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+    ring->ndevs = n;
+    for (i = 0; i < n; ++i)
+    {
+        ring->devs[i].wd = wds[i];
+        ring->devs[i].fd = wd_get_fd(wds[i]);
+        if (ring->devs[i].fd != -1)
+            ++nfds;
+    }
+
+    /* nothing to write to, same as fallback */
+    if (nfds == 0)
+        return 0;
+
+    if (wd_uring_setup(ring, (unsigned int)n))
+    {
+        wd_uring_deinit(ring);
+        WD_LOG("io_uring is not available, feeding by ioctl\n");
+    }
+
+    return 0;
+}
+
+void wd_uring_deinit(struct wd_uring *ring)
+{
+    WD_TRACE("");
+
+    if (ring == NULL)
+        return;
+
+    if (ring->sqes != NULL)
+        (void)munmap(ring->sqes, ring->sqes_len);
+
+    if (ring->cq_ring != NULL)
+        (void)munmap(ring->cq_ring, ring->cq_ring_len);
+
+    if (ring->sq_ring != NULL)
+        (void)munmap(ring->sq_ring, ring->sq_ring_len);
+
+    if (ring->fd != -1)
+        (void)close(ring->fd);
+
+    ring->sqes = NULL;
+    ring->cq_ring = NULL;
+    ring->sq_ring = NULL;
+    ring->fd = -1;
+    ring->fixed = false;
+}
+
+int wd_uring_feed(struct wd_uring *ring, const size_t *idx, size_t n, int *res)
+{
+    unsigned int queued;
+    unsigned int submitted = 0;
+    uint64_t start;
+    unsigned int done = 0;
+    long ret;
+    size_t i;
+    int failed = 0;
+
+    WD_TRACE("");
+
+    if (ring == NULL || idx == NULL || res == NULL)
+        WD_ERROR("ring == NULL || idx == NULL || res == NULL\n", 1, "");
+
+    for (i = 0; i < n; ++i)
+        if (idx[i] >= ring->ndevs)
+            WD_ERROR("Incorrect device index %zu\n", 1, idx[i]);
+
+    start = WD_TRACE_START();
+    queued = wd_uring_submit(ring, idx, n, res);
+
+    /* submit everything and wait for every completion in one call */
+    while (done < queued)
+    {
+        ret = syscall(__NR_io_uring_enter, ring->fd, queued - submitted, queued - done, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0 && errno != EINTR)
+            break;
+
+        if (ret >= 0)
+        {
+            submitted += (unsigned int)ret;
+            ++ring->batches;
+        }
+
+        done += wd_uring_reap(ring, res);
+    }
+
+    /* broken ring would keep stale SQEs, drop it and never come back */
+    if (done < queued)
+    {
+        WD_LOG("io_uring enter failed, feeding by ioctl from now on\n");
+        wd_uring_deinit(ring);
+
+        for (i = 0; i < n; ++i)
+            if (res[i] > 0)
+                res[i] = wd_uring_ioctl(ring, &ring->devs[idx[i]]);
+    }
+
+    for (i = 0; i < n; ++i)
+    {
+        if (ring->devs[idx[i]].fd != -1 && ring->fd != -1)
+        {
+            ++ring->writes;
+            WD_TRACE_OP(WD_OP_KEEPALIVE, ring->devs[idx[i]].wd, res[i] ? -1 : 0, 0, start);
+        }
+
+        if (res[i])
+        {
+            ++ring->errors;
+            failed = 1;
+        }
+    }
+
+    return failed;
+}
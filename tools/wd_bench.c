@@ -0,0 +1,512 @@
+/*
+    Latency benchmark of every watchdog.h entry point
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <sched.h>
+#include <limits.h>
+#include <sys/utsname.h>
+#include <watchdog.h>
+#include <wd_format.h>
+#include <wd_time.h>
+#include <wd_trace.h>
+#include <wd_uring.h>
+
+#define BENCH_DEFAULT_ITERS     100000
+#define BENCH_DEFAULT_WARMUP    1000
+#define BENCH_HIST_BUCKETS      32  /* log2 buckets of ns */
+#define BENCH_JSON_STR_SIZE     (6 * PATH_MAX + 3)  /* every char escaped to 6 bytes, quotes, NULL */
+
+typedef int (*bench_fn_t)(watchdog_t wd);
+
+struct bench_op
+{
+    const char  *name;
+    bench_fn_t  fn;
+};
+
+struct bench_result
+{
+    uint64_t    min;
+    uint64_t    p50;
+    uint64_t    p99;
+    uint64_t    p999;
+    uint64_t    max;
+    uint64_t    mean;
+    uint64_t    hist[BENCH_HIST_BUCKETS];
+};
+
+static unsigned int bench_timeout;
+
+/* devices fed together by feed_ioctl and feed_uring */
+static watchdog_t bench_feed_wds[WD_URING_MAX_DEVS];
+static size_t bench_feed_idx[WD_URING_MAX_DEVS];
+static size_t bench_nfeed;
+static struct wd_uring bench_ring = {.fd = -1};
+
+static int bench_keepalive(watchdog_t wd);
+static int bench_get_timeout(watchdog_t wd);
+static int bench_set_timeout(watchdog_t wd);
+static int bench_get_pretimeout(watchdog_t wd);
+static int bench_get_timeleft(watchdog_t wd);
+static int bench_get_bootstatus(watchdog_t wd);
+static int bench_get_status(watchdog_t wd);
+static int bench_get_temp(watchdog_t wd);
+static int bench_get_info(watchdog_t wd);
+static int bench_get_snapshot(watchdog_t wd);
+static int bench_feed_ioctl(watchdog_t wd);
+static int bench_feed_uring(watchdog_t wd);
+
+static const struct bench_op bench_ops[] =
+{
+    {"keepalive",       bench_keepalive},
+    {"get_timeout",     bench_get_timeout},
+    {"set_timeout",     bench_set_timeout},
+    {"get_pretimeout",  bench_get_pretimeout},
+    {"get_timeleft",    bench_get_timeleft},
+    {"get_bootstatus",  bench_get_bootstatus},
+    {"get_status",      bench_get_status},
+    {"get_temp",        bench_get_temp},
+    {"get_info",        bench_get_info},
+    {"get_snapshot",    bench_get_snapshot},
+    {"feed_ioctl",      bench_feed_ioctl},
+    {"feed_uring",      bench_feed_uring}
+};
+
+#define BENCH_OPS   (sizeof(bench_ops) / sizeof(bench_ops[0]))
+
+static int bench_cmp(const void *a, const void *b);
+static int bench_run(watchdog_t wd, const struct bench_op *op, uint64_t *samples, size_t iters, size_t warmup, struct bench_result *res);
+static void bench_print(const char *dev_json, const struct bench_op *op, size_t iters, const struct bench_result *res, bool json);
+static const char *bench_json_str(const char *str, char *buf, size_t size);
+static void usage(void);
+
+static int bench_keepalive(watchdog_t wd)
+{
+    return wd_keepalive(wd);
+}
+
+static int bench_get_timeout(watchdog_t wd)
+{
+    unsigned int val;
+
+    return wd_get_timeout(wd, &val);
+}
+
+static int bench_set_timeout(watchdog_t wd)
+{
+    return wd_set_timeout(wd, bench_timeout);
+}
+
+static int bench_get_pretimeout(watchdog_t wd)
+{
+    unsigned int val;
+
+    return wd_get_pretimeout(wd, &val);
+}
+
+static int bench_get_timeleft(watchdog_t wd)
+{
+    unsigned int val;
+
+    return wd_get_timeleft(wd, &val);
+}
+
+static int bench_get_bootstatus(watchdog_t wd)
+{
+    int val;
+
+    return wd_get_bootstatus(wd, &val);
+}
+
+static int bench_get_status(watchdog_t wd)
+{
+    int val;
+
+    return wd_get_status(wd, &val);
+}
+
+static int bench_get_temp(watchdog_t wd)
+{
+    int val;
+
+    return wd_get_temp(wd, &val);
+}
+
+static int bench_get_info(watchdog_t wd)
+{
+    struct watchdog_info info;
+
+    return wd_get_info(wd, &info);
+}
+
+static int bench_get_snapshot(watchdog_t wd)
+{
+    struct wd_snapshot snap;
+
+    return wd_get_snapshot(wd, &snap, WD_SNAP_ALL);
+}
+
+static int bench_feed_ioctl(watchdog_t wd)
+{
+    size_t i;
+    int ret = 0;
+
+    (void)wd;
+
+    for (i = 0; i < bench_nfeed; ++i)
+        ret |= wd_keepalive(bench_feed_wds[i]);
+
+    return ret;
+}
+
+static int bench_feed_uring(watchdog_t wd)
+{
+    int res[WD_URING_MAX_DEVS];
+
+    (void)wd;
+
+    return wd_uring_feed(&bench_ring, bench_feed_idx, bench_nfeed, res);
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+    const uint64_t x = *(const uint64_t *)a;
+    const uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int bench_run(watchdog_t wd, const struct bench_op *op, uint64_t *samples, size_t iters, size_t warmup, struct bench_result *res)
+{
+    uint64_t start;
+    uint64_t sum = 0;
+    size_t i;
+    size_t bucket;
+
+    /* unsupported op is detected on first call */
+    for (i = 0; i < warmup + 1; ++i)
+        if (op->fn(wd))
+            return 1;
+
+    for (i = 0; i < iters; ++i)
+    {
+        start = wd_time_now_ns();
+        (void)op->fn(wd);
+        samples[i] = wd_time_now_ns() - start;
+    }
+
+    (void)memset(res, 0, sizeof(*res));
+    for (i = 0; i < iters; ++i)
+    {
+        sum += samples[i];
+        for (bucket = 0; bucket < BENCH_HIST_BUCKETS - 1 && (samples[i] >> (bucket + 1)); ++bucket)
+            ;
+        ++res->hist[bucket];
+    }
+
+    qsort(samples, iters, sizeof(*samples), bench_cmp);
+    res->min = samples[0];
+    res->p50 = samples[iters / 2];
+    res->p99 = samples[iters * 99 / 100];
+    res->p999 = samples[iters * 999 / 1000];
+    res->max = samples[iters - 1];
+    res->mean = sum / iters;
+
+    return 0;
+}
+
+static void bench_print(const char *dev_json, const struct bench_op *op, size_t iters, const struct bench_result *res, bool json)
+{
+    size_t i;
+    size_t last = 0;
+
+    if (!json)
+    {
+        (void)printf("%-16s min %8" PRIu64 " p50 %8" PRIu64 " p99 %8" PRIu64
+                     " p99.9 %8" PRIu64 " max %10" PRIu64 " mean %8" PRIu64 " [ns]\n",
+                     op->name, res->min, res->p50, res->p99, res->p999, res->max, res->mean);
+        return;
+    }
+
+    for (i = 0; i < BENCH_HIST_BUCKETS; ++i)
+        if (res->hist[i])
+            last = i;
+
+    (void)printf("{\"dev\":%s,\"op\":\"%s\",\"iters\":%zu,\"min_ns\":%" PRIu64 ",\"p50_ns\":%" PRIu64
+                 ",\"p99_ns\":%" PRIu64 ",\"p999_ns\":%" PRIu64 ",\"max_ns\":%" PRIu64 ",\"mean_ns\":%" PRIu64
+                 ",\"hist_log2_ns\":[",
+                 dev_json, op->name, iters, res->min, res->p50, res->p99, res->p999, res->max, res->mean);
+    for (i = 0; i <= last; ++i)
+        (void)printf("%s%" PRIu64, i ? "," : "", res->hist[i]);
+    (void)printf("]}\n");
+}
+
+/* device is user input, JSON gets it quoted and escaped like wd_format does, too long one is null */
+static const char *bench_json_str(const char *str, char *buf, size_t size)
+{
+    struct wd_fbuf fb;
+
+    wd_fbuf_init(&fb, buf, size - 1);
+    wd_fbuf_quoted(&fb, str, strlen(str));
+    if (fb.overflow)
+        return "null";
+
+    buf[fb.len] = '\0';
+
+    return buf;
+}
+
+static void usage(void)
+{
+    (void)printf("HELP\n\n");
+    (void)printf("--dev [x]\t\t- device to benchmark, default is sim:\n");
+    (void)printf("--iters [x]\t\t- measured calls per op, default is %d\n", BENCH_DEFAULT_ITERS);
+    (void)printf("--warmup [x]\t\t- not measured calls per op, default is %d\n", BENCH_DEFAULT_WARMUP);
+    (void)printf("--cpu [x]\t\t- pin benchmark to cpu\n");
+    (void)printf("--op [x]\t\t- benchmark only given op (can be repeated)\n");
+    (void)printf("--json\t\t\t- print one JSON object per op\n");
+    (void)printf("--trace [x]\t\t- binary trace every call into file x (measures trace overhead)\n");
+    (void)printf("--feed-dev [x]\t\t- device fed by feed_ioctl / feed_uring (can be repeated), default is --dev\n");
+    (void)printf("--help\t\t\t- print this usage\n");
+    (void)printf("\n");
+    (void)printf("Examples\n");
+    (void)printf("./wd_bench.out --dev /dev/watchdog1 --cpu 2 --json\n");
+    (void)printf("./wd_bench.out --op keepalive --op get_timeleft --iters 1000000\n");
+    (void)printf("./wd_bench.out --op feed_ioctl --op feed_uring --feed-dev /dev/watchdog1 --feed-dev /dev/watchdog2\n");
+    (void)printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    static char dev_json[BENCH_JSON_STR_SIZE];
+    const char *dev = "sim:";
+    const char *feed_devs[WD_URING_MAX_DEVS];
+    size_t iters = BENCH_DEFAULT_ITERS;
+    size_t warmup = BENCH_DEFAULT_WARMUP;
+    int cpu = -1;
+    bool json = false;
+    bool selected[BENCH_OPS];
+    bool any_selected = false;
+    struct bench_result res;
+    struct utsname uts;
+    cpu_set_t set;
+    uint64_t *samples;
+    watchdog_t wd;
+    size_t i;
+    int opt;
+    int ret = 0;
+
+    struct option long_option[] =
+    {
+        {"dev",     required_argument,  0,  'd'},
+        {"iters",   required_argument,  0,  'n'},
+        {"warmup",  required_argument,  0,  'w'},
+        {"cpu",     required_argument,  0,  'c'},
+        {"op",      required_argument,  0,  'o'},
+        {"json",    no_argument,        0,  'j'},
+        {"trace",   required_argument,  0,  't'},
+        {"feed-dev", required_argument, 0,  'f'},
+        {"help",    no_argument,        0,  'h'},
+        {NULL,      0,                  0,  0}
+    };
+
+    (void)memset(selected, 0, sizeof(selected));
+    while ((opt = getopt_long_only(argc, argv, "", long_option, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'd':
+            {
+                dev = optarg;
+                break;
+            }
+            case 'n':
+            {
+                iters = (size_t)strtoul(optarg, NULL, 0);
+                break;
+            }
+            case 'w':
+            {
+                warmup = (size_t)strtoul(optarg, NULL, 0);
+                break;
+            }
+            case 'c':
+            {
+                cpu = atoi(optarg);
+                break;
+            }
+            case 'o':
+            {
+                for (i = 0; i < BENCH_OPS; ++i)
+                    if (strcmp(optarg, bench_ops[i].name) == 0)
+                        break;
+
+                if (i == BENCH_OPS)
+                {
+                    (void)fprintf(stderr, "Op [%s] - Incorrect argument\n", optarg);
+                    return 1;
+                }
+
+                selected[i] = true;
+                any_selected = true;
+                break;
+            }
+            case 'j':
+            {
+                json = true;
+                break;
+            }
+            case 't':
+            {
+                if (wd_trace_open(optarg, 0))
+                {
+                    (void)fprintf(stderr, "Cannot trace into %s\n", optarg);
+                    return 1;
+                }
+
+                break;
+            }
+            case 'f':
+            {
+                if (bench_nfeed == WD_URING_MAX_DEVS)
+                {
+                    (void)fprintf(stderr, "Feed dev [%s] - Too many devices, max is %d\n", optarg, WD_URING_MAX_DEVS);
+                    return 1;
+                }
+
+                /* opened only now, after --trace */
+                feed_devs[bench_nfeed++] = optarg;
+                break;
+            }
+            case 'h':
+            default:
+            {
+                usage();
+                return opt == 'h' ? 0 : 1;
+            }
+        }
+    }
+
+    if (iters == 0)
+    {
+        (void)fprintf(stderr, "Iters - Incorrect argument\n");
+        return 1;
+    }
+
+    if (cpu >= 0)
+    {
+        CPU_ZERO(&set);
+        CPU_SET((size_t)cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) == -1)
+        {
+            perror("sched_setaffinity");
+            return 1;
+        }
+    }
+
+    samples = malloc(iters * sizeof(*samples));
+    if (samples == NULL)
+        return 1;
+
+    wd = wd_open(dev);
+    if (wd == -1 || wd_get_timeout(wd, &bench_timeout))
+    {
+        (void)fprintf(stderr, "Cannot open %s\n", dev);
+        free(samples);
+        return 1;
+    }
+
+    /* without feed devices batch ops feed benchmarked device */
+    if (bench_nfeed == 0)
+    {
+        bench_feed_wds[0] = wd;
+        bench_nfeed = 1;
+    }
+    else
+    {
+        for (i = 0; i < bench_nfeed; ++i)
+        {
+            bench_feed_wds[i] = wd_open(feed_devs[i]);
+            if (bench_feed_wds[i] == -1)
+            {
+                (void)fprintf(stderr, "Cannot open %s\n", feed_devs[i]);
+                bench_nfeed = i;
+                ret = 1;
+                goto out;
+            }
+        }
+    }
+
+    for (i = 0; i < bench_nfeed; ++i)
+        bench_feed_idx[i] = i;
+
+    if (wd_uring_init(&bench_ring, bench_feed_wds, bench_nfeed))
+    {
+        ret = 1;
+        goto out;
+    }
+
+    (void)bench_json_str(dev, dev_json, sizeof(dev_json));
+    if (uname(&uts) == 0)
+    {
+        if (json)
+            (void)printf("{\"dev\":%s,\"kernel\":\"%s\",\"machine\":\"%s\",\"compiler\":\"%s\",\"cpu\":%d,\"iters\":%zu,\"warmup\":%zu}\n",
+                         dev_json, uts.release, uts.machine, __VERSION__, cpu, iters, warmup);
+        else
+            (void)printf("dev %s kernel %s %s, cpu %d, %zu iters, %zu warmup\n",
+                         dev, uts.release, uts.machine, cpu, iters, warmup);
+    }
+
+    for (i = 0; i < BENCH_OPS; ++i)
+    {
+        if (any_selected && !selected[i])
+            continue;
+
+        if (bench_run(wd, &bench_ops[i], samples, iters, warmup, &res))
+        {
+            if (json)
+                (void)printf("{\"dev\":%s,\"op\":\"%s\",\"unsupported\":true}\n", dev_json, bench_ops[i].name);
+            else
+                (void)printf("%-16s unsupported\n", bench_ops[i].name);
+
+            continue;
+        }
+
+        bench_print(dev_json, &bench_ops[i], iters, &res, json);
+    }
+
+    /* what feed_uring really used, only when it ran */
+    if (bench_ring.batches || bench_ring.ioctls)
+    {
+        if (json)
+            (void)printf("{\"feed_devs\":%zu,\"feed_engine\":\"%s\",\"feed_batches\":%" PRIu64 ",\"feed_writes\":%" PRIu64
+                         ",\"feed_ioctls\":%" PRIu64 "}\n", bench_nfeed, bench_ring.fd != -1 ? "io_uring" : "ioctl",
+                         bench_ring.batches, bench_ring.writes, bench_ring.ioctls);
+        else
+            (void)printf("feed %zu devices by %s, batches %" PRIu64 " writes %" PRIu64 " ioctls %" PRIu64 "\n",
+                         bench_nfeed, bench_ring.fd != -1 ? "io_uring" : "ioctl",
+                         bench_ring.batches, bench_ring.writes, bench_ring.ioctls);
+    }
+
+out:
+    wd_uring_deinit(&bench_ring);
+    for (i = 0; i < bench_nfeed; ++i)
+        if (bench_feed_wds[i] != wd)
+            ret |= wd_close(bench_feed_wds[i]);
+
+    ret |= wd_close(wd);
+    free(samples);
+
+    return ret;
+}
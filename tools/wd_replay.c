@@ -0,0 +1,575 @@
+/*
+    Replay of wd_* calls recorded by --record (or --trace) with original timing.
+    Every recorded call is made again at the same offset from start against
+    simulated or real WatchDog, then latency of every op and slack between
+    keepalives are compared with recording.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <errno.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <watchdog.h>
+#include <wd_trace.h>
+#include <wd_stats.h>
+#include <wd_time.h>
+
+#define REPLAY_MAX_DEVS     32
+#define REPLAY_MAX_HANDLES  (INT16_MAX + 1)
+#define REPLAY_LEAD_NS      (10 * WD_NSEC_PER_MSEC)    /* first call is made that long after start */
+
+struct replay_op
+{
+    uint64_t        calls;
+    uint64_t        mismatches;     /* failed in one run only */
+    struct wd_hist  rec;            /* recorded latency */
+    struct wd_hist  rep;            /* replay latency */
+};
+
+/* one side (recording or replay) of keepalive timing */
+struct replay_feed
+{
+    uint64_t        last_ns;        /* previous keepalive, 0 means none */
+    uint64_t        timeout_ns;     /* last known timeout, 0 means unknown */
+    int64_t         min_slack_ns;
+    uint64_t        overdue;        /* keepalives later than timeout */
+    unsigned int    min_timeleft;
+};
+
+struct replay_dev
+{
+    const char          *dev;
+    int                 handle;     /* recorded handle */
+    watchdog_t          wd;         /* replay handle or -1 */
+    uint64_t            feeds;
+    struct replay_feed  rec;
+    struct replay_feed  rep;
+    struct wd_hist      drift;      /* |replay gap - recorded gap| */
+};
+
+struct replay
+{
+    const char          *conf_devs[REPLAY_MAX_DEVS]; /* --dev in order of first recorded handle */
+    size_t              nconf_devs;
+    struct replay_dev   devs[REPLAY_MAX_DEVS];
+    size_t              ndevs;
+    int8_t              map[REPLAY_MAX_HANDLES];    /* recorded handle -> devs index + 1 */
+    struct replay_op    ops[WD_TRACE_FN_MAX];
+    struct wd_hist      late;                       /* replay call start - target */
+    uint64_t            calls;
+    uint64_t            skipped;
+    uint64_t            rec_span_ns;
+    uint64_t            rep_span_ns;
+};
+
+static struct replay replay;
+
+static size_t replay_load(const struct wd_trace_hdr *hdr, size_t size, struct wd_trace_rec **out);
+static struct replay_dev *replay_dev_get(int handle);
+static int replay_call(struct replay_dev *rdev, const struct wd_trace_rec *rec, uint32_t *val);
+static void replay_feed(struct replay_feed *feed, uint64_t now, uint64_t *gap);
+static void replay_run(const struct wd_trace_rec *recs, size_t n, double speed);
+static void replay_print(bool json);
+static void usage(void);
+
+static size_t replay_load(const struct wd_trace_hdr *hdr, size_t size, struct wd_trace_rec **out)
+{
+    const struct wd_trace_rec *recs = (const struct wd_trace_rec *)(hdr + 1);
+    const struct wd_trace_rec *rec;
+    struct wd_trace_rec *copy;
+    uint64_t seq;
+    uint64_t first;
+    uint64_t i;
+    size_t n = 0;
+
+    if (hdr->magic != WD_TRACE_MAGIC || hdr->version != WD_TRACE_VERSION ||
+        hdr->rec_size != sizeof(struct wd_trace_rec) || hdr->nrecs == 0 ||
+        (hdr->nrecs & (hdr->nrecs - 1)) != 0 ||
+        size < sizeof(*hdr) + (size_t)hdr->nrecs * sizeof(struct wd_trace_rec))
+    {
+        (void)fprintf(stderr, "Not a trace file\n");
+        return 0;
+    }
+
+    seq = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE);
+    first = seq > hdr->nrecs ? seq - hdr->nrecs : 0;
+
+    /* ring wrapped: replay starts in the middle, devices are opened on first use */
+    if (first)
+        (void)fprintf(stderr, "Recording wrapped, first %" PRIu64 " calls are lost\n", first);
+
+    copy = malloc((size_t)(seq - first) * sizeof(*copy) + 1);
+    if (copy == NULL)
+        return 0;
+
+    for (i = first; i < seq; ++i)
+    {
+        rec = &recs[i & (hdr->nrecs - 1)];
+        if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != i + 1)
+        {
+            ++replay.skipped;
+            continue;
+        }
+
+        copy[n] = *rec;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        /* recorder still running and overwrote it */
+        if (__atomic_load_n(&rec->seq, __ATOMIC_RELAXED) != i + 1 || copy[n].fn >= WD_TRACE_FN_MAX)
+        {
+            ++replay.skipped;
+            continue;
+        }
+
+        ++n;
+    }
+
+    if (n == 0)
+    {
+        (void)fprintf(stderr, "Nothing to replay\n");
+        free(copy);
+        return 0;
+    }
+
+    *out = copy;
+
+    return n;
+}
+
+static struct replay_dev *replay_dev_get(int handle)
+{
+    struct replay_dev *rdev;
+    const size_t slot = (size_t)handle & (REPLAY_MAX_HANDLES - 1);
+
+    if (replay.map[slot])
+        return &replay.devs[replay.map[slot] - 1];
+
+    if (replay.ndevs == REPLAY_MAX_DEVS)
+        return NULL;
+
+    rdev = &replay.devs[replay.ndevs];
+    (void)memset(rdev, 0, sizeof(*rdev));
+    rdev->handle = handle;
+    rdev->wd = -1;
+    rdev->dev = replay.ndevs < replay.nconf_devs ? replay.conf_devs[replay.ndevs] : "sim:";
+    rdev->rec.min_slack_ns = INT64_MAX;
+    rdev->rep.min_slack_ns = INT64_MAX;
+    rdev->rec.min_timeleft = UINT_MAX;
+    rdev->rep.min_timeleft = UINT_MAX;
+
+    replay.map[slot] = (int8_t)(++replay.ndevs);
+
+    return rdev;
+}
+
+/* makes the same call with the same argument, returns 0 iff success */
+static int replay_call(struct replay_dev *rdev, const struct wd_trace_rec *rec, uint32_t *val)
+{
+    struct watchdog_info info;
+    struct wd_snapshot snap;
+    unsigned int uval = 0;
+    int ival = 0;
+    int ret;
+
+    *val = 0;
+
+    if (rec->fn == WD_TRACE_FN_OPEN)
+    {
+        if (rdev->wd != -1)
+            return 0;
+
+        rdev->wd = wd_open(rdev->dev);
+
+        return rdev->wd == -1;
+    }
+
+    /* recording started after open */
+    if (rdev->wd == -1)
+    {
+        rdev->wd = wd_open(rdev->dev);
+        if (rdev->wd == -1)
+            return 1;
+    }
+
+    switch (rec->fn)
+    {
+        case WD_TRACE_FN_CLOSE:
+        case WD_TRACE_FN_RELEASE:
+        {
+            ret = rec->fn == WD_TRACE_FN_CLOSE ? wd_close(rdev->wd) : wd_release(rdev->wd);
+            rdev->wd = -1;
+            return ret;
+        }
+        case WD_OP_KEEPALIVE:
+        {
+            return wd_keepalive(rdev->wd);
+        }
+        case WD_OP_GET_TIMEOUT:
+        {
+            ret = wd_get_timeout(rdev->wd, &uval);
+            *val = uval;
+            return ret;
+        }
+        case WD_OP_SET_TIMEOUT:
+        {
+            *val = rec->arg;
+            return wd_set_timeout(rdev->wd, rec->arg);
+        }
+        case WD_OP_GET_PRETIMEOUT:
+        {
+            ret = wd_get_pretimeout(rdev->wd, &uval);
+            *val = uval;
+            return ret;
+        }
+        case WD_OP_SET_PRETIMEOUT:
+        {
+            return wd_set_pretimeout(rdev->wd, rec->arg);
+        }
+        case WD_OP_GET_TIMELEFT:
+        {
+            ret = wd_get_timeleft(rdev->wd, &uval);
+            *val = uval;
+            return ret;
+        }
+        case WD_OP_GET_BOOTSTATUS:
+        {
+            return wd_get_bootstatus(rdev->wd, &ival);
+        }
+        case WD_OP_GET_STATUS:
+        {
+            return wd_get_status(rdev->wd, &ival);
+        }
+        case WD_OP_GET_TEMP:
+        {
+            return wd_get_temp(rdev->wd, &ival);
+        }
+        case WD_OP_SET_OPTIONS:
+        {
+            return wd_set_options(rdev->wd, (int)rec->arg);
+        }
+        case WD_OP_GET_INFO:
+        {
+            return wd_get_info(rdev->wd, &info);
+        }
+        case WD_TRACE_FN_SNAPSHOT:
+        {
+            ret = wd_get_snapshot(rdev->wd, &snap, rec->arg ? rec->arg : WD_SNAP_ALL);
+            *val = snap.timeleft;
+            return ret;
+        }
+        default:
+            return 1;
+    }
+}
+
+static void replay_feed(struct replay_feed *feed, uint64_t now, uint64_t *gap)
+{
+    int64_t slack;
+
+    *gap = feed->last_ns ? now - feed->last_ns : 0;
+    if (feed->last_ns && feed->timeout_ns)
+    {
+        slack = (int64_t)feed->timeout_ns - (int64_t)*gap;
+        if (slack < feed->min_slack_ns)
+            feed->min_slack_ns = slack;
+
+        if (slack < 0)
+            ++feed->overdue;
+    }
+
+    feed->last_ns = now;
+}
+
+static void replay_run(const struct wd_trace_rec *recs, size_t n, double speed)
+{
+    const struct wd_trace_rec *rec;
+    struct replay_dev *rdev;
+    struct replay_op *op;
+    struct timespec ts;
+    const uint64_t rec_start = recs[0].ts_ns - recs[0].lat_ns;
+    const uint64_t rep_start = wd_time_now_ns() + REPLAY_LEAD_NS;
+    uint64_t target;
+    uint64_t start;
+    uint64_t end;
+    uint64_t rec_gap;
+    uint64_t rep_gap;
+    uint32_t val;
+    size_t i;
+    bool ok;
+
+    for (i = 0; i < n; ++i)
+    {
+        rec = &recs[i];
+        rdev = replay_dev_get(rec->wd);
+        if (rdev == NULL)
+        {
+            ++replay.skipped;
+            continue;
+        }
+
+        /* call starts where recorded one started, recorded ts is at return */
+        target = rep_start + (uint64_t)((double)(rec->ts_ns - rec->lat_ns - rec_start) / speed);
+        wd_time_to_timespec(target, &ts);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+
+        start = wd_time_now_ns();
+        ok = replay_call(rdev, rec, &val) == 0;
+        end = wd_time_now_ns();
+
+        wd_hist_add(&replay.late, start > target ? start - target : 0);
+
+        op = &replay.ops[rec->fn];
+        ++op->calls;
+        if (ok != (rec->ret == 0))
+            ++op->mismatches;
+
+        if (rec->lat_ns)
+            wd_hist_add(&op->rec, rec->lat_ns);
+
+        wd_hist_add(&op->rep, end - start);
+        ++replay.calls;
+
+        /* timeout known from recording and from this run, both sides compute own slack */
+        if (rec->ret == 0 && (rec->fn == WD_OP_GET_TIMEOUT || rec->fn == WD_OP_SET_TIMEOUT))
+            rdev->rec.timeout_ns = (uint64_t)rec->arg * WD_NSEC_PER_SEC;
+
+        if (ok && (rec->fn == WD_OP_GET_TIMEOUT || rec->fn == WD_OP_SET_TIMEOUT))
+            rdev->rep.timeout_ns = (uint64_t)val * WD_NSEC_PER_SEC;
+
+        if (rec->ret == 0 && rec->fn == WD_OP_GET_TIMELEFT && rec->arg < rdev->rec.min_timeleft)
+            rdev->rec.min_timeleft = rec->arg;
+
+        if (ok && rec->fn == WD_OP_GET_TIMELEFT && val < rdev->rep.min_timeleft)
+            rdev->rep.min_timeleft = val;
+
+        if (rec->fn == WD_OP_KEEPALIVE && rec->ret == 0 && ok)
+        {
+            ++rdev->feeds;
+            replay_feed(&rdev->rec, rec->ts_ns, &rec_gap);
+            replay_feed(&rdev->rep, end, &rep_gap);
+            if (rec_gap && rep_gap)
+            {
+                rec_gap = (uint64_t)((double)rec_gap / speed);
+                wd_hist_add(&rdev->drift, rep_gap > rec_gap ? rep_gap - rec_gap : rec_gap - rep_gap);
+            }
+        }
+    }
+
+    replay.rec_span_ns = recs[n - 1].ts_ns - rec_start;
+    replay.rep_span_ns = wd_time_now_ns() - rep_start;
+
+    for (i = 0; i < replay.ndevs; ++i)
+        if (replay.devs[i].wd != -1)
+        {
+            (void)wd_close(replay.devs[i].wd);
+            replay.devs[i].wd = -1;
+        }
+}
+
+static void replay_print(bool json)
+{
+    const struct replay_op *op;
+    const struct replay_dev *rdev;
+    size_t i;
+
+    if (json)
+        (void)printf("{\"calls\":%" PRIu64 ",\"skipped\":%" PRIu64 ",\"rec_span_ns\":%" PRIu64 ",\"rep_span_ns\":%" PRIu64
+                     ",\"late_p50_ns\":%" PRIu64 ",\"late_p99_ns\":%" PRIu64 ",\"late_max_ns\":%" PRIu64 "}\n",
+                     replay.calls, replay.skipped, replay.rec_span_ns, replay.rep_span_ns,
+                     wd_hist_percentile(&replay.late, 50.0), wd_hist_percentile(&replay.late, 99.0), replay.late.max);
+    else
+        (void)printf("%" PRIu64 " calls replayed (%" PRIu64 " skipped) in %.3f s, recorded %.3f s,"
+                     " late p50 %" PRIu64 " us p99 %" PRIu64 " us max %" PRIu64 " us\n",
+                     replay.calls, replay.skipped, (double)replay.rep_span_ns / 1e9, (double)replay.rec_span_ns / 1e9,
+                     wd_hist_percentile(&replay.late, 50.0) / WD_NSEC_PER_USEC,
+                     wd_hist_percentile(&replay.late, 99.0) / WD_NSEC_PER_USEC,
+                     replay.late.max / WD_NSEC_PER_USEC);
+
+    if (!json)
+        (void)printf("%-16s %8s %10s %10s %10s %10s %10s %10s %6s [ns]\n", "op", "calls",
+                     "rec p50", "rep p50", "rec p99", "rep p99", "rec max", "rep max", "mism");
+
+    for (i = 0; i < WD_TRACE_FN_MAX; ++i)
+    {
+        op = &replay.ops[i];
+        if (op->calls == 0)
+            continue;
+
+        if (json)
+            (void)printf("{\"op\":\"%s\",\"calls\":%" PRIu64 ",\"mismatches\":%" PRIu64
+                         ",\"rec_p50_ns\":%" PRIu64 ",\"rep_p50_ns\":%" PRIu64 ",\"rec_p99_ns\":%" PRIu64
+                         ",\"rep_p99_ns\":%" PRIu64 ",\"rec_max_ns\":%" PRIu64 ",\"rep_max_ns\":%" PRIu64 "}\n",
+                         wd_trace_fn_name((unsigned int)i), op->calls, op->mismatches,
+                         wd_hist_percentile(&op->rec, 50.0), wd_hist_percentile(&op->rep, 50.0),
+                         wd_hist_percentile(&op->rec, 99.0), wd_hist_percentile(&op->rep, 99.0),
+                         op->rec.max, op->rep.max);
+        else
+            (void)printf("%-16s %8" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+                         " %10" PRIu64 " %10" PRIu64 " %6" PRIu64 "\n",
+                         wd_trace_fn_name((unsigned int)i), op->calls,
+                         wd_hist_percentile(&op->rec, 50.0), wd_hist_percentile(&op->rep, 50.0),
+                         wd_hist_percentile(&op->rec, 99.0), wd_hist_percentile(&op->rep, 99.0),
+                         op->rec.max, op->rep.max, op->mismatches);
+    }
+
+    for (i = 0; i < replay.ndevs; ++i)
+    {
+        rdev = &replay.devs[i];
+        if (rdev->feeds == 0)
+            continue;
+
+        if (json)
+            (void)printf("{\"wd\":%d,\"dev\":\"%s\",\"feeds\":%" PRIu64
+                         ",\"rec_min_slack_ns\":%" PRId64 ",\"rep_min_slack_ns\":%" PRId64
+                         ",\"rec_overdue\":%" PRIu64 ",\"rep_overdue\":%" PRIu64
+                         ",\"rec_min_timeleft\":%d,\"rep_min_timeleft\":%d"
+                         ",\"drift_p50_ns\":%" PRIu64 ",\"drift_p99_ns\":%" PRIu64 ",\"drift_max_ns\":%" PRIu64 "}\n",
+                         rdev->handle, rdev->dev, rdev->feeds,
+                         rdev->rec.min_slack_ns == INT64_MAX ? -1 : rdev->rec.min_slack_ns,
+                         rdev->rep.min_slack_ns == INT64_MAX ? -1 : rdev->rep.min_slack_ns,
+                         rdev->rec.overdue, rdev->rep.overdue,
+                         rdev->rec.min_timeleft == UINT_MAX ? -1 : (int)rdev->rec.min_timeleft,
+                         rdev->rep.min_timeleft == UINT_MAX ? -1 : (int)rdev->rep.min_timeleft,
+                         wd_hist_percentile(&rdev->drift, 50.0), wd_hist_percentile(&rdev->drift, 99.0),
+                         rdev->drift.max);
+        else
+            (void)printf("wd %d -> %s: feeds %" PRIu64 " min slack rec %" PRId64 " ms rep %" PRId64 " ms,"
+                         " overdue rec %" PRIu64 " rep %" PRIu64 ", gap drift p50 %" PRIu64 " us p99 %" PRIu64
+                         " us max %" PRIu64 " us\n",
+                         rdev->handle, rdev->dev, rdev->feeds,
+                         rdev->rec.min_slack_ns == INT64_MAX ? -1 : rdev->rec.min_slack_ns / (int64_t)WD_NSEC_PER_MSEC,
+                         rdev->rep.min_slack_ns == INT64_MAX ? -1 : rdev->rep.min_slack_ns / (int64_t)WD_NSEC_PER_MSEC,
+                         rdev->rec.overdue, rdev->rep.overdue,
+                         wd_hist_percentile(&rdev->drift, 50.0) / WD_NSEC_PER_USEC,
+                         wd_hist_percentile(&rdev->drift, 99.0) / WD_NSEC_PER_USEC,
+                         rdev->drift.max / WD_NSEC_PER_USEC);
+    }
+}
+
+static void usage(void)
+{
+    (void)printf("HELP\n\n");
+    (void)printf("wd_replay.out [options] FILE\n");
+    (void)printf("--dev [x]\t\t- device for next recorded handle (can be repeated), default is sim:\n");
+    (void)printf("--speed [x]\t\t- replay x times faster, default is 1 (slack is comparable only at 1)\n");
+    (void)printf("--json\t\t\t- print one JSON object per op and device\n");
+    (void)printf("--help\t\t\t- print this usage\n");
+    (void)printf("\n");
+    (void)printf("Examples\n");
+    (void)printf("./watchdog.out --record /var/tmp/wd.rec --dev /dev/watchdog1 --adaptive --daemon\n");
+    (void)printf("./wd_replay.out --dev sim:timeout=30 /var/tmp/wd.rec\n");
+    (void)printf("./wd_replay.out --dev /dev/watchdog1 --json /var/tmp/wd.rec\n");
+    (void)printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    const struct wd_trace_hdr *hdr;
+    struct wd_trace_rec *recs = NULL;
+    struct stat st;
+    double speed = 1.0;
+    bool json = false;
+    size_t n;
+    int opt;
+    int fd;
+
+    struct option long_option[] =
+    {
+        {"dev",     required_argument,  0,  'd'},
+        {"speed",   required_argument,  0,  's'},
+        {"json",    no_argument,        0,  'j'},
+        {"help",    no_argument,        0,  'h'},
+        {NULL,      0,                  0,  0}
+    };
+
+    while ((opt = getopt_long_only(argc, argv, "", long_option, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'd':
+            {
+                if (replay.nconf_devs == REPLAY_MAX_DEVS)
+                {
+                    (void)fprintf(stderr, "Dev [%s] - Too many devices, max is %d\n", optarg, REPLAY_MAX_DEVS);
+                    return 1;
+                }
+
+                replay.conf_devs[replay.nconf_devs++] = optarg;
+                break;
+            }
+            case 's':
+            {
+                speed = strtod(optarg, NULL);
+                if (!(speed > 0.0))
+                {
+                    (void)fprintf(stderr, "Speed [%s] - Incorrect argument\n", optarg);
+                    return 1;
+                }
+
+                break;
+            }
+            case 'j':
+            {
+                json = true;
+                break;
+            }
+            case 'h':
+            default:
+            {
+                usage();
+                return opt == 'h' ? 0 : 1;
+            }
+        }
+    }
+
+    if (optind >= argc)
+    {
+        usage();
+        return 1;
+    }
+
+    fd = open(argv[optind], O_RDONLY | O_CLOEXEC);
+    if (fd == -1 || fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(*hdr))
+    {
+        perror(argv[optind]);
+        if (fd != -1)
+            (void)close(fd);
+
+        return 1;
+    }
+
+    hdr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    (void)close(fd);
+    if (hdr == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    /* copy first, recorder may still be writing */
+    n = replay_load(hdr, (size_t)st.st_size, &recs);
+    (void)munmap((void *)hdr, (size_t)st.st_size);
+    if (n == 0)
+        return 1;
+
+    replay_run(recs, n, speed);
+    replay_print(json);
+    free(recs);
+
+    return 0;
+}
@@ -0,0 +1,815 @@
+/*
+    Stress harness for feeder.
+    Runs watchdog.out --daemon against simulated WatchDog (or softdog when
+    present) under CPU saturation, memory pressure with reclaim, fork storm
+    and fsync-heavy I/O, then reads its --stats file and reports feed jitter,
+    worst slack and near misses for every feeder configuration.
+    Last run stops feeder for longer than its feed period and checks that
+    exporter reports missed periods.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <errno.h>
+#include <getopt.h>
+#include <glob.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <wd_stats.h>
+#include <wd_sysfs.h>
+#include <wd_time.h>
+
+#define STRESS_DEFAULT_DURATION_S   10
+#define STRESS_DEFAULT_TIMEOUT_S    10
+#define STRESS_DEFAULT_MEM_PCT      80
+#define STRESS_WARMUP_NS            (500 * WD_NSEC_PER_MSEC)   /* load runs that long before feeder starts */
+#define STRESS_MAX_WORKERS          1024
+#define STRESS_MAX_RUNS             32
+#define STRESS_IO_BLOCK             4096
+#define STRESS_IO_FILE_SIZE         (64 * 1024 * 1024)
+#define STRESS_MEM_WORKERS          2
+#define STRESS_FORK_WORKERS         2
+#define STRESS_IO_WORKERS           2
+#define STRESS_SOFTDOG_IDENTITY     "Software Watchdog"
+#define STRESS_STALL_PCT            50      /* feeder is stopped for this % of timeout */
+#define STRESS_MISSED_METRIC        "watchdog_feed_missed_periods_total"
+
+#define STRESS_LOAD_CPU     (1U << 0)
+#define STRESS_LOAD_MEM     (1U << 1)
+#define STRESS_LOAD_FORK    (1U << 2)
+#define STRESS_LOAD_IO      (1U << 3)
+#define STRESS_LOAD_ALL     (STRESS_LOAD_CPU | STRESS_LOAD_MEM | STRESS_LOAD_FORK | STRESS_LOAD_IO)
+
+struct stress_load
+{
+    const char      *name;
+    unsigned int    mask;
+};
+
+struct stress_config
+{
+    const char      *name;
+    const char      *args[3];   /* extra feeder options, NULL terminated */
+};
+
+struct stress_result
+{
+    const struct stress_config  *config;
+    const struct stress_load    *load;
+    bool                        ok;         /* feeder ran until stopped and wrote stats */
+    uint64_t                    feeds;
+    uint64_t                    errors;
+    uint64_t                    near_misses;
+    int64_t                     min_slack_ns;
+    uint64_t                    jitter_p50_ns;
+    uint64_t                    jitter_p99_ns;
+    uint64_t                    jitter_max_ns;
+    uint64_t                    ioctl_p99_ns;
+};
+
+struct stress
+{
+    const char                  *feeder;
+    const char                  *dev;
+    bool                        chardev;    /* real device, timeout is set by --set-timeout */
+    const char                  *dir;
+    unsigned int                timeout;
+    unsigned int                duration;
+    unsigned int                mem_pct;
+    bool                        verbose;
+    const struct stress_config  *configs[STRESS_MAX_RUNS];
+    size_t                      nconfigs;
+    const struct stress_load    *loads[STRESS_MAX_RUNS];
+    size_t                      nloads;
+    pid_t                       workers[STRESS_MAX_WORKERS];
+    size_t                      nworkers;
+};
+
+static const struct stress_load stress_loads[] =
+{
+    {"idle",    0},
+    {"cpu",     STRESS_LOAD_CPU},
+    {"mem",     STRESS_LOAD_MEM},
+    {"fork",    STRESS_LOAD_FORK},
+    {"io",      STRESS_LOAD_IO},
+    {"all",     STRESS_LOAD_ALL}
+};
+
+static const struct stress_config stress_configs[] =
+{
+    {"plain",       {NULL}},
+    {"rt",          {"--rt-fifo", "50", NULL}},
+    {"mlock",       {"--mlock", NULL}},
+    {"adaptive",    {"--adaptive", NULL}}
+};
+
+/* feeds every 20% of timeout, so stall misses a period and still ends 30% before expiry */
+static const struct stress_config stress_stall_config = {"stall", {"--feed-ratio", "20", NULL}};
+
+static struct stress stress;
+
+static const char *stress_softdog(void);
+static size_t stress_mem_available(void);
+static void stress_sleep(uint64_t ns);
+static void stress_cpu(void);
+static void stress_mem(size_t bytes);
+static void stress_fork(void);
+static void stress_io(const char *dir);
+static int stress_worker(unsigned int load, size_t arg);
+static int stress_load_start(unsigned int mask);
+static void stress_load_stop(void);
+static pid_t stress_feeder_start(const struct stress_config *config, const char *stats_path, const char *metrics_path);
+static void stress_run(const struct stress_config *config, const struct stress_load *load, struct stress_result *res);
+static int stress_metric(const char *path, const char *name, uint64_t *val);
+static bool stress_stall(uint64_t *missed);
+static void stress_print(const struct stress_result *res, size_t n, bool json);
+static void usage(void);
+
+/* softdog chardev or NULL, identity is set by softdog driver */
+static const char *stress_softdog(void)
+{
+    static char dev[PATH_MAX];
+    char identity[64];
+    glob_t g;
+    FILE *f;
+    size_t len;
+    size_t i;
+    bool found = false;
+
+    if (glob(WD_SYSFS_CLASS "/watchdog*/identity", 0, NULL, &g) != 0)
+        return NULL;
+
+    for (i = 0; i < g.gl_pathc && !found; ++i)
+    {
+        f = fopen(g.gl_pathv[i], "r");
+        if (f == NULL)
+            continue;
+
+        if (fgets(identity, sizeof(identity), f) != NULL)
+        {
+            len = strcspn(identity, "\n");
+            identity[len] = '\0';
+            if (strcmp(identity, STRESS_SOFTDOG_IDENTITY) == 0)
+            {
+                /* .../watchdogN/identity -> /dev/watchdogN */
+                len = strlen(g.gl_pathv[i]) - strlen("/identity");
+                g.gl_pathv[i][len] = '\0';
+                (void)snprintf(dev, sizeof(dev), "/dev/%s", strrchr(g.gl_pathv[i], '/') + 1);
+                found = true;
+            }
+        }
+
+        (void)fclose(f);
+    }
+
+    globfree(&g);
+
+    return found ? dev : NULL;
+}
+
+static size_t stress_mem_available(void)
+{
+    char line[128];
+    unsigned long kb = 0;
+    FILE *f;
+
+    f = fopen("/proc/meminfo", "r");
+    if (f == NULL)
+        return 0;
+
+    while (fgets(line, sizeof(line), f) != NULL)
+        if (sscanf(line, "MemAvailable: %lu kB", &kb) == 1)
+            break;
+
+    (void)fclose(f);
+
+    return (size_t)kb * 1024;
+}
+
+static void stress_sleep(uint64_t ns)
+{
+    struct timespec ts;
+
+    wd_time_to_timespec(wd_time_now_ns() + ns, &ts);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+static void stress_cpu(void)
+{
+    volatile uint64_t spin = 0;
+
+    for (;;)
+        ++spin;
+}
+
+/* keeps touching whole area, kernel has to reclaim page cache or swap to keep up */
+static void stress_mem(size_t bytes)
+{
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    volatile char *mem;
+    size_t i;
+    char val = 0;
+
+    mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        _exit(1);
+
+    for (;;)
+    {
+        ++val;
+        for (i = 0; i < bytes; i += page)
+            mem[i] = val;
+    }
+}
+
+static void stress_fork(void)
+{
+    pid_t pid;
+
+    for (;;)
+    {
+        pid = fork();
+        if (pid == 0)
+            _exit(0);
+
+        if (pid > 0)
+            (void)waitpid(pid, NULL, 0);
+    }
+}
+
+static void stress_io(const char *dir)
+{
+    char path[PATH_MAX];
+    char block[STRESS_IO_BLOCK];
+    off_t off = 0;
+    int fd;
+
+    (void)snprintf(path, sizeof(path), "%s/wd_stress.io.%d", dir, (int)getpid());
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1)
+        _exit(1);
+
+    /* worker is killed, file goes away with last descriptor */
+    (void)unlink(path);
+    (void)memset(block, 0x5a, sizeof(block));
+
+    for (;;)
+    {
+        if (pwrite(fd, block, sizeof(block), off) != (ssize_t)sizeof(block))
+            _exit(1);
+
+        (void)fsync(fd);
+
+        off += (off_t)sizeof(block);
+        if (off >= STRESS_IO_FILE_SIZE)
+            off = 0;
+    }
+}
+
+static int stress_worker(unsigned int load, size_t arg)
+{
+    pid_t pid;
+
+    if (stress.nworkers == STRESS_MAX_WORKERS)
+        return 1;
+
+    pid = fork();
+    if (pid == -1)
+        return 1;
+
+    if (pid == 0)
+    {
+        /* harness killed by user must not leave load behind */
+        (void)prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() == 1)
+            _exit(0);
+
+        switch (load)
+        {
+            case STRESS_LOAD_CPU:
+            {
+                stress_cpu();
+                break;
+            }
+            case STRESS_LOAD_MEM:
+            {
+                stress_mem(arg);
+                break;
+            }
+            case STRESS_LOAD_FORK:
+            {
+                stress_fork();
+                break;
+            }
+            case STRESS_LOAD_IO:
+            {
+                stress_io(stress.dir);
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+
+        _exit(0);
+    }
+
+    stress.workers[stress.nworkers++] = pid;
+
+    return 0;
+}
+
+static int stress_load_start(unsigned int mask)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t mem;
+    long i;
+    int ret = 0;
+
+    if (cpus < 1)
+        cpus = 1;
+
+    if (mask & STRESS_LOAD_CPU)
+        for (i = 0; i < cpus; ++i)
+            ret |= stress_worker(STRESS_LOAD_CPU, 0);
+
+    if (mask & STRESS_LOAD_MEM)
+    {
+        mem = stress_mem_available() / 100 * stress.mem_pct / STRESS_MEM_WORKERS;
+        if (mem == 0)
+            ret = 1;
+
+        for (i = 0; i < STRESS_MEM_WORKERS && mem; ++i)
+            ret |= stress_worker(STRESS_LOAD_MEM, mem);
+    }
+
+    if (mask & STRESS_LOAD_FORK)
+        for (i = 0; i < STRESS_FORK_WORKERS; ++i)
+            ret |= stress_worker(STRESS_LOAD_FORK, 0);
+
+    if (mask & STRESS_LOAD_IO)
+        for (i = 0; i < STRESS_IO_WORKERS; ++i)
+            ret |= stress_worker(STRESS_LOAD_IO, 0);
+
+    return ret;
+}
+
+static void stress_load_stop(void)
+{
+    size_t i;
+
+    for (i = 0; i < stress.nworkers; ++i)
+        (void)kill(stress.workers[i], SIGKILL);
+
+    for (i = 0; i < stress.nworkers; ++i)
+        (void)waitpid(stress.workers[i], NULL, 0);
+
+    stress.nworkers = 0;
+}
+
+static pid_t stress_feeder_start(const struct stress_config *config, const char *stats_path, const char *metrics_path)
+{
+    const char *argv[16];
+    char timeout[16];
+    size_t argc = 0;
+    size_t i;
+    pid_t pid;
+    int fd;
+
+    (void)snprintf(timeout, sizeof(timeout), "%u", stress.timeout);
+
+    argv[argc++] = stress.feeder;
+    argv[argc++] = "--dev";
+    argv[argc++] = stress.dev;
+    if (stress.chardev)
+    {
+        argv[argc++] = "--set-timeout";
+        argv[argc++] = timeout;
+    }
+
+    argv[argc++] = "--stats";
+    argv[argc++] = stats_path;
+    for (i = 0; config->args[i] != NULL; ++i)
+        argv[argc++] = config->args[i];
+
+    if (metrics_path != NULL)
+    {
+        argv[argc++] = "--metrics-file";
+        argv[argc++] = metrics_path;
+        argv[argc++] = "--metrics-interval";
+        argv[argc++] = "100";
+    }
+
+    argv[argc++] = "--daemon";
+    argv[argc] = NULL;
+
+    pid = fork();
+    if (pid != 0)
+        return pid;
+
+    /* SIGTERM is clean stop with magic close, real device is not left armed */
+    (void)prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (!stress.verbose)
+    {
+        fd = open("/dev/null", O_WRONLY);
+        if (fd != -1)
+        {
+            (void)dup2(fd, STDOUT_FILENO);
+            (void)dup2(fd, STDERR_FILENO);
+            (void)close(fd);
+        }
+    }
+
+    (void)execv(stress.feeder, (char *const *)(uintptr_t)argv);
+    _exit(127);
+}
+
+static void stress_run(const struct stress_config *config, const struct stress_load *load, struct stress_result *res)
+{
+    const struct wd_stats_file *file;
+    const struct wd_stats *stats;
+    char path[PATH_MAX];
+    pid_t pid;
+    int status;
+    bool early;
+
+    (void)memset(res, 0, sizeof(*res));
+    res->config = config;
+    res->load = load;
+    res->min_slack_ns = INT64_MAX;
+
+    (void)snprintf(path, sizeof(path), "%s/wd_stress.stats.%d", stress.dir, (int)getpid());
+    (void)unlink(path);
+
+    if (stress_load_start(load->mask))
+        (void)fprintf(stderr, "Load [%s] - Not every worker started\n", load->name);
+
+    stress_sleep(STRESS_WARMUP_NS);
+
+    pid = stress_feeder_start(config, path, NULL);
+    if (pid == -1)
+    {
+        stress_load_stop();
+        return;
+    }
+
+    stress_sleep((uint64_t)stress.duration * WD_NSEC_PER_SEC);
+
+    /* feeder that is gone already failed to start (RT or mlock without privilege) */
+    early = waitpid(pid, &status, WNOHANG) == pid;
+    if (!early)
+    {
+        (void)kill(pid, SIGTERM);
+        (void)waitpid(pid, &status, 0);
+    }
+
+    stress_load_stop();
+
+    file = wd_stats_attach(path);
+    if (file == NULL)
+    {
+        (void)unlink(path);
+        return;
+    }
+
+    stats = &file->devs[0];
+    res->ok = !early && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    res->feeds = stats->feeds;
+    res->errors = stats->errors;
+    res->near_misses = stats->near_misses;
+    res->min_slack_ns = stats->min_slack_ns;
+    res->jitter_p50_ns = wd_hist_percentile(&stats->jitter, 50.0);
+    res->jitter_p99_ns = wd_hist_percentile(&stats->jitter, 99.0);
+    res->jitter_max_ns = stats->jitter.max;
+    res->ioctl_p99_ns = wd_hist_percentile(&stats->ioctl, 99.0);
+
+    wd_stats_destroy(file);
+    (void)unlink(path);
+}
+
+/* first sample of metric in Prometheus text file */
+static int stress_metric(const char *path, const char *name, uint64_t *val)
+{
+    const size_t len = strlen(name);
+    char line[512];
+    char *sep;
+    FILE *file;
+    int ret = 1;
+
+    file = fopen(path, "r");
+    if (file == NULL)
+        return 1;
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if (strncmp(line, name, len) != 0 || (line[len] != '{' && line[len] != ' '))
+            continue;
+
+        sep = strrchr(line, ' ');
+        if (sep != NULL)
+        {
+            *val = strtoull(sep + 1, NULL, 10);
+            ret = 0;
+        }
+
+        break;
+    }
+
+    (void)fclose(file);
+
+    return ret;
+}
+
+/* feeder stopped past its feed period must export lost periods, true iff it did */
+static bool stress_stall(uint64_t *missed)
+{
+    char stats_path[PATH_MAX];
+    char metrics_path[PATH_MAX];
+    pid_t pid;
+    int status;
+    bool ok;
+
+    *missed = 0;
+    (void)snprintf(stats_path, sizeof(stats_path), "%s/wd_stress.stats.%d", stress.dir, (int)getpid());
+    (void)snprintf(metrics_path, sizeof(metrics_path), "%s/wd_stress.prom.%d", stress.dir, (int)getpid());
+    (void)unlink(stats_path);
+    (void)unlink(metrics_path);
+
+    pid = stress_feeder_start(&stress_stall_config, stats_path, metrics_path);
+    if (pid == -1)
+        return false;
+
+    stress_sleep(STRESS_WARMUP_NS);
+    (void)kill(pid, SIGSTOP);
+    stress_sleep((uint64_t)stress.timeout * WD_NSEC_PER_SEC * STRESS_STALL_PCT / 100);
+    (void)kill(pid, SIGCONT);
+
+    /* late feed is counted, exporter writes file every 100 ms */
+    stress_sleep(STRESS_WARMUP_NS);
+
+    ok = waitpid(pid, &status, WNOHANG) == 0;
+    if (ok)
+    {
+        (void)kill(pid, SIGTERM);
+        (void)waitpid(pid, &status, 0);
+        ok = stress_metric(metrics_path, STRESS_MISSED_METRIC, missed) == 0 && *missed > 0;
+    }
+
+    (void)unlink(stats_path);
+    (void)unlink(metrics_path);
+
+    return ok;
+}
+
+static void stress_print(const struct stress_result *res, size_t n, bool json)
+{
+    const struct stress_result *worst = NULL;
+    const struct stress_result *r;
+    uint64_t near_misses = 0;
+    size_t i;
+
+    if (!json)
+        (void)printf("%-10s %-6s %4s %8s %6s %6s %14s %12s %12s %12s %12s\n", "config", "load", "ok", "feeds", "errors",
+                     "near", "min slack[ms]", "jit p50[us]", "jit p99[us]", "jit max[us]", "ioctl p99[us]");
+
+    for (i = 0; i < n; ++i)
+    {
+        r = &res[i];
+        if (r->ok && r->feeds && (worst == NULL || r->min_slack_ns < worst->min_slack_ns))
+            worst = r;
+
+        near_misses += r->near_misses;
+
+        if (json)
+            (void)printf("{\"config\":\"%s\",\"load\":\"%s\",\"ok\":%s,\"feeds\":%" PRIu64 ",\"errors\":%" PRIu64
+                         ",\"near_misses\":%" PRIu64 ",\"min_slack_ns\":%" PRId64 ",\"jitter_p50_ns\":%" PRIu64
+                         ",\"jitter_p99_ns\":%" PRIu64 ",\"jitter_max_ns\":%" PRIu64 ",\"ioctl_p99_ns\":%" PRIu64 "}\n",
+                         r->config->name, r->load->name, r->ok ? "true" : "false", r->feeds, r->errors,
+                         r->near_misses, r->min_slack_ns == INT64_MAX ? -1 : r->min_slack_ns,
+                         r->jitter_p50_ns, r->jitter_p99_ns, r->jitter_max_ns, r->ioctl_p99_ns);
+        else
+            (void)printf("%-10s %-6s %4s %8" PRIu64 " %6" PRIu64 " %6" PRIu64 " %14" PRId64 " %12" PRIu64
+                         " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+                         r->config->name, r->load->name, r->ok ? "yes" : "NO", r->feeds, r->errors, r->near_misses,
+                         r->min_slack_ns == INT64_MAX ? -1 : r->min_slack_ns / (int64_t)WD_NSEC_PER_MSEC,
+                         r->jitter_p50_ns / WD_NSEC_PER_USEC, r->jitter_p99_ns / WD_NSEC_PER_USEC,
+                         r->jitter_max_ns / WD_NSEC_PER_USEC, r->ioctl_p99_ns / WD_NSEC_PER_USEC);
+    }
+
+    if (json)
+        return;
+
+    if (worst != NULL)
+        (void)printf("worst slack %" PRId64 " ms: config %s, load %s\n",
+                     worst->min_slack_ns / (int64_t)WD_NSEC_PER_MSEC, worst->config->name, worst->load->name);
+
+    (void)printf("near misses %" PRIu64 " in %zu runs\n", near_misses, n);
+}
+
+static void usage(void)
+{
+    (void)printf("HELP\n\n");
+    (void)printf("wd_stress.out [options]\n");
+    (void)printf("--feeder [x]\t\t- feeder binary, default is ./watchdog.out\n");
+    (void)printf("--dev [x]\t\t- device, default is softdog when present, sim: otherwise\n");
+    (void)printf("--timeout [x]\t\t- timeout in seconds, default is %d\n", STRESS_DEFAULT_TIMEOUT_S);
+    (void)printf("--duration [x]\t\t- seconds of every run, default is %d\n", STRESS_DEFAULT_DURATION_S);
+    (void)printf("--config [x]\t\t- feeder config: plain, rt, mlock, adaptive (can be repeated), default is all\n");
+    (void)printf("--load [x]\t\t- load: idle, cpu, mem, fork, io, all (can be repeated), default is all of them\n");
+    (void)printf("--mem-pct [x]\t\t- mem load touches x%% of MemAvailable, default is %d\n", STRESS_DEFAULT_MEM_PCT);
+    (void)printf("--dir [x]\t\t- directory for stats, metrics and fsync load, default is /var/tmp\n");
+    (void)printf("--verbose\t\t- show feeder output\n");
+    (void)printf("--json\t\t\t- print one JSON object per run\n");
+    (void)printf("--help\t\t\t- print this usage\n");
+    (void)printf("\n");
+    (void)printf("Examples\n");
+    (void)printf("./wd_stress.out --duration 5 --config plain --config adaptive --load idle --load cpu\n");
+    (void)printf("sudo ./wd_stress.out --dev sim:timeout=2 --timeout 2 --load all --json\n");
+    (void)printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    static struct stress_result res[STRESS_MAX_RUNS * STRESS_MAX_RUNS];
+    char sim[32];
+    uint64_t missed;
+    bool json = false;
+    bool stalled;
+    size_t nres = 0;
+    size_t i;
+    size_t j;
+    int opt;
+    int val;
+
+    struct option long_option[] =
+    {
+        {"feeder",      required_argument,  0,  'f'},
+        {"dev",         required_argument,  0,  'd'},
+        {"timeout",     required_argument,  0,  't'},
+        {"duration",    required_argument,  0,  'D'},
+        {"config",      required_argument,  0,  'c'},
+        {"load",        required_argument,  0,  'l'},
+        {"mem-pct",     required_argument,  0,  'm'},
+        {"dir",         required_argument,  0,  'o'},
+        {"verbose",     no_argument,        0,  'v'},
+        {"json",        no_argument,        0,  'j'},
+        {"help",        no_argument,        0,  'h'},
+        {NULL,          0,                  0,  0}
+    };
+
+    stress.feeder = "./watchdog.out";
+    stress.dir = "/var/tmp";
+    stress.timeout = STRESS_DEFAULT_TIMEOUT_S;
+    stress.duration = STRESS_DEFAULT_DURATION_S;
+    stress.mem_pct = STRESS_DEFAULT_MEM_PCT;
+
+    while ((opt = getopt_long_only(argc, argv, "", long_option, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'f':
+            {
+                stress.feeder = optarg;
+                break;
+            }
+            case 'd':
+            {
+                stress.dev = optarg;
+                break;
+            }
+            case 't':
+            case 'D':
+            case 'm':
+            {
+                val = atoi(optarg);
+                if (val <= 0 || (opt == 'm' && val > 100))
+                {
+                    (void)fprintf(stderr, "%s [%s] - Incorrect argument\n",
+                                  opt == 't' ? "Timeout" : (opt == 'D' ? "Duration" : "Mem pct"), optarg);
+                    return 1;
+                }
+
+                if (opt == 't')
+                    stress.timeout = (unsigned int)val;
+                else if (opt == 'D')
+                    stress.duration = (unsigned int)val;
+                else
+                    stress.mem_pct = (unsigned int)val;
+
+                break;
+            }
+            case 'c':
+            {
+                for (i = 0; i < sizeof(stress_configs) / sizeof(stress_configs[0]); ++i)
+                    if (strcmp(optarg, stress_configs[i].name) == 0)
+                        break;
+
+                if (i == sizeof(stress_configs) / sizeof(stress_configs[0]) || stress.nconfigs == STRESS_MAX_RUNS)
+                {
+                    (void)fprintf(stderr, "Config [%s] - Incorrect argument\n", optarg);
+                    return 1;
+                }
+
+                stress.configs[stress.nconfigs++] = &stress_configs[i];
+                break;
+            }
+            case 'l':
+            {
+                for (i = 0; i < sizeof(stress_loads) / sizeof(stress_loads[0]); ++i)
+                    if (strcmp(optarg, stress_loads[i].name) == 0)
+                        break;
+
+                if (i == sizeof(stress_loads) / sizeof(stress_loads[0]) || stress.nloads == STRESS_MAX_RUNS)
+                {
+                    (void)fprintf(stderr, "Load [%s] - Incorrect argument\n", optarg);
+                    return 1;
+                }
+
+                stress.loads[stress.nloads++] = &stress_loads[i];
+                break;
+            }
+            case 'o':
+            {
+                stress.dir = optarg;
+                break;
+            }
+            case 'v':
+            {
+                stress.verbose = true;
+                break;
+            }
+            case 'j':
+            {
+                json = true;
+                break;
+            }
+            case 'h':
+            default:
+            {
+                usage();
+                return opt == 'h' ? 0 : 1;
+            }
+        }
+    }
+
+    if (access(stress.feeder, X_OK) != 0)
+    {
+        (void)fprintf(stderr, "Feeder [%s] - Cannot execute, run make first\n", stress.feeder);
+        return 1;
+    }
+
+    if (stress.dev == NULL)
+        stress.dev = stress_softdog();
+
+    if (stress.dev == NULL)
+    {
+        (void)snprintf(sim, sizeof(sim), "sim:timeout=%u", stress.timeout);
+        stress.dev = sim;
+    }
+
+    stress.chardev = strncmp(stress.dev, "sim:", strlen("sim:")) != 0;
+
+    if (stress.nconfigs == 0)
+        for (i = 0; i < sizeof(stress_configs) / sizeof(stress_configs[0]); ++i)
+            stress.configs[stress.nconfigs++] = &stress_configs[i];
+
+    if (stress.nloads == 0)
+        for (i = 0; i < sizeof(stress_loads) / sizeof(stress_loads[0]); ++i)
+            stress.loads[stress.nloads++] = &stress_loads[i];
+
+    if (!json)
+        (void)printf("stress %s, timeout %u s, %u s per run, %zu runs, %ld cpus\n", stress.dev, stress.timeout,
+                     stress.duration, stress.nconfigs * stress.nloads, sysconf(_SC_NPROCESSORS_ONLN));
+
+    for (i = 0; i < stress.nconfigs; ++i)
+        for (j = 0; j < stress.nloads; ++j)
+            stress_run(stress.configs[i], stress.loads[j], &res[nres++]);
+
+    stress_print(res, nres, json);
+
+    stalled = stress_stall(&missed);
+    if (json)
+        (void)printf("{\"config\":\"%s\",\"ok\":%s,\"missed_periods\":%" PRIu64 "}\n", stress_stall_config.name,
+                     stalled ? "true" : "false", missed);
+    else
+        (void)printf("stall %u ms: missed periods %" PRIu64 ", %s\n",
+                     stress.timeout * 1000U * STRESS_STALL_PCT / 100U, missed, stalled ? "ok" : "FAILED");
+
+    return stalled ? 0 : 1;
+}
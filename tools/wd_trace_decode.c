@@ -0,0 +1,170 @@
+/*
+    Decoder of binary wd_* trace written by wd_trace (--trace)
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+    LICENCE: GPL3.0
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <wd_trace.h>
+
+static int decode(const struct wd_trace_hdr *hdr, size_t size, bool json, uint64_t last);
+static void usage(void);
+
+static int decode(const struct wd_trace_hdr *hdr, size_t size, bool json, uint64_t last)
+{
+    const struct wd_trace_rec *recs = (const struct wd_trace_rec *)(hdr + 1);
+    const struct wd_trace_rec *rec;
+    struct wd_trace_rec copy;
+    uint64_t seq;
+    uint64_t first;
+    uint64_t i;
+    uint64_t skipped = 0;
+
+    if (hdr->magic != WD_TRACE_MAGIC || hdr->version != WD_TRACE_VERSION ||
+        hdr->rec_size != sizeof(struct wd_trace_rec) || hdr->nrecs == 0 ||
+        (hdr->nrecs & (hdr->nrecs - 1)) != 0 ||
+        size < sizeof(*hdr) + (size_t)hdr->nrecs * sizeof(struct wd_trace_rec))
+    {
+        (void)fprintf(stderr, "Not a trace file\n");
+        return 1;
+    }
+
+    seq = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE);
+    first = seq > hdr->nrecs ? seq - hdr->nrecs : 0;
+    if (last && seq - first > last)
+        first = seq - last;
+
+    if (!json)
+        (void)printf("pid %" PRIu32 ", %" PRIu64 " calls traced, showing %" PRIu64 "\n",
+                     hdr->pid, seq, seq - first);
+
+    for (i = first; i < seq; ++i)
+    {
+        rec = &recs[i & (hdr->nrecs - 1)];
+        if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != i + 1)
+        {
+            ++skipped;
+            continue;
+        }
+
+        copy = *rec;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        /* overwritten while copying */
+        if (__atomic_load_n(&rec->seq, __ATOMIC_RELAXED) != i + 1)
+        {
+            ++skipped;
+            continue;
+        }
+
+        if (json)
+            (void)printf("{\"seq\":%" PRIu64 ",\"ts_ns\":%" PRIu64 ",\"fn\":\"%s\",\"wd\":%d,\"ret\":%" PRId32
+                         ",\"errno\":%" PRId32 ",\"arg\":%" PRIu32 ",\"lat_ns\":%" PRIu32 "}\n",
+                         i, copy.ts_ns, wd_trace_fn_name(copy.fn), copy.wd, copy.ret, copy.err, copy.arg, copy.lat_ns);
+        else
+            (void)printf("%10" PRIu64 " %12.6f s  %-16s wd %-3d ret %-3" PRId32 " arg %-10" PRIu32 " %8.3f us %s\n",
+                         i, (double)(copy.ts_ns - hdr->start_ns) / 1e9, wd_trace_fn_name(copy.fn),
+                         copy.wd, copy.ret, copy.arg, (double)copy.lat_ns / 1e3, copy.err ? strerror(copy.err) : "");
+    }
+
+    if (skipped)
+        (void)fprintf(stderr, "%" PRIu64 " records skipped (overwritten or in progress)\n", skipped);
+
+    return 0;
+}
+
+static void usage(void)
+{
+    (void)printf("HELP\n\n");
+    (void)printf("wd_trace_decode.out [options] FILE\n");
+    (void)printf("--last [x]\t\t- decode only x newest records\n");
+    (void)printf("--json\t\t\t- print one JSON object per record\n");
+    (void)printf("--help\t\t\t- print this usage\n");
+    (void)printf("\n");
+    (void)printf("Examples\n");
+    (void)printf("./watchdog.out --trace /tmp/wd.trace --dev sim: --get-snapshot\n");
+    (void)printf("./wd_trace_decode.out --last 100 /tmp/wd.trace\n");
+    (void)printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    const struct wd_trace_hdr *hdr;
+    struct stat st;
+    uint64_t last = 0;
+    bool json = false;
+    int opt;
+    int fd;
+    int ret;
+
+    struct option long_option[] =
+    {
+        {"last",    required_argument,  0,  'l'},
+        {"json",    no_argument,        0,  'j'},
+        {"help",    no_argument,        0,  'h'},
+        {NULL,      0,                  0,  0}
+    };
+
+    while ((opt = getopt_long_only(argc, argv, "", long_option, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'l':
+            {
+                last = (uint64_t)strtoull(optarg, NULL, 0);
+                break;
+            }
+            case 'j':
+            {
+                json = true;
+                break;
+            }
+            case 'h':
+            default:
+            {
+                usage();
+                return opt == 'h' ? 0 : 1;
+            }
+        }
+    }
+
+    if (optind >= argc)
+    {
+        usage();
+        return 1;
+    }
+
+    fd = open(argv[optind], O_RDONLY | O_CLOEXEC);
+    if (fd == -1 || fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(*hdr))
+    {
+        perror(argv[optind]);
+        if (fd != -1)
+            (void)close(fd);
+
+        return 1;
+    }
+
+    hdr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    (void)close(fd);
+    if (hdr == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    ret = decode(hdr, (size_t)st.st_size, json, last);
+    (void)munmap((void *)hdr, (size_t)st.st_size);
+
+    return ret;
+}